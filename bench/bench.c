@@ -0,0 +1,411 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * bench.c - Microbenchmarks of the parser and filter entry points, run on the
+ * fixed sections in fixtures.c. Each benchmark repeats an operation in rounds,
+ * anything it needs set up again between rounds outside the timing, until it
+ * has run long enough. Results are time, cycles and allocations an operation,
+ * written as tab separated lines which a later run can be compared against.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <malloc.h>
+#include "slowlane.h"
+#include "crc32.h"
+#include "data.h"
+#include "si.h"
+#include "index.h"
+#include "libslowlane.h"
+#include "fixtures.h"
+
+#define BENCH_NAME_MAX 64
+#define BENCH_RESULTS_MAX 64
+#define BENCH_BUFFER_SIZE 4096
+#define BENCH_SAMPLES 5
+
+/* Marks the first line of a results file. */
+#define BENCH_HEADER "# slowlane-bench name ops ns/op cycles/op cycles/byte allocs/op"
+
+/* Allocations are counted by wrapping the allocator at link time, see the Makefile. */
+static unsigned long bench_allocations;
+
+void * __real_malloc (size_t size);
+void * __real_calloc (size_t count, size_t size);
+void * __real_realloc (void *pointer, size_t size);
+char * __real_strdup (const char *text);
+
+void * __wrap_malloc (size_t size) { bench_allocations++; return __real_malloc(size); }
+void * __wrap_calloc (size_t count, size_t size) { bench_allocations++; return __real_calloc(count, size); }
+void * __wrap_realloc (void *pointer, size_t size) { bench_allocations++; return __real_realloc(pointer, size); }
+char * __wrap_strdup (const char *text) { bench_allocations++; return __real_strdup(text); }
+
+/* Cycles are the time stamp counter where there is one, none elsewhere. */
+static inline unsigned long long bench_cycles (void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return 0;
+#endif
+}
+
+typedef struct tBench {
+	const char		*name;
+
+	/* The fixture each operation works on, copied somewhere writable. */
+	const unsigned char	*fixture;
+	const int		*length;
+
+	/* Set when the length is what cycles/byte is of. */
+	int			per_byte;
+
+	/* Operations a round, the model and objects being set up again before each. */
+	unsigned int		round;
+	void			(*reset) (struct tBench *bench);
+	void			(*op) (struct tBench *bench);
+} Bench;
+
+typedef struct tBenchResult {
+	char		name[BENCH_NAME_MAX];
+	unsigned long	ops;
+	double		ns;
+	double		cycles;
+	double		cycles_per_byte;
+	double		allocations;
+} BenchResult;
+
+/* What the operations work on. */
+static Slowlane bench_context;
+static unsigned char bench_buffer[BENCH_BUFFER_SIZE];
+static Transport *bench_transport;
+static Service *bench_service;
+static OpenTVChannel bench_channel;
+static ChannelIndex bench_lineup;
+static RegionSet bench_regions;
+static volatile unsigned long bench_sink;
+
+/* Parse a section into the model ahead of those relying on it. */
+static void bench_prime (const unsigned char *fixture, int length) {
+	memcpy(bench_buffer, fixture, length);
+	si_process(bench_buffer, length, 1);
+}
+
+/* An empty model, with the fixture in the buffer. */
+static void bench_reset_model (Bench *bench) {
+	data_model_free(&bench_context.model);
+	data_model_init(&bench_context.model);
+	memcpy(bench_buffer, bench->fixture, *bench->length);
+}
+
+/* A model holding the tables the fixture refers to but not the fixture, the
+ * SDT and BAT needing the NIT's transports and the EIT the SDT's services. */
+static void bench_reset_tables (Bench *bench) {
+	data_model_free(&bench_context.model);
+	data_model_init(&bench_context.model);
+
+	if (bench->fixture != bench_nit) {
+		bench_prime(bench_nit, bench_nit_length);
+	}
+
+	if (bench->fixture == bench_eit) {
+		bench_prime(bench_sdt, bench_sdt_length);
+	}
+
+	memcpy(bench_buffer, bench->fixture, *bench->length);
+}
+
+/* A model which has seen the section already, so it's dropped as a repeat. */
+static void bench_reset_repeat (Bench *bench) {
+	bench_reset_tables(bench);
+	si_process(bench_buffer, *bench->length, 1);
+}
+
+/* The objects descriptors are parsed into, as the sections would have made them. */
+static void bench_reset_objects (Bench *bench) {
+	Network *network;
+	Bouquet *bouquet;
+
+	bench_reset_model(bench);
+
+	network = network_add(2);
+	bench_transport = transport_add(network, 2, 2000);
+	bench_service = service_add(bench_transport, 1001);
+	bouquet = bouquet_add(4101);
+
+	memset(&bench_channel, '\0', sizeof(OpenTVChannel));
+	bench_channel.bouquet = bouquet_lookup(bouquet->bouquet_id);
+	bench_channel.transport_id = 2000;
+	bench_channel.original_network_id = 2;
+}
+
+/* The network, services and bouquet, for a lineup to be filtered from. */
+static void bench_reset_lineup (Bench *bench) {
+	bench_reset_tables(bench);
+	si_process(bench_buffer, *bench->length, 1);
+	bench_prime(bench_sdt, bench_sdt_length);
+}
+
+static void bench_crc32 (Bench *bench) {
+	bench_sink += crc32((char *) bench_buffer, *bench->length, 0xffffffff);
+}
+
+static void bench_si_process (Bench *bench) {
+	bench_sink += si_process(bench_buffer, *bench->length, 1);
+}
+
+static void bench_descriptors_service (Bench *bench) {
+	bench_sink += si_process_service_descriptors(bench_buffer, *bench->length, bench_service);
+}
+
+static void bench_descriptors_channels (Bench *bench) {
+	bench_sink += si_process_bouquet_transport_descriptors(bench_buffer, *bench->length, &bench_channel);
+}
+
+static void bench_descriptor_satellite_delivery (Bench *bench) {
+	bench_sink += si_process_descriptor_satellite_delivery_system(bench_buffer, *bench->length, bench_transport);
+}
+
+static void bench_filter (Bench *bench) {
+	bench_sink += filter_data(&bench_lineup, 4101, &bench_regions, 2, 1, 0xffff);
+	bench_sink += bench_lineup.count;
+	channel_index_free(&bench_lineup);
+}
+
+/* Region 4 only for filter_data/region, see bench_run. */
+static Bench benches[] = {
+	{ "crc32/nit", bench_nit, &bench_nit_length, 1, 1024, bench_reset_model, bench_crc32 },
+	{ "crc32/sdt", bench_sdt, &bench_sdt_length, 1, 1024, bench_reset_model, bench_crc32 },
+	{ "crc32/bat", bench_bat, &bench_bat_length, 1, 1024, bench_reset_model, bench_crc32 },
+	{ "crc32/eit", bench_eit, &bench_eit_length, 1, 1024, bench_reset_model, bench_crc32 },
+	{ "si_process/nit", bench_nit, &bench_nit_length, 1, 1, bench_reset_tables, bench_si_process },
+	{ "si_process/sdt", bench_sdt, &bench_sdt_length, 1, 1, bench_reset_tables, bench_si_process },
+	{ "si_process/bat", bench_bat, &bench_bat_length, 1, 1, bench_reset_tables, bench_si_process },
+	{ "si_process/eit", bench_eit, &bench_eit_length, 1, 1, bench_reset_tables, bench_si_process },
+	{ "si_process/nit-repeat", bench_nit, &bench_nit_length, 1, 1024, bench_reset_repeat, bench_si_process },
+	{ "si_process/sdt-repeat", bench_sdt, &bench_sdt_length, 1, 1024, bench_reset_repeat, bench_si_process },
+	{ "si_process/bat-repeat", bench_bat, &bench_bat_length, 1, 1024, bench_reset_repeat, bench_si_process },
+	{ "si_process/eit-repeat", bench_eit, &bench_eit_length, 1, 1024, bench_reset_repeat, bench_si_process },
+	{ "si_process_service_descriptors", bench_service_descriptors, &bench_service_descriptors_length, 1, 1024, bench_reset_objects, bench_descriptors_service },
+	{ "si_process_bouquet_transport_descriptors", bench_channel_descriptors, &bench_channel_descriptors_length, 1, 256, bench_reset_objects, bench_descriptors_channels },
+	{ "si_process_descriptor_satellite_delivery_system", bench_satellite_delivery, &bench_satellite_delivery_length, 1, 1024, bench_reset_objects, bench_descriptor_satellite_delivery },
+	{ "filter_data/bouquet", bench_bat, &bench_bat_length, 0, 64, bench_reset_lineup, bench_filter },
+	{ "filter_data/region", bench_bat, &bench_bat_length, 0, 64, bench_reset_lineup, bench_filter }
+};
+
+/* Repeat a benchmark in rounds until it has been timed for at least min_ns,
+ * as BENCH_SAMPLES samples of which the fastest is kept, being the least
+ * disturbed by anything else running. */
+static void bench_run (Bench *bench, long long min_ns, BenchResult *result) {
+	unsigned long long cycles, cycles_start;
+	unsigned long allocations, allocations_start, ops, total = 0;
+	struct timespec start, end;
+	long long ns;
+	unsigned int i, sample;
+
+	memset(result, '\0', sizeof(BenchResult));
+	snprintf(result->name, sizeof(result->name), "%s", bench->name);
+
+	memset(&bench_regions, '\0', sizeof(RegionSet));
+
+	if (strcmp(bench->name, "filter_data/region") == 0) {
+		region_set_add(&bench_regions, 4);
+	}
+
+	for (sample = 0; sample < BENCH_SAMPLES; sample++) {
+		for (ns = 0, cycles = 0, allocations = 0, ops = 0; ns < min_ns / BENCH_SAMPLES;) {
+			bench->reset(bench);
+
+			allocations_start = bench_allocations;
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			cycles_start = bench_cycles();
+
+			for (i = 0; i < bench->round; i++) {
+				bench->op(bench);
+			}
+
+			cycles += bench_cycles() - cycles_start;
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			allocations += bench_allocations - allocations_start;
+
+			ns += (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+			ops += bench->round;
+		}
+
+		total += ops;
+
+		if (sample == 0 || (double) ns / ops < result->ns) {
+			result->ns = (double) ns / ops;
+			result->cycles = (double) cycles / ops;
+			result->allocations = (double) allocations / ops;
+		}
+	}
+
+	result->ops = total;
+	result->cycles_per_byte = bench->per_byte ? result->cycles / *bench->length : 0;
+}
+
+static void bench_print (FILE *out, BenchResult *result, int aligned) {
+	if (aligned) {
+		fprintf(out, "%-48s %9lu %10.1f %10.0f %8.2f %8.2f\n", result->name, result->ops, result->ns, result->cycles, result->cycles_per_byte, result->allocations);
+	} else {
+		fprintf(out, "%s\t%lu\t%.1f\t%.0f\t%.3f\t%.3f\n", result->name, result->ops, result->ns, result->cycles, result->cycles_per_byte, result->allocations);
+	}
+}
+
+/* Read results written with -o, returns how many or -1. */
+static int bench_load (const char *filename, BenchResult *results) {
+	char line[256];
+	int count = 0;
+	FILE *file;
+
+	if ((file = fopen(filename, "r")) == NULL) {
+		slowlane_log(0, "Unable to open bench results %s.", filename);
+		return -1;
+	}
+
+	if (fgets(line, sizeof(line), file) == NULL || strncmp(line, BENCH_HEADER, strlen(BENCH_HEADER)) != 0) {
+		slowlane_log(0, "%s isn't a bench results file.", filename);
+		fclose(file);
+		return -1;
+	}
+
+	while (count < BENCH_RESULTS_MAX && fgets(line, sizeof(line), file) != NULL) {
+		if (sscanf(line, "%63s %lu %lf %lf %lf %lf", results[count].name, &results[count].ops, &results[count].ns, &results[count].cycles, &results[count].cycles_per_byte, &results[count].allocations) == 6) {
+			count++;
+		}
+	}
+
+	fclose(file);
+
+	return count;
+}
+
+/* Compare against a baseline, a benchmark regressing if its time grew by more
+ * than threshold percent or it allocates more. Returns the regressions. */
+static int bench_compare (BenchResult *baseline, int baseline_count, BenchResult *results, int count, double threshold) {
+	int i, j, regressions = 0, regressed;
+	double change;
+
+	printf("# compare name old_ns/op new_ns/op change%% old_allocs/op new_allocs/op\n");
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < baseline_count && strcmp(baseline[j].name, results[i].name) != 0; j++);
+
+		if (j == baseline_count) {
+			printf("C %-48s %10s %10.1f %8s %8s %8.2f new\n", results[i].name, "-", results[i].ns, "-", "-", results[i].allocations);
+			continue;
+		}
+
+		change = baseline[j].ns > 0 ? (results[i].ns - baseline[j].ns) * 100 / baseline[j].ns : 0;
+		regressed = change > threshold || results[i].allocations > baseline[j].allocations + 0.005;
+		regressions += regressed;
+
+		printf("C %-48s %10.1f %10.1f %+7.1f%% %8.2f %8.2f %s\n", results[i].name, baseline[j].ns, results[i].ns, change, baseline[j].allocations, results[i].allocations, regressed ? "REGRESSION" : "ok");
+	}
+
+	printf("# %i regressions above %.1f%%\n", regressions, threshold);
+
+	return regressions;
+}
+
+static void usage (void) {
+	printf("%s bench (%s) by %s\n", SLOWLANE_NAME, SLOWLANE_VERSION, SLOWLANE_AUTHOR);
+	printf("\t-m <ms>\t\tTime Each Benchmark for at Least <ms> (<default = 200>)\n");
+	printf("\t-n <name>\tOnly Run Benchmarks Whose Names Contain <name>\n");
+	printf("\t-o <file>\tWrite the Results to <file> as Tab Separated Lines\n");
+	printf("\t-i <file>\tRead Results from <file> Rather Than Running\n");
+	printf("\t-c <file>\tCompare the Results Against Those in <file>, Failing on Regressions\n");
+	printf("\t-t <percent>\tSlow Down Counted as a Regression (<default = 10>)\n");
+}
+
+int main (int argc, char *argv[]) {
+	static BenchResult results[BENCH_RESULTS_MAX], baseline[BENCH_RESULTS_MAX];
+	const char *only = NULL, *output = NULL, *input = NULL, *compare = NULL;
+	int ch, i, count = 0, baseline_count = 0, regressions = 0;
+	double threshold = 10;
+	long long min_ns = 200000000LL;
+	FILE *out;
+
+	while ((ch = getopt(argc, argv, "m:n:o:i:c:t:h")) != -1) {
+		switch (ch) {
+			case 'm':
+				min_ns = atoll(optarg) * 1000000LL;
+				break;
+			case 'n':
+				only = optarg;
+				break;
+			case 'o':
+				output = optarg;
+				break;
+			case 'i':
+				input = optarg;
+				break;
+			case 'c':
+				compare = optarg;
+				break;
+			case 't':
+				threshold = atof(optarg);
+				break;
+			default:
+				usage();
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (compare && (baseline_count = bench_load(compare, baseline)) < 0) {
+		return EXIT_FAILURE;
+	}
+
+	if (input) {
+		if ((count = bench_load(input, results)) < 0) {
+			return EXIT_FAILURE;
+		}
+	} else {
+		/* Fix where glibc starts using mmap, else it moves with the pool
+		 * chunks freed and cold parses run at one of two speeds. */
+		mallopt(M_MMAP_THRESHOLD, 128 * 1024);
+
+		slowlane_init(&bench_context);
+		slowlane_select(&bench_context);
+
+		printf("%-48s %9s %10s %10s %8s %8s\n", "# name", "ops", "ns/op", "cycles/op", "cyc/byte", "allocs");
+
+		for (i = 0; i < (int) (sizeof(benches) / sizeof(Bench)); i++) {
+			if (only && strstr(benches[i].name, only) == NULL) {
+				continue;
+			}
+
+			bench_run(&benches[i], min_ns, &results[count]);
+			bench_print(stdout, &results[count++], 1);
+		}
+
+		slowlane_free(&bench_context);
+	}
+
+	if (output) {
+		if ((out = fopen(output, "w")) == NULL) {
+			slowlane_log(0, "Unable to write bench results to %s.", output);
+			return EXIT_FAILURE;
+		}
+
+		fprintf(out, "%s\n", BENCH_HEADER);
+
+		for (i = 0; i < count; i++) {
+			bench_print(out, &results[i], 0);
+		}
+
+		fclose(out);
+	}
+
+	if (compare) {
+		regressions = bench_compare(baseline, baseline_count, results, count, threshold);
+	}
+
+	return regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+}
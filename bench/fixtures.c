@@ -0,0 +1,151 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * fixtures.c - Sections and descriptor loops the benchmarks run on. They are
+ * fixed so results compare between builds, and laid out as Sky's are: one
+ * network, transports 2000 to 2007 on network 2, services 1001 to 1012 on
+ * transport 2000 and bouquet 4101 listing them for regions 1 and 4. Sections
+ * are whole, from table id to CRC.
+ */
+
+#include "fixtures.h"
+
+/* NIT of network 2, named, with eight transports each with a satellite delivery descriptor. */
+const unsigned char bench_nit[181] = {
+	0x40, 0xf0, 0xb2, 0x00, 0x02, 0xc3, 0x00, 0x00, 0xf0, 0x0d, 0x40, 0x0b,
+	0x53, 0x6b, 0x79, 0x20, 0x4e, 0x65, 0x74, 0x77, 0x6f, 0x72, 0x6b, 0xf0,
+	0x98, 0x07, 0xd0, 0x00, 0x02, 0xf0, 0x0d, 0x43, 0x0b, 0x01, 0x10, 0x00,
+	0x00, 0x02, 0x82, 0x05, 0x00, 0x27, 0x50, 0x03, 0x07, 0xd1, 0x00, 0x02,
+	0xf0, 0x0d, 0x43, 0x0b, 0x01, 0x10, 0x20, 0x00, 0x02, 0x82, 0x21, 0x00,
+	0x27, 0x50, 0x03, 0x07, 0xd2, 0x00, 0x02, 0xf0, 0x0d, 0x43, 0x0b, 0x01,
+	0x10, 0x40, 0x00, 0x02, 0x82, 0x01, 0x00, 0x27, 0x50, 0x03, 0x07, 0xd3,
+	0x00, 0x02, 0xf0, 0x0d, 0x43, 0x0b, 0x01, 0x10, 0x60, 0x00, 0x02, 0x82,
+	0x21, 0x00, 0x27, 0x50, 0x03, 0x07, 0xd4, 0x00, 0x02, 0xf0, 0x0d, 0x43,
+	0x0b, 0x01, 0x10, 0x80, 0x00, 0x02, 0x82, 0x05, 0x00, 0x27, 0x50, 0x03,
+	0x07, 0xd5, 0x00, 0x02, 0xf0, 0x0d, 0x43, 0x0b, 0x01, 0x11, 0x00, 0x00,
+	0x02, 0x82, 0x21, 0x00, 0x27, 0x50, 0x03, 0x07, 0xd6, 0x00, 0x02, 0xf0,
+	0x0d, 0x43, 0x0b, 0x01, 0x11, 0x20, 0x00, 0x02, 0x82, 0x01, 0x00, 0x27,
+	0x50, 0x03, 0x07, 0xd7, 0x00, 0x02, 0xf0, 0x0d, 0x43, 0x0b, 0x01, 0x11,
+	0x40, 0x00, 0x02, 0x82, 0x21, 0x00, 0x27, 0x50, 0x03, 0x82, 0xe2, 0x89,
+	0x74
+};
+
+/* SDT actual of transport 2000, twelve services with service descriptors, every third a hidden name. */
+const unsigned char bench_sdt[379] = {
+	0x42, 0xf1, 0x78, 0x07, 0xd0, 0xc5, 0x00, 0x00, 0x00, 0x02, 0xff, 0x03,
+	0xe9, 0xfc, 0x80, 0x16, 0x48, 0x14, 0x01, 0x05, 0x42, 0x53, 0x6b, 0x79,
+	0x42, 0x0c, 0x43, 0x68, 0x61, 0x6e, 0x6e, 0x65, 0x6c, 0x20, 0x31, 0x30,
+	0x30, 0x31, 0x03, 0xea, 0xfc, 0x80, 0x20, 0x48, 0x14, 0x01, 0x05, 0x42,
+	0x53, 0x6b, 0x79, 0x42, 0x0c, 0x43, 0x68, 0x61, 0x6e, 0x6e, 0x65, 0x6c,
+	0x20, 0x31, 0x30, 0x30, 0x32, 0xc0, 0x08, 0x41, 0x6c, 0x74, 0x20, 0x31,
+	0x30, 0x30, 0x32, 0x03, 0xeb, 0xfc, 0x80, 0x16, 0x48, 0x14, 0x19, 0x05,
+	0x42, 0x53, 0x6b, 0x79, 0x42, 0x0c, 0x43, 0x68, 0x61, 0x6e, 0x6e, 0x65,
+	0x6c, 0x20, 0x31, 0x30, 0x30, 0x33, 0x03, 0xec, 0xfc, 0x80, 0x16, 0x48,
+	0x14, 0x02, 0x05, 0x42, 0x53, 0x6b, 0x79, 0x42, 0x0c, 0x43, 0x68, 0x61,
+	0x6e, 0x6e, 0x65, 0x6c, 0x20, 0x31, 0x30, 0x30, 0x34, 0x03, 0xed, 0xfc,
+	0x80, 0x20, 0x48, 0x14, 0x01, 0x05, 0x42, 0x53, 0x6b, 0x79, 0x42, 0x0c,
+	0x43, 0x68, 0x61, 0x6e, 0x6e, 0x65, 0x6c, 0x20, 0x31, 0x30, 0x30, 0x35,
+	0xc0, 0x08, 0x41, 0x6c, 0x74, 0x20, 0x31, 0x30, 0x30, 0x35, 0x03, 0xee,
+	0xfc, 0x80, 0x16, 0x48, 0x14, 0x01, 0x05, 0x42, 0x53, 0x6b, 0x79, 0x42,
+	0x0c, 0x43, 0x68, 0x61, 0x6e, 0x6e, 0x65, 0x6c, 0x20, 0x31, 0x30, 0x30,
+	0x36, 0x03, 0xef, 0xfc, 0x80, 0x16, 0x48, 0x14, 0x19, 0x05, 0x42, 0x53,
+	0x6b, 0x79, 0x42, 0x0c, 0x43, 0x68, 0x61, 0x6e, 0x6e, 0x65, 0x6c, 0x20,
+	0x31, 0x30, 0x30, 0x37, 0x03, 0xf0, 0xfc, 0x80, 0x20, 0x48, 0x14, 0x02,
+	0x05, 0x42, 0x53, 0x6b, 0x79, 0x42, 0x0c, 0x43, 0x68, 0x61, 0x6e, 0x6e,
+	0x65, 0x6c, 0x20, 0x31, 0x30, 0x30, 0x38, 0xc0, 0x08, 0x41, 0x6c, 0x74,
+	0x20, 0x31, 0x30, 0x30, 0x38, 0x03, 0xf1, 0xfc, 0x80, 0x16, 0x48, 0x14,
+	0x01, 0x05, 0x42, 0x53, 0x6b, 0x79, 0x42, 0x0c, 0x43, 0x68, 0x61, 0x6e,
+	0x6e, 0x65, 0x6c, 0x20, 0x31, 0x30, 0x30, 0x39, 0x03, 0xf2, 0xfc, 0x80,
+	0x16, 0x48, 0x14, 0x01, 0x05, 0x42, 0x53, 0x6b, 0x79, 0x42, 0x0c, 0x43,
+	0x68, 0x61, 0x6e, 0x6e, 0x65, 0x6c, 0x20, 0x31, 0x30, 0x31, 0x30, 0x03,
+	0xf3, 0xfc, 0x80, 0x20, 0x48, 0x14, 0x19, 0x05, 0x42, 0x53, 0x6b, 0x79,
+	0x42, 0x0c, 0x43, 0x68, 0x61, 0x6e, 0x6e, 0x65, 0x6c, 0x20, 0x31, 0x30,
+	0x31, 0x31, 0xc0, 0x08, 0x41, 0x6c, 0x74, 0x20, 0x31, 0x30, 0x31, 0x31,
+	0x03, 0xf4, 0xfc, 0x80, 0x16, 0x48, 0x14, 0x02, 0x05, 0x42, 0x53, 0x6b,
+	0x79, 0x42, 0x0c, 0x43, 0x68, 0x61, 0x6e, 0x6e, 0x65, 0x6c, 0x20, 0x31,
+	0x30, 0x31, 0x32, 0xf2, 0x0a, 0x71, 0x01
+};
+
+/* BAT of bouquet 4101, named, transport 2000 carrying the twelve services as channels of regions 1 and 4. */
+const unsigned char bench_bat[263] = {
+	0x4a, 0xf1, 0x04, 0x10, 0x05, 0xc7, 0x00, 0x00, 0xf0, 0x11, 0x47, 0x0f,
+	0x42, 0x53, 0x6b, 0x79, 0x42, 0x20, 0x42, 0x6f, 0x75, 0x71, 0x75, 0x65,
+	0x74, 0x20, 0x35, 0xf0, 0xe6, 0x07, 0xd0, 0x00, 0x02, 0xf0, 0xe0, 0xb1,
+	0x6e, 0xff, 0x01, 0x03, 0xe9, 0x01, 0x00, 0x79, 0x00, 0x65, 0x12, 0x34,
+	0x03, 0xea, 0x01, 0x00, 0x7a, 0x00, 0x66, 0x12, 0x34, 0x03, 0xeb, 0x19,
+	0x00, 0x7b, 0x00, 0x67, 0x12, 0x34, 0x03, 0xec, 0x02, 0x00, 0x7c, 0x00,
+	0x68, 0x12, 0x34, 0x03, 0xed, 0x01, 0x00, 0x7d, 0x00, 0x69, 0x12, 0x34,
+	0x03, 0xee, 0x01, 0x00, 0x7e, 0x00, 0x6a, 0x12, 0x34, 0x03, 0xef, 0x19,
+	0x00, 0x7f, 0x00, 0x6b, 0x12, 0x34, 0x03, 0xf0, 0x02, 0x00, 0x80, 0x00,
+	0x6c, 0x12, 0x34, 0x03, 0xf1, 0x01, 0x00, 0x81, 0x00, 0x6d, 0x12, 0x34,
+	0x03, 0xf2, 0x01, 0x00, 0x82, 0x00, 0x6e, 0x12, 0x34, 0x03, 0xf3, 0x19,
+	0x00, 0x83, 0x00, 0x6f, 0x12, 0x34, 0x03, 0xf4, 0x02, 0x00, 0x84, 0x00,
+	0x70, 0x12, 0x34, 0xb1, 0x6e, 0xff, 0x04, 0x03, 0xe9, 0x01, 0x00, 0xb5,
+	0x00, 0x65, 0x12, 0x34, 0x03, 0xea, 0x01, 0x00, 0xb6, 0x00, 0x66, 0x12,
+	0x34, 0x03, 0xeb, 0x19, 0x00, 0xb7, 0x00, 0x67, 0x12, 0x34, 0x03, 0xec,
+	0x02, 0x00, 0xb8, 0x00, 0x68, 0x12, 0x34, 0x03, 0xed, 0x01, 0x00, 0xb9,
+	0x00, 0x69, 0x12, 0x34, 0x03, 0xee, 0x01, 0x00, 0xba, 0x00, 0x6a, 0x12,
+	0x34, 0x03, 0xef, 0x19, 0x00, 0xbb, 0x00, 0x6b, 0x12, 0x34, 0x03, 0xf0,
+	0x02, 0x00, 0xbc, 0x00, 0x6c, 0x12, 0x34, 0x03, 0xf1, 0x01, 0x00, 0xbd,
+	0x00, 0x6d, 0x12, 0x34, 0x03, 0xf2, 0x01, 0x00, 0xbe, 0x00, 0x6e, 0x12,
+	0x34, 0x03, 0xf3, 0x19, 0x00, 0xbf, 0x00, 0x6f, 0x12, 0x34, 0x03, 0xf4,
+	0x02, 0x00, 0xc0, 0x00, 0x70, 0x12, 0x34, 0x3e, 0xc5, 0x62, 0xdb
+};
+
+/* EIT present/following of service 1001, two events with short event descriptors. */
+const unsigned char bench_eit[104] = {
+	0x4e, 0xf0, 0x65, 0x03, 0xe9, 0xc9, 0x00, 0x01, 0x07, 0xd0, 0x00, 0x02,
+	0x01, 0x4e, 0x00, 0x64, 0xeb, 0x66, 0x22, 0x13, 0x20, 0x00, 0x30, 0x00,
+	0x80, 0x23, 0x4d, 0x21, 0x65, 0x6e, 0x67, 0x0b, 0x4e, 0x65, 0x77, 0x73,
+	0x20, 0x61, 0x74, 0x20, 0x53, 0x69, 0x78, 0x11, 0x41, 0x62, 0x6f, 0x75,
+	0x74, 0x20, 0x4e, 0x65, 0x77, 0x73, 0x20, 0x61, 0x74, 0x20, 0x53, 0x69,
+	0x78, 0x00, 0x65, 0xeb, 0x66, 0x22, 0x43, 0x20, 0x00, 0x30, 0x00, 0x80,
+	0x1b, 0x4d, 0x19, 0x65, 0x6e, 0x67, 0x07, 0x57, 0x65, 0x61, 0x74, 0x68,
+	0x65, 0x72, 0x0d, 0x41, 0x62, 0x6f, 0x75, 0x74, 0x20, 0x57, 0x65, 0x61,
+	0x74, 0x68, 0x65, 0x72, 0x77, 0xcf, 0x0f, 0x5a
+};
+
+/* Descriptor loop of a service, a service descriptor and a hidden name. */
+const unsigned char bench_service_descriptors[32] = {
+	0x48, 0x14, 0x01, 0x05, 0x42, 0x53, 0x6b, 0x79, 0x42, 0x0c, 0x43, 0x68,
+	0x61, 0x6e, 0x6e, 0x65, 0x6c, 0x20, 0x31, 0x30, 0x30, 0x32, 0xc0, 0x08,
+	0x41, 0x6c, 0x74, 0x20, 0x31, 0x30, 0x30, 0x32
+};
+
+/* Body of a satellite delivery system descriptor, DVB-S2 at 11.000 GHz. */
+const unsigned char bench_satellite_delivery[11] = {
+	0x01, 0x10, 0x00, 0x00, 0x02, 0x82, 0x05, 0x00, 0x27, 0x50, 0x03
+};
+
+/* Descriptor loop of a BAT transport, channel information for regions 1 and 4. */
+const unsigned char bench_channel_descriptors[224] = {
+	0xb1, 0x6e, 0xff, 0x01, 0x03, 0xe9, 0x01, 0x00, 0x79, 0x00, 0x65, 0x12,
+	0x34, 0x03, 0xea, 0x01, 0x00, 0x7a, 0x00, 0x66, 0x12, 0x34, 0x03, 0xeb,
+	0x19, 0x00, 0x7b, 0x00, 0x67, 0x12, 0x34, 0x03, 0xec, 0x02, 0x00, 0x7c,
+	0x00, 0x68, 0x12, 0x34, 0x03, 0xed, 0x01, 0x00, 0x7d, 0x00, 0x69, 0x12,
+	0x34, 0x03, 0xee, 0x01, 0x00, 0x7e, 0x00, 0x6a, 0x12, 0x34, 0x03, 0xef,
+	0x19, 0x00, 0x7f, 0x00, 0x6b, 0x12, 0x34, 0x03, 0xf0, 0x02, 0x00, 0x80,
+	0x00, 0x6c, 0x12, 0x34, 0x03, 0xf1, 0x01, 0x00, 0x81, 0x00, 0x6d, 0x12,
+	0x34, 0x03, 0xf2, 0x01, 0x00, 0x82, 0x00, 0x6e, 0x12, 0x34, 0x03, 0xf3,
+	0x19, 0x00, 0x83, 0x00, 0x6f, 0x12, 0x34, 0x03, 0xf4, 0x02, 0x00, 0x84,
+	0x00, 0x70, 0x12, 0x34, 0xb1, 0x6e, 0xff, 0x04, 0x03, 0xe9, 0x01, 0x00,
+	0xb5, 0x00, 0x65, 0x12, 0x34, 0x03, 0xea, 0x01, 0x00, 0xb6, 0x00, 0x66,
+	0x12, 0x34, 0x03, 0xeb, 0x19, 0x00, 0xb7, 0x00, 0x67, 0x12, 0x34, 0x03,
+	0xec, 0x02, 0x00, 0xb8, 0x00, 0x68, 0x12, 0x34, 0x03, 0xed, 0x01, 0x00,
+	0xb9, 0x00, 0x69, 0x12, 0x34, 0x03, 0xee, 0x01, 0x00, 0xba, 0x00, 0x6a,
+	0x12, 0x34, 0x03, 0xef, 0x19, 0x00, 0xbb, 0x00, 0x6b, 0x12, 0x34, 0x03,
+	0xf0, 0x02, 0x00, 0xbc, 0x00, 0x6c, 0x12, 0x34, 0x03, 0xf1, 0x01, 0x00,
+	0xbd, 0x00, 0x6d, 0x12, 0x34, 0x03, 0xf2, 0x01, 0x00, 0xbe, 0x00, 0x6e,
+	0x12, 0x34, 0x03, 0xf3, 0x19, 0x00, 0xbf, 0x00, 0x6f, 0x12, 0x34, 0x03,
+	0xf4, 0x02, 0x00, 0xc0, 0x00, 0x70, 0x12, 0x34
+};
+
+const int bench_nit_length = sizeof(bench_nit);
+const int bench_sdt_length = sizeof(bench_sdt);
+const int bench_bat_length = sizeof(bench_bat);
+const int bench_eit_length = sizeof(bench_eit);
+const int bench_service_descriptors_length = sizeof(bench_service_descriptors);
+const int bench_satellite_delivery_length = sizeof(bench_satellite_delivery);
+const int bench_channel_descriptors_length = sizeof(bench_channel_descriptors);
@@ -0,0 +1,27 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * fixtures.h - Benchmark fixture headers.
+ */
+
+#ifndef __FIXTURES_H_
+#define __FIXTURES_H_ 1
+
+extern const unsigned char bench_nit[];
+extern const int bench_nit_length;
+extern const unsigned char bench_sdt[];
+extern const int bench_sdt_length;
+extern const unsigned char bench_bat[];
+extern const int bench_bat_length;
+extern const unsigned char bench_eit[];
+extern const int bench_eit_length;
+extern const unsigned char bench_service_descriptors[];
+extern const int bench_service_descriptors_length;
+extern const unsigned char bench_satellite_delivery[];
+extern const int bench_satellite_delivery_length;
+extern const unsigned char bench_channel_descriptors[];
+extern const int bench_channel_descriptors_length;
+
+#endif
@@ -22,7 +22,13 @@ FasterCSV.foreach("/home/peter/slowlane/output") do |row|
   end 
 
   name = db.escape_string(row[9])
-  db.query("INSERT INTO channel (chanid, channum, sourceid, callsign, name, useonairguide, mplexid, serviceid) VALUES (#{row[8].to_i}, #{row[8].to_i}, 1, '#{name}', '#{name}', 0, #{mplexid}, #{row[7].to_i})")
+
+  # Run with -X the xmltvid, callsign and icon follow, empty if not joined.
+  xmltvid = db.escape_string(row[10] || '')
+  callsign = (row[11].nil? || row[11].empty?) ? name : db.escape_string(row[11])
+  icon = db.escape_string(row[12] || '')
+
+  db.query("INSERT INTO channel (chanid, channum, sourceid, callsign, name, useonairguide, mplexid, serviceid, xmltvid, icon) VALUES (#{row[8].to_i}, #{row[8].to_i}, 1, '#{callsign}', '#{name}', 0, #{mplexid}, #{row[7].to_i}, '#{xmltvid}', '#{icon}')")
 
 
 end
@@ -0,0 +1,805 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * demuxemu.c - Demux emulator, loaded with LD_PRELOAD in front of slowlane so
+ * the acquisition loop can be run without a card. Opening
+ * /dev/dvb/adapterN/demuxN gives an eventfd standing in for the device, and
+ * read, ioctl and close on it are answered here. A thread plays the sections
+ * of a capture written with -w round as a carousel would, each kind of table
+ * once a cycle spread evenly over it, and every fd with a started filter the
+ * section passes gets it in its buffer as the kernel would: the filter, mask
+ * and mode of DMX_SET_FILTER, DMX_CHECK_CRC, a buffer of DMX_SET_BUFFER_SIZE
+ * which is flushed and has the next read fail with EOVERFLOW when a section
+ * doesn't fit, and reads which return at most one section. Faults are injected as asked in SLOWLANE_DEMUX, see
+ * emu_configure. Anything else is passed on to libc.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <linux/dvb/dmx.h>
+#include "crc32.h"
+#include "filter.h"
+
+/* Highest fd that may be a demux. */
+#define EMU_FD_MAX 1024
+
+/* The kernel's buffer for a section filter until DMX_SET_BUFFER_SIZE. */
+#define EMU_BUFFER_DEFAULT 8192
+
+/* Kinds of table, each with a cycle of its own. */
+#define EMU_NIT 0
+#define EMU_SDT 1
+#define EMU_BAT 2
+#define EMU_EIT 3
+#define EMU_OPENTV 4
+#define EMU_KINDS 5
+
+static const char *emu_kind_names[EMU_KINDS] = { "nit", "sdt", "bat", "eit", "opentv" };
+
+/* A section of the capture, the last of each seen with its key. */
+typedef struct tEmuSection {
+	unsigned char	*data;
+	int		length;
+	unsigned int	order;
+} EmuSection;
+
+/* A kind of table's sections, the next due being cursor of cycle. */
+typedef struct tEmuCarousel {
+	unsigned int	*sections;
+	unsigned int	count;
+	unsigned int	cursor;
+	unsigned long	cycle;
+	long		period_ms;
+} EmuCarousel;
+
+/* An open demux, its buffer being a ring the carousel writes sections to. */
+typedef struct tEmuDemux {
+	pthread_mutex_t	lock;
+	pthread_cond_t	ready;
+	int		fd;
+	int		nonblocking;
+
+	SectionFilter	filter;
+	int		started;
+
+	unsigned char	*buffer;
+	size_t		size;
+	size_t		head;
+	size_t		used;
+	int		overflowed;
+
+	/* Bytes left of the section being read, 0 between sections. */
+	size_t		todo;
+} EmuDemux;
+
+/* Options from SLOWLANE_DEMUX. */
+typedef struct tEmuOptions {
+	char		capture[256];
+	long		period_ms[EMU_KINDS];
+	unsigned int	lost;
+	unsigned int	crc_errors;
+	long		bump_ms;
+	long		overflow_ms;
+	unsigned int	seed;
+} EmuOptions;
+
+/* What happened, reported at exit. */
+typedef struct tEmuStats {
+	unsigned long	played;
+	unsigned long	delivered;
+	unsigned long	lost;
+	unsigned long	crc_errors;
+	unsigned long	crc_dropped;
+	unsigned long	overflows;
+	unsigned long	bumps;
+} EmuStats;
+
+static int (*emu_real_open) (const char *path, int flags, ...);
+static int (*emu_real_open64) (const char *path, int flags, ...);
+static ssize_t (*emu_real_read) (int fd, void *buffer, size_t count);
+static int (*emu_real_ioctl) (int fd, unsigned long request, ...);
+static int (*emu_real_close) (int fd);
+
+static pthread_once_t emu_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t emu_lock = PTHREAD_MUTEX_INITIALIZER;
+static EmuDemux *emu_demuxes[EMU_FD_MAX];
+static EmuOptions emu_options;
+static EmuStats emu_stats;
+static EmuSection *emu_sections;
+static unsigned int emu_section_count;
+static EmuCarousel emu_carousels[EMU_KINDS];
+static int emu_running;
+
+/* The calls passed on, looked up on first use as anything may call in before
+ * the constructors have run. */
+static void emu_symbols (void) {
+	if (emu_real_close) {
+		return;
+	}
+
+	*(void **) &emu_real_open = dlsym(RTLD_NEXT, "open");
+	*(void **) &emu_real_open64 = dlsym(RTLD_NEXT, "open64");
+	*(void **) &emu_real_read = dlsym(RTLD_NEXT, "read");
+	*(void **) &emu_real_ioctl = dlsym(RTLD_NEXT, "ioctl");
+	*(void **) &emu_real_close = dlsym(RTLD_NEXT, "close");
+}
+
+static int emu_kind (unsigned char table_id) {
+	switch (filter_table_pid(table_id)) {
+		case 0x0010:
+			return EMU_NIT;
+		case 0x0011:
+			return table_id == 0x4a ? EMU_BAT : EMU_SDT;
+		case 0x0030:
+		case 0x0040:
+			return EMU_OPENTV;
+		default:
+			return EMU_EIT;
+	}
+}
+
+/* SLOWLANE_DEMUX is a comma separated list of:
+ *
+ *	capture=<file>	The capture to play, written with -w.
+ *	cycle=<ms>	How long every kind of table takes to come round (2000).
+ *	nit=, sdt=, bat=, eit=, opentv=<ms>	The same for one kind.
+ *	lost=<n>	Lose n in a thousand sections played.
+ *	crc=<n>		Corrupt n in a thousand, DMX_CHECK_CRC then drops them.
+ *	bump=<ms>	Move every table on a version each ms.
+ *	overflow=<ms>	Overflow every buffer each ms.
+ *	seed=<n>	Seed for losses and corruption, so runs repeat.
+ */
+static int emu_configure (void) {
+	char *options = getenv("SLOWLANE_DEMUX"), *copy, *option, *value, *save;
+	int retval = 0, i;
+
+	for (i = 0; i < EMU_KINDS; i++) {
+		emu_options.period_ms[i] = 2000;
+	}
+
+	emu_options.seed = 1;
+
+	if (options == NULL || (copy = strdup(options)) == NULL) {
+		fprintf(stderr, "demuxemu: SLOWLANE_DEMUX isn't set, nothing to play.\n");
+		return -1;
+	}
+
+	for (option = strtok_r(copy, ",", &save); option != NULL && retval == 0; option = strtok_r(NULL, ",", &save)) {
+		if ((value = strchr(option, '=')) == NULL) {
+			fprintf(stderr, "demuxemu: Option %s has no value.\n", option);
+			retval = -1;
+			break;
+		}
+
+		*value++ = '\0';
+
+		for (i = 0; i < EMU_KINDS && strcmp(option, emu_kind_names[i]) != 0; i++);
+
+		if (i < EMU_KINDS) {
+			emu_options.period_ms[i] = atol(value);
+		} else if (strcmp(option, "capture") == 0) {
+			snprintf(emu_options.capture, sizeof(emu_options.capture), "%s", value);
+		} else if (strcmp(option, "cycle") == 0) {
+			for (i = 0; i < EMU_KINDS; i++) {
+				emu_options.period_ms[i] = atol(value);
+			}
+		} else if (strcmp(option, "lost") == 0) {
+			emu_options.lost = atoi(value);
+		} else if (strcmp(option, "crc") == 0) {
+			emu_options.crc_errors = atoi(value);
+		} else if (strcmp(option, "bump") == 0) {
+			emu_options.bump_ms = atol(value);
+		} else if (strcmp(option, "overflow") == 0) {
+			emu_options.overflow_ms = atol(value);
+		} else if (strcmp(option, "seed") == 0) {
+			emu_options.seed = atoi(value);
+		} else {
+			fprintf(stderr, "demuxemu: Unknown option %s.\n", option);
+			retval = -1;
+		}
+	}
+
+	free(copy);
+
+	if (retval == 0 && emu_options.capture[0] == '\0') {
+		fprintf(stderr, "demuxemu: No capture given in SLOWLANE_DEMUX.\n");
+		retval = -1;
+	}
+
+	return retval;
+}
+
+/* Sections are the same table and section where they have the same table id,
+ * extension, section number and, for the SDT and EIT, network. Those without
+ * a section number are never the same as another. */
+static int emu_section_key (const EmuSection *first, const EmuSection *second) {
+	int retval, length;
+
+	if (!(first->data[1] & 0x80) || !(second->data[1] & 0x80) || first->length < 12 || second->length < 12) {
+		retval = (first->data[1] & 0x80) - (second->data[1] & 0x80);
+		return retval ? retval : (int) first->order - (int) second->order;
+	}
+
+	if ((retval = first->data[0] - second->data[0]) != 0 || (retval = memcmp(first->data + 3, second->data + 3, 2)) != 0 || (retval = first->data[6] - second->data[6]) != 0) {
+		return retval;
+	}
+
+	length = first->data[0] == 0x42 || first->data[0] == 0x46 || first->data[0] >= 0x4e ? 4 : 0;
+
+	return length ? memcmp(first->data + 8, second->data + 8, length) : 0;
+}
+
+static int emu_section_compare (const void *a, const void *b) {
+	const EmuSection *first = (const EmuSection *) a, *second = (const EmuSection *) b;
+	int retval = emu_section_key(first, second);
+
+	return retval ? retval : (int) first->order - (int) second->order;
+}
+
+static int emu_section_order (const void *a, const void *b) {
+	return (int) ((const EmuSection *) a)->order - (int) ((const EmuSection *) b)->order;
+}
+
+/* Load the capture, keeping the last of each section in the order first seen. */
+static int emu_load (void) {
+	unsigned int i, count = 0, kind;
+	long file_length, offset;
+	unsigned char *data;
+	int section_length;
+	EmuSection *sections;
+	FILE *file;
+
+	if ((file = fopen(emu_options.capture, "rb")) == NULL) {
+		fprintf(stderr, "demuxemu: Unable to open capture %s.\n", emu_options.capture);
+		return -1;
+	}
+
+	fseek(file, 0, SEEK_END);
+	file_length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	if (file_length <= 0 || (data = (unsigned char *) malloc(file_length)) == NULL || fread(data, 1, file_length, file) != (size_t) file_length) {
+		fprintf(stderr, "demuxemu: Unable to read capture %s.\n", emu_options.capture);
+		fclose(file);
+		return -1;
+	}
+
+	fclose(file);
+
+	/* At most one section in three bytes. */
+	if ((sections = (EmuSection *) calloc(file_length / 3 + 1, sizeof(EmuSection))) == NULL) {
+		fprintf(stderr, "demuxemu: Unable to index capture %s.\n", emu_options.capture);
+		free(data);
+		return -1;
+	}
+
+	for (offset = 0; offset + 3 <= file_length; offset += section_length) {
+		section_length = (((data[offset + 1] & 0x0f) << 8) | data[offset + 2]) + 3;
+
+		if (offset + section_length > file_length) {
+			break;
+		}
+
+		sections[count].data = data + offset;
+		sections[count].length = section_length;
+		sections[count].order = count;
+		count++;
+	}
+
+	/* Sort the same sections together, latest last, and keep only that. */
+	qsort(sections, count, sizeof(EmuSection), emu_section_compare);
+
+	for (i = 0, emu_section_count = 0; i < count; i++) {
+		if (i + 1 == count || emu_section_key(&sections[i], &sections[i + 1]) != 0) {
+			sections[emu_section_count++] = sections[i];
+		}
+	}
+
+	qsort(sections, emu_section_count, sizeof(EmuSection), emu_section_order);
+	emu_sections = sections;
+
+	for (i = 0; i < emu_section_count; i++) {
+		emu_carousels[emu_kind(sections[i].data[0])].count++;
+	}
+
+	for (kind = 0; kind < EMU_KINDS; kind++) {
+		emu_carousels[kind].period_ms = emu_options.period_ms[kind];
+
+		if ((emu_carousels[kind].sections = (unsigned int *) calloc(emu_carousels[kind].count + 1, sizeof(unsigned int))) == NULL) {
+			fprintf(stderr, "demuxemu: Unable to allocate the %s carousel.\n", emu_kind_names[kind]);
+			return -1;
+		}
+
+		emu_carousels[kind].count = 0;
+	}
+
+	for (i = 0; i < emu_section_count; i++) {
+		kind = emu_kind(sections[i].data[0]);
+		emu_carousels[kind].sections[emu_carousels[kind].count++] = i;
+	}
+
+	fprintf(stderr, "demuxemu: Playing %u sections of %u in %s, NIT %u SDT %u BAT %u EIT %u OpenTV %u.\n", emu_section_count, count, emu_options.capture,
+		emu_carousels[EMU_NIT].count, emu_carousels[EMU_SDT].count, emu_carousels[EMU_BAT].count, emu_carousels[EMU_EIT].count, emu_carousels[EMU_OPENTV].count);
+
+	return 0;
+}
+
+/* When a carousel's next section is due, in ms from the start. */
+static long emu_due (EmuCarousel *carousel) {
+	return carousel->cycle * carousel->period_ms + (long) carousel->cursor * carousel->period_ms / carousel->count;
+}
+
+static long emu_elapsed (struct timespec *start) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+static void emu_sleep_until (struct timespec *start, long ms) {
+	struct timespec due;
+
+	due.tv_sec = start->tv_sec + ms / 1000;
+	due.tv_nsec = start->tv_nsec + (ms % 1000) * 1000000;
+
+	if (due.tv_nsec >= 1000000000) {
+		due.tv_sec++;
+		due.tv_nsec -= 1000000000;
+	}
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR);
+}
+
+/* Empty the buffer, the eventfd is drained so poll no longer wakes. */
+static void emu_flush (EmuDemux *demux) {
+	eventfd_t count;
+
+	demux->head = 0;
+	demux->used = 0;
+	demux->todo = 0;
+	eventfd_read(demux->fd, &count);
+}
+
+/* Append a section to a demux's buffer as the kernel would, the whole
+ * buffer being lost if it won't fit. Called with the demux locked. */
+static void emu_write (EmuDemux *demux, unsigned char *section, int section_length) {
+	size_t tail, first;
+
+	if (demux->used + section_length > demux->size) {
+		emu_flush(demux);
+		demux->overflowed = 1;
+		__atomic_add_fetch(&emu_stats.overflows, 1, __ATOMIC_RELAXED);
+	} else {
+		tail = (demux->head + demux->used) % demux->size;
+		first = demux->size - tail < (size_t) section_length ? demux->size - tail : (size_t) section_length;
+
+		memcpy(demux->buffer + tail, section, first);
+		memcpy(demux->buffer, section + first, section_length - first);
+		demux->used += section_length;
+		emu_stats.delivered++;
+	}
+
+	eventfd_write(demux->fd, 1);
+	pthread_cond_broadcast(&demux->ready);
+}
+
+/* Give a section to every demux whose filter passes it. */
+static void emu_play (unsigned char *section, int section_length, int corrupt) {
+	unsigned short pid = filter_table_pid(section[0]);
+	EmuDemux *demux;
+	int i;
+
+	pthread_mutex_lock(&emu_lock);
+
+	for (i = 0; i < EMU_FD_MAX; i++) {
+		if ((demux = emu_demuxes[i]) == NULL) {
+			continue;
+		}
+
+		pthread_mutex_lock(&demux->lock);
+
+		if (demux->started && demux->filter.pid == pid && filter_match(&demux->filter, section, section_length)) {
+			/* As the kernel, only sections with the syntax indicator carry a CRC. */
+			if (corrupt && (demux->filter.flags & FILTER_CHECK_CRC) && (section[1] & 0x80)) {
+				emu_stats.crc_dropped++;
+			} else {
+				emu_write(demux, section, section_length);
+			}
+		}
+
+		pthread_mutex_unlock(&demux->lock);
+	}
+
+	pthread_mutex_unlock(&emu_lock);
+}
+
+/* Move every section with a version on one, with the CRC made good again. */
+static void emu_bump (void) {
+	unsigned char *section;
+	unsigned int i, crc;
+
+	for (i = 0; i < emu_section_count; i++) {
+		section = emu_sections[i].data;
+
+		if (!(section[1] & 0x80) || emu_sections[i].length < 12) {
+			continue;
+		}
+
+		section[5] = (section[5] & 0xc1) | ((((section[5] >> 1) + 1) & 0x1f) << 1);
+		crc = crc32((char *) section, emu_sections[i].length - 4, 0xffffffff);
+
+		section[emu_sections[i].length - 4] = crc >> 24;
+		section[emu_sections[i].length - 3] = crc >> 16;
+		section[emu_sections[i].length - 2] = crc >> 8;
+		section[emu_sections[i].length - 1] = crc;
+	}
+
+	emu_stats.bumps++;
+	fprintf(stderr, "demuxemu: Bumped every table a version.\n");
+}
+
+static void emu_overflow (void) {
+	EmuDemux *demux;
+	int i;
+
+	pthread_mutex_lock(&emu_lock);
+
+	for (i = 0; i < EMU_FD_MAX; i++) {
+		if ((demux = emu_demuxes[i]) != NULL && demux->started) {
+			pthread_mutex_lock(&demux->lock);
+			emu_flush(demux);
+			demux->overflowed = 1;
+			emu_stats.overflows++;
+			eventfd_write(demux->fd, 1);
+			pthread_cond_broadcast(&demux->ready);
+			pthread_mutex_unlock(&demux->lock);
+		}
+	}
+
+	pthread_mutex_unlock(&emu_lock);
+}
+
+/* Play the carousels, from when the first demux was opened. */
+static void * emu_carousel_thread (void *arg) {
+	unsigned char copy[4096 + 3];
+	unsigned int seed = emu_options.seed, kind, next;
+	long due, next_due, bumped = 0, overflowed = 0;
+	struct timespec start;
+	EmuCarousel *carousel;
+	EmuSection *section;
+	int corrupt;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (;;) {
+		for (kind = 0, next = EMU_KINDS, next_due = 0; kind < EMU_KINDS; kind++) {
+			if (emu_carousels[kind].count == 0 || emu_carousels[kind].period_ms <= 0) {
+				continue;
+			}
+
+			if (next == EMU_KINDS || (due = emu_due(&emu_carousels[kind])) < next_due) {
+				next = kind;
+				next_due = emu_due(&emu_carousels[kind]);
+			}
+		}
+
+		if (next == EMU_KINDS) {
+			break;
+		}
+
+		if (next_due > emu_elapsed(&start)) {
+			emu_sleep_until(&start, next_due);
+		}
+
+		if (emu_options.bump_ms > 0 && next_due / emu_options.bump_ms > bumped) {
+			bumped = next_due / emu_options.bump_ms;
+			emu_bump();
+		}
+
+		if (emu_options.overflow_ms > 0 && next_due / emu_options.overflow_ms > overflowed) {
+			overflowed = next_due / emu_options.overflow_ms;
+			emu_overflow();
+		}
+
+		carousel = &emu_carousels[next];
+		section = &emu_sections[carousel->sections[carousel->cursor]];
+
+		if (++carousel->cursor == carousel->count) {
+			carousel->cursor = 0;
+			carousel->cycle++;
+		}
+
+		emu_stats.played++;
+
+		if (emu_options.lost && (unsigned int) rand_r(&seed) % 1000 < emu_options.lost) {
+			emu_stats.lost++;
+			continue;
+		}
+
+		corrupt = emu_options.crc_errors && (unsigned int) rand_r(&seed) % 1000 < emu_options.crc_errors;
+
+		if (corrupt && section->length > 8 && section->length <= (int) sizeof(copy)) {
+			memcpy(copy, section->data, section->length);
+			copy[section->length - 5] ^= 0x5a;
+			emu_stats.crc_errors++;
+			emu_play(copy, section->length, 1);
+		} else {
+			emu_play(section->data, section->length, 0);
+		}
+	}
+
+	return arg;
+}
+
+static void emu_start (void) {
+	pthread_t thread;
+
+	if (emu_configure() < 0 || emu_load() < 0) {
+		return;
+	}
+
+	if (pthread_create(&thread, NULL, emu_carousel_thread, NULL) != 0) {
+		fprintf(stderr, "demuxemu: Unable to start carousel thread.\n");
+		return;
+	}
+
+	pthread_detach(thread);
+	emu_running = 1;
+}
+
+static void __attribute__((destructor)) emu_report (void) {
+	if (emu_running) {
+		fprintf(stderr, "demuxemu: Played %lu sections, delivered %lu, lost %lu, corrupted %lu (%lu dropped on CRC), %lu overflows, %lu version bumps.\n",
+			emu_stats.played, emu_stats.delivered, emu_stats.lost, emu_stats.crc_errors, emu_stats.crc_dropped, emu_stats.overflows, emu_stats.bumps);
+	}
+}
+
+static EmuDemux * emu_demux (int fd) {
+	return fd >= 0 && fd < EMU_FD_MAX ? emu_demuxes[fd] : NULL;
+}
+
+/* Is path a demux device? Every adapter's is the same capture. */
+static int emu_is_demux (const char *path) {
+	int adapter, demux;
+	char end;
+
+	return path && sscanf(path, "/dev/dvb/adapter%i/demux%i%c", &adapter, &demux, &end) == 2;
+}
+
+static int emu_open (int flags) {
+	EmuDemux *demux;
+	int fd;
+
+	pthread_once(&emu_once, emu_start);
+
+	if (!emu_running) {
+		errno = ENODEV;
+		return -1;
+	}
+
+	if ((demux = (EmuDemux *) calloc(1, sizeof(EmuDemux))) == NULL || (demux->buffer = (unsigned char *) malloc(EMU_BUFFER_DEFAULT)) == NULL) {
+		free(demux);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if ((fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0 || fd >= EMU_FD_MAX) {
+		if (fd >= 0) {
+			emu_real_close(fd);
+		}
+
+		free(demux->buffer);
+		free(demux);
+		errno = EMFILE;
+		return -1;
+	}
+
+	pthread_mutex_init(&demux->lock, NULL);
+	pthread_cond_init(&demux->ready, NULL);
+	demux->fd = fd;
+	demux->nonblocking = (flags & O_NONBLOCK) != 0;
+	demux->size = EMU_BUFFER_DEFAULT;
+
+	pthread_mutex_lock(&emu_lock);
+	emu_demuxes[fd] = demux;
+	pthread_mutex_unlock(&emu_lock);
+
+	return fd;
+}
+
+/* The device's calls, for emulated fds. */
+int open (const char *path, int flags, ...) {
+	mode_t mode = 0;
+	va_list ap;
+
+	emu_symbols();
+
+	if (emu_is_demux(path)) {
+		return emu_open(flags);
+	}
+
+	if (flags & O_CREAT) {
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+
+	return emu_real_open(path, flags, mode);
+}
+
+int open64 (const char *path, int flags, ...) {
+	mode_t mode = 0;
+	va_list ap;
+
+	emu_symbols();
+
+	if (emu_is_demux(path)) {
+		return emu_open(flags);
+	}
+
+	if (flags & O_CREAT) {
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+
+	return emu_real_open64(path, flags, mode);
+}
+
+/* As the kernel's section filter, a read takes the next section or as much
+ * of it as fits, the rest following on the next read, or fails once with
+ * EOVERFLOW after the buffer was lost. Sections are only ever buffered whole. */
+ssize_t read (int fd, void *buffer, size_t count) {
+	EmuDemux *demux;
+	size_t length, first;
+
+	emu_symbols();
+
+	if ((demux = emu_demux(fd)) == NULL) {
+		return emu_real_read(fd, buffer, count);
+	}
+
+	pthread_mutex_lock(&demux->lock);
+
+	while (demux->used == 0 && !demux->overflowed && !demux->nonblocking) {
+		pthread_cond_wait(&demux->ready, &demux->lock);
+	}
+
+	if (demux->overflowed) {
+		demux->overflowed = 0;
+		pthread_mutex_unlock(&demux->lock);
+		errno = EOVERFLOW;
+		return -1;
+	}
+
+	if (demux->used == 0) {
+		pthread_mutex_unlock(&demux->lock);
+		errno = EAGAIN;
+		return -1;
+	}
+
+	/* The section's length is in its header. */
+	if (demux->todo == 0) {
+		demux->todo = (((demux->buffer[(demux->head + 1) % demux->size] & 0x0f) << 8) | demux->buffer[(demux->head + 2) % demux->size]) + 3;
+	}
+
+	length = count < demux->todo ? count : demux->todo;
+	demux->todo -= length;
+	first = demux->size - demux->head < length ? demux->size - demux->head : length;
+
+	memcpy(buffer, demux->buffer + demux->head, first);
+	memcpy((unsigned char *) buffer + first, demux->buffer, length - first);
+	demux->head = (demux->head + length) % demux->size;
+	demux->used -= length;
+
+	if (demux->used == 0) {
+		emu_flush(demux);
+	}
+
+	pthread_mutex_unlock(&demux->lock);
+
+	return length;
+}
+
+static int emu_ioctl (EmuDemux *demux, unsigned long request, void *arg) {
+	struct dmx_sct_filter_params *params = (struct dmx_sct_filter_params *) arg;
+	unsigned char *buffer;
+	size_t size;
+
+	switch (request) {
+		case DMX_SET_FILTER:
+			/* The filter is laid out as ours, see filter.h. */
+			memset(&demux->filter, '\0', sizeof(SectionFilter));
+			demux->filter.pid = params->pid;
+			memcpy(demux->filter.filter, params->filter.filter, FILTER_SIZE);
+			memcpy(demux->filter.mask, params->filter.mask, FILTER_SIZE);
+			memcpy(demux->filter.mode, params->filter.mode, FILTER_SIZE);
+			demux->filter.flags = params->flags & DMX_CHECK_CRC ? FILTER_CHECK_CRC : 0;
+			filter_prepare(&demux->filter);
+
+			emu_flush(demux);
+			demux->overflowed = 0;
+			demux->started = (params->flags & DMX_IMMEDIATE_START) != 0;
+			return 0;
+		case DMX_START:
+			demux->started = 1;
+			return 0;
+		case DMX_STOP:
+			demux->started = 0;
+			return 0;
+		case DMX_SET_BUFFER_SIZE:
+			size = (unsigned long) arg;
+
+			if (size == 0 || (buffer = (unsigned char *) malloc(size)) == NULL) {
+				errno = ENOMEM;
+				return -1;
+			}
+
+			free(demux->buffer);
+			demux->buffer = buffer;
+			demux->size = size;
+			emu_flush(demux);
+			return 0;
+		default:
+			/* PES filters and the rest aren't emulated, there's no dvr. */
+			errno = EINVAL;
+			return -1;
+	}
+}
+
+int ioctl (int fd, unsigned long request, ...) {
+	EmuDemux *demux;
+	void *arg;
+	va_list ap;
+	int retval;
+
+	emu_symbols();
+
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+
+	if ((demux = emu_demux(fd)) == NULL) {
+		return emu_real_ioctl(fd, request, arg);
+	}
+
+	pthread_mutex_lock(&demux->lock);
+	retval = emu_ioctl(demux, request, arg);
+	pthread_mutex_unlock(&demux->lock);
+
+	return retval;
+}
+
+int close (int fd) {
+	EmuDemux *demux;
+
+	emu_symbols();
+
+	if ((demux = emu_demux(fd)) != NULL) {
+		pthread_mutex_lock(&emu_lock);
+		emu_demuxes[fd] = NULL;
+		pthread_mutex_unlock(&emu_lock);
+
+		pthread_mutex_destroy(&demux->lock);
+		pthread_cond_destroy(&demux->ready);
+		free(demux->buffer);
+		free(demux);
+	}
+
+	return emu_real_close(fd);
+}
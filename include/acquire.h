@@ -0,0 +1,73 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * acquire.h - Acquisition headers.
+ */
+
+#ifndef __ACQUIRE_H_
+#define __ACQUIRE_H_ 1
+
+#include <pthread.h>
+#include "data.h"
+
+/* Most feeds scanned at once. */
+#define ACQUIRE_MAX 8
+
+/* Kinds of source. */
+#define ACQUIRE_DEMUX 0
+#define ACQUIRE_DVR 1
+#define ACQUIRE_CAPTURE 2
+#define ACQUIRE_TS 3
+
+/* Settings common to every acquisition. */
+typedef struct tAcquireOptions {
+	int		crc_dvb;
+	int		crc_internal;
+	int		loop_time;
+	int		workers;
+	int		filter_bouquet_id;
+	unsigned long	buffer_size;
+	int		eit;
+	int		opentv;
+
+	/* Set when only the lineup of filter_bouquet_id is wanted, the scan is
+	 * then complete once everything it depends on is. */
+	int		lineup;
+	RegionSet	filter_regions;
+	int		filter_user_number;
+
+	/* Captures are written deduplicated if set, and deduplicated captures
+	 * are replayed at replay_speed times the rate they were read, or as fast
+	 * as they can be if 0, see carousel.c. */
+	int		carousel;
+	int		replay_speed;
+} AcquireOptions;
+
+/* Everything needed to scan one feed, each runs on a thread of its own and
+ * builds a model of its own which is merged once all are done. */
+typedef struct tAcquisition {
+	/* Where from. */
+	int		source;
+	int		dvb_adapter;
+	int		dvb_demux;
+	char		*filename;
+
+	/* Record what was read here if set. */
+	char		*capture_out;
+
+	AcquireOptions	*options;
+	DataModel	model;
+
+	pthread_t	thread;
+	int		result;
+	long		elapsed;
+} Acquisition;
+
+void acquire_init (Acquisition *acquisition, int source, AcquireOptions *options);
+int acquire_run (Acquisition *acquisition);
+int acquire_start (Acquisition *acquisition);
+int acquire_wait (Acquisition *acquisition);
+
+#endif
@@ -0,0 +1,63 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * batch.h - Batch processing of many captures headers.
+ */
+
+#ifndef __BATCH_H_
+#define __BATCH_H_ 1
+
+#include <stdio.h>
+#include "acquire.h"
+#include "history.h"
+
+/* One capture of a batch and what became of it. */
+typedef struct tBatchCapture {
+	/* Where it's read from, and the name its lineup and report line go by. */
+	char		*filename;
+	char		*name;
+
+	int		result;
+	long		elapsed;
+	unsigned long	sections;
+
+	/* The lineup, kept once the capture's model is gone. */
+	HistorySnapshot	lineup;
+} BatchCapture;
+
+typedef struct tBatch {
+	/* Every capture is scanned with these, each into a context of its own. */
+	AcquireOptions	options;
+	unsigned int	demand;
+	int		retain;
+	int		filter_dvbs;
+	int		filter_hd;
+
+	/* Bytes each capture's models may hold, unlimited if 0. */
+	size_t		memory_cap;
+
+	/* Lineups are written here in output_format, none if output_dir is NULL. */
+	const char	*output_dir;
+	int		output_format;
+
+	BatchCapture	*captures;
+	unsigned int	count;
+	unsigned int	size;
+
+	/* Captures scanned at once, and the next one to take. */
+	int		jobs;
+	unsigned int	next;
+
+	long		elapsed;
+} Batch;
+
+void batch_init (Batch *batch, AcquireOptions *options);
+void batch_free (Batch *batch);
+
+int batch_add (Batch *batch, const char *path);
+int batch_run (Batch *batch);
+void batch_report (Batch *batch, FILE *out);
+
+#endif
@@ -0,0 +1,90 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * carousel.h - Deduplicated section capture headers.
+ */
+
+#ifndef __CAROUSEL_H_
+#define __CAROUSEL_H_ 1
+
+#include <stdio.h>
+#include <stddef.h>
+#include "pool.h"
+
+#define CAROUSEL_MAGIC "SLCARO\001\n"
+#define CAROUSEL_MAGIC_SIZE 8
+
+/* Section bytes are kept in blocks of this size, which never move. */
+#define CAROUSEL_BLOCK_SIZE 65536
+
+/* One distinct section, its index in the pool being its reference. */
+typedef struct tCarouselSection {
+	/* Hash chain. */
+	unsigned int	next;
+
+	unsigned short	length;
+	unsigned int	hash;
+	unsigned char	*data;
+} CarouselSection;
+
+/* A capture being written, every distinct section hashed on its key. */
+typedef struct tCarouselWriter {
+	FILE		*file;
+
+	Pool		sections;
+	unsigned int	*buckets;
+	unsigned int	bucket_count;
+
+	unsigned char	**blocks;
+	unsigned int	block_count;
+	unsigned int	block_used;
+
+	/* Time of the last read written, in microseconds. */
+	unsigned long long time;
+
+	/* Statistics. */
+	unsigned long	arrivals;
+	unsigned long	bytes_in;
+	unsigned long	bytes_out;
+} CarouselWriter;
+
+/* A capture mapped for replay, sections being found by the offset of their
+ * first copy. Replay is paced to speed times the time it was captured in,
+ * or is as fast as it can be read if speed is 0. */
+typedef struct tCarousel {
+	unsigned char	*map;
+	size_t		map_size;
+	size_t		offset;
+
+	size_t		*sections;
+	unsigned int	section_count;
+	unsigned int	section_size;
+
+	/* The time of the read being replayed, and if it's been started. */
+	unsigned long long time;
+	int		partial;
+
+	/* Pacing, the time of the first read and when it was replayed. */
+	int		speed;
+	unsigned long long first_time;
+	unsigned long long started;
+
+	/* Statistics. */
+	unsigned long	arrivals;
+} Carousel;
+
+static inline CarouselSection * carousel_section_at (CarouselWriter *writer, unsigned int index) { return (CarouselSection *) pool_get(&writer->sections, index); }
+
+int carousel_writer_open (CarouselWriter *writer, const char *filename);
+int carousel_write (CarouselWriter *writer, const unsigned char *data, int length, unsigned long long time);
+int carousel_writer_close (CarouselWriter *writer);
+
+int carousel_is (int fd);
+int carousel_open (Carousel *carousel, int fd, int speed);
+int carousel_read (Carousel *carousel, unsigned char *buffer, int size, unsigned long long *time);
+long carousel_wait (Carousel *carousel);
+void carousel_close (Carousel *carousel);
+
+#endif
@@ -9,30 +9,38 @@
 #ifndef __DATA_H_
 #define __DATA_H_ 1
 
+#include "pool.h"
+#include "text.h"
+
 /* Structure for section tracking. */
 typedef struct tSectionTracking {
+	/* Which sections have been received, one bit per section number. */
+	unsigned int	received_section[8];
+
 	/* Which version of the table are we working on. */
 	unsigned char	version;
 
 	/* Which is the last section of this table. */
 	unsigned char	last_section;
 
-	/* Which sections have been received. */
-	unsigned char	received_section[0xff];
-
 	/* Is this populated yet? */
 	unsigned char	populated;
 } SectionTracking;
 
+/* Nodes below are kept in pools and link to each other with 32-bit pool
+ * indexes (POOL_NONE terminates), fields needed for lookups are kept in the
+ * node itself and colder descriptor payloads are split out into their own
+ * pools so a lookup walk touches as few cache lines as possible. */
+
 /* Entries required for storing BAT details. */
 typedef struct tOpenTVChannel {
 	/* Linked List */
-	struct tOpenTVChannel	*next;
+	unsigned int	next;
 
 	/* Reference Primarly for Building and later reference. */
-	struct tBouquet		*bouquet;
-	struct tService		*service;
-	struct tTransport	*transport;
+	unsigned int	bouquet;
+	unsigned int	service;
+	unsigned int	transport;
 
 	/* Details About OpenTVChannel */
 	unsigned short	transport_id;
@@ -46,106 +54,204 @@ typedef struct tOpenTVChannel {
 	unsigned short	flags;
 } OpenTVChannel;
 
+/* Regions a lineup is filtered to, a bit for each, none set for every region. */
+typedef struct tRegionSet {
+	unsigned long long	bits[4];
+	unsigned short		count;
+} RegionSet;
+
+static inline int region_set_has (const RegionSet *set, unsigned char region) { return (set->bits[region >> 6] >> (region & 63)) & 1; }
+static inline int region_set_passes (const RegionSet *set, unsigned char region) { return set->count == 0 || region_set_has(set, region); }
+
+static inline void region_set_add (RegionSet *set, unsigned char region) {
+	if (!region_set_has(set, region)) {
+		set->bits[region >> 6] |= 1ULL << (region & 63);
+		set->count++;
+	}
+}
+
 typedef struct tBouquet {
 	/* Linked List */
-	struct tBouquet		*next;
-
-	/* Section Tracking */
-	SectionTracking	sections;
+	unsigned int	next;
 
 	/* OpenTVChannels */
-	OpenTVChannel	*channels;
+	unsigned int	channels;
 
 	/* Details About Bouquet */
 	unsigned short	bouquet_id;
-	char		*name;
+	TextView	name;
+
+	/* Set when the channels weren't asked for, see si_load_bouquets. */
+	unsigned char	deferred;
+
+	/* Section Tracking */
+	SectionTracking	sections;
 } Bouquet;
 
 /* Entries required for storing SMT and NIT details. */
 
+/* Cold part of a service, only needed for output. */
+typedef struct tServiceNames {
+	TextView	name;
+	TextView	alt_name;
+	TextView	provider;
+} ServiceNames;
+
 typedef struct tService {
 	/* Linked List */
-	struct tService		*next;
+	unsigned int	next;
+
+	/* ServiceNames, POOL_NONE until a name is seen. */
+	unsigned int	names;
 
 	/* Details About Service */
 	unsigned short	service_id;
 	unsigned char	running;
 	unsigned char	free_ca;
 	unsigned char	type;
+} Service;
 
-	char		*name;
-	char		*alt_name;
-	char		*provider;
+/* Cold part of a transport, from the satellite delivery system descriptor. */
+typedef struct tTransportTuning {
+	unsigned int	frequency;
+	unsigned int	symbol_rate;
+	unsigned short	orbital_position;
 
-} Service;
+	unsigned char	modulation_system;
+	unsigned char	polarization;
+	unsigned char	modulation_type;
+	unsigned char	fec;
+	unsigned char	roll_off;
+	unsigned char	west_east_flag;
+} TransportTuning;
 
 typedef struct tTransport {
 	/* Linked List */
-	struct tTransport	*next;
-
-	/* Section Tracking */
-	SectionTracking	sections;
+	unsigned int	next;
 
 	/* Services */
-	Service		*services;
+	unsigned int	services;
+
+	/* TransportTuning, POOL_NONE until a delivery descriptor is seen. */
+	unsigned int	tuning;
 
 	/* Details About Transport */
 	unsigned short	original_network_id;
 	unsigned short	transport_id;
 
-	unsigned char	modulation_system;
-
-	unsigned int	frequency;
-	unsigned int	symbol_rate;
-	unsigned char	polarization;
-	unsigned char	modulation_type;
-	unsigned char	fec;
-	unsigned char	roll_off;
-
-	unsigned short	orbital_position;
-	unsigned char	west_east_flag;
+	/* Section Tracking */
+	SectionTracking	sections;
 } Transport;
 
 typedef struct tNetwork {
 	/* Linked List */
-	struct tNetwork		*next;
-
-	/* Section Tracking */
-	SectionTracking	sections;
+	unsigned int	next;
 
 	/* Transports */
-	Transport	*transports;
+	unsigned int	transports;
 
 	/* Details About Network */
 	unsigned short	network_id;
-	char		*name;
+	TextView	name;
+
+	/* Section Tracking */
+	SectionTracking	sections;
 } Network;
 
-extern Network *network_list;
-extern Bouquet *bouquet_list;
+/* Called with each whole section accepted into a model, on whichever thread
+ * parsed it. */
+typedef void (*SectionCallback) (void *user, const unsigned char *section, int section_length);
+
+/* How sections are parsed into a model, see si.c. Handed down to the models
+ * of the feeds and workers which build it. */
+typedef struct tParseSettings {
+	/* What to decode, see SI_DEMAND_*, and the only bouquet and regions whose channels are wanted if set. */
+	unsigned int	demand;
+	unsigned short	demand_bouquet_id;
+	RegionSet	demand_regions;
+
+	/* Keep the NIT, SDT and BAT sections accepted, names then point into them. */
+	int		retain;
+
+	/* OpenTV titles and summaries are ignored without one. */
+	struct tHuffman	*opentv_dictionary;
+
+	SectionCallback	section_callback;
+	void		*section_user;
+
+	/* The pools and retained sections of every model built are charged to this if set. */
+	PoolCap		*cap;
+} ParseSettings;
+
+/* Everything we have learnt from the feed. */
+typedef struct tDataModel {
+	Pool		networks;
+	Pool		transports;
+	Pool		transport_tunings;
+	Pool		services;
+	Pool		service_names;
+	Pool		bouquets;
+	Pool		channels;
+
+	/* List heads. */
+	unsigned int	network_list;
+	unsigned int	bouquet_list;
+
+	/* EIT events, NULL until one is seen, see event.c. */
+	struct tEventStore *events;
+
+	/* Accepted sections when they're retained, NULL otherwise, see store.c. */
+	struct tSectionStore *sections;
+
+	/* Set for a worker's partial model, see worker.c. */
+	unsigned char	shard;
+
+	ParseSettings	settings;
+} DataModel;
+
+/* The model the calling thread works on, workers each point this at their own. */
+extern __thread DataModel *data_model;
+
+void data_model_init (DataModel *model);
+void data_model_free (DataModel *model);
+void data_model_settings (DataModel *model, ParseSettings *settings);
+void data_model_merge (DataModel *from, int create);
+void data_memory_report (void);
+
+/* Index to pointer helpers, used for walking the lists. */
+static inline Network * network_at (unsigned int index) { return (Network *) pool_get(&data_model->networks, index); }
+static inline Transport * transport_at (unsigned int index) { return (Transport *) pool_get(&data_model->transports, index); }
+static inline Service * service_at (unsigned int index) { return (Service *) pool_get(&data_model->services, index); }
+static inline Bouquet * bouquet_at (unsigned int index) { return (Bouquet *) pool_get(&data_model->bouquets, index); }
+static inline OpenTVChannel * opentv_channel_at (unsigned int index) { return (OpenTVChannel *) pool_get(&data_model->channels, index); }
 
 Network * network_get (unsigned short network_id);
-void network_add (Network *new_ptr);
-Network * network_new (void);
+Network * network_add (unsigned short network_id);
 
 Transport * transport_get (Network *network_ptr, unsigned short transport_id);
 Transport * transport_get_with_original_network_id (unsigned short original_network_id, unsigned short transport_id);
-void transport_add (Network *network_ptr, Transport *new_ptr);
-Transport * transport_new (void);
+unsigned int transport_lookup (unsigned short original_network_id, unsigned short transport_id);
+Transport * transport_add (Network *network_ptr, unsigned short original_network_id, unsigned short transport_id);
+TransportTuning * transport_tuning (Transport *transport_ptr);
+TransportTuning * transport_tuning_set (Transport *transport_ptr);
 
 Service * service_get (Transport *transport_ptr, unsigned short service_id);
-void service_add (Transport *transport_ptr, Service *new_ptr);
-Service * service_new (void);
+unsigned int service_lookup (Transport *transport_ptr, unsigned short service_id);
+Service * service_add (Transport *transport_ptr, unsigned short service_id);
+ServiceNames * service_names (Service *service_ptr);
+ServiceNames * service_names_set (Service *service_ptr);
 
 Bouquet * bouquet_get (unsigned short bouquet_id);
-void bouquet_add (Bouquet *new_ptr);
+unsigned int bouquet_lookup (unsigned short bouquet_id);
+Bouquet * bouquet_add (unsigned short bouquet_id);
 Bouquet * bouquet_new (void);
 
 OpenTVChannel * opentv_channel_get (Bouquet *bouquet_ptr, unsigned short channel_number);
-void opentv_channel_add (Bouquet *bouquet_ptr, OpenTVChannel *new_ptr);
-OpenTVChannel * opentv_channel_new (void);
+OpenTVChannel * opentv_channel_add (Bouquet *bouquet_ptr);
+void opentv_channel_link (Bouquet *bouquet_ptr, unsigned int channel_index);
 
+int section_tracking_received (SectionTracking *section_tracking, unsigned char section_number);
+void section_tracking_set (SectionTracking *section_tracking, unsigned char section_number);
 int section_tracking_check (SectionTracking *section_tracking);
-Bouquet * filter_data (int filter_bouquet_id, unsigned char filter_region_count, unsigned char *filter_region, int filter_dvbs, int filter_hd, int filter_user_number);
 
 #endif
@@ -9,11 +9,19 @@
 #ifndef __DVB_H_
 #define __DVB_H_ 1
 
+#include "filter.h"
+
 #define DVB_BUFFER_SIZE 2*4096
 
 int dvb_open(int dvb_adapter, int dvb_demux);
+int dvb_open_dvr(int dvb_adapter, int dvb_dvr);
+int dvb_open_capture(const char *filename);
 void dvb_close(int dvb_demux_fd);
 int dvb_read(int dvb_demux_fd, char *buffer, int buffer_length);
+int dvb_set_buffer_size(int dvb_demux_fd, unsigned long size);
 int dvb_set_filter(int dvb_demux_fd, unsigned short pid, unsigned char table, unsigned char mask, int crc_dvb);
+int dvb_set_section_filter(int dvb_demux_fd, SectionFilter *filter);
+int dvb_stop_filter(int dvb_demux_fd);
+int dvb_set_pes_filter(int dvb_demux_fd, unsigned short pid);
 
 #endif
@@ -0,0 +1,115 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * event.h - EIT event store headers.
+ */
+
+#ifndef __EVENT_H_
+#define __EVENT_H_ 1
+
+#include "pool.h"
+#include "data.h"
+
+/* EIT tables, p/f and schedule, actual and other. */
+#define EVENT_TABLE_FIRST 0x4e
+#define EVENT_TABLE_LAST 0x6f
+
+/* Schedule tables of one kind, 0x50-0x5f for actual and 0x60-0x6f for other. */
+#define EVENT_SCHEDULE_TABLES 16
+
+/* Sections in a schedule segment, see EN 300 468 5.2.4. */
+#define EVENT_SEGMENT_SECTIONS 8
+
+/* OpenTV titles and summaries, which are keyed by channel rather than service. */
+#define EVENT_OPENTV_TITLE_FIRST 0xa0
+#define EVENT_OPENTV_TITLE_LAST 0xa3
+#define EVENT_OPENTV_SUMMARY_FIRST 0xa8
+#define EVENT_OPENTV_SUMMARY_LAST 0xab
+
+/* Transport an OpenTV channel's events are kept under until it's linked to
+ * its service, the service id being the channel id. */
+#define EVENT_OPENTV_TRANSPORT 0xffff
+
+typedef struct tEvent {
+	/* UTC seconds since the epoch, and length in seconds. */
+	unsigned int	start;
+	unsigned int	duration;
+
+	unsigned short	event_id;
+	unsigned char	running;
+	unsigned char	free_ca;
+
+	/* From the short event descriptor, NULL if there wasn't one. */
+	char		*title;
+	char		*text;
+} Event;
+
+/* Text for an event, known only by its id until the event is seen. */
+typedef struct tEventText {
+	unsigned short	event_id;
+	char		*text;
+} EventText;
+
+/* Everything known about the events of one service. Actual and other tables
+ * describe the same events so share the tracking, as the SDT does. */
+typedef struct tEventService {
+	/* Hash chain. */
+	unsigned int	next;
+
+	unsigned short	original_network_id;
+	unsigned short	transport_id;
+	unsigned short	service_id;
+
+	/* Highest schedule table signalled, 0 until a schedule section is seen. */
+	unsigned char	last_table_id;
+
+	/* Section tracking for p/f and each schedule table. */
+	SectionTracking	present_following;
+	SectionTracking	schedule[EVENT_SCHEDULE_TABLES];
+
+	/* Events ordered by start, they never overlap so are ordered by end too. */
+	Event		*events;
+	unsigned int	event_count;
+	unsigned int	event_size;
+
+	/* OpenTV summaries, given to their events by event_store_link_opentv. */
+	EventText	*texts;
+	unsigned int	text_count;
+	unsigned int	text_size;
+} EventService;
+
+/* Services with events, hashed on original network, transport and service. */
+typedef struct tEventStore {
+	Pool		services;
+	unsigned int	*buckets;
+	unsigned int	bucket_count;
+
+	/* Statistics. */
+	unsigned long	sections;
+	unsigned long	repeats;
+	unsigned long	events;
+} EventStore;
+
+static inline int event_table_eit (unsigned char table_id) { return table_id >= EVENT_TABLE_FIRST && table_id <= EVENT_TABLE_LAST; }
+static inline int event_table_opentv (unsigned char table_id) { return (table_id >= EVENT_OPENTV_TITLE_FIRST && table_id <= EVENT_OPENTV_TITLE_LAST) || (table_id >= EVENT_OPENTV_SUMMARY_FIRST && table_id <= EVENT_OPENTV_SUMMARY_LAST); }
+
+static inline EventService * event_service_at (EventStore *store, unsigned int index) { return (EventService *) pool_get(&store->services, index); }
+
+EventStore * event_store (DataModel *model, int create);
+void event_store_free (EventStore *store);
+void event_store_merge (EventStore *to, EventStore *from);
+int event_store_complete (EventStore *store);
+
+EventService * event_service_get (EventStore *store, unsigned short original_network_id, unsigned short transport_id, unsigned short service_id, int create);
+SectionTracking * event_tracking (EventService *service, unsigned char table_id);
+void event_tracking_segment (SectionTracking *sections, unsigned char section_number, unsigned char segment_last_section);
+int event_service_complete (EventService *service);
+
+Event * event_add (EventStore *store, EventService *service, unsigned int start, unsigned int duration, unsigned short event_id);
+unsigned int event_find (EventService *service, unsigned int time);
+int event_text_add (EventService *service, unsigned short event_id, char *text);
+void event_store_link_opentv (EventStore *store);
+
+#endif
@@ -0,0 +1,75 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * export.h - Structured output headers.
+ */
+
+#ifndef __EXPORT_H_
+#define __EXPORT_H_ 1
+
+#include <stddef.h>
+#include "text.h"
+#include "data.h"
+#include "xmltv.h"
+
+/* Output is built up in chunks of this size, which are written together. */
+#define EXPORT_CHUNK_SIZE (1024 * 1024)
+
+/* Comma separated, one record per line, quoted where needed. */
+#define EXPORT_CSV 0
+
+/* One JSON object per line, with a "type" member naming the record. */
+#define EXPORT_NDJSON 1
+
+/* Records of a type byte and a 16-bit little endian body length, the body
+ * being the fields in order, integers as 32-bit little endian and strings as
+ * a 16-bit little endian length and UTF-8, empty if there's no string. */
+#define EXPORT_BINARY 2
+
+/* Record types, also the binary type byte. */
+#define EXPORT_RECORD_NETWORK 'N'
+#define EXPORT_RECORD_TRANSPORT 'T'
+#define EXPORT_RECORD_SERVICE 'S'
+#define EXPORT_RECORD_BOUQUET 'B'
+#define EXPORT_RECORD_CHANNEL 'C'
+
+typedef struct tExporter {
+	int		format;
+	int		fd;
+
+	/* Chunks filled so far, the last one being filled. */
+	char		**chunks;
+	unsigned int	chunk_count;
+	size_t		used;
+	size_t		total;
+
+	/* The record being built, and where its binary length goes. */
+	unsigned int	fields;
+	unsigned char	*record_length;
+	size_t		record_total;
+
+	/* Set if memory ran out, the output is then incomplete. */
+	int		failed;
+} Exporter;
+
+int export_format (const char *name);
+void export_init (Exporter *exporter, int format, int fd);
+void export_free (Exporter *exporter);
+int export_flush (Exporter *exporter);
+
+void export_raw (Exporter *exporter, const char *text);
+void export_begin (Exporter *exporter, unsigned char record);
+void export_int (Exporter *exporter, const char *field, unsigned long value);
+void export_string (Exporter *exporter, const char *field, const char *text, int length);
+void export_text (Exporter *exporter, const char *field, TextView view);
+void export_end (Exporter *exporter);
+
+void export_network (Exporter *exporter, Network *network);
+void export_transport (Exporter *exporter, Transport *transport);
+void export_service (Exporter *exporter, Transport *transport, Service *service);
+void export_bouquet (Exporter *exporter, Bouquet *bouquet);
+void export_channel (Exporter *exporter, OpenTVChannel *channel, Xmltv *xmltv);
+
+#endif
@@ -0,0 +1,64 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * feed.h - Section feed headers.
+ */
+
+#ifndef __FEED_H_
+#define __FEED_H_ 1
+
+#include <pthread.h>
+#include "filter.h"
+#include "ts.h"
+
+/* Where sections come from. */
+#define FEED_DEMUX 0
+#define FEED_CAPTURE 1
+#define FEED_TS 2
+
+/* Filters a feed can have at once, each is a demux fd of its own. */
+#define FEED_FILTER_MAX 20
+
+/* A source of sections with a set of section filters. On a demux every
+ * filter is set in the kernel on its own fd, a section capture or transport
+ * stream is filtered here with the same semantics. */
+typedef struct tFeed {
+	int		type;
+
+	/* The fds to read, one per filter on a demux, otherwise just the one. */
+	int		fds[FEED_FILTER_MAX];
+	int		fd_count;
+
+	/* PIDs tapped through to the dvr when reading the transport stream live. */
+	int		pes_fds[2];
+
+	/* Current filters, guarded by lock for software filtering. */
+	SectionFilter	filters[FEED_FILTER_MAX];
+	unsigned char	used[FEED_FILTER_MAX];
+	pthread_mutex_t	lock;
+
+	/* Software demux, only for FEED_TS. */
+	TsDemux		ts;
+
+	/* Set for a deduplicated FEED_CAPTURE, see carousel.c. */
+	struct tCarousel *carousel;
+
+	/* Sections passed and dropped by software filtering. */
+	unsigned long	passed;
+	unsigned long	dropped;
+} Feed;
+
+int feed_open_demux (Feed *feed, int dvb_adapter, int dvb_demux, unsigned long buffer_size, int filter_count);
+int feed_open_dvr (Feed *feed, int dvb_adapter, int dvb_demux, unsigned long buffer_size);
+int feed_open_capture (Feed *feed, const char *filename, int speed);
+int feed_open_ts (Feed *feed, const char *filename);
+void feed_close (Feed *feed);
+
+int feed_set_filter (Feed *feed, int index, SectionFilter *filter);
+void feed_stop_filter (Feed *feed, int index);
+int feed_filter_sections (Feed *feed, unsigned char *buffer, int buffer_length, int *kept);
+int feed_is_file (Feed *feed);
+
+#endif
@@ -0,0 +1,44 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * filter.h - Software section filter headers.
+ */
+
+#ifndef __FILTER_H_
+#define __FILTER_H_ 1
+
+/* Same depth as DMX_FILTER_SIZE. */
+#define FILTER_SIZE 16
+
+/* Flags, as DMX_CHECK_CRC. */
+#define FILTER_CHECK_CRC 1
+
+/* A section filter as given to DMX_SET_FILTER. Byte 0 of filter, mask and
+ * mode is the table_id and bytes 1 onwards match section bytes 3 onwards,
+ * skipping the length. A mode bit of 0 means the masked bit must equal the
+ * filter bit, a mode bit of 1 means at least one such bit must differ. */
+typedef struct tSectionFilter {
+	unsigned short	pid;
+	unsigned char	filter[FILTER_SIZE];
+	unsigned char	mask[FILTER_SIZE];
+	unsigned char	mode[FILTER_SIZE];
+	unsigned int	flags;
+
+	/* Worked out by filter_prepare, indexed by section byte. */
+	unsigned char	value[FILTER_SIZE + 2];
+	unsigned char	positive[FILTER_SIZE + 2];
+	unsigned char	negative[FILTER_SIZE + 2];
+	unsigned char	depth;
+	unsigned char	any_negative;
+} SectionFilter;
+
+void filter_init (SectionFilter *filter, unsigned short pid, unsigned char table, unsigned char mask, int crc);
+void filter_extension (SectionFilter *filter, unsigned short extension);
+void filter_version_not (SectionFilter *filter, unsigned char version);
+void filter_prepare (SectionFilter *filter);
+int filter_match (SectionFilter *filter, unsigned char *section, int section_length);
+unsigned short filter_table_pid (unsigned char table_id);
+
+#endif
@@ -0,0 +1,78 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * history.h - Lineup history store headers.
+ */
+
+#ifndef __HISTORY_H_
+#define __HISTORY_H_ 1
+
+#include <stdio.h>
+#include <stddef.h>
+#include "index.h"
+
+/* Every this many snapshots one is written whole rather than as changes, so
+ * a read never applies more than this less one deltas. */
+#define HISTORY_KEYFRAME_INTERVAL 16
+
+/* Record types. */
+#define HISTORY_RECORD_KEYFRAME 'K'
+#define HISTORY_RECORD_DELTA 'D'
+
+/* A lineup channel as stored, keyed as the channel index is. */
+typedef struct tHistoryEntry {
+	unsigned long long key;
+
+	unsigned int	frequency;
+	unsigned int	symbol_rate;
+	unsigned short	original_network_id;
+	unsigned short	transport_id;
+	unsigned short	service_id;
+	unsigned short	bouquet_id;
+	unsigned char	service_type;
+	unsigned char	polarization;
+	unsigned char	modulation_system;
+	unsigned char	roll_off;
+
+	/* UTF-8 name, an offset into the snapshot's names. */
+	unsigned int	name;
+	unsigned short	name_length;
+} HistoryEntry;
+
+static inline unsigned short history_entry_user_number (HistoryEntry *entry) { return entry->key >> 24; }
+static inline unsigned short history_entry_channel_number (HistoryEntry *entry) { return (entry->key >> 8) & 0xffff; }
+static inline unsigned char history_entry_region (HistoryEntry *entry) { return entry->key & 0xff; }
+
+/* A whole lineup as it stood when a snapshot was taken, in key order. */
+typedef struct tHistorySnapshot {
+	unsigned long long time;
+
+	HistoryEntry	*entries;
+	unsigned int	count;
+	unsigned int	size;
+
+	char		*names;
+	size_t		names_used;
+	size_t		names_size;
+} HistorySnapshot;
+
+/* Which entries are shown, every one for a user number of 0 and no regions. */
+typedef struct tHistoryFilter {
+	unsigned short	user_number;
+	RegionSet	*regions;
+} HistoryFilter;
+
+int history_time (const char *text, unsigned long long *time);
+
+int history_append (const char *filename, unsigned long long time, ChannelIndex *lineup);
+int history_read (const char *filename, unsigned long long time, HistorySnapshot *snapshot);
+int history_snapshot_lineup (ChannelIndex *lineup, HistorySnapshot *snapshot);
+void history_snapshot_free (HistorySnapshot *snapshot);
+
+void history_print (FILE *out, HistorySnapshot *snapshot, HistoryFilter *filter);
+void history_diff (FILE *out, HistorySnapshot *from, HistorySnapshot *to, HistoryFilter *filter);
+void history_compare (HistorySnapshot *from, HistorySnapshot *to, HistoryFilter *filter, unsigned int *removed, unsigned int *added, unsigned int *changed);
+
+#endif
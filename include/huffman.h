@@ -0,0 +1,43 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * huffman.h - Table driven Huffman decoder headers.
+ */
+
+#ifndef __HUFFMAN_H_
+#define __HUFFMAN_H_ 1
+
+/* Bits decoded per table lookup. */
+#define HUFFMAN_BITS 8
+#define HUFFMAN_ENTRIES (1 << HUFFMAN_BITS)
+
+/* Entry next for a byte which leaves the code tree or ends the string, decoding stops there. */
+#define HUFFMAN_INVALID 0xffff
+
+/* What a byte decodes to from one state, the text of every code completed
+ * in it and the state the last incomplete code leaves us in. */
+typedef struct tHuffmanEntry {
+	unsigned int	text;
+	unsigned short	length;
+	unsigned short	next;
+} HuffmanEntry;
+
+/* A dictionary compiled into one table of HUFFMAN_ENTRIES per state, a state
+ * being a point part way through a code, state 0 being the start of one. */
+typedef struct tHuffman {
+	HuffmanEntry	*table;
+	unsigned int	state_count;
+
+	/* Text of all entries, back to back. */
+	char		*text;
+	unsigned int	text_length;
+	unsigned int	text_size;
+} Huffman;
+
+int huffman_load (Huffman *huffman, const char *filename);
+void huffman_free (Huffman *huffman);
+int huffman_decode (Huffman *huffman, const unsigned char *data, int data_length, char *out, int out_size);
+
+#endif
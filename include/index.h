@@ -0,0 +1,36 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * index.h - Sorted channel number index headers.
+ */
+
+#ifndef __INDEX_H_
+#define __INDEX_H_ 1
+
+#include "data.h"
+
+/* Channels ordered by user number, then channel number, then region, with
+ * the same channel from other regions dropped. Entries are indexes into the
+ * model's channel pool. */
+typedef struct tChannelIndex {
+	unsigned int	*channels;
+	unsigned int	count;
+
+	/* Region variants dropped while building. */
+	unsigned int	duplicates;
+} ChannelIndex;
+
+/* The sort key, user number then channel number then region. */
+static inline unsigned long long channel_index_key (OpenTVChannel *channel) { return ((unsigned long long) channel->user_number << 24) | ((unsigned long long) channel->channel_number << 8) | channel->region; }
+
+static inline OpenTVChannel * channel_index_at (ChannelIndex *index, unsigned int position) { return opentv_channel_at(index->channels[position]); }
+
+int channel_index_build (ChannelIndex *index, unsigned int *channels, unsigned int count);
+void channel_index_free (ChannelIndex *index);
+int channel_index_find (ChannelIndex *index, unsigned short user_number);
+
+int filter_data (ChannelIndex *index, int filter_bouquet_id, RegionSet *filter_regions, int filter_dvbs, int filter_hd, int filter_user_number);
+
+#endif
@@ -0,0 +1,60 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * libslowlane.h - Library interface headers.
+ */
+
+#ifndef __LIBSLOWLANE_H_
+#define __LIBSLOWLANE_H_ 1
+
+#include "data.h"
+#include "si.h"
+#include "huffman.h"
+#include "acquire.h"
+#include "index.h"
+
+/* A lineup channel as handed to a ChannelCallback. The names are UTF-8 and
+ * only valid during the call, NULL where none was seen. */
+typedef struct tSlowlaneChannel {
+	OpenTVChannel	*channel;
+	Service		*service;
+	TransportTuning	*tuning;
+	unsigned short	bouquet_id;
+
+	const char	*name;
+	const char	*alt_name;
+	const char	*provider;
+} SlowlaneChannel;
+
+typedef void (*ChannelCallback) (void *user, SlowlaneChannel *channel);
+
+/* Everything one scan works on, any number may be in use at once. */
+typedef struct tSlowlane {
+	DataModel	model;
+
+	/* Settings for feeds acquired into this context. */
+	AcquireOptions	options;
+
+	/* The filtered lineup, once slowlane_filter has run. */
+	ChannelIndex	lineup;
+} Slowlane;
+
+void slowlane_init (Slowlane *slowlane);
+void slowlane_free (Slowlane *slowlane);
+DataModel * slowlane_select (Slowlane *slowlane);
+
+void slowlane_set_demand (Slowlane *slowlane, unsigned int demand, unsigned short bouquet_id);
+void slowlane_set_demand_regions (Slowlane *slowlane, RegionSet *regions);
+void slowlane_set_memory_cap (Slowlane *slowlane, PoolCap *cap);
+void slowlane_set_retain (Slowlane *slowlane, int retain);
+void slowlane_set_opentv_dictionary (Slowlane *slowlane, Huffman *dictionary);
+void slowlane_set_section_callback (Slowlane *slowlane, SectionCallback callback, void *user);
+
+int slowlane_process (Slowlane *slowlane, unsigned char *buffer, int buffer_length);
+int slowlane_acquire (Slowlane *slowlane, Acquisition *acquisitions, int acquisition_count);
+int slowlane_filter (Slowlane *slowlane, int filter_dvbs, int filter_hd);
+void slowlane_channels (Slowlane *slowlane, ChannelCallback callback, void *user);
+
+#endif
@@ -0,0 +1,80 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * names.h - Region and bouquet names headers.
+ */
+
+#ifndef __NAMES_H_
+#define __NAMES_H_ 1
+
+/* Longest name, and so key, in REGIONS or BOUQUETS. */
+#define NAMES_KEY_MAX 128
+
+/* A region or bouquet as listed in REGIONS or BOUQUETS, bouquet_id being the
+ * bouquet a region was listed under. */
+typedef struct tNameEntry {
+	unsigned short	id;
+	unsigned short	bouquet_id;
+	const char	*name;
+} NameEntry;
+
+/* A minimal perfect hash of size keys onto size slots, built by mknames. A
+ * key's hash with no seed picks the seed its slot is hashed with. Each slot
+ * holds the entry of its key, and for names the key itself to tell a miss. */
+typedef struct tNameHash {
+	unsigned int		size;
+	const unsigned short	*seeds;
+	const unsigned char	*slots;
+	const char * const	*keys;
+} NameHash;
+
+/* FNV-1a, started from the seed. */
+static inline unsigned int names_hash (const unsigned char *data, unsigned int length, unsigned int seed) {
+	unsigned int hash = 2166136261u ^ (seed * 0x9e3779b9u), i;
+
+	for (i = 0; i < length; i++) {
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+static inline unsigned int names_slot (const NameHash *table, const unsigned char *data, unsigned int length) {
+	return names_hash(data, length, table->seeds[names_hash(data, length, 0) % table->size]) % table->size;
+}
+
+/* Names match ignoring case and anything but letters and digits, so
+ * "england-2-oxford" finds "England 2 - Oxford". The part of a name after its
+ * last " - " matches too where no other name shares it, "oxford" included.
+ * Returns the key's length, -1 if too long. */
+static inline int names_key (const char *name, char *key) {
+	int length = 0;
+
+	for (; *name; name++) {
+		if ((*name >= 'a' && *name <= 'z') || (*name >= '0' && *name <= '9')) {
+			key[length++] = *name;
+		} else if (*name >= 'A' && *name <= 'Z') {
+			key[length++] = *name - 'A' + 'a';
+		}
+
+		if (length == NAMES_KEY_MAX) {
+			return -1;
+		}
+	}
+
+	key[length] = '\0';
+
+	return length;
+}
+
+/* Ids from a number or a name, -1 if neither. */
+int names_bouquet_id (const char *text);
+int names_region_id (const char *text);
+
+/* Names of ids, NULL if not listed. */
+const char * names_bouquet (unsigned short bouquet_id);
+const char * names_region (unsigned char region);
+
+#endif
@@ -0,0 +1,67 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * pool.h - Chunked object pool headers.
+ */
+
+#ifndef __POOL_H_
+#define __POOL_H_ 1
+
+#include <stddef.h>
+
+/* Index 0 is never handed out, it terminates lists in place of NULL. */
+#define POOL_NONE 0
+
+/* A limit on the bytes the pools of a scan may hold between them, shared by
+ * every model it builds on whichever thread. Chunks are charged as they're
+ * added and released with the pool, and once a chunk would take used past
+ * limit none is added and exceeded is set, so the scan can fail as a whole. */
+typedef struct tPoolCap {
+	size_t		limit;
+	size_t		used;
+	size_t		peak;
+	int		exceeded;
+} PoolCap;
+
+/* Objects are allocated in fixed size chunks which never move, so a pointer
+ * to an object stays valid for the life of the pool and objects can refer to
+ * each other with a 32-bit index rather than a 64-bit pointer. */
+typedef struct tPool {
+	/* Size of one object, and objects per chunk expressed as a shift. */
+	unsigned int	object_size;
+	unsigned int	chunk_shift;
+
+	/* Number of indexes handed out, including the reserved index 0. */
+	unsigned int	count;
+
+	/* Chunk table. */
+	unsigned int	chunk_count;
+	char		**chunks;
+
+	/* Charged for each chunk if set. */
+	PoolCap		*cap;
+} Pool;
+
+/* Static initialiser, equivalent to pool_init. */
+#define POOL_INITIALIZER(object_size, chunk_shift) { (object_size), (chunk_shift), 1, 0, NULL, NULL }
+
+void pool_init (Pool *pool, unsigned int object_size, unsigned int chunk_shift);
+unsigned int pool_alloc (Pool *pool);
+void pool_free_all (Pool *pool);
+size_t pool_bytes (Pool *pool);
+
+int pool_cap_charge (PoolCap *cap, size_t bytes);
+void pool_cap_release (PoolCap *cap, size_t bytes);
+static inline int pool_cap_exceeded (PoolCap *cap) { return cap && cap->exceeded; }
+
+/* Translate an index into a pointer, POOL_NONE gives NULL. */
+static inline void * pool_get (Pool *pool, unsigned int index) {
+	if (index == POOL_NONE)
+		return NULL;
+
+	return pool->chunks[index >> pool->chunk_shift] + (index & ((1u << pool->chunk_shift) - 1)) * pool->object_size;
+}
+
+#endif
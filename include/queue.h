@@ -0,0 +1,62 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * queue.h - Single producer, single consumer section queue headers.
+ */
+
+#ifndef __QUEUE_H_
+#define __QUEUE_H_ 1
+
+/* Large enough for anything a single demux read can return. */
+#define QUEUE_SLOT_SIZE 2*4096
+
+/* One buffer as returned by a read, the usual thing to queue. */
+typedef struct tQueueSlot {
+	int		length;
+
+	/* When it was read, in monotonic microseconds, or when it was captured on replay. */
+	unsigned long long time;
+
+	unsigned char	data[QUEUE_SLOT_SIZE];
+} QueueSlot;
+
+/* Lock free ring of slots, only one thread may write and one may read. The
+ * producer owns head and the consumer owns tail, each is only ever written by
+ * its owner and is padded out to its own cache line. */
+typedef struct tQueue {
+	/* Number of slots, always a power of two, and bytes per slot. */
+	unsigned int	size;
+	unsigned int	slot_size;
+	char		*slots;
+
+	/* Next slot the producer will fill. */
+	unsigned int	head;
+	char		head_pad[60];
+
+	/* Next slot the consumer will read. */
+	unsigned int	tail;
+	char		tail_pad[60];
+
+	/* Set by the producer when nothing more will be written. */
+	int		closed;
+
+	/* Number of times the producer had to wait for a free slot. */
+	unsigned long	stalls;
+} Queue;
+
+int queue_init (Queue *queue, unsigned int size, unsigned int slot_size);
+void queue_free (Queue *queue);
+
+void * queue_write_slot (Queue *queue);
+void * queue_write_wait (Queue *queue, int timeout_ms);
+void queue_write_commit (Queue *queue);
+void queue_close (Queue *queue);
+
+void * queue_read_slot (Queue *queue);
+void * queue_read_wait (Queue *queue, int timeout_ms);
+void queue_read_release (Queue *queue);
+int queue_finished (Queue *queue);
+
+#endif
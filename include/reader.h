@@ -0,0 +1,54 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * reader.h - Demux reader thread headers.
+ */
+
+#ifndef __READER_H_
+#define __READER_H_ 1
+
+#include <pthread.h>
+#include "queue.h"
+#include "feed.h"
+
+/* Slots in the queue between the reader and the parser, at QUEUE_SLOT_SIZE
+ * each this is 2MB which covers several seconds of a full SI carousel. */
+#define READER_QUEUE_SLOTS 256
+
+/* Transport stream is read this many packets at a time. */
+#define READER_TS_PACKETS 1024
+
+/* Reader states. */
+#define READER_RUNNING 0
+#define READER_EOF 1
+#define READER_FAILED -1
+
+typedef struct tReader {
+	/* Where we read from and where it goes. */
+	Feed		*feed;
+	Queue		*queue;
+
+	/* Transport stream is demuxed into the slot being filled until it is
+	 * full or the read is done, a capture keeps a split section in buffer
+	 * until the next read. */
+	unsigned char	*buffer;
+	int		carry_length;
+	QueueSlot	*slot;
+
+	/* Thread and control. */
+	pthread_t	thread;
+	int		stop;
+	int		state;
+
+	/* Statistics. */
+	unsigned long	reads;
+	unsigned long	bytes;
+	unsigned long	overflows;
+} Reader;
+
+int reader_start (Reader *reader, Feed *feed, Queue *queue);
+void reader_stop (Reader *reader);
+
+#endif
@@ -0,0 +1,198 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * schema.h - Section and descriptor layouts, described once.
+ */
+
+#ifndef __SCHEMA_H_
+#define __SCHEMA_H_ 1
+
+/* Big endian reads of one to four bytes. */
+static inline unsigned int schema_read1 (const unsigned char *data) { return data[0]; }
+static inline unsigned int schema_read2 (const unsigned char *data) { return (data[0] << 8) | data[1]; }
+static inline unsigned int schema_read3 (const unsigned char *data) { return (data[0] << 16) | (data[1] << 8) | data[2]; }
+static inline unsigned int schema_read4 (const unsigned char *data) { return ((unsigned int) data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3]; }
+
+/* A schema lists the fixed part of a structure as F(S, name, offset, bytes,
+ * shift, mask), the field being the bits mask of the big endian bytes at
+ * offset shifted down by shift. SCHEMA_DEFINE makes of it a type holding every
+ * field, S_size for the bytes it covers, S_name_offset for where each field
+ * starts, S_read filling the type from data with no branches, and a check at
+ * compile time that every field lies within S_size. Nothing is read before
+ * the section has been validated, see si_valid. */
+#define SCHEMA_FIELD(S, name, offset, bytes, shift, mask) unsigned int name;
+#define SCHEMA_READ(S, name, offset, bytes, shift, mask) out->name = (schema_read##bytes(data + (offset)) >> (shift)) & (mask);
+#define SCHEMA_OFFSET(S, name, offset, bytes, shift, mask) S##_##name##_offset = (offset),
+#define SCHEMA_CHECK(S, name, offset, bytes, shift, mask) typedef char S##_##name##_within[(offset) + (bytes) <= S##_size ? 1 : -1];
+
+#define SCHEMA_DEFINE(type, S, size, FIELDS) \
+	enum { S##_size = (size), FIELDS(SCHEMA_OFFSET, S) }; \
+	typedef struct { FIELDS(SCHEMA_FIELD, S) } type; \
+	FIELDS(SCHEMA_CHECK, S) \
+	static inline void S##_read (const unsigned char *data, type *out) { FIELDS(SCHEMA_READ, S) }
+
+/* Offsets are from past the table id and section length. */
+
+/* NIT and BAT, id being the network or bouquet. */
+#define SI_NETWORK_HEADER(F, S) \
+	F(S, id, 0, 2, 0, 0xffff) \
+	F(S, version, 2, 1, 1, 0x1f) \
+	F(S, section_number, 3, 1, 0, 0xff) \
+	F(S, last_section_number, 4, 1, 0, 0xff) \
+	F(S, descriptors_length, 5, 2, 0, 0x0fff)
+
+#define SI_SDT_HEADER(F, S) \
+	F(S, transport_stream_id, 0, 2, 0, 0xffff) \
+	F(S, version, 2, 1, 1, 0x1f) \
+	F(S, section_number, 3, 1, 0, 0xff) \
+	F(S, last_section_number, 4, 1, 0, 0xff) \
+	F(S, original_network_id, 5, 2, 0, 0xffff)
+
+#define SI_EIT_HEADER(F, S) \
+	F(S, service_id, 0, 2, 0, 0xffff) \
+	F(S, version, 2, 1, 1, 0x1f) \
+	F(S, section_number, 3, 1, 0, 0xff) \
+	F(S, last_section_number, 4, 1, 0, 0xff) \
+	F(S, transport_stream_id, 5, 2, 0, 0xffff) \
+	F(S, original_network_id, 7, 2, 0, 0xffff) \
+	F(S, segment_last_section_number, 9, 1, 0, 0xff) \
+	F(S, last_table_id, 10, 1, 0, 0xff)
+
+/* OpenTV titles and summaries, start times count from the date. */
+#define SI_OPENTV_HEADER(F, S) \
+	F(S, channel_id, 0, 2, 0, 0xffff) \
+	F(S, version, 2, 1, 1, 0x1f) \
+	F(S, section_number, 3, 1, 0, 0xff) \
+	F(S, last_section_number, 4, 1, 0, 0xff) \
+	F(S, date, 5, 2, 0, 0xffff)
+
+/* Length of the transport stream loop of a NIT or BAT. */
+#define SI_LOOP(F, S) \
+	F(S, length, 0, 2, 0, 0x0fff)
+
+/* Loop entries, each followed by descriptors_length bytes of descriptors. */
+#define SI_TRANSPORT_ENTRY(F, S) \
+	F(S, transport_stream_id, 0, 2, 0, 0xffff) \
+	F(S, original_network_id, 2, 2, 0, 0xffff) \
+	F(S, descriptors_length, 4, 2, 0, 0x0fff)
+
+#define SI_SERVICE_ENTRY(F, S) \
+	F(S, service_id, 0, 2, 0, 0xffff) \
+	F(S, running, 3, 1, 5, 0x07) \
+	F(S, free_ca, 3, 1, 4, 0x01) \
+	F(S, descriptors_length, 3, 2, 0, 0x0fff)
+
+/* Start is a Modified Julian Date and BCD time, duration BCD. */
+#define SI_EVENT_ENTRY(F, S) \
+	F(S, event_id, 0, 2, 0, 0xffff) \
+	F(S, date, 2, 2, 0, 0xffff) \
+	F(S, start, 4, 3, 0, 0xffffff) \
+	F(S, duration, 7, 3, 0, 0xffffff) \
+	F(S, running, 10, 1, 5, 0x07) \
+	F(S, free_ca, 10, 1, 4, 0x01) \
+	F(S, descriptors_length, 10, 2, 0, 0x0fff)
+
+/* An OpenTV event, followed by records laid out as descriptors. */
+#define SI_OPENTV_EVENT_ENTRY(F, S) \
+	F(S, event_id, 0, 2, 0, 0xffff) \
+	F(S, descriptors_length, 2, 2, 0, 0x0fff)
+
+/* Descriptors and OpenTV records, followed by length bytes. */
+#define SI_DESCRIPTOR(F, S) \
+	F(S, tag, 0, 1, 0, 0xff) \
+	F(S, length, 1, 1, 0, 0xff)
+
+/* Descriptor bodies, offsets from past the tag and length. */
+
+/* Frequency, orbital position and symbol rate are BCD. */
+#define SI_SATELLITE_DELIVERY(F, S) \
+	F(S, frequency, 0, 4, 0, 0xffffffff) \
+	F(S, orbital_position, 4, 2, 0, 0xffff) \
+	F(S, west_east_flag, 6, 1, 7, 0x01) \
+	F(S, polarization, 6, 1, 5, 0x03) \
+	F(S, roll_off, 6, 1, 3, 0x03) \
+	F(S, modulation_system, 6, 1, 2, 0x01) \
+	F(S, modulation_type, 6, 1, 0, 0x03) \
+	F(S, symbol_rate, 7, 4, 4, 0x0fffffff) \
+	F(S, fec, 10, 1, 0, 0x0f)
+
+/* Followed by the provider's name, then the length and bytes of the service's. */
+#define SI_SERVICE_DESCRIPTOR(F, S) \
+	F(S, service_type, 0, 1, 0, 0xff) \
+	F(S, provider_name_length, 1, 1, 0, 0xff)
+
+/* Followed by the event name, then the length and bytes of the text. */
+#define SI_SHORT_EVENT(F, S) \
+	F(S, language, 0, 3, 0, 0xffffff) \
+	F(S, event_name_length, 3, 1, 0, 0xff)
+
+#define SI_COUNTRY_AVAILABILITY(F, S) \
+	F(S, flag, 0, 1, 7, 0x01)
+
+/* MediaHighway channel information, a region followed by channels. */
+#define SI_OPENTV_CHANNELS(F, S) \
+	F(S, region, 1, 1, 0, 0xff)
+
+#define SI_OPENTV_CHANNEL(F, S) \
+	F(S, service_id, 0, 2, 0, 0xffff) \
+	F(S, type, 2, 1, 0, 0xff) \
+	F(S, channel_number, 3, 2, 0, 0xffff) \
+	F(S, user_number, 5, 2, 0, 0xffff) \
+	F(S, flags, 7, 2, 0, 0xffff)
+
+/* An OpenTV title record, the Huffman coded title following. Start and
+ * duration are in two second units. */
+#define SI_OPENTV_TITLE(F, S) \
+	F(S, start, 0, 2, 0, 0xffff) \
+	F(S, duration, 2, 2, 0, 0xffff) \
+	F(S, category, 4, 1, 0, 0xff)
+
+SCHEMA_DEFINE(SiNetworkHeader, si_network_header, 7, SI_NETWORK_HEADER)
+SCHEMA_DEFINE(SiSdtHeader, si_sdt_header, 8, SI_SDT_HEADER)
+SCHEMA_DEFINE(SiEitHeader, si_eit_header, 11, SI_EIT_HEADER)
+SCHEMA_DEFINE(SiOpenTVHeader, si_opentv_header, 7, SI_OPENTV_HEADER)
+SCHEMA_DEFINE(SiLoop, si_loop, 2, SI_LOOP)
+SCHEMA_DEFINE(SiTransportEntry, si_transport_entry, 6, SI_TRANSPORT_ENTRY)
+SCHEMA_DEFINE(SiServiceEntry, si_service_entry, 5, SI_SERVICE_ENTRY)
+SCHEMA_DEFINE(SiEventEntry, si_event_entry, 12, SI_EVENT_ENTRY)
+SCHEMA_DEFINE(SiOpenTVEventEntry, si_opentv_event_entry, 4, SI_OPENTV_EVENT_ENTRY)
+SCHEMA_DEFINE(SiDescriptor, si_descriptor, 2, SI_DESCRIPTOR)
+SCHEMA_DEFINE(SiSatelliteDelivery, si_satellite_delivery, 11, SI_SATELLITE_DELIVERY)
+SCHEMA_DEFINE(SiServiceDescriptor, si_service_descriptor, 2, SI_SERVICE_DESCRIPTOR)
+SCHEMA_DEFINE(SiShortEvent, si_short_event, 4, SI_SHORT_EVENT)
+SCHEMA_DEFINE(SiCountryAvailability, si_country_availability, 1, SI_COUNTRY_AVAILABILITY)
+SCHEMA_DEFINE(SiOpenTVChannels, si_opentv_channels, 2, SI_OPENTV_CHANNELS)
+SCHEMA_DEFINE(SiOpenTVChannel, si_opentv_channel, 9, SI_OPENTV_CHANNEL)
+SCHEMA_DEFINE(SiOpenTVTitle, si_opentv_title, 7, SI_OPENTV_TITLE)
+
+/* The descriptor loops of the tables, each allowing descriptors of its own.
+ * SCHEMA_RECORDS is for loops of OpenTV records, which look like descriptors
+ * but have tags of their own. */
+#define SCHEMA_RECORDS 0
+#define SCHEMA_NETWORK 1
+#define SCHEMA_NETWORK_TRANSPORT 2
+#define SCHEMA_SERVICE 3
+#define SCHEMA_BOUQUET 4
+#define SCHEMA_BOUQUET_TRANSPORT 5
+#define SCHEMA_EVENT 6
+#define SCHEMA_LOOPS 7
+
+/* How a section is laid out past its fixed header: a descriptor loop whose
+ * length is in the header, a loop length if the entries have one rather than
+ * running to the CRC, then entries of a fixed size each followed by a
+ * descriptor loop with its length in the entry. The loop lengths are 12 bits,
+ * and each descriptor loop is one of SCHEMA_RECORDS to SCHEMA_EVENT. */
+typedef struct tSchemaLayout {
+	const char	*name;
+	unsigned char	header_size;
+	signed char	header_descriptors;
+	unsigned char	header_loop;
+	unsigned char	loop;
+	unsigned char	entry_size;
+	unsigned char	entry_descriptors;
+	unsigned char	entry_loop;
+} SchemaLayout;
+
+#endif
@@ -10,15 +10,41 @@
 #define __SI_H_ 1
 
 #include "data.h"
+#include "event.h"
+#include "huffman.h"
 
+/* What the selected output needs decoded. Descriptors nothing needs are
+ * stepped over, and a bouquet's channels are only decoded if it's wanted. */
+#define SI_DEMAND_NETWORK_NAMES 0x01
+#define SI_DEMAND_BOUQUET_NAMES 0x02
+#define SI_DEMAND_SERVICE_NAMES 0x04
+#define SI_DEMAND_TUNING 0x08
+#define SI_DEMAND_CHANNELS 0x10
+#define SI_DEMAND_EVENTS 0x20
+
+/* Descriptors which are only logged. */
+#define SI_DEMAND_OTHER 0x40
+#define SI_DEMAND_ALL 0x7f
+
+int si_load_bouquets(unsigned short bouquet_id);
 int si_process(unsigned char *buffer, int buffer_length, int internal_crc);
+int si_section_length(unsigned char *buffer, int buffer_length);
+int si_process_section(unsigned char *buffer, int section_length);
 int si_process_nit(unsigned char *buffer, int buffer_length);
 int si_process_sdt(unsigned char *buffer, int buffer_length);
 int si_process_bat(unsigned char *buffer, int buffer_length);
-int si_process_descriptors(unsigned char *buffer, int buffer_length, void *object);
+int si_process_eit(unsigned char table_id, unsigned char *buffer, int buffer_length);
+int si_process_opentv_title(unsigned char table_id, unsigned char *buffer, int buffer_length);
+int si_process_opentv_summary(unsigned char table_id, unsigned char *buffer, int buffer_length);
+int si_process_network_descriptors(unsigned char *buffer, int buffer_length, Network *network);
+int si_process_network_transport_descriptors(unsigned char *buffer, int buffer_length, Transport *transport);
+int si_process_service_descriptors(unsigned char *buffer, int buffer_length, Service *service);
+int si_process_bouquet_descriptors(unsigned char *buffer, int buffer_length, Bouquet *bouquet);
+int si_process_bouquet_transport_descriptors(unsigned char *buffer, int buffer_length, OpenTVChannel *channel);
 int si_process_descriptor_service(unsigned char *buffer, int buffer_length, Service *service);
 int si_process_descriptor_country_availability(unsigned char *buffer, int buffer_length);
-int si_process_descriptor_generic_name(unsigned char *buffer, int buffer_length, char **name);
+int si_process_descriptor_generic_name(unsigned char *buffer, int buffer_length, TextView *name);
+int si_process_descriptor_short_event(unsigned char *buffer, int buffer_length, Event *event);
 int si_process_descriptor_opentv_channel_information(unsigned char *buffer, int buffer_length, OpenTVChannel *channel);
 int si_process_descriptor_satellite_delivery_system(unsigned char *buffer, int buffer_length, Transport *transport);
 
@@ -0,0 +1,182 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * snapshot.h - Lineup snapshot file headers.
+ */
+
+#ifndef __SNAPSHOT_H_
+#define __SNAPSHOT_H_ 1
+
+#include <stddef.h>
+#include "data.h"
+#include "index.h"
+
+#define SNAPSHOT_MAGIC "SLSNAP\001\n"
+#define SNAPSHOT_MAGIC_SIZE 8
+#define SNAPSHOT_VERSION 2
+
+/* Written as it lies in memory, a reader of the other byte order refuses it. */
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+/* A reference to nothing, where an index or string may be missing. */
+#define SNAPSHOT_NONE 0xffffffff
+
+/* Tables, in the order they follow the header. */
+#define SNAPSHOT_NETWORKS 0
+#define SNAPSHOT_TRANSPORTS 1
+#define SNAPSHOT_SERVICES 2
+#define SNAPSHOT_BOUQUETS 3
+#define SNAPSHOT_LINEUP 4
+#define SNAPSHOT_LINEUP_BY_SERVICE 5
+#define SNAPSHOT_STRINGS 6
+#define SNAPSHOT_TABLES 7
+
+/* Where a table is, in bytes from the start of the file, and its count of
+ * records of size bytes. The strings are records of one byte. */
+typedef struct tSnapshotTable {
+	unsigned int	offset;
+	unsigned int	count;
+	unsigned int	size;
+} SnapshotTable;
+
+/* The start of the file, time being when the lineup was filtered and the
+ * filter what it was filtered to. The CRC is of the header before it. */
+typedef struct tSnapshotHeader {
+	char		magic[SNAPSHOT_MAGIC_SIZE];
+	unsigned int	version;
+	unsigned int	byte_order;
+	unsigned long long time;
+	unsigned long long file_size;
+	unsigned long long regions[4];
+	unsigned short	bouquet_id;
+	unsigned short	user_number;
+	unsigned int	header_size;
+	SnapshotTable	tables[SNAPSHOT_TABLES];
+	unsigned int	crc;
+} SnapshotHeader;
+
+/* Records refer to each other by index and to names by offset into the
+ * strings, every name being UTF-8 and terminated, 0 being the empty one. */
+
+/* Ordered by network id. */
+typedef struct tSnapshotNetwork {
+	unsigned short	network_id;
+	unsigned short	reserved;
+	unsigned int	name;
+} SnapshotNetwork;
+
+/* The same original network and transport ids may be used on more than one
+ * satellite, each is a transport of its own. Records are ordered by ids then
+ * by orbit, see snapshot_orbit. */
+static inline unsigned short snapshot_orbit (unsigned short orbital_position, unsigned char west_east_flag) { return (orbital_position << 1) | (west_east_flag & 1); }
+
+/* Ordered by original network id, transport id then orbit, each transport's
+ * services being the service_count from services. */
+typedef struct tSnapshotTransport {
+	unsigned short	original_network_id;
+	unsigned short	transport_id;
+	unsigned int	network;
+	unsigned int	services;
+	unsigned int	service_count;
+	unsigned int	frequency;
+	unsigned int	symbol_rate;
+	unsigned short	orbital_position;
+	unsigned char	modulation_system;
+	unsigned char	polarization;
+	unsigned char	modulation_type;
+	unsigned char	fec;
+	unsigned char	roll_off;
+	unsigned char	west_east_flag;
+} SnapshotTransport;
+
+/* Ordered by original network id, transport id, service id then the orbit
+ * of its transport. */
+typedef struct tSnapshotService {
+	unsigned short	original_network_id;
+	unsigned short	transport_id;
+	unsigned short	service_id;
+	unsigned char	type;
+	unsigned char	running;
+	unsigned char	free_ca;
+	unsigned char	west_east_flag;
+	unsigned short	orbital_position;
+	unsigned int	transport;
+	unsigned int	name;
+	unsigned int	alt_name;
+	unsigned int	provider;
+} SnapshotService;
+
+/* Ordered by bouquet id. */
+typedef struct tSnapshotBouquet {
+	unsigned short	bouquet_id;
+	unsigned short	reserved;
+	unsigned int	name;
+} SnapshotBouquet;
+
+/* The filtered lineup in channel index order, so by user number. Service
+ * and transport are SNAPSHOT_NONE where the model had none, the orbit is
+ * that of the transport, the names are those in REGIONS and BOUQUETS. The
+ * lineup by service is the positions of the lineup ordered by original
+ * network, transport and service id then orbit. */
+typedef struct tSnapshotChannel {
+	unsigned short	user_number;
+	unsigned short	channel_number;
+	unsigned short	original_network_id;
+	unsigned short	transport_id;
+	unsigned short	service_id;
+	unsigned short	bouquet_id;
+	unsigned char	region;
+	unsigned char	type;
+	unsigned short	flags;
+	unsigned short	orbital_position;
+	unsigned char	west_east_flag;
+	unsigned char	reserved;
+	unsigned int	service;
+	unsigned int	transport;
+	unsigned int	region_name;
+	unsigned int	bouquet_name;
+} SnapshotChannel;
+
+/* The layout is fixed, whatever the compiler. */
+typedef char snapshot_header_size[sizeof(SnapshotHeader) == 160 ? 1 : -1];
+typedef char snapshot_network_size[sizeof(SnapshotNetwork) == 8 ? 1 : -1];
+typedef char snapshot_transport_size[sizeof(SnapshotTransport) == 32 ? 1 : -1];
+typedef char snapshot_service_size[sizeof(SnapshotService) == 28 ? 1 : -1];
+typedef char snapshot_bouquet_size[sizeof(SnapshotBouquet) == 8 ? 1 : -1];
+typedef char snapshot_channel_size[sizeof(SnapshotChannel) == 36 ? 1 : -1];
+
+/* A snapshot file mapped for reading, the tables pointing into the mapping. */
+typedef struct tSnapshot {
+	void			*map;
+	size_t			map_size;
+
+	const SnapshotHeader	*header;
+	const SnapshotNetwork	*networks;
+	const SnapshotTransport	*transports;
+	const SnapshotService	*services;
+	const SnapshotBouquet	*bouquets;
+	const SnapshotChannel	*lineup;
+	const unsigned int	*lineup_by_service;
+	const char		*strings;
+} Snapshot;
+
+static inline unsigned int snapshot_count (Snapshot *snapshot, int table) { return snapshot->header->tables[table].count; }
+
+/* A name, the empty one if offset isn't in the strings. */
+static inline const char * snapshot_string (Snapshot *snapshot, unsigned int offset) { return offset < snapshot->header->tables[SNAPSHOT_STRINGS].count ? snapshot->strings + offset : snapshot->strings; }
+
+int snapshot_write (const char *filename, unsigned long long time, ChannelIndex *lineup, unsigned short bouquet_id, RegionSet *regions, unsigned short user_number);
+
+int snapshot_open (Snapshot *snapshot, const char *filename);
+void snapshot_close (Snapshot *snapshot);
+
+int snapshot_find (Snapshot *snapshot, unsigned short user_number);
+const SnapshotChannel * snapshot_channel_by_service (Snapshot *snapshot, unsigned short original_network_id, unsigned short transport_id, unsigned short service_id, unsigned short orbit);
+const SnapshotService * snapshot_service (Snapshot *snapshot, unsigned short original_network_id, unsigned short transport_id, unsigned short service_id, unsigned short orbit);
+const SnapshotTransport * snapshot_transport (Snapshot *snapshot, unsigned short original_network_id, unsigned short transport_id, unsigned short orbit);
+const SnapshotNetwork * snapshot_network (Snapshot *snapshot, unsigned short network_id);
+const SnapshotBouquet * snapshot_bouquet (Snapshot *snapshot, unsigned short bouquet_id);
+
+#endif
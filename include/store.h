@@ -0,0 +1,55 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * store.h - Retained section store headers.
+ */
+
+#ifndef __STORE_H_
+#define __STORE_H_ 1
+
+#include "pool.h"
+#include "data.h"
+
+/* Section bytes are kept in blocks of this size, which never move. A
+ * section is at most 4096 bytes so always fits. */
+#define STORE_BLOCK_SIZE 65536
+
+typedef struct tStoredSection {
+	/* Hash chain. */
+	unsigned int	next;
+
+	unsigned short	length;
+
+	/* Table id, secondary id, extension and section number, see section_store_key. */
+	unsigned long long key;
+
+	unsigned char	*data;
+} StoredSection;
+
+/* The latest copy of each accepted section, hashed on its key. */
+typedef struct tSectionStore {
+	Pool		sections;
+	unsigned int	*buckets;
+	unsigned int	bucket_count;
+
+	unsigned char	**blocks;
+	unsigned int	block_count;
+	unsigned int	block_used;
+
+	/* Statistics. */
+	unsigned long	bytes;
+} SectionStore;
+
+static inline StoredSection * stored_section_at (SectionStore *store, unsigned int index) { return (StoredSection *) pool_get(&store->sections, index); }
+
+SectionStore * section_store (DataModel *model, int create);
+void section_store_free (SectionStore *store);
+void section_store_merge (SectionStore *to, SectionStore *from);
+
+unsigned long long section_store_key (unsigned char table_id, unsigned short secondary_id, unsigned short extension, unsigned char section_number);
+unsigned char * section_store_add (SectionStore *store, const unsigned char *section, int section_length);
+unsigned char * section_store_get (SectionStore *store, unsigned long long key, int *section_length);
+
+#endif
@@ -0,0 +1,44 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * text.h - DVB text conversion and string interning headers.
+ */
+
+#ifndef __TEXT_H_
+#define __TEXT_H_ 1
+
+#include <stddef.h>
+
+/* Longest conversion of a descriptor string, 255 bytes of at most three
+ * bytes of UTF-8 each, plus the terminator. */
+#define TEXT_MAX 1024
+
+/* The DVB default table followed by ISO/IEC 8859-1 to 15, see EN 300 468 Annex A. */
+#define TEXT_CHARSETS 16
+#define TEXT_CHARSET_DEFAULT 0
+
+/* 8859-12 was never published, its slot keeps ASCII only and is used for
+ * the character tables we can't convert. */
+#define TEXT_CHARSET_ASCII 12
+
+/* A DVB string where it lies, a pointer to its length byte with the
+ * unconverted bytes following. It points into a retained section or into the
+ * intern set, NULL if no string was seen. */
+typedef struct tTextView {
+	const unsigned char *data;
+} TextView;
+
+static inline int text_view_length (TextView view) { return view.data ? view.data[0] : 0; }
+
+void text_init (void);
+void text_free (void);
+
+int text_convert (const unsigned char *data, int data_length, char *out, int out_size);
+TextView text_intern (const unsigned char *data, int data_length);
+const char * text_view_string (TextView view, char *out, int out_size);
+
+void text_intern_stats (unsigned int *count, size_t *bytes, unsigned long *lookups);
+
+#endif
@@ -0,0 +1,33 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * tracker.h - Section tracking by table key headers.
+ */
+
+#ifndef __TRACKER_H_
+#define __TRACKER_H_ 1
+
+#include "data.h"
+
+/* Section tracking for one table, keyed the same way the data model keys it. */
+typedef struct tTrackerEntry {
+	/* Transport, table class, extension and original network, 0 for an empty entry. */
+	unsigned long long	key;
+	SectionTracking		sections;
+} TrackerEntry;
+
+/* Open addressed hash of TrackerEntry. */
+typedef struct tSectionTracker {
+	unsigned int	size;
+	unsigned int	count;
+	TrackerEntry	*entries;
+} SectionTracker;
+
+unsigned char tracker_table_class (unsigned char table_id);
+int tracker_init (SectionTracker *tracker);
+void tracker_free (SectionTracker *tracker);
+SectionTracking * tracker_get (SectionTracker *tracker, unsigned char table_id, unsigned short extension, unsigned short original_network_id, unsigned short transport_id, int create);
+
+#endif
@@ -0,0 +1,77 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * ts.h - Transport stream section demultiplexer headers.
+ */
+
+#ifndef __TS_H_
+#define __TS_H_ 1
+
+#include <pthread.h>
+#include "filter.h"
+
+#define TS_PACKET_SIZE 188
+#define TS_SYNC_BYTE 0x47
+#define TS_PID_COUNT 8192
+
+/* Largest section allowed, private sections included. */
+#define TS_SECTION_MAX 4096
+
+/* Section filters that may be installed at once. */
+#define TS_FILTER_MAX 32
+
+/* Called with each whole section that passes a filter. */
+typedef void (*TsSectionCallback) (void *context, unsigned char *section, int section_length);
+
+/* Reassembly state for one PID. */
+typedef struct tTsPid {
+	/* Continuity counter we expect next, -1 before the first packet. */
+	int		continuity;
+
+	/* Section so far, -1 when waiting for a payload_unit_start, and its
+	 * full length once the header is in. */
+	int		length;
+	int		section_length;
+	unsigned char	data[TS_SECTION_MAX];
+} TsPid;
+
+typedef struct tTsDemux {
+	/* Filters, a PID only gets an assembler once filtered on. */
+	SectionFilter	filters[TS_FILTER_MAX];
+	unsigned char	filter_used[TS_FILTER_MAX];
+	TsPid		*pids[TS_PID_COUNT];
+
+	/* One bit per PID with a filter, checked for every packet. */
+	unsigned int	pid_map[TS_PID_COUNT / 32];
+
+	/* Filters may be changed from another thread while we demux, changes
+	 * are staged here and picked up at the start of the next buffer. */
+	pthread_mutex_t	lock;
+	SectionFilter	pending[TS_FILTER_MAX];
+	unsigned char	pending_used[TS_FILTER_MAX];
+	int		pending_changed;
+
+	/* Partial packet left over from the last buffer. */
+	unsigned char	carry[TS_PACKET_SIZE];
+	int		carry_length;
+
+	TsSectionCallback	callback;
+	void		*context;
+
+	/* Statistics. */
+	unsigned long	packets;
+	unsigned long	resyncs;
+	unsigned long	discontinuities;
+	unsigned long	sections;
+	unsigned long	crc_errors;
+} TsDemux;
+
+int ts_demux_init (TsDemux *ts, TsSectionCallback callback, void *context);
+void ts_demux_free (TsDemux *ts);
+int ts_demux_set_filter (TsDemux *ts, int index, SectionFilter *filter);
+void ts_demux_clear_filter (TsDemux *ts, int index);
+void ts_demux_process (TsDemux *ts, unsigned char *buffer, int buffer_length);
+
+#endif
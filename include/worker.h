@@ -0,0 +1,78 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * worker.h - Sharded section parsing headers.
+ */
+
+#ifndef __WORKER_H_
+#define __WORKER_H_ 1
+
+#include <pthread.h>
+#include "data.h"
+#include "queue.h"
+#include "tracker.h"
+
+/* Sections waiting for each worker. */
+#define WORKER_QUEUE_SLOTS 64
+
+/* Accepted sections reported back to the dispatcher. */
+#define WORKER_EVENT_SLOTS 1024
+
+#define WORKER_MAX 64
+
+/* Header of a section a worker has checked and parsed. */
+typedef struct tSectionEvent {
+	unsigned char	table_id;
+	unsigned char	version;
+	unsigned char	section_number;
+	unsigned char	last_section;
+	unsigned short	extension;
+	unsigned short	original_network_id;
+
+	/* EIT only, the rest are keyed without them. */
+	unsigned short	transport_id;
+	unsigned char	segment_last_section;
+} SectionEvent;
+
+typedef struct tWorker {
+	pthread_t	thread;
+
+	/* Sections in, one per QueueSlot, and SectionEvents out. */
+	Queue		sections;
+	Queue		events;
+
+	/* The tables this worker owns. */
+	DataModel	model;
+
+	int		internal_crc;
+
+	/* Statistics. */
+	unsigned long	parsed;
+	unsigned long	bytes;
+} Worker;
+
+typedef struct tWorkerPool {
+	int		count;
+	Worker		*workers;
+
+	int		internal_crc;
+
+	/* A bouquet whose BAT is parsed on the dispatching thread, 0 for none. */
+	unsigned short	local_bouquet_id;
+
+	/* What the workers have accepted so far, for dropping repeats and completion. */
+	SectionTracker	tracker;
+
+	/* Statistics. */
+	unsigned long	dispatched;
+	unsigned long	repeats;
+} WorkerPool;
+
+int worker_pool_start (WorkerPool *pool, int count, int internal_crc, unsigned short local_bouquet_id);
+int worker_pool_dispatch (WorkerPool *pool, unsigned char *buffer, int buffer_length);
+int worker_pool_complete (WorkerPool *pool);
+void worker_pool_finish (WorkerPool *pool);
+
+#endif
@@ -0,0 +1,60 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * xmltv.h - XMLTV channel override headers.
+ */
+
+#ifndef __XMLTV_H_
+#define __XMLTV_H_ 1
+
+#include "pool.h"
+#include "data.h"
+
+/* Bytes read from the file at a time, a tag larger than this grows it. */
+#define XMLTV_READ_SIZE (256 * 1024)
+
+/* Longest display name or icon kept, longer ones are cut. */
+#define XMLTV_TEXT_MAX 512
+
+#define XMLTV_INITIAL_BUCKETS 256
+
+/* A channel from the file, with whichever keys it gave. */
+typedef struct tXmltvChannel {
+	/* Hash chains, by service and by user number. */
+	unsigned int	next_service;
+	unsigned int	next_number;
+
+	char		*xmltvid;
+	char		*callsign;
+	char		*icon;
+
+	unsigned short	original_network_id;
+	unsigned short	transport_id;
+	unsigned short	service_id;
+	unsigned short	user_number;
+
+	unsigned char	has_service;
+	unsigned char	has_number;
+} XmltvChannel;
+
+typedef struct tXmltv {
+	Pool		channels;
+
+	unsigned int	*service_buckets;
+	unsigned int	*number_buckets;
+	unsigned int	bucket_count;
+
+	/* Statistics. */
+	unsigned long	bytes;
+	unsigned long	tags;
+} Xmltv;
+
+static inline XmltvChannel * xmltv_channel_at (Xmltv *xmltv, unsigned int index) { return (XmltvChannel *) pool_get(&xmltv->channels, index); }
+
+int xmltv_load (Xmltv *xmltv, const char *filename);
+void xmltv_free (Xmltv *xmltv);
+XmltvChannel * xmltv_find (Xmltv *xmltv, OpenTVChannel *channel);
+
+#endif
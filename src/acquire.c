@@ -0,0 +1,524 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * acquire.c - Acquisition of the SI tables from one feed. Runs the NIT then
+ * BAT and SDT phases against a feed, parsing into a model of its own, so a
+ * feed per adapter or satellite can be scanned at the same time as others.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "slowlane.h"
+#include "queue.h"
+#include "reader.h"
+#include "worker.h"
+#include "filter.h"
+#include "dvb.h"
+#include "feed.h"
+#include "carousel.h"
+#include "tracker.h"
+#include "si.h"
+#include "data.h"
+#include "event.h"
+#include "acquire.h"
+
+/* Feed filter slots. */
+#define FILTER_NIT 0
+#define FILTER_SDT 1
+#define FILTER_BAT 2
+#define FILTER_EIT 3
+#define FILTER_OPENTV_TITLE 4
+#define FILTER_OPENTV_SUMMARY 12
+
+/* OpenTV spreads titles and summaries over this many PIDs each. */
+#define OPENTV_PIDS 8
+
+/* Smallest demux buffer for event tables, they come in bursts far larger than the default. */
+#define EIT_BUFFER_SIZE (1024 * 1024)
+
+/* Everything an acquisition uses while it runs. */
+typedef struct tAcquireState {
+	Feed		feed;
+	Queue		queue;
+	Reader		reader;
+	WorkerPool	pool;
+	FILE		*capture;
+	CarouselWriter	carousel;
+	int		replay;
+
+	/* The first lineup channel not yet known to be complete, once the BAT is. */
+	int		lineup_started;
+	unsigned int	lineup_cursor;
+} AcquireState;
+
+void acquire_init (Acquisition *acquisition, int source, AcquireOptions *options) {
+	memset(acquisition, '\0', sizeof(Acquisition));
+	acquisition->source = source;
+	acquisition->options = options;
+	data_model_init(&acquisition->model);
+}
+
+/* OpenTV titles on 0x30-0x37 and summaries on 0x40-0x47, a filter per PID. */
+static int acquire_opentv_filters (Feed *feed, int crc_dvb) {
+	SectionFilter section_filter;
+	int i;
+
+	for (i = 0; i < OPENTV_PIDS; i++) {
+		filter_init(&section_filter, 0x0030 + i, 0xa0, 0xfc, crc_dvb);
+
+		if (feed_set_filter(feed, FILTER_OPENTV_TITLE + i, &section_filter) < 0) {
+			slowlane_log(0, "OpenTV title feed_set_filter failed for PID 0x%x.", 0x0030 + i);
+			return -1;
+		}
+
+		filter_init(&section_filter, 0x0040 + i, 0xa8, 0xfc, crc_dvb);
+
+		if (feed_set_filter(feed, FILTER_OPENTV_SUMMARY + i, &section_filter) < 0) {
+			slowlane_log(0, "OpenTV summary feed_set_filter failed for PID 0x%x.", 0x0040 + i);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Filters for the second phase. With a bouquet asked for only its BAT is let
+ * through, and SDTs on their own, rather than every BAT. */
+static int acquire_sdt_bat_filters (Feed *feed, AcquireOptions *options) {
+	SectionFilter section_filter;
+	int filter_bouquet_id = options->filter_bouquet_id, crc_dvb = options->crc_dvb;
+
+	if (options->opentv && acquire_opentv_filters(feed, crc_dvb) < 0) {
+		return -1;
+	}
+
+	/* Everything on the EIT PID, p/f and schedule, which is 0x4e-0x6f less the odd stuffing table. */
+	if (options->eit) {
+		filter_init(&section_filter, 0x0012, 0x40, 0xc0, crc_dvb);
+
+		if (feed_set_filter(feed, FILTER_EIT, &section_filter) < 0) {
+			slowlane_log(0, "EIT feed_set_filter failed for bouquet %i.", filter_bouquet_id);
+			return -1;
+		}
+	}
+
+	if (filter_bouquet_id) {
+		filter_init(&section_filter, 0x0011, 0x42, 0xfb, crc_dvb);
+
+		if (feed_set_filter(feed, FILTER_SDT, &section_filter) < 0) {
+			slowlane_log(0, "SDT feed_set_filter failed for bouquet %i.", filter_bouquet_id);
+			return -1;
+		}
+
+		filter_init(&section_filter, 0x0011, 0x4a, 0xff, crc_dvb);
+		filter_extension(&section_filter, filter_bouquet_id);
+
+		if (feed_set_filter(feed, FILTER_BAT, &section_filter) < 0) {
+			slowlane_log(0, "BAT feed_set_filter failed for bouquet %i.", filter_bouquet_id);
+			return -1;
+		}
+	} else {
+		filter_init(&section_filter, 0x0011, 0x40, 0xf0, crc_dvb);
+
+		if (feed_set_filter(feed, FILTER_SDT, &section_filter) < 0) {
+			slowlane_log(0, "BAT/SDT feed_set_filter failed for all bouquets (%i).", filter_bouquet_id);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Open the feed and set the first filters. */
+static int acquire_open (Acquisition *acquisition, AcquireState *state) {
+	AcquireOptions *options = acquisition->options;
+	SectionFilter section_filter;
+	int retval, i;
+
+	/* Open where the sections come from, files are filtered in software the same as the demux. */
+	switch (acquisition->source) {
+		case ACQUIRE_CAPTURE:
+			retval = feed_open_capture(&state->feed, acquisition->filename, options->replay_speed);
+			break;
+		case ACQUIRE_TS:
+			retval = feed_open_ts(&state->feed, acquisition->filename);
+			break;
+		case ACQUIRE_DVR:
+			retval = feed_open_dvr(&state->feed, acquisition->dvb_adapter, acquisition->dvb_demux, options->buffer_size);
+			break;
+		default:
+			retval = feed_open_demux(&state->feed, acquisition->dvb_adapter, acquisition->dvb_demux, options->buffer_size, options->opentv ? FEED_FILTER_MAX : FILTER_EIT + options->eit);
+			break;
+	}
+
+	if (retval < 0) {
+		slowlane_log(0, "Unable to open feed, returned %i.", retval);
+		return -1;
+	}
+
+	/* Event tables are read at their full rate, give them room if the kernel default is what we have. */
+	for (i = FILTER_EIT; state->feed.type == FEED_DEMUX && options->buffer_size < EIT_BUFFER_SIZE && i < state->feed.fd_count; i++) {
+		if (dvb_set_buffer_size(state->feed.fds[i], EIT_BUFFER_SIZE) < 0) {
+			feed_close(&state->feed);
+			return -1;
+		}
+	}
+
+	/* Files are read as fast as we can, there's no point waiting on them. */
+	state->replay = feed_is_file(&state->feed);
+
+	/* Set filter for NIT. */
+	filter_init(&section_filter, 0x0010, 0x40, 0xf0, options->crc_dvb);
+
+	if ((retval = feed_set_filter(&state->feed, FILTER_NIT, &section_filter)) < 0) {
+		slowlane_log(0, "NIT feed_set_filter failed and returned %i.", retval);
+		feed_close(&state->feed);
+		return -1;
+	}
+
+	/* Filtering in software costs nothing extra, so take SDT and BAT from the start and a recording is used in one pass. A
+	 * lineup scan does the same on the demux, it's over as soon as its BAT and SDTs are in. */
+	if ((state->feed.type != FEED_DEMUX || options->lineup) && acquire_sdt_bat_filters(&state->feed, options) < 0) {
+		feed_close(&state->feed);
+		return -1;
+	}
+
+	/* Record everything read, for replaying later with -f. */
+	if (acquisition->capture_out && options->carousel && carousel_writer_open(&state->carousel, acquisition->capture_out) < 0) {
+		feed_close(&state->feed);
+		return -1;
+	} else if (acquisition->capture_out && !options->carousel && (state->capture = fopen(acquisition->capture_out, "wb")) == NULL) {
+		slowlane_log(0, "Unable to open capture file %s.", acquisition->capture_out);
+		feed_close(&state->feed);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Is a channel in the regions and user numbers the lineup is filtered to? */
+static int acquire_lineup_wanted (AcquireOptions *options, OpenTVChannel *channel) {
+	return channel->user_number <= options->filter_user_number && region_set_passes(&options->filter_regions, channel->region);
+}
+
+/* Is everything the lineup depends on in? That's the bouquet's BAT, then for
+ * each channel wanted from it the tuning of its transport from the NIT and
+ * the transport's SDT. The BAT is parsed on this thread, see worker.c. Once
+ * the BAT is complete its channels are fixed and only ever become complete,
+ * so the cursor keeps the first one which isn't and each check carries on
+ * from there. */
+static int acquire_lineup_complete (AcquireOptions *options, AcquireState *state) {
+	OpenTVChannel *channel;
+	Transport *transport;
+	Bouquet *bouquet;
+	SectionTracking *sections;
+
+	if (!state->lineup_started) {
+		if ((bouquet = bouquet_get(options->filter_bouquet_id)) == NULL || !section_tracking_check(&bouquet->sections)) {
+			return 0;
+		}
+
+		state->lineup_cursor = bouquet->channels;
+		state->lineup_started = 1;
+	}
+
+	for (; state->lineup_cursor != POOL_NONE; state->lineup_cursor = channel->next) {
+		channel = opentv_channel_at(state->lineup_cursor);
+
+		if (!acquire_lineup_wanted(options, channel)) {
+			continue;
+		}
+
+		if ((transport = transport_get_with_original_network_id(channel->original_network_id, channel->transport_id)) == NULL || transport->tuning == POOL_NONE) {
+			return 0;
+		}
+
+		sections = options->workers ? tracker_get(&state->pool.tracker, 0x42, transport->transport_id, transport->original_network_id, 0, 0) : &transport->sections;
+
+		if (sections == NULL || sections->populated == 0 || !section_tracking_check(sections)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* Loop obtaining packets until we have enough, returns -1 if the feed failed. */
+static int acquire_loop (Acquisition *acquisition, AcquireState *state) {
+	AcquireOptions *options = acquisition->options;
+	int dvb_loop = 1, dvb_data_length = 0, dvb_data_size = 0, processed_bytes = 0, done = 0, bat_watched = 0, retval = 0;
+	unsigned char *dvb_data = NULL, *dvb_temp = NULL;
+	time_t dvb_loop_start = time(NULL);
+	SectionFilter section_filter;
+	SectionTracking *sections;
+	QueueSlot *slot;
+	Network *network;
+	Transport *transport;
+	Bouquet *bouquet;
+
+	while (dvb_loop) {
+		/* Wait for the reader, waking regularly so the timeout checks still run. */
+		if ((slot = (QueueSlot *) queue_read_wait(&state->queue, 1000)) == NULL) {
+			if (queue_finished(&state->queue) && (state->replay || state->feed.carousel) && state->reader.state == READER_EOF) {
+				/* Replay is done when the capture is, complete or not, paced or not. */
+				slowlane_log(1, "End of capture reached in phase %i.", dvb_loop);
+				break;
+			} else if (queue_finished(&state->queue)) {
+				slowlane_log(0, "Reader finished early with state %i.", state->reader.state);
+				retval = -1;
+				break;
+			}
+		} else {
+			/* Copy data into dvb_data, after anything left from the last buffer. */
+			if (dvb_data_length + slot->length > dvb_data_size) {
+				slowlane_log(3, "Buffer read in %i, already %i here, growing buffer.", slot->length, dvb_data_length);
+				dvb_temp = (unsigned char *) realloc (dvb_data, dvb_data_length + slot->length);
+
+				if (dvb_temp == NULL) {
+					slowlane_log(0, "Unable to grow buffer to %i.", dvb_data_length + slot->length);
+					retval = -1;
+					break;
+				}
+
+				dvb_data = dvb_temp;
+				dvb_data_size = dvb_data_length + slot->length;
+			}
+
+			memcpy(dvb_data + dvb_data_length, slot->data, slot->length);
+			dvb_data_length += slot->length;
+
+			if (state->capture) {
+				fwrite(slot->data, 1, slot->length, state->capture);
+			} else if (state->carousel.file && carousel_write(&state->carousel, slot->data, slot->length, slot->time) < 0) {
+				/* Carry on with the scan, the capture is as good as it got. */
+				carousel_writer_close(&state->carousel);
+			}
+
+			queue_read_release(&state->queue);
+
+			/* Loop while processing function is reporting success, this is needed for some dvb cards or sasc-ng virtual cards which
+			 * don't obey the one packet per read rule. */
+			do {
+				/* Process SI received. */
+				if ((processed_bytes = options->workers ? worker_pool_dispatch(&state->pool, dvb_data, dvb_data_length) : si_process(dvb_data, dvb_data_length, options->crc_internal)) < 0) {
+					slowlane_log(0, "si_process failed and returned %i.", processed_bytes);
+
+					/* Dump data and flush buffer. */
+					dvb_data_length = 0;
+				} else if (processed_bytes > 0) {
+					if (processed_bytes == dvb_data_length) {
+						slowlane_log(3, "si_process processed whole data of size %i.", processed_bytes);
+					} else {
+						slowlane_log(3, "si_process processed less then whole data of size %i out of %i.", processed_bytes, dvb_data_length);
+						memmove(dvb_data, dvb_data + processed_bytes, dvb_data_length - processed_bytes);
+					}
+
+					dvb_data_length -= processed_bytes;
+				}
+			} while (processed_bytes > 0 && dvb_data_length > 0);
+		}
+
+		/* A model missing what wouldn't fit under the cap is no use, give up on the scan. */
+		if (pool_cap_exceeded(data_model->settings.cap)) {
+			slowlane_log(0, "Abandoning scan at the memory cap of %lu KiB.", (unsigned long) (data_model->settings.cap->limit >> 10));
+			retval = -1;
+			break;
+		}
+
+		/* A lineup is done as soon as everything it uses is, in either phase. */
+		if (options->lineup && acquire_lineup_complete(options, state)) {
+			slowlane_log(2, "Lineup for bouquet %i complete (%i).", options->filter_bouquet_id, dvb_loop);
+			break;
+		}
+
+		if (dvb_loop == 1) {
+			/* Verify if timeout has expired. */
+			if (time(NULL) > dvb_loop_start + options->loop_time || state->replay) {
+				/* Verify if all present networks are complete. */
+				done = 1;
+
+				for (network = network_at(data_model->network_list); network != NULL; network = network_at(network->next)) {
+					if (!section_tracking_check(&network->sections)) {
+						done = 0;
+					}
+				}
+
+				if (done) {
+					/* Inform the user. */
+					slowlane_log(2, "NIT tables complete (%i), moving to BAT and DST tables.", dvb_loop);
+
+					/* Set filter for BAT and SDT in place of the NIT, software feeds and lineup scans have had them all along. */
+					if (state->feed.type == FEED_DEMUX && !options->lineup) {
+						feed_stop_filter(&state->feed, FILTER_NIT);
+
+						if (acquire_sdt_bat_filters(&state->feed, options) < 0) {
+							retval = -1;
+							break;
+						}
+					}
+
+					/* Essentially starting the loop again. */
+				        dvb_loop_start = time(NULL);
+					dvb_loop = 2;
+				}
+			}
+		} else {
+			/* Once the bouquet we want is complete only a new version of it is of any interest, have the filter drop the rest. */
+			if (options->filter_bouquet_id && !bat_watched) {
+				sections = options->workers && !options->lineup ? tracker_get(&state->pool.tracker, 0x4a, options->filter_bouquet_id, 0, 0, 0) : ((bouquet = bouquet_get(options->filter_bouquet_id)) ? &bouquet->sections : NULL);
+
+				if (sections && section_tracking_check(sections)) {
+					filter_init(&section_filter, 0x0011, 0x4a, 0xff, options->crc_dvb);
+					filter_extension(&section_filter, options->filter_bouquet_id);
+					filter_version_not(&section_filter, sections->version);
+					feed_set_filter(&state->feed, FILTER_BAT, &section_filter);
+					bat_watched = 1;
+
+					slowlane_log(2, "BAT for bouquet %i complete at version %i, only passing other versions.", options->filter_bouquet_id, sections->version);
+				}
+			}
+
+			/* Verify if timeout has expired, a capture has no clock so BATs may not have been seen yet and it is read to the end. */
+			if (!state->replay && time(NULL) > dvb_loop_start + options->loop_time) {
+				/* Verify if all present networks are complete, the workers track this for themselves. */
+				done = options->workers ? worker_pool_complete(&state->pool) : 1;
+
+				for (network = network_at(data_model->network_list); network != NULL && !options->workers; network = network_at(network->next)) {
+					for (transport = transport_at(network->transports); transport != NULL; transport = transport_at(transport->next)) {
+						if (transport->sections.populated == 0 || !section_tracking_check(&transport->sections)) {
+							done = 0;
+						}
+					}
+				}
+
+				for (bouquet = bouquet_at(data_model->bouquet_list); bouquet != NULL && !options->workers; bouquet = bouquet_at(bouquet->next)) {
+					if (!section_tracking_check(&bouquet->sections)) {
+						done = 0;
+					}
+				}
+
+				if ((options->eit || options->opentv) && !options->workers && !event_store_complete(event_store(data_model, 0))) {
+					done = 0;
+				}
+
+				if (done) {
+					/* Inform the user. */
+					slowlane_log(2, "BAT and DST tables complete (%i).", dvb_loop);
+
+					dvb_loop = 0;
+					break;
+				}
+			}
+		}
+	}
+
+	free(dvb_data);
+	return retval;
+}
+
+/* Scan one feed into the acquisition's model on the calling thread. */
+int acquire_run (Acquisition *acquisition) {
+	AcquireOptions *options = acquisition->options;
+	DataModel *previous_model = data_model;
+	struct timespec start, end;
+	AcquireState *state;
+	char name[64];
+	int retval = 0;
+
+	if (acquisition->filename) {
+		snprintf(name, sizeof(name), "%s", acquisition->filename);
+	} else {
+		snprintf(name, sizeof(name), "adapter%i/demux%i", acquisition->dvb_adapter, acquisition->dvb_demux);
+	}
+
+	if ((state = (AcquireState *) calloc(1, sizeof(AcquireState))) == NULL) {
+		slowlane_log(0, "Unable to allocate acquisition state for %s.", name);
+		return -1;
+	}
+
+	/* Everything parsed on this thread goes into our own model. */
+	data_model = &acquisition->model;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (acquire_open(acquisition, state) < 0) {
+		retval = -1;
+	} else if (options->workers > 0 && worker_pool_start(&state->pool, options->workers, options->crc_internal, options->lineup ? options->filter_bouquet_id : 0) < 0) {
+		/* Hand sections out to workers if asked. */
+		slowlane_log(0, "Unable to start %i workers.", options->workers);
+		feed_close(&state->feed);
+		retval = -1;
+	} else if (queue_init(&state->queue, READER_QUEUE_SLOTS, sizeof(QueueSlot)) < 0 || reader_start(&state->reader, &state->feed, &state->queue) < 0) {
+		/* Start the reader, from here on this thread only parses what it queues. */
+		slowlane_log(0, "Unable to start reader on %i fds.", state->feed.fd_count);
+		feed_close(&state->feed);
+		retval = -1;
+	} else {
+		retval = acquire_loop(acquisition, state);
+
+		/* Stop the reader and close fd now we're done. */
+		reader_stop(&state->reader);
+		queue_free(&state->queue);
+		feed_close(&state->feed);
+
+		if (state->capture) {
+			fclose(state->capture);
+		} else if (state->carousel.file && carousel_writer_close(&state->carousel) < 0) {
+			slowlane_log(0, "Unable to finish capture file %s.", acquisition->capture_out);
+		}
+
+		/* Bring together what the workers built. */
+		if (options->workers) {
+			worker_pool_finish(&state->pool);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	acquisition->elapsed = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+	acquisition->result = retval;
+
+	slowlane_log(1, "Acquisition from %s took %li ms.", name, acquisition->elapsed);
+
+	if (acquisition->model.events) {
+		slowlane_log(1, "EIT from %s gave %lu events from %lu sections, %lu repeats dropped.", name, acquisition->model.events->events, acquisition->model.events->sections, acquisition->model.events->repeats);
+	}
+
+	free(state);
+	data_model = previous_model;
+
+	return retval;
+}
+
+static void * acquire_thread (void *arg) {
+	acquire_run((Acquisition *) arg);
+
+	return NULL;
+}
+
+/* Scan one feed on a thread of its own, parsed as the calling thread's
+ * model would be. */
+int acquire_start (Acquisition *acquisition) {
+	int retval;
+
+	data_model_settings(&acquisition->model, &data_model->settings);
+
+	if ((retval = pthread_create(&acquisition->thread, NULL, acquire_thread, acquisition)) != 0) {
+		slowlane_log(0, "Unable to start acquisition thread (%s).", strerror(retval));
+		acquisition->result = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Wait for a feed started with acquire_start, returns as acquire_run. */
+int acquire_wait (Acquisition *acquisition) {
+	pthread_join(acquisition->thread, NULL);
+
+	return acquisition->result;
+}
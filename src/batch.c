@@ -0,0 +1,378 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * batch.c - Batch processing of many captures. Each capture is scanned into a
+ * context of its own by one of a number of jobs, which take the next capture
+ * waiting as they finish, so nothing is shared between them but the list.
+ * The lineup is written out and kept as a history snapshot, so captures can be
+ * compared once every model is gone.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "slowlane.h"
+#include "data.h"
+#include "export.h"
+#include "libslowlane.h"
+#include "history.h"
+#include "batch.h"
+
+#define BATCH_PATH_MAX 4096
+
+void batch_init (Batch *batch, AcquireOptions *options) {
+	memset(batch, '\0', sizeof(Batch));
+	batch->options = *options;
+	batch->filter_dvbs = 1;
+	batch->output_format = EXPORT_CSV;
+
+	if ((batch->jobs = sysconf(_SC_NPROCESSORS_ONLN)) < 1) {
+		batch->jobs = 1;
+	}
+}
+
+void batch_free (Batch *batch) {
+	unsigned int i;
+
+	for (i = 0; i < batch->count; i++) {
+		free(batch->captures[i].filename);
+		free(batch->captures[i].name);
+		history_snapshot_free(&batch->captures[i].lineup);
+	}
+
+	free(batch->captures);
+	batch->captures = NULL;
+	batch->count = batch->size = 0;
+}
+
+/* Add one capture, named for its path with the directories flattened. */
+static int batch_add_capture (Batch *batch, const char *filename, const char *name) {
+	BatchCapture *captures, *capture;
+	char *c;
+
+	if (batch->count == batch->size) {
+		batch->size = batch->size ? batch->size * 2 : 64;
+
+		if ((captures = (BatchCapture *) realloc(batch->captures, batch->size * sizeof(BatchCapture))) == NULL) {
+			slowlane_log(0, "Unable to grow batch to %u captures.", batch->size);
+			return -1;
+		}
+
+		batch->captures = captures;
+	}
+
+	capture = &batch->captures[batch->count];
+	memset(capture, '\0', sizeof(BatchCapture));
+
+	for (; name[0] == '/' || (name[0] == '.' && name[1] == '/'); name += name[0] == '/' ? 1 : 2);
+
+	if ((capture->filename = strdup(filename)) == NULL || (capture->name = strdup(name)) == NULL) {
+		slowlane_log(0, "Unable to add %s to batch.", filename);
+		free(capture->filename);
+		return -1;
+	}
+
+	for (c = capture->name; *c; c++) {
+		if (*c == '/') {
+			*c = '_';
+		}
+	}
+
+	batch->count++;
+
+	return 0;
+}
+
+static int batch_compare_names (const void *a, const void *b) {
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/* Every file in a directory, in name order. */
+static int batch_add_directory (Batch *batch, const char *path) {
+	char filename[BATCH_PATH_MAX], **names = NULL, **grown;
+	unsigned int count = 0, size = 0, i;
+	struct dirent *entry;
+	struct stat info;
+	int retval = 0;
+	DIR *dir;
+
+	if ((dir = opendir(path)) == NULL) {
+		slowlane_log(0, "Unable to open batch directory %s.", path);
+		return -1;
+	}
+
+	while ((entry = readdir(dir)) != NULL) {
+		snprintf(filename, sizeof(filename), "%s/%s", path, entry->d_name);
+
+		if (entry->d_name[0] == '.' || stat(filename, &info) < 0 || !S_ISREG(info.st_mode)) {
+			continue;
+		}
+
+		if (count == size) {
+			size = size ? size * 2 : 64;
+
+			if ((grown = (char **) realloc(names, size * sizeof(char *))) == NULL) {
+				slowlane_log(0, "Unable to list %u captures in %s.", size, path);
+				retval = -1;
+				break;
+			}
+
+			names = grown;
+		}
+
+		if ((names[count] = strdup(entry->d_name)) == NULL) {
+			retval = -1;
+			break;
+		}
+
+		count++;
+	}
+
+	closedir(dir);
+	qsort(names, count, sizeof(char *), batch_compare_names);
+
+	for (i = 0; i < count; i++) {
+		snprintf(filename, sizeof(filename), "%s/%s", path, names[i]);
+
+		if (retval == 0 && batch_add_capture(batch, filename, names[i]) < 0) {
+			retval = -1;
+		}
+
+		free(names[i]);
+	}
+
+	free(names);
+
+	return retval;
+}
+
+/* A list of captures, one path a line, or a directory of them. "-" reads the
+ * list from stdin, blank lines and those starting # are skipped. */
+int batch_add (Batch *batch, const char *path) {
+	char line[BATCH_PATH_MAX];
+	struct stat info;
+	int retval = 0;
+	size_t length;
+	FILE *list;
+
+	if (strcmp(path, "-") != 0 && stat(path, &info) == 0 && S_ISDIR(info.st_mode)) {
+		return batch_add_directory(batch, path);
+	}
+
+	if ((list = strcmp(path, "-") == 0 ? stdin : fopen(path, "r")) == NULL) {
+		slowlane_log(0, "Unable to open batch list %s.", path);
+		return -1;
+	}
+
+	while (retval == 0 && fgets(line, sizeof(line), list) != NULL) {
+		for (length = strlen(line); length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r' || line[length - 1] == ' ' || line[length - 1] == '\t'); line[--length] = '\0');
+
+		if (length == 0 || line[0] == '#') {
+			continue;
+		}
+
+		retval = batch_add_capture(batch, line, line);
+	}
+
+	if (list != stdin) {
+		fclose(list);
+	}
+
+	return retval;
+}
+
+/* Count each section a capture's model accepts, from whichever thread parsed it. */
+static void batch_section (void *user, const unsigned char *section, int section_length) {
+	__sync_fetch_and_add(&((BatchCapture *) user)->sections, 1);
+}
+
+/* A transport stream has a sync byte every packet, a recording may start
+ * part way into one. Sections start with their table. */
+static int batch_source (const char *filename) {
+	unsigned char packets[188 * 4];
+	int source = ACQUIRE_CAPTURE, offset;
+	FILE *file;
+
+	if ((file = fopen(filename, "rb")) != NULL) {
+		if (fread(packets, sizeof(packets), 1, file) == 1) {
+			for (offset = 0; offset < 188 && source == ACQUIRE_CAPTURE; offset++) {
+				if (packets[offset] == 0x47 && packets[offset + 188] == 0x47 && packets[offset + 376] == 0x47) {
+					source = ACQUIRE_TS;
+				}
+			}
+		}
+
+		fclose(file);
+	}
+
+	return source;
+}
+
+/* Write a capture's lineup to the output directory. */
+static int batch_write (Batch *batch, BatchCapture *capture, ChannelIndex *lineup) {
+	static const char *extensions[] = { "csv", "ndjson", "bin" };
+	char filename[BATCH_PATH_MAX];
+	Exporter exporter;
+	unsigned int i;
+	int fd, retval;
+
+	snprintf(filename, sizeof(filename), "%s/%s.%s", batch->output_dir, capture->name, extensions[batch->output_format]);
+
+	if ((fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+		slowlane_log(0, "Unable to write lineup to %s.", filename);
+		return -1;
+	}
+
+	export_init(&exporter, batch->output_format, fd);
+
+	for (i = 0; i < lineup->count; i++) {
+		export_channel(&exporter, channel_index_at(lineup, i), NULL);
+	}
+
+	retval = export_flush(&exporter);
+	export_free(&exporter);
+	close(fd);
+
+	return retval;
+}
+
+/* Scan one capture start to finish in a context of its own. */
+static void batch_capture (Batch *batch, BatchCapture *capture) {
+	PoolCap cap = { batch->memory_cap, 0, 0, 0 };
+	struct timespec start, end;
+	Acquisition acquisition;
+	Slowlane slowlane;
+	DataModel *previous;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	slowlane_init(&slowlane);
+	slowlane.options = batch->options;
+	slowlane_set_demand(&slowlane, batch->demand, batch->options.filter_bouquet_id);
+	slowlane_set_demand_regions(&slowlane, &batch->options.filter_regions);
+	slowlane_set_memory_cap(&slowlane, batch->memory_cap ? &cap : NULL);
+	slowlane_set_retain(&slowlane, batch->retain);
+	slowlane_set_section_callback(&slowlane, batch_section, capture);
+
+	acquire_init(&acquisition, batch_source(capture->filename), &slowlane.options);
+	acquisition.filename = capture->filename;
+
+	if ((capture->result = slowlane_acquire(&slowlane, &acquisition, 1)) == 0 && (capture->result = slowlane_filter(&slowlane, batch->filter_dvbs, batch->filter_hd)) == 0) {
+		previous = slowlane_select(&slowlane);
+
+		if (history_snapshot_lineup(&slowlane.lineup, &capture->lineup) < 0 || (batch->output_dir && batch_write(batch, capture, &slowlane.lineup) < 0)) {
+			capture->result = -1;
+		}
+
+		data_model = previous;
+	}
+
+	slowlane_free(&slowlane);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	capture->elapsed = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+
+	slowlane_log(1, "Batch capture %s took %li ms.", capture->name, capture->elapsed);
+}
+
+/* A job takes the next capture waiting until none are left. */
+static void * batch_job (void *arg) {
+	Batch *batch = (Batch *) arg;
+	unsigned int next;
+
+	while ((next = __sync_fetch_and_add(&batch->next, 1)) < batch->count) {
+		batch_capture(batch, &batch->captures[next]);
+	}
+
+	return NULL;
+}
+
+/* Scan every capture, jobs at a time. Returns the number which failed. */
+int batch_run (Batch *batch) {
+	struct timespec start, end;
+	pthread_t *threads;
+	unsigned int i, failed = 0;
+	int jobs, started;
+
+	jobs = batch->jobs < (int) batch->count ? batch->jobs : (int) batch->count;
+	batch->next = 0;
+
+	if ((threads = (pthread_t *) calloc(jobs ? jobs : 1, sizeof(pthread_t))) == NULL) {
+		slowlane_log(0, "Unable to allocate %i batch jobs.", jobs);
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (started = 0; started < jobs; started++) {
+		if (pthread_create(&threads[started], NULL, batch_job, batch) != 0) {
+			slowlane_log(0, "Unable to start batch job %i.", started);
+			break;
+		}
+	}
+
+	/* With no job started the captures are scanned here. */
+	if (started == 0) {
+		batch_job(batch);
+	}
+
+	for (i = 0; i < (unsigned int) started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	batch->elapsed = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+	batch->jobs = started ? started : 1;
+	free(threads);
+
+	for (i = 0; i < batch->count; i++) {
+		failed += batch->captures[i].result < 0;
+	}
+
+	return failed;
+}
+
+/* One line a capture of its result, time, sections accepted, channels and
+ * the channels gone, come and changed against the first capture to succeed,
+ * then the totals. */
+void batch_report (Batch *batch, FILE *out) {
+	BatchCapture *capture, *reference = NULL;
+	HistoryFilter filter = { 0, NULL };
+	unsigned int i, removed, added, changed, failed = 0;
+	unsigned long sections = 0;
+	long elapsed = 0;
+
+	for (i = 0; i < batch->count && reference == NULL; i++) {
+		if (batch->captures[i].result == 0) {
+			reference = &batch->captures[i];
+		}
+	}
+
+	fprintf(out, "# Batch of %u captures against %s\n", batch->count, reference ? reference->name : "none");
+
+	for (i = 0; i < batch->count; i++) {
+		capture = &batch->captures[i];
+		elapsed += capture->elapsed;
+		sections += capture->sections;
+
+		if (capture->result < 0) {
+			fprintf(out, "R %s failed %li %lu\n", capture->name, capture->elapsed, capture->sections);
+			failed++;
+			continue;
+		}
+
+		history_compare(&reference->lineup, &capture->lineup, &filter, &removed, &added, &changed);
+		fprintf(out, "R %s ok %li %lu %u -%u +%u ~%u\n", capture->name, capture->elapsed, capture->sections, capture->lineup.count, removed, added, changed);
+	}
+
+	fprintf(out, "# %u failed, %lu sections in %li ms of scanning, %li ms on %i jobs\n", failed, sections, elapsed, batch->elapsed, batch->jobs);
+}
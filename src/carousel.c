@@ -0,0 +1,426 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * carousel.c - Deduplicated section captures. A carousel sends the same few
+ * sections round and round, so rather than every copy as read, a capture
+ * holds each distinct section once and every arrival as a reference to it.
+ *
+ * The file starts with CAROUSEL_MAGIC, then a record for each section read.
+ * A record is a varint head, the microseconds since the read before shifted
+ * up one for the first section of a read or 1 for any other, and a varint
+ * reference, the index of a section seen before or 0 for a new one, whose
+ * bytes follow as read. New sections are numbered from 1 in the order they
+ * come. Sections are matched on table, extension, version, section number
+ * and CRC, and compared whole, so a replay gives back exactly what was read
+ * and when. A record cut short by a crash ends the capture.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "slowlane.h"
+#include "crc32.h"
+#include "pool.h"
+#include "ts.h"
+#include "carousel.h"
+
+#define CAROUSEL_INITIAL_BUCKETS 256
+#define CAROUSEL_INITIAL_SECTIONS 256
+
+/* Monotonic microseconds, what reads are paced against. */
+static unsigned long long carousel_now (void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static unsigned int carousel_mix (unsigned long long key) {
+	key ^= key >> 29;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 32;
+	return (unsigned int) key;
+}
+
+/* Table, extension, version, section number and CRC for sections with the
+ * syntax indicator, the CRC of the whole for the others, which have none. */
+static unsigned int carousel_hash (const unsigned char *section, int section_length) {
+	unsigned long long key;
+	unsigned int crc;
+
+	if ((section[1] & 0x80) && section_length >= 12) {
+		key = ((unsigned long long) section[0] << 40) | ((unsigned long long) section[3] << 32) | ((unsigned long long) section[4] << 24) | ((unsigned long long) ((section[5] >> 1) & 0x1f) << 16) | section[6];
+		crc = (section[section_length - 4] << 24) | (section[section_length - 3] << 16) | (section[section_length - 2] << 8) | section[section_length - 1];
+	} else {
+		key = section_length;
+		crc = crc32((char *) section, section_length, 0xffffffff);
+	}
+
+	return carousel_mix(key ^ ((unsigned long long) crc << 20));
+}
+
+static unsigned char * carousel_put_varint (unsigned char *out, unsigned long long value) {
+	for (; value >= 0x80; value >>= 7) {
+		*out++ = (value & 0x7f) | 0x80;
+	}
+
+	*out++ = value;
+	return out;
+}
+
+/* Read a varint, NULL if it runs off the end. */
+static const unsigned char * carousel_get_varint (const unsigned char *p, const unsigned char *end, unsigned long long *value) {
+	int shift;
+
+	for (*value = 0, shift = 0; p < end && shift < 64; shift += 7) {
+		*value |= (unsigned long long) (*p & 0x7f) << shift;
+
+		if ((*p++ & 0x80) == 0) {
+			return p;
+		}
+	}
+
+	return NULL;
+}
+
+int carousel_writer_open (CarouselWriter *writer, const char *filename) {
+	memset(writer, '\0', sizeof(CarouselWriter));
+
+	if ((writer->buckets = (unsigned int *) calloc(CAROUSEL_INITIAL_BUCKETS, sizeof(unsigned int))) == NULL) {
+		slowlane_log(0, "Unable to allocate capture index of %i buckets.", CAROUSEL_INITIAL_BUCKETS);
+		return -1;
+	}
+
+	pool_init(&writer->sections, sizeof(CarouselSection), 8);
+	writer->bucket_count = CAROUSEL_INITIAL_BUCKETS;
+
+	if ((writer->file = fopen(filename, "wb")) == NULL || fwrite(CAROUSEL_MAGIC, CAROUSEL_MAGIC_SIZE, 1, writer->file) != 1) {
+		slowlane_log(0, "Unable to open capture file %s.", filename);
+		carousel_writer_close(writer);
+		return -1;
+	}
+
+	writer->bytes_out = CAROUSEL_MAGIC_SIZE;
+
+	return 0;
+}
+
+/* Double the buckets, keeps chains to around one section. */
+static int carousel_writer_grow (CarouselWriter *writer) {
+	unsigned int *buckets, bucket_count = writer->bucket_count * 2, i, bucket;
+	CarouselSection *section;
+
+	if ((buckets = (unsigned int *) calloc(bucket_count, sizeof(unsigned int))) == NULL) {
+		slowlane_log(0, "Unable to grow capture index to %u buckets.", bucket_count);
+		return -1;
+	}
+
+	for (i = 1; i < writer->sections.count; i++) {
+		section = carousel_section_at(writer, i);
+		bucket = section->hash & (bucket_count - 1);
+		section->next = buckets[bucket];
+		buckets[bucket] = i;
+	}
+
+	free(writer->buckets);
+	writer->buckets = buckets;
+	writer->bucket_count = bucket_count;
+
+	return 0;
+}
+
+/* The reference of a section seen before, POOL_NONE if it's new. */
+static unsigned int carousel_writer_find (CarouselWriter *writer, unsigned int hash, const unsigned char *data, int length) {
+	unsigned int index;
+	CarouselSection *section;
+
+	for (index = writer->buckets[hash & (writer->bucket_count - 1)]; index != POOL_NONE; index = section->next) {
+		section = carousel_section_at(writer, index);
+
+		if (section->hash == hash && section->length == length && memcmp(section->data, data, length) == 0) {
+			return index;
+		}
+	}
+
+	return POOL_NONE;
+}
+
+/* Keep a copy of a new section to compare those after with. */
+static int carousel_writer_add (CarouselWriter *writer, unsigned int hash, const unsigned char *data, int length) {
+	unsigned char **blocks;
+	CarouselSection *section;
+	unsigned int index, bucket;
+
+	if (writer->sections.count > writer->bucket_count && carousel_writer_grow(writer) < 0) {
+		return -1;
+	}
+
+	if (writer->block_count == 0 || writer->block_used + length > CAROUSEL_BLOCK_SIZE) {
+		if ((blocks = (unsigned char **) realloc(writer->blocks, (writer->block_count + 1) * sizeof(unsigned char *))) == NULL) {
+			slowlane_log(0, "Unable to grow capture index to %u blocks.", writer->block_count + 1);
+			return -1;
+		}
+
+		writer->blocks = blocks;
+
+		if ((writer->blocks[writer->block_count] = (unsigned char *) malloc(CAROUSEL_BLOCK_SIZE)) == NULL) {
+			slowlane_log(0, "Unable to allocate capture block %u.", writer->block_count);
+			return -1;
+		}
+
+		writer->block_count++;
+		writer->block_used = 0;
+	}
+
+	if ((index = pool_alloc(&writer->sections)) == POOL_NONE) {
+		return -1;
+	}
+
+	bucket = hash & (writer->bucket_count - 1);
+	section = carousel_section_at(writer, index);
+	section->data = writer->blocks[writer->block_count - 1] + writer->block_used;
+	section->length = length;
+	section->hash = hash;
+	section->next = writer->buckets[bucket];
+	writer->buckets[bucket] = index;
+
+	memcpy(section->data, data, length);
+	writer->block_used += length;
+
+	return 0;
+}
+
+/* Record the whole sections of one read, made at time in microseconds. */
+int carousel_write (CarouselWriter *writer, const unsigned char *data, int length, unsigned long long time) {
+	unsigned char record[20], *out;
+	unsigned int hash, reference;
+	int offset, section_length;
+
+	for (offset = 0; offset + 3 <= length; offset += section_length) {
+		section_length = (((data[offset + 1] & 0x0f) << 8) | data[offset + 2]) + 3;
+
+		if (section_length > TS_SECTION_MAX || offset + section_length > length) {
+			slowlane_log(1, "Capture dropped %i bytes which aren't a whole section.", length - offset);
+			break;
+		}
+
+		/* Time only moves on at the start of a read. */
+		if (offset == 0) {
+			out = carousel_put_varint(record, (time > writer->time ? time - writer->time : 0) << 1);
+			writer->time = time > writer->time ? time : writer->time;
+		} else {
+			out = carousel_put_varint(record, 1);
+		}
+
+		hash = carousel_hash(data + offset, section_length);
+
+		if ((reference = carousel_writer_find(writer, hash, data + offset, section_length)) == POOL_NONE && carousel_writer_add(writer, hash, data + offset, section_length) < 0) {
+			return -1;
+		}
+
+		out = carousel_put_varint(out, reference);
+
+		if (fwrite(record, out - record, 1, writer->file) != 1 || (reference == POOL_NONE && fwrite(data + offset, section_length, 1, writer->file) != 1)) {
+			slowlane_log(0, "Unable to write %i byte section to capture.", section_length);
+			return -1;
+		}
+
+		writer->arrivals++;
+		writer->bytes_in += section_length;
+		writer->bytes_out += (out - record) + (reference == POOL_NONE ? section_length : 0);
+	}
+
+	return 0;
+}
+
+/* Close the capture, returns -1 if it couldn't all be written. */
+int carousel_writer_close (CarouselWriter *writer) {
+	unsigned int i;
+	int retval = 0;
+
+	if (writer->file) {
+		retval = fclose(writer->file) == 0 ? 0 : -1;
+		slowlane_log(1, "Capture of %lu sections, %u distinct, took %lu bytes for %lu read.", writer->arrivals, writer->sections.count - 1, writer->bytes_out, writer->bytes_in);
+	}
+
+	for (i = 0; i < writer->block_count; i++) {
+		free(writer->blocks[i]);
+	}
+
+	pool_free_all(&writer->sections);
+	free(writer->blocks);
+	free(writer->buckets);
+	memset(writer, '\0', sizeof(CarouselWriter));
+
+	return retval;
+}
+
+/* Is what's open on fd a deduplicated capture? Anything else is taken as
+ * sections as the demux gave them. */
+int carousel_is (int fd) {
+	char magic[CAROUSEL_MAGIC_SIZE];
+
+	return pread(fd, magic, CAROUSEL_MAGIC_SIZE, 0) == CAROUSEL_MAGIC_SIZE && memcmp(magic, CAROUSEL_MAGIC, CAROUSEL_MAGIC_SIZE) == 0;
+}
+
+/* Map the capture open on fd for replay. */
+int carousel_open (Carousel *carousel, int fd, int speed) {
+	struct stat st;
+	void *map;
+
+	memset(carousel, '\0', sizeof(Carousel));
+
+	if (fstat(fd, &st) < 0 || st.st_size < CAROUSEL_MAGIC_SIZE || (map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		slowlane_log(0, "Unable to map capture on fd %i (%s).", fd, strerror(errno));
+		return -1;
+	}
+
+	carousel->map = (unsigned char *) map;
+	carousel->map_size = st.st_size;
+	carousel->offset = CAROUSEL_MAGIC_SIZE;
+	carousel->speed = speed;
+
+	/* Reference 0 is a new section, so is never filled in. */
+	if ((carousel->sections = (size_t *) malloc(CAROUSEL_INITIAL_SECTIONS * sizeof(size_t))) == NULL) {
+		slowlane_log(0, "Unable to allocate capture index of %i sections.", CAROUSEL_INITIAL_SECTIONS);
+		carousel_close(carousel);
+		return -1;
+	}
+
+	carousel->section_count = 1;
+	carousel->section_size = CAROUSEL_INITIAL_SECTIONS;
+
+	return 0;
+}
+
+/* Remember where a new section is, for the references to it after. */
+static int carousel_remember (Carousel *carousel, size_t offset) {
+	size_t *sections;
+
+	if (carousel->section_count == carousel->section_size) {
+		if ((sections = (size_t *) realloc(carousel->sections, carousel->section_size * 2 * sizeof(size_t))) == NULL) {
+			slowlane_log(0, "Unable to grow capture index to %u sections.", carousel->section_size * 2);
+			return -1;
+		}
+
+		carousel->sections = sections;
+		carousel->section_size *= 2;
+	}
+
+	carousel->sections[carousel->section_count++] = offset;
+
+	return 0;
+}
+
+/* Replay the next read into buffer, or as much of it as fits with the rest
+ * following on the next call, setting time to when it was made. Returns the
+ * bytes of sections, 0 at the end or -1 if the capture is damaged or has a
+ * section larger than the buffer. */
+int carousel_read (Carousel *carousel, unsigned char *buffer, int size, unsigned long long *time) {
+	const unsigned char *p, *end = carousel->map + carousel->map_size, *section;
+	unsigned long long head, reference;
+	int used = 0, section_length;
+
+	while (carousel->offset < carousel->map_size) {
+		if ((p = carousel_get_varint(carousel->map + carousel->offset, end, &head)) == NULL || (p = carousel_get_varint(p, end, &reference)) == NULL) {
+			slowlane_log(1, "Capture cut short at %lu bytes.", (unsigned long) carousel->offset);
+			carousel->offset = carousel->map_size;
+			break;
+		}
+
+		/* The next read starts here, leave it for the next call. */
+		if ((head & 1) == 0 && (used > 0 || carousel->partial)) {
+			break;
+		}
+
+		if (reference == POOL_NONE) {
+			section = p;
+
+			if (end - section < 3 || (section_length = (((section[1] & 0x0f) << 8) | section[2]) + 3) > end - section) {
+				slowlane_log(1, "Capture cut short at %lu bytes.", (unsigned long) carousel->offset);
+				carousel->offset = carousel->map_size;
+				break;
+			}
+		} else if (reference < carousel->section_count) {
+			section = carousel->map + carousel->sections[reference];
+			section_length = (((section[1] & 0x0f) << 8) | section[2]) + 3;
+		} else {
+			slowlane_log(0, "Capture refers to section %llu at %lu bytes, only %u seen.", reference, (unsigned long) carousel->offset, carousel->section_count - 1);
+			errno = EINVAL;
+			return -1;
+		}
+
+		if (used + section_length > size) {
+			if (used == 0) {
+				slowlane_log(0, "Capture has a %i byte section at %lu bytes, larger than the %i byte buffer.", section_length, (unsigned long) carousel->offset, size);
+				errno = EMSGSIZE;
+				return -1;
+			}
+
+			carousel->partial = 1;
+			break;
+		}
+
+		if (reference == POOL_NONE) {
+			if (carousel_remember(carousel, section - carousel->map) < 0) {
+				errno = ENOMEM;
+				return -1;
+			}
+
+			p += section_length;
+		}
+
+		carousel->time += head >> 1;
+		carousel->offset = p - carousel->map;
+		carousel->partial = 0;
+		carousel->arrivals++;
+
+		memcpy(buffer + used, section, section_length);
+		used += section_length;
+	}
+
+	*time = carousel->time;
+
+	return used;
+}
+
+/* Microseconds until the next read is due, 0 if it is or replay isn't paced. */
+long carousel_wait (Carousel *carousel) {
+	unsigned long long head, now, due;
+
+	if (carousel->speed == 0 || carousel->partial || carousel_get_varint(carousel->map + carousel->offset, carousel->map + carousel->map_size, &head) == NULL || (head & 1)) {
+		return 0;
+	}
+
+	now = carousel_now();
+
+	/* The clock starts with the first read. */
+	if (carousel->started == 0) {
+		carousel->first_time = carousel->time + (head >> 1);
+		carousel->started = now;
+		return 0;
+	}
+
+	due = carousel->started + (carousel->time + (head >> 1) - carousel->first_time) / carousel->speed;
+
+	return due > now ? (long) (due - now) : 0;
+}
+
+void carousel_close (Carousel *carousel) {
+	if (carousel->map) {
+		munmap(carousel->map, carousel->map_size);
+		slowlane_log(1, "Capture replayed %lu sections, %u distinct.", carousel->arrivals, carousel->section_count - 1);
+	}
+
+	free(carousel->sections);
+	memset(carousel, '\0', sizeof(Carousel));
+}
@@ -10,17 +10,343 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include "slowlane.h"
 #include "data.h"
+#include "event.h"
+#include "text.h"
+#include "store.h"
+#include "index.h"
+#include "si.h"
+
+/* The model used unless another is selected. */
+static DataModel default_model = {
+	POOL_INITIALIZER(sizeof(Network), 4),
+	POOL_INITIALIZER(sizeof(Transport), 8),
+	POOL_INITIALIZER(sizeof(TransportTuning), 8),
+	POOL_INITIALIZER(sizeof(Service), 10),
+	POOL_INITIALIZER(sizeof(ServiceNames), 10),
+	POOL_INITIALIZER(sizeof(Bouquet), 5),
+	POOL_INITIALIZER(sizeof(OpenTVChannel), 12),
+	POOL_NONE,
+	POOL_NONE,
+	NULL,
+	NULL,
+	0,
+	{ SI_DEMAND_ALL, 0, { { 0 }, 0 }, 0, NULL, NULL, NULL, NULL }
+};
+
+__thread DataModel *data_model = &default_model;
+
+/* Shared empty cold records, handed out for nodes which have none yet. */
+static TransportTuning empty_tuning;
+static ServiceNames empty_names;
+
+/* Model */
+void data_model_init (DataModel *model) {
+	memset(model, '\0', sizeof(DataModel));
+
+	pool_init(&model->networks, sizeof(Network), 4);
+	pool_init(&model->transports, sizeof(Transport), 8);
+	pool_init(&model->transport_tunings, sizeof(TransportTuning), 8);
+	pool_init(&model->services, sizeof(Service), 10);
+	pool_init(&model->service_names, sizeof(ServiceNames), 10);
+	pool_init(&model->bouquets, sizeof(Bouquet), 5);
+	pool_init(&model->channels, sizeof(OpenTVChannel), 12);
+
+	model->network_list = POOL_NONE;
+	model->bouquet_list = POOL_NONE;
+	model->settings.demand = SI_DEMAND_ALL;
+}
+
+/* Parse into a model as settings say, charging its pools to their cap. */
+void data_model_settings (DataModel *model, ParseSettings *settings) {
+	model->settings = *settings;
+
+	model->networks.cap = settings->cap;
+	model->transports.cap = settings->cap;
+	model->transport_tunings.cap = settings->cap;
+	model->services.cap = settings->cap;
+	model->service_names.cap = settings->cap;
+	model->bouquets.cap = settings->cap;
+	model->channels.cap = settings->cap;
+
+	if (model->sections) {
+		model->sections->sections.cap = settings->cap;
+	}
+}
+
+/* Release a model's pools. Interned strings are left alone, and retained
+ * sections which were merged into another model now belong to it. */
+void data_model_free (DataModel *model) {
+	pool_free_all(&model->networks);
+	pool_free_all(&model->transports);
+	pool_free_all(&model->transport_tunings);
+	pool_free_all(&model->services);
+	pool_free_all(&model->service_names);
+	pool_free_all(&model->bouquets);
+	pool_free_all(&model->channels);
+	event_store_free(model->events);
+	section_store_free(model->sections);
+
+	model->events = NULL;
+	model->sections = NULL;
+	model->network_list = POOL_NONE;
+	model->bouquet_list = POOL_NONE;
+}
+
+/* Lists are built by pushing on to the front, so walk another model's list
+ * back to front when copying to keep the same order. Returns the indexes in
+ * list order and the count, NULL if the list is empty. */
+static unsigned int * data_merge_list (Pool *pool, unsigned int head, size_t next_offset, unsigned int *count) {
+	unsigned int *indexes = NULL, *tmp, index, size = 0;
+
+	for (*count = 0, index = head; index != POOL_NONE; index = *(unsigned int *) ((char *) pool_get(pool, index) + next_offset)) {
+		if (*count == size) {
+			size = size ? size * 2 : 64;
+
+			if ((tmp = (unsigned int *) realloc(indexes, size * sizeof(unsigned int))) == NULL) {
+				break;
+			}
+
+			indexes = tmp;
+		}
+
+		indexes[(*count)++] = index;
+	}
+
+	return indexes;
+}
+
+/* Copy services on to the end of a transport, keeping their order. */
+static void data_merge_services (DataModel *from, Transport *src, Transport *dst) {
+	unsigned int src_index, *tail, index;
+	Service *src_service, *service;
+	ServiceNames *src_names;
+
+	for (tail = &dst->services; *tail != POOL_NONE; tail = &service_at(*tail)->next);
+
+	for (src_index = src->services; src_index != POOL_NONE; src_index = src_service->next) {
+		src_service = (Service *) pool_get(&from->services, src_index);
+
+		if ((index = pool_alloc(&data_model->services)) == POOL_NONE) {
+			return;
+		}
+
+		service = service_at(index);
+		*service = *src_service;
+		service->next = POOL_NONE;
+		service->names = POOL_NONE;
 
-Network *network_list = NULL;
-Bouquet *bouquet_list = NULL;
+		if (src_service->names != POOL_NONE) {
+			src_names = (ServiceNames *) pool_get(&from->service_names, src_service->names);
+			*service_names_set(service) = *src_names;
+		}
+
+		*tail = index;
+		tail = &service->next;
+	}
+}
+
+/* A transport of the model being merged by its ids, which are unique
+ * within one feed's model. */
+static unsigned int data_merge_lookup (DataModel *from, unsigned short original_network_id, unsigned short transport_id) {
+	unsigned int network_index, index;
+	Network *network_ptr;
+	Transport *transport_ptr;
+
+	for (network_index = from->network_list; network_index != POOL_NONE; network_index = network_ptr->next) {
+		network_ptr = (Network *) pool_get(&from->networks, network_index);
+
+		for (index = network_ptr->transports; index != POOL_NONE; index = transport_ptr->next) {
+			transport_ptr = (Transport *) pool_get(&from->transports, index);
+
+			if (transport_ptr->transport_id == transport_id && transport_ptr->original_network_id == original_network_id) {
+				return index;
+			}
+		}
+	}
+
+	return POOL_NONE;
+}
+
+/* Copy channels on to the end of a bouquet, keeping their order. Each is
+ * bound to what its transport in the model being merged became, through
+ * transport_map, as the ids alone may name a transport on another satellite. */
+static void data_merge_channels (DataModel *from, Bouquet *src, Bouquet *dst, unsigned int dst_index, unsigned int *transport_map) {
+	unsigned int src_index, *tail, index, src_transport;
+	OpenTVChannel *src_channel, *channel;
+
+	for (tail = &dst->channels; *tail != POOL_NONE; tail = &opentv_channel_at(*tail)->next);
+
+	for (src_index = src->channels; src_index != POOL_NONE; src_index = src_channel->next) {
+		src_channel = (OpenTVChannel *) pool_get(&from->channels, src_index);
+
+		if ((index = pool_alloc(&data_model->channels)) == POOL_NONE) {
+			return;
+		}
+
+		channel = opentv_channel_at(index);
+		*channel = *src_channel;
+		channel->next = POOL_NONE;
+		channel->bouquet = dst_index;
+		channel->transport = POOL_NONE;
+		channel->service = POOL_NONE;
+
+		if (transport_map && (src_transport = data_merge_lookup(from, channel->original_network_id, channel->transport_id)) != POOL_NONE) {
+			channel->transport = transport_map[src_transport];
+		}
+
+		*tail = index;
+		tail = &channel->next;
+	}
+}
+
+/* Find a transport to merge into, by ids and orbital position, returning its
+ * index. The same ids on another satellite are another transport, a transport
+ * with no tuning yet (a worker's stand in) matches on ids alone. */
+static unsigned int data_merge_transport (DataModel *from, Transport *src) {
+	TransportTuning *src_tuning = NULL, *tuning;
+	Network *network_ptr;
+	Transport *transport_ptr;
+	unsigned int index;
+
+	if (src->tuning != POOL_NONE) {
+		src_tuning = (TransportTuning *) pool_get(&from->transport_tunings, src->tuning);
+	}
+
+	for (network_ptr = network_at(data_model->network_list); network_ptr != NULL; network_ptr = network_at(network_ptr->next)) {
+		for (index = network_ptr->transports; index != POOL_NONE; index = transport_ptr->next) {
+			transport_ptr = transport_at(index);
+
+			if (transport_ptr->transport_id != src->transport_id || transport_ptr->original_network_id != src->original_network_id) {
+				continue;
+			}
+
+			if (src_tuning && src_tuning->orbital_position && transport_ptr->tuning != POOL_NONE) {
+				tuning = transport_tuning(transport_ptr);
+
+				if (tuning->orbital_position != src_tuning->orbital_position || tuning->west_east_flag != src_tuning->west_east_flag) {
+					continue;
+				}
+			}
+
+			return index;
+		}
+	}
+
+	return POOL_NONE;
+}
+
+/* Merge another model into the calling thread's model. Tables already present
+ * are kept, the first copy of a table wins. Transports which aren't already
+ * known are only created if create is set, otherwise they're dropped in the
+ * same way an SDT for an unknown transport is. */
+void data_model_merge (DataModel *from, int create) {
+	unsigned int *networks, *transports, *bouquets, *transport_map, network_count, transport_count, bouquet_count, i, j, index;
+	Network *src_network, *network;
+	Transport *src_transport, *transport;
+	Bouquet *src_bouquet, *bouquet;
+
+	/* What each transport merged became, for the channels which refer to them. */
+	if ((transport_map = (unsigned int *) calloc(from->transports.count + 1, sizeof(unsigned int))) == NULL) {
+		slowlane_log(0, "Unable to allocate a map of %u transports, channels will be found by ids alone.", from->transports.count);
+	}
+
+	networks = data_merge_list(&from->networks, from->network_list, offsetof(Network, next), &network_count);
+
+	for (i = network_count; i-- > 0;) {
+		src_network = (Network *) pool_get(&from->networks, networks[i]);
+
+		if ((network = network_get(src_network->network_id)) == NULL && create) {
+			if ((network = network_add(src_network->network_id)) == NULL) {
+				break;
+			}
+
+			network->name = src_network->name;
+			network->sections = src_network->sections;
+		}
+
+		transports = data_merge_list(&from->transports, src_network->transports, offsetof(Transport, next), &transport_count);
+
+		for (j = transport_count; j-- > 0;) {
+			src_transport = (Transport *) pool_get(&from->transports, transports[j]);
+
+			if ((index = data_merge_transport(from, src_transport)) == POOL_NONE) {
+				if (!create || network == NULL) {
+					if (src_transport->sections.populated) {
+						slowlane_log(1, "Could not find transport for TS %i on ONID %i!", src_transport->transport_id, src_transport->original_network_id);
+					}
+
+					continue;
+				}
+
+				if ((transport = transport_add(network, src_transport->original_network_id, src_transport->transport_id)) == NULL) {
+					break;
+				}
+
+				index = network->transports;
+
+				if (src_transport->tuning != POOL_NONE) {
+					*transport_tuning_set(transport) = *(TransportTuning *) pool_get(&from->transport_tunings, src_transport->tuning);
+				}
+			} else {
+				transport = transport_at(index);
+			}
+
+			if (transport_map) {
+				transport_map[transports[j]] = index;
+			}
+
+			/* Take the services from the first model to have the SDT. */
+			if (src_transport->sections.populated && !transport->sections.populated) {
+				transport->sections = src_transport->sections;
+				data_merge_services(from, src_transport, transport);
+			}
+		}
+
+		free(transports);
+	}
+
+	free(networks);
+
+	bouquets = data_merge_list(&from->bouquets, from->bouquet_list, offsetof(Bouquet, next), &bouquet_count);
+
+	for (i = bouquet_count; i-- > 0;) {
+		src_bouquet = (Bouquet *) pool_get(&from->bouquets, bouquets[i]);
+
+		if ((bouquet = bouquet_get(src_bouquet->bouquet_id)) == NULL) {
+			if ((bouquet = bouquet_add(src_bouquet->bouquet_id)) == NULL) {
+				break;
+			}
+		} else if (bouquet->channels != POOL_NONE || bouquet->name.data) {
+			continue;
+		}
+
+		bouquet->name = src_bouquet->name;
+		bouquet->sections = src_bouquet->sections;
+		bouquet->deferred = src_bouquet->deferred;
+		data_merge_channels(from, src_bouquet, bouquet, bouquet_lookup(bouquet->bouquet_id), transport_map);
+	}
+
+	free(bouquets);
+	free(transport_map);
+
+	if (from->events && event_store(data_model, 1)) {
+		event_store_merge(data_model->events, from->events);
+	}
+
+	/* Names may point into the sections, so they come too. */
+	if (from->sections && section_store(data_model, 1)) {
+		section_store_merge(data_model->sections, from->sections);
+	}
+}
 
 /* Network */
 Network * network_get (unsigned short network_id) {
 	Network *network_ptr;
 
-	for (network_ptr = network_list; network_ptr != NULL; network_ptr = network_ptr->next) {
+	for (network_ptr = network_at(data_model->network_list); network_ptr != NULL; network_ptr = network_at(network_ptr->next)) {
 		if (network_ptr->network_id == network_id) {
 			return network_ptr;
 		}
@@ -29,27 +355,28 @@ Network * network_get (unsigned short network_id) {
 	return NULL;
 }
 
-void network_add (Network *new_ptr) {
-	if (network_list == NULL) {
-		new_ptr->next = NULL;
-	} else {
-		new_ptr->next = network_list;	
+Network * network_add (unsigned short network_id) {
+	DataModel *model = data_model;
+	unsigned int index;
+	Network *new_ptr;
+
+	if ((index = pool_alloc(&model->networks)) == POOL_NONE) {
+		return NULL;
 	}
 
-	network_list = new_ptr;
-}
+	new_ptr = network_at(index);
+	new_ptr->network_id = network_id;
+	new_ptr->next = model->network_list;
+	model->network_list = index;
 
-Network * network_new (void) {
-	Network *network_ptr = (Network *) malloc(sizeof(Network));
-	memset(network_ptr, '\0', sizeof(Network));
-	return network_ptr;
+	return new_ptr;
 }
 
 /* Transport */
 Transport * transport_get (Network *network_ptr, unsigned short transport_id) {
 	Transport *transport_ptr;
 
-	for (transport_ptr = network_ptr->transports; transport_ptr != NULL; transport_ptr = transport_ptr->next) {
+	for (transport_ptr = transport_at(network_ptr->transports); transport_ptr != NULL; transport_ptr = transport_at(transport_ptr->next)) {
 		if (transport_ptr->transport_id == transport_id) {
 			return transport_ptr;
 		}
@@ -59,99 +386,176 @@ Transport * transport_get (Network *network_ptr, unsigned short transport_id) {
 }
 
 Transport * transport_get_with_original_network_id (unsigned short original_network_id, unsigned short transport_id) {
+	return transport_at(transport_lookup(original_network_id, transport_id));
+}
+
+/* As above, but returns the pool index for storing in other nodes. */
+unsigned int transport_lookup (unsigned short original_network_id, unsigned short transport_id) {
 	Network *network_ptr;
 	Transport *transport_ptr;
+	unsigned int index;
+
+	for (network_ptr = network_at(data_model->network_list); network_ptr != NULL; network_ptr = network_at(network_ptr->next)) {
+		for (index = network_ptr->transports; index != POOL_NONE; index = transport_ptr->next) {
+			transport_ptr = transport_at(index);
 
-	for (network_ptr = network_list; network_ptr != NULL; network_ptr = network_ptr->next) {
-		for (transport_ptr = network_ptr->transports; transport_ptr != NULL; transport_ptr = transport_ptr->next) {
 			if (transport_ptr->transport_id == transport_id && transport_ptr->original_network_id == original_network_id) {
-				return transport_ptr;
+				return index;
 			}
 		}
 	}
 
-	return NULL;
+	return POOL_NONE;
 }
 
-void transport_add (Network *network_ptr, Transport *new_ptr) {
-	if (network_ptr->transports == NULL) {
-		new_ptr->next = NULL;
-	} else {
-		new_ptr->next = network_ptr->transports;
+Transport * transport_add (Network *network_ptr, unsigned short original_network_id, unsigned short transport_id) {
+	unsigned int index;
+	Transport *new_ptr;
+
+	if ((index = pool_alloc(&data_model->transports)) == POOL_NONE) {
+		return NULL;
 	}
 
-	network_ptr->transports = new_ptr;
+	new_ptr = transport_at(index);
+	new_ptr->original_network_id = original_network_id;
+	new_ptr->transport_id = transport_id;
+	new_ptr->next = network_ptr->transports;
+	network_ptr->transports = index;
+
+	return new_ptr;
 }
 
-Transport * transport_new (void) {
-	Transport *transport_ptr = (Transport *) malloc(sizeof(Transport));
-	memset(transport_ptr, '\0', sizeof(Transport));
-	return transport_ptr;
+/* Tuning details for reading, all zero if no delivery descriptor was seen. */
+TransportTuning * transport_tuning (Transport *transport_ptr) {
+	if (transport_ptr->tuning == POOL_NONE) {
+		return &empty_tuning;
+	}
+
+	return (TransportTuning *) pool_get(&data_model->transport_tunings, transport_ptr->tuning);
+}
+
+/* Tuning details for writing, allocated on first use. */
+TransportTuning * transport_tuning_set (Transport *transport_ptr) {
+	if (transport_ptr->tuning == POOL_NONE) {
+		if ((transport_ptr->tuning = pool_alloc(&data_model->transport_tunings)) == POOL_NONE) {
+			return &empty_tuning;
+		}
+	}
+
+	return (TransportTuning *) pool_get(&data_model->transport_tunings, transport_ptr->tuning);
 }
 
 /* Service */
 Service * service_get (Transport *transport_ptr, unsigned short service_id) {
+	return service_at(service_lookup(transport_ptr, service_id));
+}
+
+/* As above, but returns the pool index for storing in other nodes. */
+unsigned int service_lookup (Transport *transport_ptr, unsigned short service_id) {
         Service *service_ptr;
+        unsigned int index;
+
+        for (index = transport_ptr->services; index != POOL_NONE; index = service_ptr->next) {
+                service_ptr = service_at(index);
 
-        for (service_ptr = transport_ptr->services; service_ptr != NULL; service_ptr = service_ptr->next) {
                 if (service_ptr->service_id == service_id) {
-                        return service_ptr;
+                        return index;
                 }
         }
 
-        return NULL;
+        return POOL_NONE;
 }
 
-void service_add (Transport *transport_ptr, Service *new_ptr) {
-        if (transport_ptr->services == NULL) {
-                new_ptr->next = NULL;
-        } else {
-                new_ptr->next = transport_ptr->services;
-        }
+Service * service_add (Transport *transport_ptr, unsigned short service_id) {
+	unsigned int index;
+	Service *new_ptr;
+
+	if ((index = pool_alloc(&data_model->services)) == POOL_NONE) {
+		return NULL;
+	}
 
-        transport_ptr->services = new_ptr;
+	new_ptr = service_at(index);
+	new_ptr->service_id = service_id;
+	new_ptr->next = transport_ptr->services;
+	transport_ptr->services = index;
+
+	return new_ptr;
 }
 
-Service * service_new (void) {
-        Service *service_ptr = (Service *) malloc(sizeof(Service));
-        memset(service_ptr, '\0', sizeof(Service));
-        return service_ptr;
+/* Names for reading, all NULL if no name descriptors were seen. */
+ServiceNames * service_names (Service *service_ptr) {
+	if (service_ptr->names == POOL_NONE) {
+		return &empty_names;
+	}
+
+	return (ServiceNames *) pool_get(&data_model->service_names, service_ptr->names);
+}
+
+/* Names for writing, allocated on first use. */
+ServiceNames * service_names_set (Service *service_ptr) {
+	if (service_ptr->names == POOL_NONE) {
+		if ((service_ptr->names = pool_alloc(&data_model->service_names)) == POOL_NONE) {
+			return &empty_names;
+		}
+	}
+
+	return (ServiceNames *) pool_get(&data_model->service_names, service_ptr->names);
 }
 
 /* Bouquet */
 Bouquet * bouquet_get (unsigned short bouquet_id) {
+	return bouquet_at(bouquet_lookup(bouquet_id));
+}
+
+/* As above, but returns the pool index for storing in other nodes. */
+unsigned int bouquet_lookup (unsigned short bouquet_id) {
         Bouquet *bouquet_ptr;
+        unsigned int index;
+
+        for (index = data_model->bouquet_list; index != POOL_NONE; index = bouquet_ptr->next) {
+                bouquet_ptr = bouquet_at(index);
 
-        for (bouquet_ptr = bouquet_list; bouquet_ptr != NULL; bouquet_ptr = bouquet_ptr->next) {
                 if (bouquet_ptr->bouquet_id == bouquet_id) {
-                        return bouquet_ptr;
+                        return index;
                 }
         }
 
-        return NULL;
+        return POOL_NONE;
 }
 
-void bouquet_add (Bouquet *new_ptr) {
-        if (bouquet_list == NULL) {
-                new_ptr->next = NULL;
-        } else {
-                new_ptr->next = bouquet_list;
-        }
+Bouquet * bouquet_add (unsigned short bouquet_id) {
+	DataModel *model = data_model;
+	unsigned int index;
+	Bouquet *new_ptr;
+
+	if ((index = pool_alloc(&model->bouquets)) == POOL_NONE) {
+		return NULL;
+	}
+
+	new_ptr = bouquet_at(index);
+	new_ptr->bouquet_id = bouquet_id;
+	new_ptr->next = model->bouquet_list;
+	model->bouquet_list = index;
 
-        bouquet_list = new_ptr;
+	return new_ptr;
 }
 
+/* A bouquet which is not on the bouquet list, used for filtered results. */
 Bouquet * bouquet_new (void) {
-        Bouquet *bouquet_ptr = (Bouquet *) malloc(sizeof(Bouquet));
-        memset(bouquet_ptr, '\0', sizeof(Bouquet));
-        return bouquet_ptr;
+	unsigned int index;
+
+	if ((index = pool_alloc(&data_model->bouquets)) == POOL_NONE) {
+		return NULL;
+	}
+
+	return bouquet_at(index);
 }
 
 /* OpenTVChannel */
 OpenTVChannel * opentv_channel_get (Bouquet *bouquet_ptr, unsigned short channel_number) {
         OpenTVChannel *opentv_channel_ptr;
 
-        for (opentv_channel_ptr = bouquet_ptr->channels; opentv_channel_ptr != NULL; opentv_channel_ptr = opentv_channel_ptr->next) {
+        for (opentv_channel_ptr = opentv_channel_at(bouquet_ptr->channels); opentv_channel_ptr != NULL; opentv_channel_ptr = opentv_channel_at(opentv_channel_ptr->next)) {
                 if (opentv_channel_ptr->channel_number == channel_number) {
                         return opentv_channel_ptr;
                 }
@@ -160,86 +564,110 @@ OpenTVChannel * opentv_channel_get (Bouquet *bouquet_ptr, unsigned short channel
         return NULL;
 }
 
-void opentv_channel_add (Bouquet *bouquet_ptr, OpenTVChannel *new_ptr) {
-        if (bouquet_ptr->channels == NULL) {
-                new_ptr->next = NULL;
-        } else {
-                new_ptr->next = bouquet_ptr->channels;
-        }
+OpenTVChannel * opentv_channel_add (Bouquet *bouquet_ptr) {
+	unsigned int index;
+
+	if ((index = pool_alloc(&data_model->channels)) == POOL_NONE) {
+		return NULL;
+	}
+
+	opentv_channel_link(bouquet_ptr, index);
 
-        bouquet_ptr->channels = new_ptr;
+	return opentv_channel_at(index);
 }
 
-OpenTVChannel * opentv_channel_new (void) {
-        OpenTVChannel *opentv_channel_ptr = (OpenTVChannel *) malloc(sizeof(OpenTVChannel));
-        memset(opentv_channel_ptr, '\0', sizeof(OpenTVChannel));
-        return opentv_channel_ptr;
+/* Push an existing channel on to the front of a bouquet's channel list. */
+void opentv_channel_link (Bouquet *bouquet_ptr, unsigned int channel_index) {
+	opentv_channel_at(channel_index)->next = bouquet_ptr->channels;
+	bouquet_ptr->channels = channel_index;
+}
+
+/* Section Tracking */
+int section_tracking_received (SectionTracking *section_tracking, unsigned char section_number) {
+	return (section_tracking->received_section[section_number >> 5] >> (section_number & 0x1f)) & 1;
+}
+
+void section_tracking_set (SectionTracking *section_tracking, unsigned char section_number) {
+	section_tracking->received_section[section_number >> 5] |= 1u << (section_number & 0x1f);
 }
 
 int section_tracking_check (SectionTracking *section_tracking) {
-	int i = 0;
-	
-	for (i = 0; i <= section_tracking->last_section; i++) {
-		if (section_tracking->received_section[i] == 0)
+	int i = 0, last_word = section_tracking->last_section >> 5;
+	unsigned int last_mask;
+
+	/* Every word before the last must be full. */
+	for (i = 0; i < last_word; i++) {
+		if (section_tracking->received_section[i] != 0xffffffff)
 			return 0;
 	}
 
-	return 1;
+	/* And the last one up to and including last_section. */
+	last_mask = 0xffffffff >> (31 - (section_tracking->last_section & 0x1f));
+
+	return (section_tracking->received_section[last_word] & last_mask) == last_mask;
 }
 
-Bouquet * filter_data (int filter_bouquet_id, unsigned char filter_region_count, unsigned char *filter_region, int filter_dvbs, int filter_hd, int filter_user_number) {
+/* Pick the channels which pass the filters into a sorted index. */
+int filter_data (ChannelIndex *index, int filter_bouquet_id, RegionSet *filter_regions, int filter_dvbs, int filter_hd, int filter_user_number) {
 	/* Temporary variables. */
-	Bouquet *final_bouquet;
 	Bouquet *bouquet;
-	OpenTVChannel *channel, *next_channel;
-	int i = 0, done = 0;
-
-	/* Create our bouquet with everything we need. */
-	final_bouquet = bouquet_new();
+	OpenTVChannel *channel;
+	Transport *transport;
+	TransportTuning *tuning;
+	Service *service;
+	unsigned int channel_index, next_channel, *picked = NULL, *tmp, picked_count = 0, picked_size = 0;
 
 	/* Process BAT/SMT data to form channnel list. */
-	for (bouquet = bouquet_list; bouquet != NULL; bouquet = bouquet->next) {
+	for (bouquet = bouquet_at(data_model->bouquet_list); bouquet != NULL; bouquet = bouquet_at(bouquet->next)) {
 		if (filter_bouquet_id == 0 || filter_bouquet_id == bouquet->bouquet_id) {
-			for (channel = bouquet->channels; channel != NULL;) {
+			for (channel_index = bouquet->channels; channel_index != POOL_NONE;) {
+				channel = opentv_channel_at(channel_index);
 				next_channel = channel->next;
-				done = 0;
-
-				if (filter_region_count) {
-					for (i = 0; i < filter_region_count; i++) {
-						if (filter_region[i] == channel->region) {
-							done = 1;
-						}
+				if (region_set_passes(filter_regions, channel->region)) {
+					/* Channels merged from a feed are already bound to their transport, the ids may be on another satellite too. */
+					if (channel->transport == POOL_NONE) {
+						channel->transport = transport_lookup(channel->original_network_id, channel->transport_id);
 					}
-				} else {
-					done = 1;
-				}
 
-				if (done) {
-					channel->transport = transport_get_with_original_network_id(channel->original_network_id, channel->transport_id);
+					transport = transport_at(channel->transport);
 
-					if (!channel->transport) {
+					if (!transport) {
 						slowlane_log(1, "Could not find transport %i on network %i for bouquet %i and service %i.", channel->transport_id, channel->original_network_id, bouquet->bouquet_id, channel->service_id);
 					} else {
-						if (channel->transport->modulation_system >= filter_dvbs) {
-							slowlane_log(3, "Transport %i is a modulation system of %i, however program running in DVB-S%i mode.", channel->transport->transport_id, channel->transport->modulation_system, filter_dvbs);
+						tuning = transport_tuning(transport);
+
+						if (tuning->modulation_system >= filter_dvbs) {
+							slowlane_log(3, "Transport %i is a modulation system of %i, however program running in DVB-S%i mode.", transport->transport_id, tuning->modulation_system, filter_dvbs);
 						} else {
-							if (channel->transport->frequency < 1000000 || channel->transport->frequency > 1400000) {
-								slowlane_log(2, "Transport %i has frequency (%i) outside of the Ku band, ignoring as DVB-S cards can't tune it.", channel->transport->transport_id, channel->transport->frequency);
+							if (tuning->frequency < 1000000 || tuning->frequency > 1400000) {
+								slowlane_log(2, "Transport %i has frequency (%i) outside of the Ku band, ignoring as DVB-S cards can't tune it.", transport->transport_id, tuning->frequency);
 							} else {
-								channel->service = service_get(channel->transport, channel->service_id);
+								channel->service = service_lookup(transport, channel->service_id);
+								service = service_at(channel->service);
 
-								if (!channel->service) {
+								if (!service) {
 									slowlane_log(1, "Could not find service %i on network %i for bouquet %i and transport %i.", channel->service_id, channel->original_network_id, bouquet->bouquet_id, channel->transport_id);
 								} else {
-									if (channel->service->type == 1 || channel->service->type == 2 || channel->service->type == 4 || channel->service->type == 5 || channel->service->type == 25) {
-										if (channel->service->type == 25 && !filter_hd) {
-											slowlane_log(3, "Ignoring service %i:%i as is HD, running not in HD mode.", channel->service->service_id, channel->transport->transport_id);
+									if (service->type == 1 || service->type == 2 || service->type == 4 || service->type == 5 || service->type == 25) {
+										if (service->type == 25 && !filter_hd) {
+											slowlane_log(3, "Ignoring service %i:%i as is HD, running not in HD mode.", service->service_id, transport->transport_id);
 										} else {
 											if (channel->user_number > filter_user_number) {
-												slowlane_log(3, "Ignoring service %i:%i as user number %i is above %i.", channel->service->service_id, channel->transport->transport_id, channel->user_number, filter_user_number);
+												slowlane_log(3, "Ignoring service %i:%i as user number %i is above %i.", service->service_id, transport->transport_id, channel->user_number, filter_user_number);
 											} else {
-												channel->next = NULL;
-												opentv_channel_add(final_bouquet, channel);
+												if (picked_count == picked_size) {
+													picked_size = picked_size ? picked_size * 2 : 256;
+
+													if ((tmp = (unsigned int *) realloc(picked, picked_size * sizeof(unsigned int))) == NULL) {
+														slowlane_log(0, "Unable to grow channel list to %u channels.", picked_size);
+														free(picked);
+														return -1;
+													}
+
+													picked = tmp;
+												}
+
+												picked[picked_count++] = channel_index;
 											}
 										}
 									}
@@ -249,10 +677,129 @@ Bouquet * filter_data (int filter_bouquet_id, unsigned char filter_region_count,
 					}
 				}
 
-				channel = next_channel;
+				channel_index = next_channel;
 			}
 		}
 	}
 
-	return final_bouquet;
+	if (channel_index_build(index, picked, picked_count) < 0) {
+		free(picked);
+		return -1;
+	}
+
+	slowlane_log(2, "Filtered %u channels, %u region variants dropped.", index->count, index->duplicates);
+
+	return 0;
+}
+
+/* Node layouts as they were before the pools, kept only so the memory report
+ * can show what the same model would have cost. */
+typedef struct tLegacySectionTracking {
+	unsigned char	version;
+	unsigned char	last_section;
+	unsigned char	received_section[0xff];
+	unsigned char	populated;
+} LegacySectionTracking;
+
+typedef struct tLegacyOpenTVChannel {
+	void		*next, *bouquet, *service, *transport;
+	unsigned short	transport_id, original_network_id, service_id;
+	unsigned char	region, type;
+	unsigned short	channel_number, user_number, flags;
+} LegacyOpenTVChannel;
+
+typedef struct tLegacyBouquet {
+	void		*next;
+	LegacySectionTracking sections;
+	void		*channels;
+	unsigned short	bouquet_id;
+	char		*name;
+} LegacyBouquet;
+
+typedef struct tLegacyService {
+	void		*next;
+	unsigned short	service_id;
+	unsigned char	running, free_ca, type;
+	char		*name, *alt_name, *provider;
+} LegacyService;
+
+typedef struct tLegacyTransport {
+	void		*next;
+	LegacySectionTracking sections;
+	void		*services;
+	unsigned short	original_network_id, transport_id;
+	unsigned char	modulation_system;
+	unsigned int	frequency, symbol_rate;
+	unsigned char	polarization, modulation_type, fec, roll_off;
+	unsigned short	orbital_position;
+	unsigned char	west_east_flag;
+} LegacyTransport;
+
+typedef struct tLegacyNetwork {
+	void		*next;
+	LegacySectionTracking sections;
+	void		*transports;
+	unsigned short	network_id;
+	char		*name;
+} LegacyNetwork;
+
+static void data_memory_report_line (const char *type, Pool *pool, size_t legacy_size, size_t *total, size_t *legacy_total) {
+	unsigned int count = pool->count - 1;
+
+	printf("%-16s %8u %6u %6u %10lu %10lu\n", type, count, pool->object_size, (unsigned int) legacy_size, (unsigned long) pool_bytes(pool), (unsigned long) (count * legacy_size));
+
+	*total += pool_bytes(pool);
+	*legacy_total += count * legacy_size;
+}
+
+static size_t data_memory_string (TextView view) {
+	return view.data ? text_view_length(view) + 1 : 0;
+}
+
+/* Print bytes per object and totals for the current and previous layouts. */
+void data_memory_report (void) {
+	size_t total = 0, legacy_total = 0, strings = 0, interned, sections;
+	unsigned long lookups;
+	unsigned int i, interned_count;
+	Network *network;
+	Bouquet *bouquet;
+	ServiceNames *names;
+
+	printf("# Memory Report\n");
+	printf("%-16s %8s %6s %6s %10s %10s\n", "# Type", "Count", "Bytes", "Legacy", "Total", "LegacyTot");
+
+	/* The legacy layout had no cold records, their cost is in the parent. */
+	data_memory_report_line("Network", &data_model->networks, sizeof(LegacyNetwork), &total, &legacy_total);
+	data_memory_report_line("Transport", &data_model->transports, sizeof(LegacyTransport), &total, &legacy_total);
+	data_memory_report_line("TransportTuning", &data_model->transport_tunings, 0, &total, &legacy_total);
+	data_memory_report_line("Service", &data_model->services, sizeof(LegacyService), &total, &legacy_total);
+	data_memory_report_line("ServiceNames", &data_model->service_names, 0, &total, &legacy_total);
+	data_memory_report_line("Bouquet", &data_model->bouquets, sizeof(LegacyBouquet), &total, &legacy_total);
+	data_memory_report_line("OpenTVChannel", &data_model->channels, sizeof(LegacyOpenTVChannel), &total, &legacy_total);
+
+	/* Strings were a copy each, they're now views into the intern set or the retained sections. */
+	for (network = network_at(data_model->network_list); network != NULL; network = network_at(network->next)) {
+		strings += data_memory_string(network->name);
+	}
+
+	for (bouquet = bouquet_at(data_model->bouquet_list); bouquet != NULL; bouquet = bouquet_at(bouquet->next)) {
+		strings += data_memory_string(bouquet->name);
+	}
+
+	for (i = 1; i < data_model->service_names.count; i++) {
+		names = (ServiceNames *) pool_get(&data_model->service_names, i);
+		strings += data_memory_string(names->name) + data_memory_string(names->alt_name) + data_memory_string(names->provider);
+	}
+
+	text_intern_stats(&interned_count, &interned, &lookups);
+
+	sections = data_model->sections ? data_model->sections->block_count * STORE_BLOCK_SIZE + pool_bytes(&data_model->sections->sections) : 0;
+
+	printf("%-16s %8u %6s %6s %10lu %10lu\n", "Strings", interned_count, "-", "-", (unsigned long) interned, (unsigned long) strings);
+
+	if (data_model->sections) {
+		printf("%-16s %8u %6s %6s %10lu %10s\n", "Sections", data_model->sections->sections.count - 1, "-", "-", (unsigned long) sections, "-");
+	}
+
+	printf("%-16s %8s %6s %6s %10lu %10lu\n", "Total", "-", "-", "-", (unsigned long) (total + interned + sections), (unsigned long) (legacy_total + strings));
 }
@@ -15,6 +15,7 @@
 #include <sys/ioctl.h>
 #include <linux/dvb/dmx.h>
 #include <linux/dvb/frontend.h>
+#include "filter.h"
 #include "dvb.h"
 #include "slowlane.h"
 
@@ -46,6 +47,40 @@ int dvb_open(int dvb_adapter, int dvb_demux) {
 	return dvb_demux_fd;
 }
 
+/* Open the DVR device, for reading the transport stream itself. */
+int dvb_open_dvr(int dvb_adapter, int dvb_dvr) {
+	int dvb_dvr_fd = 0, count;
+	char dvb_device[32];
+
+	count = snprintf(dvb_device, sizeof(dvb_device), "/dev/dvb/adapter%i/dvr%i", dvb_adapter, dvb_dvr);
+
+	if (count < 22 || count > 31) {
+		slowlane_log(1, "Unable to create device name for dvr, character count was %i.", count);
+		return -1;
+	}
+
+	if ((dvb_dvr_fd = open(dvb_device, O_RDONLY)) < 0) {
+		slowlane_log(0, "unable to open DVB dvr (%s)", dvb_device);
+		return -1;
+	}
+
+	slowlane_log(2, "DVR device %s opened on fd %i.", dvb_device, dvb_dvr_fd);
+	return dvb_dvr_fd;
+}
+
+/* Open a capture file written with -w, which reads the same as the demux. */
+int dvb_open_capture(const char *filename) {
+	int dvb_demux_fd;
+
+	if ((dvb_demux_fd = open(filename, O_RDONLY)) < 0) {
+		slowlane_log(0, "unable to open capture (%s)", filename);
+		return -1;
+	}
+
+	slowlane_log(2, "Capture %s opened on fd %i.", filename, dvb_demux_fd);
+	return dvb_demux_fd;
+}
+
 /* Close DVB interface. */
 void dvb_close(int dvb_demux_fd) {
 	if (dvb_demux_fd > 0) {
@@ -64,12 +99,38 @@ int dvb_read(int dvb_demux_fd, char *buffer, int buffer_length) {
 	return read(dvb_demux_fd, buffer, buffer_length);
 }
 
-/* Set up filter for DVB interface. */
+/* Set the size of the kernel's demux buffer, must be done before any filter is set. */
+int dvb_set_buffer_size(int dvb_demux_fd, unsigned long size) {
+	int retval;
+
+	if ((retval = ioctl(dvb_demux_fd, DMX_SET_BUFFER_SIZE, size)) < 0) {
+		slowlane_log(0, "Unable to set demux buffer size to %lu, value is %i.", size, retval);
+		return -1;
+	}
+
+	slowlane_log(1, "Demux buffer on fd %i set to %lu bytes.", dvb_demux_fd, size);
+	return 0;
+}
+
+/* Set up filter for DVB interface on PID and table alone. */
 int dvb_set_filter(int dvb_demux_fd, unsigned short pid, unsigned char table, unsigned char mask, int crc_dvb) {
+	SectionFilter filter;
+
+	filter_init(&filter, pid, table, mask, crc_dvb);
+
+	if (dvb_set_section_filter(dvb_demux_fd, &filter) < 0) {
+		close(dvb_demux_fd);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Set up a full depth section filter, the kernel then only passes matching sections up to us. */
+int dvb_set_section_filter(int dvb_demux_fd, SectionFilter *filter) {
 	struct dmx_sct_filter_params sctFilterParams;
 	int retval;
 
-	/* Set up filter on demux stream to only obtain data relivent to Sky channel list. */
 	memset(&sctFilterParams, 0, sizeof(sctFilterParams));
 
 	/* Don't ever stop filtering, and don't wait for a DMX_START ioctl. */
@@ -77,24 +138,56 @@ int dvb_set_filter(int dvb_demux_fd, unsigned short pid, unsigned char table, un
 	sctFilterParams.flags = DMX_IMMEDIATE_START;
 
 	/* Only enable DVB CRC checks if required, supported in case DVB card can't or stack wont. */
-	if (crc_dvb) {
+	if (filter->flags & FILTER_CHECK_CRC) {
 		sctFilterParams.flags |= DMX_CHECK_CRC;
 	} else {
-		slowlane_log(1, "Not enabling DVB stack/hardware CRC check as crc_dvb is %i!", crc_dvb);
+		slowlane_log(1, "Not enabling DVB stack/hardware CRC check on fd %i!", dvb_demux_fd);
 	}
 
-	/* Configure PID and table filter. */
-	sctFilterParams.pid = pid;
-	sctFilterParams.filter.filter[0] = table;
-	sctFilterParams.filter.mask[0] = mask;
+	/* Configure PID and all of the filter, which is laid out as the kernel's. */
+	sctFilterParams.pid = filter->pid;
+	memcpy(sctFilterParams.filter.filter, filter->filter, DMX_FILTER_SIZE);
+	memcpy(sctFilterParams.filter.mask, filter->mask, DMX_FILTER_SIZE);
+	memcpy(sctFilterParams.filter.mode, filter->mode, DMX_FILTER_SIZE);
 
 	/* Actually set filter on demux. */
 	if ((retval = ioctl(dvb_demux_fd, DMX_SET_FILTER, &sctFilterParams)) < 0) {
-		close(dvb_demux_fd);
 		slowlane_log(0, "Unable to install demux filter, value is %i.", retval);
 		return -1;
 	}
 
-	slowlane_log(1, "Installed filter on fd %i for PID 0x%x for table 0x%x/0x%x, CRC = %i.", dvb_demux_fd, pid, table, mask, crc_dvb);
+	slowlane_log(1, "Installed filter on fd %i for PID 0x%x for table 0x%x/0x%x extension 0x%02x%02x/0x%02x%02x, CRC = %i.", dvb_demux_fd, filter->pid, filter->filter[0], filter->mask[0], filter->filter[1], filter->filter[2], filter->mask[1], filter->mask[2], filter->flags & FILTER_CHECK_CRC);
+	return 0;
+}
+
+/* Stop the filter on fd, the fd stays open for a new one. */
+int dvb_stop_filter(int dvb_demux_fd) {
+	if (ioctl(dvb_demux_fd, DMX_STOP) < 0) {
+		slowlane_log(0, "Unable to stop demux filter on fd %i.", dvb_demux_fd);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Pass a whole PID through to the DVR device rather than filtering sections. */
+int dvb_set_pes_filter(int dvb_demux_fd, unsigned short pid) {
+	struct dmx_pes_filter_params pesFilterParams;
+	int retval;
+
+	memset(&pesFilterParams, 0, sizeof(pesFilterParams));
+	pesFilterParams.pid = pid;
+	pesFilterParams.input = DMX_IN_FRONTEND;
+	pesFilterParams.output = DMX_OUT_TS_TAP;
+	pesFilterParams.pes_type = DMX_PES_OTHER;
+	pesFilterParams.flags = DMX_IMMEDIATE_START;
+
+	if ((retval = ioctl(dvb_demux_fd, DMX_SET_PES_FILTER, &pesFilterParams)) < 0) {
+		close(dvb_demux_fd);
+		slowlane_log(0, "Unable to install PES filter, value is %i.", retval);
+		return -1;
+	}
+
+	slowlane_log(1, "Installed PES filter on fd %i for PID 0x%x to DVR.", dvb_demux_fd, pid);
 	return 0;
 }
@@ -0,0 +1,458 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * event.c - EIT event store. Events are kept per service in an array ordered
+ * by start time, so the schedule for a time range is a binary search and a
+ * walk. Repeated sections are dropped on their section tracking before any
+ * event is looked at, and an event seen again at the same start replaces the
+ * one there rather than being added twice.
+ *
+ * OpenTV titles and summaries are kept by channel until the acquisition is
+ * done, then moved to the service the bouquets give for the channel.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slowlane.h"
+#include "pool.h"
+#include "data.h"
+#include "event.h"
+
+#define EVENT_INITIAL_BUCKETS 256
+#define EVENT_INITIAL_EVENTS 32
+
+/* The store for a model, created on first use if create is set. */
+EventStore * event_store (DataModel *model, int create) {
+	EventStore *store;
+
+	if (model->events || !create) {
+		return model->events;
+	}
+
+	if ((store = (EventStore *) calloc(1, sizeof(EventStore))) == NULL || (store->buckets = (unsigned int *) calloc(EVENT_INITIAL_BUCKETS, sizeof(unsigned int))) == NULL) {
+		slowlane_log(0, "Unable to allocate event store of %i buckets.", EVENT_INITIAL_BUCKETS);
+		free(store);
+		return NULL;
+	}
+
+	pool_init(&store->services, sizeof(EventService), 6);
+	store->bucket_count = EVENT_INITIAL_BUCKETS;
+	model->events = store;
+
+	return store;
+}
+
+/* Release a store. As with the model strings are left alone, they may have
+ * been merged into another store. */
+void event_store_free (EventStore *store) {
+	unsigned int i;
+
+	if (store == NULL) {
+		return;
+	}
+
+	for (i = 1; i < store->services.count; i++) {
+		free(event_service_at(store, i)->events);
+		free(event_service_at(store, i)->texts);
+	}
+
+	pool_free_all(&store->services);
+	free(store->buckets);
+	free(store);
+}
+
+static unsigned int event_hash (unsigned short original_network_id, unsigned short transport_id, unsigned short service_id) {
+	unsigned long long key = ((unsigned long long) original_network_id << 32) | ((unsigned long long) transport_id << 16) | service_id;
+
+	key ^= key >> 29;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 32;
+	return (unsigned int) key;
+}
+
+/* Double the buckets, keeps chains to around one service. */
+static int event_store_grow (EventStore *store) {
+	unsigned int *buckets, bucket_count = store->bucket_count * 2, i, bucket;
+	EventService *service;
+
+	if ((buckets = (unsigned int *) calloc(bucket_count, sizeof(unsigned int))) == NULL) {
+		slowlane_log(0, "Unable to grow event store to %u buckets.", bucket_count);
+		return -1;
+	}
+
+	for (i = 1; i < store->services.count; i++) {
+		service = event_service_at(store, i);
+		bucket = event_hash(service->original_network_id, service->transport_id, service->service_id) & (bucket_count - 1);
+		service->next = buckets[bucket];
+		buckets[bucket] = i;
+	}
+
+	free(store->buckets);
+	store->buckets = buckets;
+	store->bucket_count = bucket_count;
+
+	return 0;
+}
+
+/* Find a service's events, adding an empty entry if create is set. */
+EventService * event_service_get (EventStore *store, unsigned short original_network_id, unsigned short transport_id, unsigned short service_id, int create) {
+	unsigned int bucket = event_hash(original_network_id, transport_id, service_id) & (store->bucket_count - 1), index;
+	EventService *service;
+
+	for (index = store->buckets[bucket]; index != POOL_NONE; index = service->next) {
+		service = event_service_at(store, index);
+
+		if (service->service_id == service_id && service->transport_id == transport_id && service->original_network_id == original_network_id) {
+			return service;
+		}
+	}
+
+	if (!create) {
+		return NULL;
+	}
+
+	if (store->services.count > store->bucket_count) {
+		if (event_store_grow(store) < 0) {
+			return NULL;
+		}
+
+		bucket = event_hash(original_network_id, transport_id, service_id) & (store->bucket_count - 1);
+	}
+
+	if ((index = pool_alloc(&store->services)) == POOL_NONE) {
+		return NULL;
+	}
+
+	service = event_service_at(store, index);
+	memset(service, '\0', sizeof(EventService));
+	service->original_network_id = original_network_id;
+	service->transport_id = transport_id;
+	service->service_id = service_id;
+	service->next = store->buckets[bucket];
+	store->buckets[bucket] = index;
+
+	return service;
+}
+
+/* Section tracking for an EIT table, NULL if it isn't one. */
+SectionTracking * event_tracking (EventService *service, unsigned char table_id) {
+	if (table_id == 0x4e || table_id == 0x4f) {
+		return &service->present_following;
+	} else if ((table_id >= 0x50 && table_id <= EVENT_TABLE_LAST) || event_table_opentv(table_id)) {
+		return &service->schedule[table_id & 0x0f];
+	}
+
+	return NULL;
+}
+
+/* Schedules are sent in segments of eight sections, where a segment ends
+ * early the sections after its last are never sent. Mark them received so
+ * the usual check on last_section works across the gaps. */
+void event_tracking_segment (SectionTracking *sections, unsigned char section_number, unsigned char segment_last_section) {
+	unsigned int first = section_number & ~(EVENT_SEGMENT_SECTIONS - 1), i;
+
+	if (segment_last_section < section_number || segment_last_section >= first + EVENT_SEGMENT_SECTIONS) {
+		return;
+	}
+
+	for (i = segment_last_section + 1; i < first + EVENT_SEGMENT_SECTIONS; i++) {
+		section_tracking_set(sections, i);
+	}
+}
+
+/* Have we every section of p/f and of each schedule table signalled or seen? */
+int event_service_complete (EventService *service) {
+	int i;
+
+	if (service->present_following.populated && !section_tracking_check(&service->present_following)) {
+		return 0;
+	}
+
+	for (i = 0; i < EVENT_SCHEDULE_TABLES; i++) {
+		if (service->schedule[i].populated ? !section_tracking_check(&service->schedule[i]) : (service->last_table_id && i <= (service->last_table_id & 0x0f))) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int event_store_complete (EventStore *store) {
+	unsigned int i;
+
+	for (i = 1; store && i < store->services.count; i++) {
+		if (!event_service_complete(event_service_at(store, i))) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* First event starting at or after start. */
+static unsigned int event_search (EventService *service, unsigned int start) {
+	unsigned int low = 0, high = service->event_count, middle;
+
+	while (low < high) {
+		middle = low + (high - low) / 2;
+
+		if (service->events[middle].start < start) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+/* Open a gap at position, returns NULL if the array can't grow. */
+static Event * event_insert (EventService *service, unsigned int position) {
+	Event *events;
+	unsigned int size;
+
+	if (service->event_count == service->event_size) {
+		size = service->event_size ? service->event_size * 2 : EVENT_INITIAL_EVENTS;
+
+		if ((events = (Event *) realloc(service->events, size * sizeof(Event))) == NULL) {
+			slowlane_log(0, "Unable to grow events of service %i to %u.", service->service_id, size);
+			return NULL;
+		}
+
+		service->events = events;
+		service->event_size = size;
+	}
+
+	/* Schedules mostly arrive in order, so this is usually an append. */
+	if (position < service->event_count) {
+		memmove(&service->events[position + 1], &service->events[position], (service->event_count - position) * sizeof(Event));
+	}
+
+	service->event_count++;
+	memset(&service->events[position], '\0', sizeof(Event));
+
+	return &service->events[position];
+}
+
+/* Add an event, or replace the one already starting at the same time. The
+ * event is returned for the descriptors to be filled in. */
+Event * event_add (EventStore *store, EventService *service, unsigned int start, unsigned int duration, unsigned short event_id) {
+	unsigned int position = event_search(service, start);
+	Event *event;
+
+	if (position < service->event_count && service->events[position].start == start) {
+		event = &service->events[position];
+		free(event->title);
+		free(event->text);
+		event->title = event->text = NULL;
+	} else if ((event = event_insert(service, position)) == NULL) {
+		return NULL;
+	} else {
+		store->events++;
+		event->start = start;
+	}
+
+	event->duration = duration;
+	event->event_id = event_id;
+
+	return event;
+}
+
+/* Index of the first event still running at or after time, so events in a
+ * range are those from here until one starts after the range ends. */
+unsigned int event_find (EventService *service, unsigned int time) {
+	unsigned int position = event_search(service, time);
+
+	/* Broadcasters do overlap events now and again, so don't stop at one. */
+	while (position > 0 && service->events[position - 1].start + service->events[position - 1].duration > time) {
+		position--;
+	}
+
+	return position;
+}
+
+/* Keep text for an event which may not have been seen yet. */
+int event_text_add (EventService *service, unsigned short event_id, char *text) {
+	EventText *texts;
+	unsigned int size;
+
+	if (service->text_count == service->text_size) {
+		size = service->text_size ? service->text_size * 2 : EVENT_INITIAL_EVENTS;
+
+		if ((texts = (EventText *) realloc(service->texts, size * sizeof(EventText))) == NULL) {
+			slowlane_log(0, "Unable to grow event texts of service %i to %u.", service->service_id, size);
+			return -1;
+		}
+
+		service->texts = texts;
+		service->text_size = size;
+	}
+
+	service->texts[service->text_count].event_id = event_id;
+	service->texts[service->text_count].text = text;
+	service->text_count++;
+
+	return 0;
+}
+
+/* Move a service's events and texts to another, the first copy of a table or
+ * event wins. */
+static int event_service_merge (EventStore *to, EventService *dst, EventService *src) {
+	Event *event;
+	unsigned int j, position;
+
+	if (!dst->present_following.populated) {
+		dst->present_following = src->present_following;
+	}
+
+	for (j = 0; j < EVENT_SCHEDULE_TABLES; j++) {
+		if (!dst->schedule[j].populated) {
+			dst->schedule[j] = src->schedule[j];
+		}
+	}
+
+	if (src->last_table_id > dst->last_table_id) {
+		dst->last_table_id = src->last_table_id;
+	}
+
+	for (j = 0; j < src->text_count; j++) {
+		if (event_text_add(dst, src->texts[j].event_id, src->texts[j].text) < 0) {
+			return -1;
+		}
+	}
+
+	src->text_count = 0;
+
+	/* Usually the service is only in one, then the events are just moved. */
+	if (dst->event_count == 0) {
+		free(dst->events);
+		dst->events = src->events;
+		dst->event_count = src->event_count;
+		dst->event_size = src->event_size;
+		src->events = NULL;
+		src->event_count = src->event_size = 0;
+		to->events += dst->event_count;
+		return 0;
+	}
+
+	for (j = 0; j < src->event_count; j++) {
+		position = event_search(dst, src->events[j].start);
+
+		/* The copy already there wins, drop this one's text with it. */
+		if (position < dst->event_count && dst->events[position].start == src->events[j].start) {
+			free(src->events[j].title);
+			free(src->events[j].text);
+			continue;
+		}
+
+		if ((event = event_insert(dst, position)) == NULL) {
+			return -1;
+		}
+
+		*event = src->events[j];
+		to->events++;
+	}
+
+	src->event_count = 0;
+
+	return 0;
+}
+
+/* Merge another store into to, as with data_model_merge. */
+void event_store_merge (EventStore *to, EventStore *from) {
+	EventService *src, *dst;
+	unsigned int i;
+
+	for (i = 1; i < from->services.count; i++) {
+		src = event_service_at(from, i);
+
+		if ((dst = event_service_get(to, src->original_network_id, src->transport_id, src->service_id, 1)) == NULL || event_service_merge(to, dst, src) < 0) {
+			return;
+		}
+	}
+
+	to->sections += from->sections;
+	to->repeats += from->repeats;
+}
+
+static int event_text_compare (const void *a, const void *b) {
+	return (int) ((const EventText *) a)->event_id - (int) ((const EventText *) b)->event_id;
+}
+
+/* Give each OpenTV event its summary, then move the channel's events to the
+ * service the bouquets carry it as. Channels no bouquet has are left as they
+ * are. Uses the calling thread's model for the bouquets. */
+void event_store_link_opentv (EventStore *store) {
+	OpenTVChannel **channels, *channel;
+	Bouquet *bouquet;
+	EventService *service, *target;
+	EventText key, *text;
+	unsigned int i, j, count, linked = 0;
+
+	if ((channels = (OpenTVChannel **) calloc(0x10000, sizeof(OpenTVChannel *))) == NULL) {
+		slowlane_log(0, "Unable to allocate channel map of %i entries.", 0x10000);
+		return;
+	}
+
+	for (bouquet = bouquet_at(data_model->bouquet_list); bouquet != NULL; bouquet = bouquet_at(bouquet->next)) {
+		for (channel = opentv_channel_at(bouquet->channels); channel != NULL; channel = opentv_channel_at(channel->next)) {
+			if (channels[channel->channel_number] == NULL) {
+				channels[channel->channel_number] = channel;
+			}
+		}
+	}
+
+	/* Linking adds services, so only go as far as there were to start with. */
+	for (i = 1, count = store->services.count; i < count; i++) {
+		service = event_service_at(store, i);
+
+		if (service->transport_id != EVENT_OPENTV_TRANSPORT || service->original_network_id != 0) {
+			continue;
+		}
+
+		if (service->text_count) {
+			qsort(service->texts, service->text_count, sizeof(EventText), event_text_compare);
+
+			for (j = 0; j < service->event_count; j++) {
+				key.event_id = service->events[j].event_id;
+
+				if (service->events[j].text == NULL && (text = (EventText *) bsearch(&key, service->texts, service->text_count, sizeof(EventText), event_text_compare)) != NULL) {
+					service->events[j].text = text->text;
+					text->text = NULL;
+				}
+			}
+
+			/* Summaries no title was seen for. */
+			for (j = 0; j < service->text_count; j++) {
+				free(service->texts[j].text);
+			}
+
+			service->text_count = 0;
+		}
+
+		if ((channel = channels[service->service_id]) == NULL) {
+			continue;
+		}
+
+		if ((target = event_service_get(store, channel->original_network_id, channel->transport_id, channel->service_id, 1)) == NULL) {
+			break;
+		}
+
+		/* The events are already counted in this store, the merge counts those it keeps. */
+		store->events -= service->event_count;
+
+		if (event_service_merge(store, target, service) < 0) {
+			break;
+		}
+
+		linked++;
+	}
+
+	free(channels);
+
+	slowlane_log(1, "Linked %u OpenTV channels to their services.", linked);
+}
@@ -0,0 +1,506 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * export.c - Structured output as CSV, NDJSON or binary records. Records are
+ * formatted straight into large chunks, integers and escaping by hand rather
+ * than through printf, and nothing is allocated per record. The chunks are
+ * written with writev when the output is flushed, normally once at the end.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "slowlane.h"
+#include "text.h"
+#include "data.h"
+#include "xmltv.h"
+#include "names.h"
+#include "export.h"
+
+/* Room a single field may need, a converted name escaped six bytes a character. */
+#define EXPORT_FIELD_MAX (TEXT_MAX * 6 + 64)
+
+/* What each byte needs in a JSON string, 0 nothing, 1 a backslash, 2 \u00xx. */
+static const unsigned char export_json_escape[256] = {
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+	0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0
+};
+
+static const char export_hex[] = "0123456789abcdef";
+
+/* Format names for -O, -1 if unknown. */
+int export_format (const char *name) {
+	if (strcmp(name, "csv") == 0) {
+		return EXPORT_CSV;
+	} else if (strcmp(name, "ndjson") == 0) {
+		return EXPORT_NDJSON;
+	} else if (strcmp(name, "binary") == 0) {
+		return EXPORT_BINARY;
+	}
+
+	return -1;
+}
+
+void export_init (Exporter *exporter, int format, int fd) {
+	memset(exporter, '\0', sizeof(Exporter));
+	exporter->format = format;
+	exporter->fd = fd;
+}
+
+void export_free (Exporter *exporter) {
+	unsigned int i;
+
+	for (i = 0; i < exporter->chunk_count; i++) {
+		free(exporter->chunks[i]);
+	}
+
+	free(exporter->chunks);
+	export_init(exporter, exporter->format, exporter->fd);
+}
+
+/* Somewhere to write length bytes, contiguous, NULL if memory ran out. */
+static char * export_reserve (Exporter *exporter, size_t length) {
+	char **chunks;
+
+	if (exporter->failed) {
+		return NULL;
+	}
+
+	if (exporter->chunk_count == 0 || exporter->used + length > EXPORT_CHUNK_SIZE) {
+		if ((chunks = (char **) realloc(exporter->chunks, (exporter->chunk_count + 1) * sizeof(char *))) == NULL || (chunks[exporter->chunk_count] = (char *) malloc(EXPORT_CHUNK_SIZE)) == NULL) {
+			slowlane_log(0, "Unable to grow export buffer to %u chunks.", exporter->chunk_count + 1);
+			exporter->chunks = chunks ? chunks : exporter->chunks;
+			exporter->failed = 1;
+			return NULL;
+		}
+
+		exporter->chunks = chunks;
+		exporter->chunk_count++;
+		exporter->used = 0;
+	}
+
+	return exporter->chunks[exporter->chunk_count - 1] + exporter->used;
+}
+
+static void export_commit (Exporter *exporter, size_t length) {
+	exporter->used += length;
+	exporter->total += length;
+}
+
+/* Write everything built so far, after anything already given to stdio. */
+int export_flush (Exporter *exporter) {
+	struct iovec iov[64];
+	unsigned int i = 0, count, j;
+	ssize_t written;
+	size_t skip = 0;
+
+	fflush(stdout);
+
+	while (i < exporter->chunk_count) {
+		for (count = 0; count < 64 && i + count < exporter->chunk_count; count++) {
+			iov[count].iov_base = exporter->chunks[i + count];
+			iov[count].iov_len = i + count == exporter->chunk_count - 1 ? exporter->used : EXPORT_CHUNK_SIZE;
+		}
+
+		/* Pick up where a short write left off. */
+		iov[0].iov_base = (char *) iov[0].iov_base + skip;
+		iov[0].iov_len -= skip;
+
+		if ((written = writev(exporter->fd, iov, count)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			slowlane_log(0, "Unable to write output, %s.", strerror(errno));
+			export_free(exporter);
+			return -1;
+		}
+
+		for (j = 0; j < count && (size_t) written >= iov[j].iov_len; j++) {
+			written -= iov[j].iov_len;
+		}
+
+		i += j;
+		skip = j == 0 ? skip + written : (size_t) written;
+	}
+
+	if (exporter->failed) {
+		slowlane_log(0, "Output incomplete, memory ran out after %lu bytes.", (unsigned long) exporter->total);
+	}
+
+	j = exporter->failed;
+	export_free(exporter);
+
+	return j ? -1 : 0;
+}
+
+/* Text as is, for headings. Not a record. */
+void export_raw (Exporter *exporter, const char *text) {
+	size_t length = strlen(text);
+	char *out;
+
+	if ((out = export_reserve(exporter, length)) != NULL) {
+		memcpy(out, text, length);
+		export_commit(exporter, length);
+	}
+}
+
+static const char * export_record_name (unsigned char record) {
+	switch (record) {
+		case EXPORT_RECORD_NETWORK:
+			return "network";
+		case EXPORT_RECORD_TRANSPORT:
+			return "transport";
+		case EXPORT_RECORD_SERVICE:
+			return "service";
+		case EXPORT_RECORD_BOUQUET:
+			return "bouquet";
+		default:
+			return "channel";
+	}
+}
+
+void export_begin (Exporter *exporter, unsigned char record) {
+	const char *name;
+	size_t length;
+	char *out;
+
+	exporter->fields = 0;
+
+	if ((out = export_reserve(exporter, 32)) == NULL) {
+		return;
+	}
+
+	switch (exporter->format) {
+		case EXPORT_NDJSON:
+			name = export_record_name(record);
+			length = strlen(name);
+			memcpy(out, "{\"type\":\"", 9);
+			memcpy(out + 9, name, length);
+			out[9 + length] = '"';
+			export_commit(exporter, length + 10);
+			break;
+
+		case EXPORT_BINARY:
+			out[0] = record;
+			exporter->record_length = (unsigned char *) out + 1;
+			export_commit(exporter, 3);
+			exporter->record_total = exporter->total;
+			break;
+	}
+}
+
+/* Separator and name before a field's value. */
+static size_t export_field (Exporter *exporter, char *out, const char *field) {
+	size_t length = 0, name_length;
+
+	switch (exporter->format) {
+		case EXPORT_CSV:
+			if (exporter->fields++) {
+				out[length++] = ',';
+			}
+			break;
+
+		case EXPORT_NDJSON:
+			out[length++] = ',';
+			out[length++] = '"';
+			name_length = strlen(field);
+			memcpy(out + length, field, name_length);
+			length += name_length;
+			out[length++] = '"';
+			out[length++] = ':';
+			break;
+	}
+
+	return length;
+}
+
+/* Decimal digits two at a time, written backwards then moved into place. */
+static const char export_pairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static size_t export_digits (char *out, unsigned long value) {
+	char digits[24], *end = digits + sizeof(digits), *start = end;
+
+	while (value >= 100) {
+		start -= 2;
+		memcpy(start, export_pairs + (value % 100) * 2, 2);
+		value /= 100;
+	}
+
+	if (value >= 10) {
+		start -= 2;
+		memcpy(start, export_pairs + value * 2, 2);
+	} else {
+		*--start = '0' + value;
+	}
+
+	memcpy(out, start, end - start);
+
+	return end - start;
+}
+
+void export_int (Exporter *exporter, const char *field, unsigned long value) {
+	size_t length;
+	char *out;
+
+	if ((out = export_reserve(exporter, EXPORT_FIELD_MAX)) == NULL) {
+		return;
+	}
+
+	if (exporter->format == EXPORT_BINARY) {
+		out[0] = value & 0xff;
+		out[1] = (value >> 8) & 0xff;
+		out[2] = (value >> 16) & 0xff;
+		out[3] = (value >> 24) & 0xff;
+		export_commit(exporter, 4);
+		return;
+	}
+
+	length = export_field(exporter, out, field);
+	length += export_digits(out + length, value);
+	export_commit(exporter, length);
+}
+
+/* A UTF-8 string, NULL if there isn't one. */
+void export_string (Exporter *exporter, const char *field, const char *text, int text_length) {
+	size_t length;
+	int i, run, quote = 0;
+	char *out;
+
+	if ((out = export_reserve(exporter, EXPORT_FIELD_MAX)) == NULL) {
+		return;
+	}
+
+	if (text == NULL) {
+		text_length = 0;
+	}
+
+	switch (exporter->format) {
+		case EXPORT_CSV:
+			length = export_field(exporter, out, field);
+
+			/* Only quoted if it has to be, doubling any quotes. */
+			for (i = 0; i < text_length && !quote; i++) {
+				quote = text[i] == ',' || text[i] == '"' || text[i] == '\n' || text[i] == '\r';
+			}
+
+			if (!quote) {
+				memcpy(out + length, text, text_length);
+				length += text_length;
+				break;
+			}
+
+			out[length++] = '"';
+
+			for (i = 0; i < text_length; i++) {
+				if (text[i] == '"') {
+					out[length++] = '"';
+				}
+
+				out[length++] = text[i];
+			}
+
+			out[length++] = '"';
+			break;
+
+		case EXPORT_NDJSON:
+			length = export_field(exporter, out, field);
+
+			if (text == NULL) {
+				memcpy(out + length, "null", 4);
+				length += 4;
+				break;
+			}
+
+			out[length++] = '"';
+
+			for (i = 0; i < text_length; i++) {
+				/* Copy runs which need nothing in one go. */
+				for (run = i; run < text_length && export_json_escape[(unsigned char) text[run]] == 0; run++);
+
+				memcpy(out + length, text + i, run - i);
+				length += run - i;
+
+				if ((i = run) == text_length) {
+					break;
+				}
+
+				switch (export_json_escape[(unsigned char) text[i]]) {
+					case 1:
+						out[length++] = '\\';
+						out[length++] = text[i];
+						break;
+
+					default:
+						memcpy(out + length, "\\u00", 4);
+						out[length + 4] = export_hex[(unsigned char) text[i] >> 4];
+						out[length + 5] = export_hex[text[i] & 0x0f];
+						length += 6;
+						break;
+				}
+			}
+
+			out[length++] = '"';
+			break;
+
+		default:
+			out[0] = text_length & 0xff;
+			out[1] = text_length >> 8;
+			memcpy(out + 2, text, text_length);
+			length = text_length + 2;
+			break;
+	}
+
+	export_commit(exporter, length);
+}
+
+/* A DVB string, converted to UTF-8 on the way. */
+static void export_terminated (Exporter *exporter, const char *field, const char *text) {
+	export_string(exporter, field, text, text ? strlen(text) : 0);
+}
+
+void export_text (Exporter *exporter, const char *field, TextView view) {
+	char converted[TEXT_MAX];
+	int length = 0;
+
+	if (view.data) {
+		length = text_convert(view.data + 1, view.data[0], converted, sizeof(converted));
+	}
+
+	export_string(exporter, field, view.data ? converted : NULL, length);
+}
+
+void export_end (Exporter *exporter) {
+	size_t length;
+	char *out;
+
+	if (exporter->format == EXPORT_BINARY) {
+		if (exporter->record_length) {
+			length = exporter->total - exporter->record_total;
+			exporter->record_length[0] = length & 0xff;
+			exporter->record_length[1] = (length >> 8) & 0xff;
+			exporter->record_length = NULL;
+		}
+
+		return;
+	}
+
+	if ((out = export_reserve(exporter, 2)) == NULL) {
+		return;
+	}
+
+	length = 0;
+
+	if (exporter->format == EXPORT_NDJSON) {
+		out[length++] = '}';
+	}
+
+	out[length++] = '\n';
+	export_commit(exporter, length);
+}
+
+/* Records for the model, the same fields whichever list they're in. */
+void export_network (Exporter *exporter, Network *network) {
+	export_begin(exporter, EXPORT_RECORD_NETWORK);
+	export_int(exporter, "network_id", network->network_id);
+	export_text(exporter, "name", network->name);
+	export_end(exporter);
+}
+
+void export_transport (Exporter *exporter, Transport *transport) {
+	TransportTuning *tuning = transport_tuning(transport);
+
+	export_begin(exporter, EXPORT_RECORD_TRANSPORT);
+	export_int(exporter, "transport_id", transport->transport_id);
+	export_int(exporter, "original_network_id", transport->original_network_id);
+	export_int(exporter, "modulation_system", tuning->modulation_system);
+	export_int(exporter, "frequency", tuning->frequency);
+	export_int(exporter, "symbol_rate", tuning->symbol_rate);
+	export_int(exporter, "polarization", tuning->polarization);
+	export_int(exporter, "modulation_type", tuning->modulation_type);
+	export_int(exporter, "fec", tuning->fec);
+	export_int(exporter, "roll_off", tuning->roll_off);
+	export_int(exporter, "orbital_position", tuning->orbital_position);
+	export_int(exporter, "west_east_flag", tuning->west_east_flag);
+	export_end(exporter);
+}
+
+void export_service (Exporter *exporter, Transport *transport, Service *service) {
+	ServiceNames *names = service_names(service);
+
+	export_begin(exporter, EXPORT_RECORD_SERVICE);
+	export_int(exporter, "transport_id", transport->transport_id);
+	export_int(exporter, "original_network_id", transport->original_network_id);
+	export_int(exporter, "service_id", service->service_id);
+	export_int(exporter, "running", service->running);
+	export_int(exporter, "free_ca", service->free_ca);
+	export_int(exporter, "service_type", service->type);
+	export_text(exporter, "name", names->name);
+	export_text(exporter, "alt_name", names->alt_name);
+	export_text(exporter, "provider", names->provider);
+	export_end(exporter);
+}
+
+void export_bouquet (Exporter *exporter, Bouquet *bouquet) {
+	export_begin(exporter, EXPORT_RECORD_BOUQUET);
+	export_int(exporter, "bouquet_id", bouquet->bouquet_id);
+	export_text(exporter, "name", bouquet->name);
+	export_end(exporter);
+}
+
+/* A lineup channel. CSV has the columns contrib/insert.rb reads, the other
+ * formats add the channel's region, bouquet and their names. With an XMLTV
+ * file each format adds the XMLTV id, callsign and icon, empty where none. */
+void export_channel (Exporter *exporter, OpenTVChannel *channel, Xmltv *xmltv) {
+	XmltvChannel *match = NULL;
+	TransportTuning *tuning = transport_tuning(transport_at(channel->transport));
+	Service *service = service_at(channel->service);
+	ServiceNames *names = service_names(service);
+	unsigned short bouquet_id = bouquet_at(channel->bouquet)->bouquet_id;
+
+	export_begin(exporter, EXPORT_RECORD_CHANNEL);
+	export_int(exporter, "transport_id", channel->transport_id);
+	export_int(exporter, "original_network_id", channel->original_network_id);
+	export_int(exporter, "frequency", tuning->frequency);
+	export_int(exporter, "symbol_rate", tuning->symbol_rate);
+	export_int(exporter, "polarization", tuning->polarization);
+	export_int(exporter, "modulation_system", tuning->modulation_system);
+	export_int(exporter, "roll_off", tuning->roll_off);
+	export_int(exporter, "service_id", channel->service_id);
+	export_int(exporter, "user_number", channel->user_number);
+	export_text(exporter, "name", names->name);
+
+	/* CSV keeps the columns contrib/insert.rb reads, the names are from the
+	 * tables built from REGIONS and BOUQUETS. */
+	if (exporter->format != EXPORT_CSV) {
+		export_int(exporter, "channel_number", channel->channel_number);
+		export_int(exporter, "region", channel->region);
+		export_int(exporter, "bouquet_id", bouquet_id);
+		export_int(exporter, "service_type", service ? service->type : channel->type);
+		export_text(exporter, "alt_name", names->alt_name);
+		export_terminated(exporter, "region_name", names_region(channel->region));
+		export_terminated(exporter, "bouquet_name", names_bouquet(bouquet_id));
+	}
+
+	if (xmltv) {
+		match = xmltv_find(xmltv, channel);
+		export_terminated(exporter, "xmltvid", match ? match->xmltvid : NULL);
+		export_terminated(exporter, "callsign", match ? match->callsign : NULL);
+		export_terminated(exporter, "icon", match ? match->icon : NULL);
+	}
+
+	export_end(exporter);
+}
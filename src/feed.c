@@ -0,0 +1,263 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * feed.c - Section feeds. Puts the demux, a section capture and a transport
+ * stream behind the same set of section filters, the kernel does the work
+ * for the demux and the others are filtered here in the same way.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include "slowlane.h"
+#include "crc32.h"
+#include "dvb.h"
+#include "filter.h"
+#include "ts.h"
+#include "carousel.h"
+#include "feed.h"
+
+static int feed_init (Feed *feed, int type) {
+	int retval;
+
+	memset(feed, '\0', sizeof(Feed));
+	feed->type = type;
+
+	if ((retval = pthread_mutex_init(&feed->lock, NULL)) != 0) {
+		slowlane_log(0, "Unable to create lock for feed (%s).", strerror(retval));
+		return -1;
+	}
+
+	return 0;
+}
+
+/* One demux fd per filter, the kernel only allows one filter per fd. Only
+ * filter_count are opened, each takes one of the demux's limited filters. */
+int feed_open_demux (Feed *feed, int dvb_adapter, int dvb_demux, unsigned long buffer_size, int filter_count) {
+	int i;
+
+	if (feed_init(feed, FEED_DEMUX) < 0) {
+		return -1;
+	}
+
+	for (i = 0; i < filter_count && i < FEED_FILTER_MAX; i++) {
+		if ((feed->fds[i] = dvb_open(dvb_adapter, dvb_demux)) < 1) {
+			feed_close(feed);
+			return -1;
+		}
+
+		feed->fd_count++;
+
+		/* Enlarge the kernel buffer if asked, gives more slack if we fall behind. */
+		if (buffer_size && dvb_set_buffer_size(feed->fds[i], buffer_size) < 0) {
+			feed_close(feed);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Tap the SI PIDs through to the dvr and demux the transport stream ourselves. */
+int feed_open_dvr (Feed *feed, int dvb_adapter, int dvb_demux, unsigned long buffer_size) {
+	if (feed_init(feed, FEED_TS) < 0 || ts_demux_init(&feed->ts, NULL, NULL) < 0) {
+		return -1;
+	}
+
+	if ((feed->pes_fds[0] = dvb_open(dvb_adapter, dvb_demux)) < 1 || dvb_set_pes_filter(feed->pes_fds[0], 0x0010) < 0 ||
+	    (feed->pes_fds[1] = dvb_open(dvb_adapter, dvb_demux)) < 1 || dvb_set_pes_filter(feed->pes_fds[1], 0x0011) < 0) {
+		slowlane_log(0, "Unable to pass SI PIDs to DVR on adapter %i.", dvb_adapter);
+		feed_close(feed);
+		return -1;
+	}
+
+	if ((feed->fds[0] = dvb_open_dvr(dvb_adapter, dvb_demux)) < 1) {
+		feed_close(feed);
+		return -1;
+	}
+
+	feed->fd_count = 1;
+
+	if (buffer_size && dvb_set_buffer_size(feed->fds[0], buffer_size) < 0) {
+		feed_close(feed);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* A capture written with -w, holding sections as the demux gave them or
+ * deduplicated, which is replayed at speed times as fast as it was read. */
+int feed_open_capture (Feed *feed, const char *filename, int speed) {
+	if (feed_init(feed, FEED_CAPTURE) < 0) {
+		return -1;
+	}
+
+	if ((feed->fds[0] = dvb_open_capture(filename)) < 1) {
+		feed_close(feed);
+		return -1;
+	}
+
+	feed->fd_count = 1;
+
+	if (!carousel_is(feed->fds[0])) {
+		return 0;
+	}
+
+	if ((feed->carousel = (Carousel *) malloc(sizeof(Carousel))) == NULL || carousel_open(feed->carousel, feed->fds[0], speed) < 0) {
+		slowlane_log(0, "Unable to open deduplicated capture %s.", filename);
+		free(feed->carousel);
+		feed->carousel = NULL;
+		feed_close(feed);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* A transport stream recording. */
+int feed_open_ts (Feed *feed, const char *filename) {
+	if (feed_init(feed, FEED_TS) < 0 || ts_demux_init(&feed->ts, NULL, NULL) < 0) {
+		return -1;
+	}
+
+	if ((feed->fds[0] = dvb_open_capture(filename)) < 1) {
+		feed_close(feed);
+		return -1;
+	}
+
+	feed->fd_count = 1;
+	return 0;
+}
+
+void feed_close (Feed *feed) {
+	int i;
+
+	for (i = 0; i < feed->fd_count; i++) {
+		dvb_close(feed->fds[i]);
+	}
+
+	dvb_close(feed->pes_fds[0]);
+	dvb_close(feed->pes_fds[1]);
+
+	if (feed->type == FEED_TS) {
+		ts_demux_free(&feed->ts);
+	} else if (feed->type == FEED_CAPTURE) {
+		slowlane_log(1, "Capture filters passed %lu sections and dropped %lu.", feed->passed, feed->dropped);
+	}
+
+	if (feed->carousel) {
+		carousel_close(feed->carousel);
+		free(feed->carousel);
+		feed->carousel = NULL;
+	}
+
+	pthread_mutex_destroy(&feed->lock);
+	feed->fd_count = 0;
+}
+
+/* Files are read as fast as they can be, there's no clock to wait on. A
+ * paced replay keeps the clock it was captured on, so is taken as live. */
+int feed_is_file (Feed *feed) {
+	return (feed->type == FEED_CAPTURE && !(feed->carousel && feed->carousel->speed)) || (feed->type == FEED_TS && feed->pes_fds[0] == 0);
+}
+
+/* Install filter in slot index, replacing what was there. */
+int feed_set_filter (Feed *feed, int index, SectionFilter *filter) {
+	if (index < 0 || index >= FEED_FILTER_MAX || (feed->type == FEED_DEMUX && index >= feed->fd_count)) {
+		slowlane_log(0, "No filter slot %i on feed.", index);
+		return -1;
+	}
+
+	pthread_mutex_lock(&feed->lock);
+	memcpy(&feed->filters[index], filter, sizeof(SectionFilter));
+	filter_prepare(&feed->filters[index]);
+	feed->used[index] = 1;
+	pthread_mutex_unlock(&feed->lock);
+
+	switch (feed->type) {
+		case FEED_DEMUX:
+			return dvb_set_section_filter(feed->fds[index], filter);
+		case FEED_TS:
+			return ts_demux_set_filter(&feed->ts, index, filter);
+		default:
+			slowlane_log(1, "Installed capture filter %i for PID 0x%x for table 0x%x/0x%x extension 0x%02x%02x/0x%02x%02x.", index, filter->pid, filter->filter[0], filter->mask[0], filter->filter[1], filter->filter[2], filter->mask[1], filter->mask[2]);
+			return 0;
+	}
+}
+
+/* Stop the filter in slot index. */
+void feed_stop_filter (Feed *feed, int index) {
+	if (index < 0 || index >= FEED_FILTER_MAX || !feed->used[index]) {
+		return;
+	}
+
+	pthread_mutex_lock(&feed->lock);
+	feed->used[index] = 0;
+	pthread_mutex_unlock(&feed->lock);
+
+	switch (feed->type) {
+		case FEED_DEMUX:
+			dvb_stop_filter(feed->fds[index]);
+			break;
+		case FEED_TS:
+			ts_demux_clear_filter(&feed->ts, index);
+			break;
+	}
+
+	slowlane_log(2, "Stopped filter %i.", index);
+}
+
+/* Filter whole sections from a capture as the demux would have, packing
+ * those that pass to the start of buffer. Returns the bytes of buffer used
+ * up, anything after that is an incomplete section, and sets kept to the
+ * bytes of sections passed. */
+int feed_filter_sections (Feed *feed, unsigned char *buffer, int buffer_length, int *kept) {
+	int offset = 0, section_length, i, pass;
+
+	*kept = 0;
+	pthread_mutex_lock(&feed->lock);
+
+	while (offset + 3 <= buffer_length) {
+		section_length = (((buffer[offset + 1] & 0x0f) << 8) | buffer[offset + 2]) + 3;
+
+		/* Nothing can be made of the rest if the length is nonsense. */
+		if (section_length > TS_SECTION_MAX) {
+			feed->dropped++;
+			offset = buffer_length;
+			break;
+		}
+
+		if (offset + section_length > buffer_length) {
+			break;
+		}
+
+		for (i = 0, pass = 0; i < FEED_FILTER_MAX && !pass; i++) {
+			if (!feed->used[i] || feed->filters[i].pid != filter_table_pid(buffer[offset]) || !filter_match(&feed->filters[i], buffer + offset, section_length)) {
+				continue;
+			}
+
+			/* As the kernel, only sections with the syntax indicator carry a CRC. */
+			pass = !(feed->filters[i].flags & FILTER_CHECK_CRC) || !(buffer[offset + 1] & 0x80) || !crc32((char *) buffer + offset, section_length, 0xffffffff);
+		}
+
+		if (pass) {
+			memmove(buffer + *kept, buffer + offset, section_length);
+			*kept += section_length;
+			feed->passed++;
+		} else {
+			feed->dropped++;
+		}
+
+		offset += section_length;
+	}
+
+	pthread_mutex_unlock(&feed->lock);
+
+	return offset;
+}
@@ -0,0 +1,133 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * filter.c - Software section filter, matches sections the same way the
+ * kernel demux does for a dmx_sct_filter_params.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <string.h>
+#include "slowlane.h"
+#include "filter.h"
+
+/* Filter on PID and table only, the same as dvb_set_filter. */
+void filter_init (SectionFilter *filter, unsigned short pid, unsigned char table, unsigned char mask, int crc) {
+	memset(filter, '\0', sizeof(SectionFilter));
+	filter->pid = pid;
+	filter->filter[0] = table;
+	filter->mask[0] = mask;
+
+	if (crc) {
+		filter->flags |= FILTER_CHECK_CRC;
+	}
+
+	filter_prepare(filter);
+}
+
+/* Also match table_id_extension, bouquet_id for a BAT or transport_stream_id for an SDT. */
+void filter_extension (SectionFilter *filter, unsigned short extension) {
+	filter->filter[1] = extension >> 8;
+	filter->filter[2] = extension & 0xff;
+	filter->mask[1] = 0xff;
+	filter->mask[2] = 0xff;
+	filter->mode[1] = 0;
+	filter->mode[2] = 0;
+
+	filter_prepare(filter);
+}
+
+/* Only pass versions other than this one, for watching a table we already have. */
+void filter_version_not (SectionFilter *filter, unsigned char version) {
+	filter->filter[3] = (version & 0x1f) << 1;
+	filter->mask[3] = 0x3e;
+	filter->mode[3] = 0x3e;
+
+	filter_prepare(filter);
+}
+
+/* Lay the filter out against section bytes and split positive from negative
+ * bits, must be called after changing filter, mask or mode. */
+void filter_prepare (SectionFilter *filter) {
+	int i, to;
+
+	memset(filter->value, '\0', sizeof(filter->value));
+	memset(filter->positive, '\0', sizeof(filter->positive));
+	memset(filter->negative, '\0', sizeof(filter->negative));
+	filter->depth = 0;
+	filter->any_negative = 0;
+
+	for (i = 0; i < FILTER_SIZE; i++) {
+		/* The two length bytes can't be filtered on. */
+		to = i ? i + 2 : 0;
+
+		filter->value[to] = filter->filter[i] & filter->mask[i];
+		filter->positive[to] = filter->mask[i] & ~filter->mode[i];
+		filter->negative[to] = filter->mask[i] & filter->mode[i];
+
+		if (filter->mask[i]) {
+			filter->depth = to + 1;
+		}
+
+		if (filter->negative[to]) {
+			filter->any_negative = 1;
+		}
+	}
+}
+
+/* Returns 1 if the section passes the filter, PID is left to the caller. */
+int filter_match (SectionFilter *filter, unsigned char *section, int section_length) {
+	unsigned char differ, negative = 0;
+	int i;
+
+	/* Anything the filter looks at must be there. */
+	if (section_length < filter->depth) {
+		return 0;
+	}
+
+	for (i = 0; i < filter->depth; i++) {
+		differ = (section[i] ^ filter->value[i]);
+
+		if (differ & filter->positive[i]) {
+			return 0;
+		}
+
+		negative |= differ & filter->negative[i];
+	}
+
+	/* With any negative bits at least one of them has to differ. */
+	if (filter->any_negative && !negative) {
+		return 0;
+	}
+
+	return 1;
+}
+
+/* A section capture doesn't keep the PID, but each SI table only ever comes
+ * on one. OpenTV tables are spread over several, they're given the first. */
+unsigned short filter_table_pid (unsigned char table_id) {
+	switch (table_id) {
+		case 0x40:
+		case 0x41:
+			return 0x0010;
+		case 0x42:
+		case 0x46:
+		case 0x4a:
+			return 0x0011;
+		case 0xa0: /* OpenTV titles, sent on 0x30-0x37 */
+		case 0xa1:
+		case 0xa2:
+		case 0xa3:
+			return 0x0030;
+		case 0xa8: /* OpenTV summaries, sent on 0x40-0x47 */
+		case 0xa9:
+		case 0xaa:
+		case 0xab:
+			return 0x0040;
+		default:
+			/* EIT and everything else on the EIT PID. */
+			return 0x0012;
+	}
+}
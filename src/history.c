@@ -0,0 +1,769 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * history.c - Lineup history store. Each filtered lineup is appended to one
+ * file as the changes from the one before, with every HISTORY_KEYFRAME_INTERVAL
+ * written whole, so the file grows with what changed rather than with the
+ * lineup. Any point is read back from the keyframe before it and at most the
+ * interval of deltas, found by stepping over record headers alone.
+ *
+ * The file starts with HISTORY_MAGIC, then records of a header, a type byte
+ * and little endian 32-bit payload length, 64-bit time, 32-bit channel count
+ * once applied, 32-bit operation count and 32-bit CRC of the payload,
+ * followed by the payload. The payload is operations in key order, each an
+ * operation byte and the key as a varint difference from the last, a set
+ * then carrying the entry's fields as varints and its name. A record cut
+ * short by a crash is dropped, and overwritten by the next append, as is one
+ * found damaged when appending along with every record after it.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include "slowlane.h"
+#include "crc32.h"
+#include "data.h"
+#include "text.h"
+#include "index.h"
+#include "history.h"
+
+#define HISTORY_MAGIC "SLHIST\001\n"
+#define HISTORY_MAGIC_SIZE 8
+#define HISTORY_HEADER_SIZE 25
+
+/* Operations. */
+#define HISTORY_OP_SET 0
+#define HISTORY_OP_REMOVE 1
+
+/* A record header and where it is. */
+typedef struct tHistoryRecord {
+	long		offset;
+	unsigned char	type;
+	unsigned int	length;
+	unsigned long long time;
+	unsigned int	count;
+	unsigned int	ops;
+	unsigned int	crc;
+} HistoryRecord;
+
+/* The records of a file, and where the last whole one ends. */
+typedef struct tHistoryIndex {
+	HistoryRecord	*records;
+	unsigned int	count;
+	unsigned int	size;
+	long		end;
+} HistoryIndex;
+
+/* Bytes being built up for a record. */
+typedef struct tHistoryBuffer {
+	unsigned char	*data;
+	size_t		used;
+	size_t		size;
+	int		failed;
+} HistoryBuffer;
+
+static unsigned char * history_reserve (HistoryBuffer *buffer, size_t length) {
+	unsigned char *data;
+	size_t size;
+
+	if (buffer->used + length > buffer->size) {
+		size = buffer->size ? buffer->size * 2 : 4096;
+
+		while (size < buffer->used + length) {
+			size *= 2;
+		}
+
+		if ((data = (unsigned char *) realloc(buffer->data, size)) == NULL) {
+			slowlane_log(0, "Unable to grow history buffer to %lu bytes.", (unsigned long) size);
+			buffer->failed = 1;
+			return NULL;
+		}
+
+		buffer->data = data;
+		buffer->size = size;
+	}
+
+	data = buffer->data + buffer->used;
+	buffer->used += length;
+
+	return data;
+}
+
+static void history_put_varint (HistoryBuffer *buffer, unsigned long long value) {
+	unsigned char *out;
+
+	if ((out = history_reserve(buffer, 10)) == NULL) {
+		return;
+	}
+
+	for (; value >= 0x80; value >>= 7) {
+		*out++ = (value & 0x7f) | 0x80;
+	}
+
+	*out++ = value;
+	buffer->used = out - buffer->data;
+}
+
+/* Read a varint, NULL if it runs off the end. */
+static const unsigned char * history_get_varint (const unsigned char *p, const unsigned char *end, unsigned long long *value) {
+	int shift;
+
+	for (*value = 0, shift = 0; p < end && shift < 64; shift += 7) {
+		*value |= (unsigned long long) (*p & 0x7f) << shift;
+
+		if ((*p++ & 0x80) == 0) {
+			return p;
+		}
+	}
+
+	return NULL;
+}
+
+static void history_put_le (unsigned char *out, unsigned long long value, int bytes) {
+	int i;
+
+	for (i = 0; i < bytes; i++) {
+		out[i] = (value >> (i * 8)) & 0xff;
+	}
+}
+
+static unsigned long long history_get_le (const unsigned char *in, int bytes) {
+	unsigned long long value = 0;
+	int i;
+
+	for (i = bytes - 1; i >= 0; i--) {
+		value = (value << 8) | in[i];
+	}
+
+	return value;
+}
+
+/* Add an entry to the end of a snapshot, keys must come in order. */
+static int history_snapshot_add (HistorySnapshot *snapshot, HistoryEntry *entry, const char *name, int name_length) {
+	HistoryEntry *entries;
+	char *names;
+	size_t size;
+
+	if (snapshot->count == snapshot->size) {
+		snapshot->size = snapshot->size ? snapshot->size * 2 : 256;
+
+		if ((entries = (HistoryEntry *) realloc(snapshot->entries, snapshot->size * sizeof(HistoryEntry))) == NULL) {
+			slowlane_log(0, "Unable to grow history snapshot to %u channels.", snapshot->size);
+			return -1;
+		}
+
+		snapshot->entries = entries;
+	}
+
+	if (snapshot->names_used + name_length > snapshot->names_size) {
+		for (size = snapshot->names_size ? snapshot->names_size * 2 : 16384; size < snapshot->names_used + name_length; size *= 2);
+
+		if ((names = (char *) realloc(snapshot->names, size)) == NULL) {
+			slowlane_log(0, "Unable to grow history names to %lu bytes.", (unsigned long) size);
+			return -1;
+		}
+
+		snapshot->names = names;
+		snapshot->names_size = size;
+	}
+
+	snapshot->entries[snapshot->count] = *entry;
+	snapshot->entries[snapshot->count].name = snapshot->names_used;
+	snapshot->entries[snapshot->count].name_length = name_length;
+	memcpy(snapshot->names + snapshot->names_used, name, name_length);
+	snapshot->names_used += name_length;
+	snapshot->count++;
+
+	return 0;
+}
+
+void history_snapshot_free (HistorySnapshot *snapshot) {
+	free(snapshot->entries);
+	free(snapshot->names);
+	memset(snapshot, '\0', sizeof(HistorySnapshot));
+}
+
+/* Do two entries differ in anything but where their names are kept? */
+static int history_entry_differs (HistorySnapshot *a, HistoryEntry *x, HistorySnapshot *b, HistoryEntry *y) {
+	return x->frequency != y->frequency || x->symbol_rate != y->symbol_rate || x->original_network_id != y->original_network_id || x->transport_id != y->transport_id || x->service_id != y->service_id || x->bouquet_id != y->bouquet_id || x->service_type != y->service_type || x->polarization != y->polarization || x->modulation_system != y->modulation_system || x->roll_off != y->roll_off || x->name_length != y->name_length || memcmp(a->names + x->name, b->names + y->name, x->name_length) != 0;
+}
+
+static void history_put_op (HistoryBuffer *buffer, unsigned char op, unsigned long long key, unsigned long long *last_key, HistorySnapshot *snapshot, HistoryEntry *entry) {
+	unsigned char *out;
+
+	if ((out = history_reserve(buffer, 1)) == NULL) {
+		return;
+	}
+
+	*out = op;
+	history_put_varint(buffer, key - *last_key);
+	*last_key = key;
+
+	if (op == HISTORY_OP_REMOVE) {
+		return;
+	}
+
+	history_put_varint(buffer, entry->original_network_id);
+	history_put_varint(buffer, entry->transport_id);
+	history_put_varint(buffer, entry->service_id);
+	history_put_varint(buffer, entry->bouquet_id);
+	history_put_varint(buffer, entry->service_type);
+	history_put_varint(buffer, entry->frequency);
+	history_put_varint(buffer, entry->symbol_rate);
+	history_put_varint(buffer, entry->polarization);
+	history_put_varint(buffer, entry->modulation_system);
+	history_put_varint(buffer, entry->roll_off);
+	history_put_varint(buffer, entry->name_length);
+
+	if ((out = history_reserve(buffer, entry->name_length)) != NULL) {
+		memcpy(out, snapshot->names + entry->name, entry->name_length);
+	}
+}
+
+/* The operations taking from to to, everything in to if from is NULL.
+ * Returns the number of operations. */
+static unsigned int history_encode (HistoryBuffer *buffer, HistorySnapshot *from, HistorySnapshot *to) {
+	unsigned int i = 0, j = 0, ops = 0, from_count = from ? from->count : 0;
+	unsigned long long last_key = 0;
+
+	while (i < from_count || j < to->count) {
+		if (j == to->count || (i < from_count && from->entries[i].key < to->entries[j].key)) {
+			history_put_op(buffer, HISTORY_OP_REMOVE, from->entries[i].key, &last_key, NULL, NULL);
+			i++;
+			ops++;
+		} else if (i == from_count || to->entries[j].key < from->entries[i].key) {
+			history_put_op(buffer, HISTORY_OP_SET, to->entries[j].key, &last_key, to, &to->entries[j]);
+			j++;
+			ops++;
+		} else {
+			if (history_entry_differs(from, &from->entries[i], to, &to->entries[j])) {
+				history_put_op(buffer, HISTORY_OP_SET, to->entries[j].key, &last_key, to, &to->entries[j]);
+				ops++;
+			}
+
+			i++;
+			j++;
+		}
+	}
+
+	return ops;
+}
+
+/* Apply a record's operations to from, building to. */
+static int history_apply (HistorySnapshot *from, const unsigned char *p, const unsigned char *end, unsigned int ops, HistorySnapshot *to) {
+	unsigned long long key = 0, value[12];
+	unsigned int i = 0, op, field;
+	unsigned char code;
+	HistoryEntry entry;
+
+	for (op = 0; op < ops; op++) {
+		if (p >= end) {
+			return -1;
+		}
+
+		code = *p++;
+
+		if ((p = history_get_varint(p, end, &value[0])) == NULL) {
+			return -1;
+		}
+
+		key += value[0];
+
+		/* Everything before the key carries over. */
+		for (; i < from->count && from->entries[i].key < key; i++) {
+			if (history_snapshot_add(to, &from->entries[i], from->names + from->entries[i].name, from->entries[i].name_length) < 0) {
+				return -1;
+			}
+		}
+
+		if (i < from->count && from->entries[i].key == key) {
+			i++;
+		}
+
+		if (code == HISTORY_OP_REMOVE) {
+			continue;
+		} else if (code != HISTORY_OP_SET) {
+			return -1;
+		}
+
+		for (field = 0; field < 11; field++) {
+			if ((p = history_get_varint(p, end, &value[field])) == NULL) {
+				return -1;
+			}
+		}
+
+		if (value[10] > (unsigned long long) (end - p)) {
+			return -1;
+		}
+
+		memset(&entry, '\0', sizeof(HistoryEntry));
+		entry.key = key;
+		entry.original_network_id = value[0];
+		entry.transport_id = value[1];
+		entry.service_id = value[2];
+		entry.bouquet_id = value[3];
+		entry.service_type = value[4];
+		entry.frequency = value[5];
+		entry.symbol_rate = value[6];
+		entry.polarization = value[7];
+		entry.modulation_system = value[8];
+		entry.roll_off = value[9];
+
+		if (history_snapshot_add(to, &entry, (const char *) p, value[10]) < 0) {
+			return -1;
+		}
+
+		p += value[10];
+	}
+
+	for (; i < from->count; i++) {
+		if (history_snapshot_add(to, &from->entries[i], from->names + from->entries[i].name, from->entries[i].name_length) < 0) {
+			return -1;
+		}
+	}
+
+	return p == end ? 0 : -1;
+}
+
+/* Step over the record headers, stopping at the first which is cut short. */
+static int history_scan (FILE *file, HistoryIndex *index) {
+	unsigned char header[HISTORY_HEADER_SIZE];
+	HistoryRecord *records;
+	long size, offset;
+
+	memset(index, '\0', sizeof(HistoryIndex));
+
+	if (fseek(file, 0, SEEK_END) < 0 || (size = ftell(file)) < HISTORY_MAGIC_SIZE) {
+		return -1;
+	}
+
+	for (offset = HISTORY_MAGIC_SIZE; offset + HISTORY_HEADER_SIZE <= size; offset += HISTORY_HEADER_SIZE + index->records[index->count++].length) {
+		if (fseek(file, offset, SEEK_SET) < 0 || fread(header, HISTORY_HEADER_SIZE, 1, file) != 1) {
+			break;
+		}
+
+		if ((header[0] != HISTORY_RECORD_KEYFRAME && header[0] != HISTORY_RECORD_DELTA) || offset + HISTORY_HEADER_SIZE + (long) history_get_le(header + 1, 4) > size) {
+			break;
+		}
+
+		if (index->count == index->size) {
+			index->size = index->size ? index->size * 2 : 64;
+
+			if ((records = (HistoryRecord *) realloc(index->records, index->size * sizeof(HistoryRecord))) == NULL) {
+				slowlane_log(0, "Unable to grow history index to %u records.", index->size);
+				return -1;
+			}
+
+			index->records = records;
+		}
+
+		records = &index->records[index->count];
+		records->offset = offset;
+		records->type = header[0];
+		records->length = history_get_le(header + 1, 4);
+		records->time = history_get_le(header + 5, 8);
+		records->count = history_get_le(header + 13, 4);
+		records->ops = history_get_le(header + 17, 4);
+		records->crc = history_get_le(header + 21, 4);
+	}
+
+	index->end = offset;
+
+	if (offset != size) {
+		slowlane_log(1, "History ends in a partial record at %li of %li bytes, ignoring it.", offset, size);
+	}
+
+	return 0;
+}
+
+/* Rebuild the lineup as of record target, from the keyframe before it. A
+ * damaged record ends the index, so it and those after it are dropped. */
+static int history_load (FILE *file, HistoryIndex *index, unsigned int target, HistorySnapshot *snapshot) {
+	HistorySnapshot next;
+	HistoryRecord *record;
+	unsigned char *payload = NULL, *grown;
+	unsigned int keyframe, i, payload_size = 0;
+	int damaged = 0;
+
+	memset(snapshot, '\0', sizeof(HistorySnapshot));
+
+	for (keyframe = target; keyframe > 0 && index->records[keyframe].type != HISTORY_RECORD_KEYFRAME; keyframe--);
+
+	if (index->records[keyframe].type != HISTORY_RECORD_KEYFRAME) {
+		slowlane_log(0, "History has no keyframe before record %u.", target);
+		return -1;
+	}
+
+	for (i = keyframe; i <= target; i++) {
+		record = &index->records[i];
+
+		if (record->length > payload_size) {
+			if ((grown = (unsigned char *) realloc(payload, record->length)) == NULL) {
+				slowlane_log(0, "Unable to allocate %u bytes of history.", record->length);
+				break;
+			}
+
+			payload = grown;
+			payload_size = record->length;
+		}
+
+		if (fseek(file, record->offset + HISTORY_HEADER_SIZE, SEEK_SET) < 0 || (record->length && fread(payload, record->length, 1, file) != 1)) {
+			slowlane_log(0, "Unable to read history record at %li.", record->offset);
+			break;
+		}
+
+		if (crc32((char *) payload, record->length, 0xffffffff) != record->crc) {
+			slowlane_log(0, "History record at %li fails its CRC.", record->offset);
+			damaged = 1;
+			break;
+		}
+
+		memset(&next, '\0', sizeof(HistorySnapshot));
+
+		if (history_apply(snapshot, payload, payload + record->length, record->ops, &next) < 0 || next.count != record->count) {
+			slowlane_log(0, "History record at %li doesn't apply.", record->offset);
+			history_snapshot_free(&next);
+			damaged = 1;
+			break;
+		}
+
+		history_snapshot_free(snapshot);
+		*snapshot = next;
+		snapshot->time = record->time;
+	}
+
+	free(payload);
+
+	if (i <= target) {
+		if (damaged) {
+			index->count = i;
+			index->end = index->records[i].offset;
+		}
+
+		history_snapshot_free(snapshot);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Rebuild the lineup as of the last record, stepping back past any which are
+ * damaged so the next append follows the last whole one. */
+static int history_load_last (FILE *file, HistoryIndex *index, const char *filename, HistorySnapshot *snapshot) {
+	unsigned int count;
+
+	memset(snapshot, '\0', sizeof(HistorySnapshot));
+
+	while (index->count) {
+		count = index->count;
+
+		if (history_load(file, index, count - 1, snapshot) == 0) {
+			return 0;
+		}
+
+		if (index->count == count) {
+			return -1;
+		}
+
+		slowlane_log(1, "History %s is damaged at %li, dropping the last %u records.", filename, index->end, count - index->count);
+	}
+
+	return 0;
+}
+
+/* Open a store and index it, creating it if asked. */
+static FILE * history_open (const char *filename, int create, HistoryIndex *index) {
+	char magic[HISTORY_MAGIC_SIZE];
+	FILE *file;
+
+	memset(index, '\0', sizeof(HistoryIndex));
+
+	if ((file = fopen(filename, create ? "r+b" : "rb")) == NULL && create && (file = fopen(filename, "w+b")) != NULL) {
+		fwrite(HISTORY_MAGIC, HISTORY_MAGIC_SIZE, 1, file);
+	}
+
+	if (file == NULL) {
+		slowlane_log(0, "Unable to open history %s.", filename);
+		return NULL;
+	}
+
+	if (fseek(file, 0, SEEK_SET) < 0 || fread(magic, HISTORY_MAGIC_SIZE, 1, file) != 1 || memcmp(magic, HISTORY_MAGIC, HISTORY_MAGIC_SIZE) != 0 || history_scan(file, index) < 0) {
+		slowlane_log(0, "%s is not a lineup history.", filename);
+		free(index->records);
+		fclose(file);
+		return NULL;
+	}
+
+	return file;
+}
+
+/* The lineup as it's stored, from the model it was filtered from. */
+int history_snapshot_lineup (ChannelIndex *lineup, HistorySnapshot *snapshot) {
+	char name[TEXT_MAX];
+	OpenTVChannel *channel;
+	TransportTuning *tuning;
+	Service *service;
+	HistoryEntry entry;
+	unsigned int i;
+
+	memset(snapshot, '\0', sizeof(HistorySnapshot));
+
+	for (i = 0; i < lineup->count; i++) {
+		channel = channel_index_at(lineup, i);
+		service = service_at(channel->service);
+		tuning = transport_tuning(transport_at(channel->transport));
+
+		memset(&entry, '\0', sizeof(HistoryEntry));
+		entry.key = channel_index_key(channel);
+		entry.original_network_id = channel->original_network_id;
+		entry.transport_id = channel->transport_id;
+		entry.service_id = channel->service_id;
+		entry.bouquet_id = bouquet_at(channel->bouquet)->bouquet_id;
+		entry.service_type = service ? service->type : channel->type;
+		entry.frequency = tuning->frequency;
+		entry.symbol_rate = tuning->symbol_rate;
+		entry.polarization = tuning->polarization;
+		entry.modulation_system = tuning->modulation_system;
+		entry.roll_off = tuning->roll_off;
+
+		if (text_view_string(service_names(service)->name, name, sizeof(name)) == NULL) {
+			name[0] = '\0';
+		}
+
+		if (history_snapshot_add(snapshot, &entry, name, strlen(name)) < 0) {
+			history_snapshot_free(snapshot);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Add a lineup to the end of the store, as changes from the last unless a keyframe is due. */
+int history_append (const char *filename, unsigned long long time, ChannelIndex *lineup) {
+	HistorySnapshot previous, current;
+	HistoryBuffer buffer = { NULL, 0, 0, 0 };
+	HistoryIndex index;
+	unsigned char *header;
+	unsigned int ops, keyframe;
+	int retval = 0, whole;
+	FILE *file;
+
+	if ((file = history_open(filename, 1, &index)) == NULL) {
+		return -1;
+	}
+
+	memset(&previous, '\0', sizeof(HistorySnapshot));
+
+	if (history_snapshot_lineup(lineup, &current) < 0 || history_load_last(file, &index, filename, &previous) < 0) {
+		retval = -1;
+	} else {
+		for (keyframe = index.count; keyframe > 0 && index.records[keyframe - 1].type != HISTORY_RECORD_KEYFRAME; keyframe--);
+
+		/* Whole if there's nothing before, or the last keyframe has all the deltas it may have. */
+		whole = index.count == 0 || keyframe == 0 || index.count - keyframe + 1 >= HISTORY_KEYFRAME_INTERVAL;
+
+		header = history_reserve(&buffer, HISTORY_HEADER_SIZE);
+		ops = history_encode(&buffer, whole ? NULL : &previous, &current);
+
+		if (header == NULL || buffer.failed) {
+			retval = -1;
+		} else {
+			header = buffer.data;
+			header[0] = whole ? HISTORY_RECORD_KEYFRAME : HISTORY_RECORD_DELTA;
+			history_put_le(header + 1, buffer.used - HISTORY_HEADER_SIZE, 4);
+			history_put_le(header + 5, time, 8);
+			history_put_le(header + 13, current.count, 4);
+			history_put_le(header + 17, ops, 4);
+			history_put_le(header + 21, crc32((char *) buffer.data + HISTORY_HEADER_SIZE, buffer.used - HISTORY_HEADER_SIZE, 0xffffffff), 4);
+
+			/* Anything after the last whole record was a write cut short. */
+			fflush(file);
+
+			if (ftruncate(fileno(file), index.end) < 0 || fseek(file, index.end, SEEK_SET) < 0 || fwrite(buffer.data, buffer.used, 1, file) != 1 || fflush(file) != 0 || fsync(fileno(file)) < 0) {
+				slowlane_log(0, "Unable to append to history %s.", filename);
+				retval = -1;
+			} else {
+				slowlane_log(1, "History %s has a %s of %u changes for %u channels in %lu bytes.", filename, whole ? "keyframe" : "delta", ops, current.count, (unsigned long) buffer.used);
+			}
+		}
+	}
+
+	history_snapshot_free(&previous);
+	history_snapshot_free(&current);
+	free(buffer.data);
+	free(index.records);
+	fclose(file);
+
+	return retval;
+}
+
+/* The lineup as of the last snapshot taken at or before time. */
+int history_read (const char *filename, unsigned long long time, HistorySnapshot *snapshot) {
+	HistoryIndex index;
+	unsigned int i, target = 0, found = 0;
+	int retval;
+	FILE *file;
+
+	if ((file = history_open(filename, 0, &index)) == NULL) {
+		return -1;
+	}
+
+	for (i = 0; i < index.count; i++) {
+		if (index.records[i].time <= time) {
+			target = i;
+			found = 1;
+		}
+	}
+
+	if (!found) {
+		slowlane_log(0, "History %s has no lineup at or before %llu.", filename, time);
+		retval = -1;
+	} else {
+		retval = history_load(file, &index, target, snapshot);
+	}
+
+	free(index.records);
+	fclose(file);
+
+	return retval;
+}
+
+/* A time as seconds since the epoch, "now" or a UTC date and time. */
+int history_time (const char *text, unsigned long long *when) {
+	static const char *formats[] = { "%Y-%m-%d %H:%M:%S", "%Y-%m-%dT%H:%M:%S", "%Y-%m-%d %H:%M", "%Y-%m-%d", NULL };
+	struct tm tm;
+	char *end;
+	int i;
+
+	if (strcmp(text, "now") == 0) {
+		*when = time(NULL);
+		return 0;
+	}
+
+	*when = strtoull(text, &end, 10);
+
+	if (end != text && *end == '\0') {
+		return 0;
+	}
+
+	for (i = 0; formats[i]; i++) {
+		memset(&tm, '\0', sizeof(tm));
+
+		if ((end = strptime(text, formats[i], &tm)) != NULL && *end == '\0') {
+			*when = timegm(&tm);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+static int history_shown (HistoryFilter *filter, HistoryEntry *entry) {
+	if (filter->user_number && history_entry_user_number(entry) != filter->user_number) {
+		return 0;
+	}
+
+	return filter->regions == NULL || region_set_passes(filter->regions, history_entry_region(entry));
+}
+
+static void history_print_entry (FILE *out, const char *prefix, HistorySnapshot *snapshot, HistoryEntry *entry) {
+	fprintf(out, "%sC %u %u %u (%u:%u:%u) %u %.*s\n", prefix, history_entry_user_number(entry), history_entry_channel_number(entry), history_entry_region(entry), entry->original_network_id, entry->transport_id, entry->service_id, entry->service_type, entry->name_length, snapshot->names + entry->name);
+}
+
+static const char * history_time_string (unsigned long long when, char *out, int out_size) {
+	time_t seconds = when;
+	struct tm tm;
+
+	gmtime_r(&seconds, &tm);
+	strftime(out, out_size, "%Y-%m-%d %H:%M:%S", &tm);
+
+	return out;
+}
+
+/* The lineup, one channel a line, as user number, channel number, region,
+ * service, service type and name. */
+void history_print (FILE *out, HistorySnapshot *snapshot, HistoryFilter *filter) {
+	char when[32];
+	unsigned int i;
+
+	fprintf(out, "# Lineup at %s\n", history_time_string(snapshot->time, when, sizeof(when)));
+
+	for (i = 0; i < snapshot->count; i++) {
+		if (history_shown(filter, &snapshot->entries[i])) {
+			history_print_entry(out, "", snapshot, &snapshot->entries[i]);
+		}
+	}
+}
+
+/* Walk two lineups in key order, printing the changes to out if set and
+ * counting them in changes, removed, added then changed. */
+static void history_walk (FILE *out, HistorySnapshot *from, HistorySnapshot *to, HistoryFilter *filter, unsigned int changes[3]) {
+	unsigned int i = 0, j = 0;
+	HistoryEntry *x, *y;
+
+	while (i < from->count || j < to->count) {
+		x = i < from->count ? &from->entries[i] : NULL;
+		y = j < to->count ? &to->entries[j] : NULL;
+
+		if (y == NULL || (x && x->key < y->key)) {
+			if (history_shown(filter, x)) {
+				if (out) {
+					history_print_entry(out, "- ", from, x);
+				}
+
+				changes[0]++;
+			}
+
+			i++;
+		} else if (x == NULL || y->key < x->key) {
+			if (history_shown(filter, y)) {
+				if (out) {
+					history_print_entry(out, "+ ", to, y);
+				}
+
+				changes[1]++;
+			}
+
+			j++;
+		} else {
+			if (history_shown(filter, x) && history_entry_differs(from, x, to, y)) {
+				if (out) {
+					history_print_entry(out, "- ", from, x);
+					history_print_entry(out, "+ ", to, y);
+				}
+
+				changes[2]++;
+			}
+
+			i++;
+			j++;
+		}
+	}
+}
+
+/* What changed between two lineups, a channel gone as "-", new as "+" and
+ * one changed as both. */
+void history_diff (FILE *out, HistorySnapshot *from, HistorySnapshot *to, HistoryFilter *filter) {
+	char from_when[32], to_when[32];
+	unsigned int changes[3] = { 0, 0, 0 };
+
+	fprintf(out, "# Changes from %s to %s\n", history_time_string(from->time, from_when, sizeof(from_when)), history_time_string(to->time, to_when, sizeof(to_when)));
+	history_walk(out, from, to, filter, changes);
+}
+
+/* How many channels went, came and changed between two lineups. */
+void history_compare (HistorySnapshot *from, HistorySnapshot *to, HistoryFilter *filter, unsigned int *removed, unsigned int *added, unsigned int *changed) {
+	unsigned int changes[3] = { 0, 0, 0 };
+
+	history_walk(NULL, from, to, filter, changes);
+	*removed = changes[0];
+	*added = changes[1];
+	*changed = changes[2];
+}
@@ -0,0 +1,265 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * huffman.c - Table driven Huffman decoder. The dictionary is read into a
+ * code tree once, which is then compiled into a lookup table per internal
+ * node giving the text of every code completed by the next byte and the node
+ * it ends on, so decoding is one lookup and a copy per byte rather than a
+ * tree step per bit.
+ *
+ * The dictionary has one code per line as text=bits, for example "e=0101",
+ * the text being everything before the last '='. A code with no text marks
+ * the end of a string.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slowlane.h"
+#include "huffman.h"
+
+/* Code tree, only used while compiling. */
+typedef struct tHuffmanNode {
+	int		child[2];
+	int		state;
+	char		*text;
+} HuffmanNode;
+
+typedef struct tHuffmanTree {
+	HuffmanNode	*nodes;
+	int		count;
+	int		size;
+} HuffmanTree;
+
+static int huffman_node_new (HuffmanTree *tree) {
+	HuffmanNode *nodes;
+
+	if (tree->count == tree->size) {
+		tree->size = tree->size ? tree->size * 2 : 512;
+
+		if ((nodes = (HuffmanNode *) realloc(tree->nodes, tree->size * sizeof(HuffmanNode))) == NULL) {
+			slowlane_log(0, "Unable to grow Huffman tree to %i nodes.", tree->size);
+			return -1;
+		}
+
+		tree->nodes = nodes;
+	}
+
+	tree->nodes[tree->count].child[0] = tree->nodes[tree->count].child[1] = -1;
+	tree->nodes[tree->count].state = -1;
+	tree->nodes[tree->count].text = NULL;
+
+	return tree->count++;
+}
+
+/* Add one code to the tree, a code may not be the prefix of another. */
+static int huffman_tree_add (HuffmanTree *tree, const char *bits, const char *text) {
+	int node = 0, child;
+
+	for (; *bits; bits++) {
+		if (tree->nodes[node].text) {
+			slowlane_log(1, "Huffman code for \"%s\" runs through the code for \"%s\".", text, tree->nodes[node].text);
+			return -1;
+		}
+
+		if ((child = tree->nodes[node].child[*bits - '0']) < 0) {
+			if ((child = huffman_node_new(tree)) < 0) {
+				return -1;
+			}
+
+			tree->nodes[node].child[*bits - '0'] = child;
+		}
+
+		node = child;
+	}
+
+	if (node == 0 || tree->nodes[node].text || tree->nodes[node].child[0] >= 0 || tree->nodes[node].child[1] >= 0) {
+		slowlane_log(1, "Huffman code for \"%s\" clashes with another.", text);
+		return -1;
+	}
+
+	if ((tree->nodes[node].text = strdup(text)) == NULL) {
+		return -1;
+	}
+
+	return 0;
+}
+
+static int huffman_text_append (Huffman *huffman, const char *text) {
+	unsigned int length = strlen(text);
+	char *grown;
+
+	if (length == 0) {
+		return 0;
+	}
+
+	if (huffman->text_length + length > huffman->text_size) {
+		huffman->text_size = (huffman->text_length + length) * 2;
+
+		if ((grown = (char *) realloc(huffman->text, huffman->text_size)) == NULL) {
+			slowlane_log(0, "Unable to grow Huffman text to %u bytes.", huffman->text_size);
+			return -1;
+		}
+
+		huffman->text = grown;
+	}
+
+	memcpy(huffman->text + huffman->text_length, text, length);
+	huffman->text_length += length;
+
+	return 0;
+}
+
+/* Work out every byte from every state. */
+static int huffman_compile (Huffman *huffman, HuffmanTree *tree) {
+	HuffmanEntry *entry;
+	int i, byte, bit, node;
+
+	for (i = 0, huffman->state_count = 0; i < tree->count; i++) {
+		if (tree->nodes[i].text == NULL) {
+			tree->nodes[i].state = huffman->state_count++;
+		}
+	}
+
+	if (huffman->state_count >= HUFFMAN_INVALID) {
+		slowlane_log(0, "Huffman dictionary has too many codes, %u states.", huffman->state_count);
+		return -1;
+	}
+
+	if ((huffman->table = (HuffmanEntry *) calloc(huffman->state_count * HUFFMAN_ENTRIES, sizeof(HuffmanEntry))) == NULL) {
+		slowlane_log(0, "Unable to allocate Huffman table for %u states.", huffman->state_count);
+		return -1;
+	}
+
+	for (i = 0; i < tree->count; i++) {
+		if (tree->nodes[i].text) {
+			continue;
+		}
+
+		for (byte = 0; byte < HUFFMAN_ENTRIES; byte++) {
+			entry = &huffman->table[(tree->nodes[i].state << HUFFMAN_BITS) | byte];
+			entry->text = huffman->text_length;
+
+			for (bit = HUFFMAN_BITS - 1, node = i; bit >= 0 && node >= 0; bit--) {
+				if ((node = tree->nodes[node].child[(byte >> bit) & 1]) < 0 || tree->nodes[node].text == NULL) {
+					continue;
+				}
+
+				/* The end of the string, whatever follows is padding. */
+				if (tree->nodes[node].text[0] == '\0') {
+					node = -1;
+				} else if (huffman_text_append(huffman, tree->nodes[node].text) < 0) {
+					return -1;
+				} else {
+					node = 0;
+				}
+			}
+
+			entry->length = huffman->text_length - entry->text;
+			entry->next = node < 0 ? HUFFMAN_INVALID : tree->nodes[node].state;
+		}
+	}
+
+	return 0;
+}
+
+/* Read and compile a dictionary. */
+int huffman_load (Huffman *huffman, const char *filename) {
+	HuffmanTree tree = { NULL, 0, 0 };
+	char line[1024], *bits, *end;
+	int retval = 0, codes = 0, i;
+	FILE *file;
+
+	memset(huffman, '\0', sizeof(Huffman));
+
+	if ((file = fopen(filename, "r")) == NULL) {
+		slowlane_log(0, "Unable to open Huffman dictionary %s.", filename);
+		return -1;
+	}
+
+	if (huffman_node_new(&tree) < 0) {
+		fclose(file);
+		return -1;
+	}
+
+	while (retval == 0 && fgets(line, sizeof(line), file) != NULL) {
+		line[strcspn(line, "\r\n")] = '\0';
+
+		if ((bits = strrchr(line, '=')) == NULL || bits[1] == '\0') {
+			continue;
+		}
+
+		*bits++ = '\0';
+
+		for (end = bits; *end == '0' || *end == '1'; end++);
+
+		if (*end != '\0') {
+			slowlane_log(1, "Huffman code for \"%s\" is not binary, skipping %s.", line, bits);
+			continue;
+		}
+
+		retval = huffman_tree_add(&tree, bits, line);
+		codes++;
+	}
+
+	fclose(file);
+
+	if (retval == 0) {
+		retval = huffman_compile(huffman, &tree);
+	}
+
+	for (i = 0; i < tree.count; i++) {
+		free(tree.nodes[i].text);
+	}
+
+	free(tree.nodes);
+
+	if (retval < 0) {
+		slowlane_log(0, "Unable to load Huffman dictionary %s.", filename);
+		huffman_free(huffman);
+		return -1;
+	}
+
+	slowlane_log(1, "Huffman dictionary %s has %i codes, compiled to %u states.", filename, codes, huffman->state_count);
+
+	return 0;
+}
+
+void huffman_free (Huffman *huffman) {
+	free(huffman->table);
+	free(huffman->text);
+	memset(huffman, '\0', sizeof(Huffman));
+}
+
+/* Decode data into out, stopping at the end of data, the first bits that
+ * aren't a code or when out is full. Returns the length of out, which is
+ * always terminated. Any partial code at the end is padding. */
+int huffman_decode (Huffman *huffman, const unsigned char *data, int data_length, char *out, int out_size) {
+	unsigned int state = 0;
+	int i, used = 0, length;
+	HuffmanEntry *entry;
+
+	for (i = 0; i < data_length; i++) {
+		entry = &huffman->table[(state << HUFFMAN_BITS) | data[i]];
+
+		if ((length = entry->length) > out_size - 1 - used) {
+			length = out_size - 1 - used;
+		}
+
+		memcpy(out + used, huffman->text + entry->text, length);
+		used += length;
+
+		if (entry->next == HUFFMAN_INVALID) {
+			break;
+		}
+
+		state = entry->next;
+	}
+
+	out[used] = '\0';
+
+	return used;
+}
@@ -0,0 +1,120 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * index.c - Sorted channel number index. The channels picked by the filter
+ * are ordered with a least significant digit radix sort over their user
+ * number, channel number and region, a byte at a time, which is linear in
+ * the number of channels. Region variants of a channel end up next to each
+ * other, so they're dropped as the sorted order is copied out.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slowlane.h"
+#include "data.h"
+#include "index.h"
+
+/* Bytes of the sort key, region lowest then channel number then user number. */
+#define INDEX_KEY_BYTES 5
+
+typedef struct tChannelKey {
+	unsigned long long key;
+	unsigned int	channel;
+} ChannelKey;
+
+/* Sort the channel pool indexes given into the index, which takes them over. */
+int channel_index_build (ChannelIndex *index, unsigned int *channels, unsigned int count) {
+	ChannelKey *keys, *sorted, *swap;
+	unsigned int counts[256], i, byte, total, bucket;
+	unsigned long long previous = ~0ULL;
+
+	memset(index, '\0', sizeof(ChannelIndex));
+	index->channels = channels;
+
+	if (count == 0) {
+		return 0;
+	}
+
+	if ((keys = (ChannelKey *) malloc(2 * count * sizeof(ChannelKey))) == NULL) {
+		slowlane_log(0, "Unable to allocate sort space for %u channels.", count);
+		return -1;
+	}
+
+	sorted = keys + count;
+
+	for (i = 0; i < count; i++) {
+		keys[i].key = channel_index_key(opentv_channel_at(channels[i]));
+		keys[i].channel = channels[i];
+	}
+
+	for (byte = 0; byte < INDEX_KEY_BYTES; byte++) {
+		memset(counts, '\0', sizeof(counts));
+
+		for (i = 0; i < count; i++) {
+			counts[(keys[i].key >> (byte * 8)) & 0xff]++;
+		}
+
+		/* Every key has the same byte here, so this pass would change nothing. */
+		if (counts[(keys[0].key >> (byte * 8)) & 0xff] == count) {
+			continue;
+		}
+
+		for (bucket = 0, total = 0; bucket < 256; bucket++) {
+			total += counts[bucket];
+			counts[bucket] = total - counts[bucket];
+		}
+
+		for (i = 0; i < count; i++) {
+			sorted[counts[(keys[i].key >> (byte * 8)) & 0xff]++] = keys[i];
+		}
+
+		swap = keys;
+		keys = sorted;
+		sorted = swap;
+	}
+
+	/* The same channel at the same number in another region is a variant, the lowest region is kept. */
+	for (i = 0; i < count; i++) {
+		if ((keys[i].key >> 8) == previous) {
+			index->duplicates++;
+			continue;
+		}
+
+		previous = keys[i].key >> 8;
+		channels[index->count++] = keys[i].channel;
+	}
+
+	free(keys < sorted ? keys : sorted);
+
+	return 0;
+}
+
+void channel_index_free (ChannelIndex *index) {
+	free(index->channels);
+	memset(index, '\0', sizeof(ChannelIndex));
+}
+
+/* Position of the first channel with a user number, -1 if there's none. */
+int channel_index_find (ChannelIndex *index, unsigned short user_number) {
+	unsigned int low = 0, high = index->count, middle;
+
+	while (low < high) {
+		middle = low + (high - low) / 2;
+
+		if (channel_index_at(index, middle)->user_number < user_number) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	if (low == index->count || channel_index_at(index, low)->user_number != user_number) {
+		return -1;
+	}
+
+	return low;
+}
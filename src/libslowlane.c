@@ -0,0 +1,192 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * libslowlane.c - Library interface. A context holds a model and everything
+ * needed to parse into it, so several scans can run in one process, and
+ * sections can be handed in by the caller rather than read from a feed.
+ * Each call selects the context's model on the calling thread for as long as
+ * it runs, as acquisitions and workers do for their own.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slowlane.h"
+#include "data.h"
+#include "si.h"
+#include "event.h"
+#include "text.h"
+#include "acquire.h"
+#include "index.h"
+#include "libslowlane.h"
+
+/* Log level, shared by every context in the process. */
+int verbose = 0;
+
+void slowlane_init (Slowlane *slowlane) {
+	memset(slowlane, '\0', sizeof(Slowlane));
+	data_model_init(&slowlane->model);
+
+	slowlane->options.crc_dvb = 1;
+	slowlane->options.crc_internal = 1;
+	slowlane->options.loop_time = 10;
+
+	/* The UTF-8 tables are built by the first context, the intern set is shared by all of them. */
+	text_init();
+}
+
+void slowlane_free (Slowlane *slowlane) {
+	channel_index_free(&slowlane->lineup);
+	data_model_free(&slowlane->model);
+	text_free();
+}
+
+/* Make the context's model the one the calling thread works on, so the model
+ * functions and list walks see it. Returns the model it replaces. */
+DataModel * slowlane_select (Slowlane *slowlane) {
+	DataModel *previous = data_model;
+
+	data_model = &slowlane->model;
+
+	return previous;
+}
+
+/* What to decode, see SI_DEMAND_*, and the only bouquet whose channels are
+ * wanted if bouquet_id is set. Everything by default. */
+void slowlane_set_demand (Slowlane *slowlane, unsigned int demand, unsigned short bouquet_id) {
+	slowlane->model.settings.demand = demand;
+	slowlane->model.settings.demand_bouquet_id = bouquet_id;
+}
+
+/* Only keep channels of these regions, every region if none are set. Those
+ * dropped can't be filtered for later, even from retained sections. */
+void slowlane_set_demand_regions (Slowlane *slowlane, RegionSet *regions) {
+	slowlane->model.settings.demand_regions = *regions;
+}
+
+/* Hold the context's models to the cap, which may be shared with other
+ * contexts. Once it's reached the scan fails, see pool_cap_charge. */
+void slowlane_set_memory_cap (Slowlane *slowlane, PoolCap *cap) {
+	ParseSettings settings = slowlane->model.settings;
+
+	settings.cap = cap;
+	data_model_settings(&slowlane->model, &settings);
+}
+
+/* Keep the NIT, SDT and BAT sections accepted, names then point into them. */
+void slowlane_set_retain (Slowlane *slowlane, int retain) {
+	slowlane->model.settings.retain = retain;
+}
+
+/* Decode OpenTV titles and summaries with the dictionary, which must outlive the context. */
+void slowlane_set_opentv_dictionary (Slowlane *slowlane, Huffman *dictionary) {
+	slowlane->model.settings.opentv_dictionary = dictionary;
+}
+
+/* Be told of each section accepted, from the thread which parsed it. With
+ * workers that's several threads at once. */
+void slowlane_set_section_callback (Slowlane *slowlane, SectionCallback callback, void *user) {
+	slowlane->model.settings.section_callback = callback;
+	slowlane->model.settings.section_user = user;
+}
+
+/* Parse the section at the start of buffer, returns as si_process does. */
+int slowlane_process (Slowlane *slowlane, unsigned char *buffer, int buffer_length) {
+	DataModel *previous = slowlane_select(slowlane);
+	int retval;
+
+	retval = si_process(buffer, buffer_length, slowlane->options.crc_internal);
+	data_model = previous;
+
+	return retval;
+}
+
+/* Scan every feed at once and merge them into the context, the same
+ * transport on another satellite kept apart. The acquisitions must have been
+ * set up with the context's options. */
+int slowlane_acquire (Slowlane *slowlane, Acquisition *acquisitions, int acquisition_count) {
+	DataModel *previous = slowlane_select(slowlane);
+	EventStore *events;
+	int i, failed = 0;
+
+	for (i = 0; i < acquisition_count; i++) {
+		acquire_start(&acquisitions[i]);
+	}
+
+	for (i = 0; i < acquisition_count; i++) {
+		if (acquire_wait(&acquisitions[i]) < 0) {
+			failed++;
+		}
+	}
+
+	if (failed) {
+		slowlane_log(0, "%i of %i feeds failed.", failed, acquisition_count);
+	} else {
+		/* Merging copies into the context's pools, which may take it past its cap too. */
+		for (i = 0; i < acquisition_count; i++) {
+			data_model_merge(&acquisitions[i].model, 1);
+		}
+
+		/* OpenTV events are by channel, the bouquets say which service that is. */
+		if (slowlane->options.opentv && (events = event_store(data_model, 0)) != NULL) {
+			event_store_link_opentv(events);
+		}
+
+		if ((failed = pool_cap_exceeded(data_model->settings.cap))) {
+			slowlane_log(0, "Scan incomplete at the memory cap of %lu KiB.", (unsigned long) (data_model->settings.cap->limit >> 10));
+		}
+	}
+
+	for (i = 0; i < acquisition_count; i++) {
+		data_model_free(&acquisitions[i].model);
+	}
+
+	data_model = previous;
+
+	return failed ? -1 : 0;
+}
+
+/* Build the lineup from the bouquet, regions and user numbers in the context's options. */
+int slowlane_filter (Slowlane *slowlane, int filter_dvbs, int filter_hd) {
+	AcquireOptions *options = &slowlane->options;
+	DataModel *previous = slowlane_select(slowlane);
+	int retval;
+
+	channel_index_free(&slowlane->lineup);
+
+	/* Channels skipped on the way in can still be had from retained sections. */
+	si_load_bouquets(options->filter_bouquet_id);
+
+	retval = filter_data(&slowlane->lineup, options->filter_bouquet_id, &options->filter_regions, filter_dvbs, filter_hd, options->filter_user_number);
+	data_model = previous;
+
+	return retval;
+}
+
+/* Hand each lineup channel to callback in order, with the context selected. */
+void slowlane_channels (Slowlane *slowlane, ChannelCallback callback, void *user) {
+	DataModel *previous = slowlane_select(slowlane);
+	char name[TEXT_MAX], alt_name[TEXT_MAX], provider[TEXT_MAX];
+	SlowlaneChannel channel;
+	ServiceNames *names;
+	unsigned int i;
+
+	for (i = 0; i < slowlane->lineup.count; i++) {
+		channel.channel = channel_index_at(&slowlane->lineup, i);
+		channel.service = service_at(channel.channel->service);
+		channel.tuning = transport_tuning(transport_at(channel.channel->transport));
+		channel.bouquet_id = bouquet_at(channel.channel->bouquet)->bouquet_id;
+
+		names = service_names(channel.service);
+		channel.name = text_view_string(names->name, name, sizeof(name));
+		channel.alt_name = text_view_string(names->alt_name, alt_name, sizeof(alt_name));
+		channel.provider = text_view_string(names->provider, provider, sizeof(provider));
+
+		callback(user, &channel);
+	}
+
+	data_model = previous;
+}
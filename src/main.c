@@ -12,59 +12,107 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <sys/resource.h>
 #include "slowlane.h"
-#include "dvb.h"
-#include "si.h"
+#include "acquire.h"
 #include "data.h"
+#include "event.h"
+#include "huffman.h"
+#include "si.h"
+#include "text.h"
+#include "index.h"
+#include "xmltv.h"
+#include "history.h"
+#include "snapshot.h"
+#include "batch.h"
+#include "export.h"
+#include "names.h"
+#include "libslowlane.h"
 
 /* Local definitions. */
 void usage (void);
-
-/* Global variables */
-int verbose = 0;
+Acquisition * add_acquisition (Acquisition *acquisitions, int *acquisition_count, int source, AcquireOptions *options);
+long peak_rss (void);
 
 /* Program start. */
 int main (int argc, char *argv[]) {
-	int crc_dvb = 1, crc_internal = 1, dvb_adapter = 0, dvb_demux = 0, dvb_loop = 1, loop_time = 10;
-	int ch, dvb_demux_fd, dvb_bytes, retval, dvb_data_length = 0, processed_bytes = 0, done = 0, show_bouquet_list = 0, show_sdt_list = 0, show_filtered_list = 0;
-	int filter_bouquet_id = 0, dvbs = 1, hd = 0, filter_user_number = 0;
-        unsigned char filter_region_count = 0;
-        unsigned char filter_region[10];
-	time_t dvb_loop_start;
-	char dvb_buffer[DVB_BUFFER_SIZE];
-	char *dvb_data = NULL, *dvb_temp = NULL;
+	int ch, i, show_bouquet_list = 0, show_sdt_list = 0, show_filtered_list = 0, show_memory_report = 0;
+	int snapshot_user_number = -1, batch_jobs = 0, batch_failed, dvbs = 1, hd = 0, ts_dvr = 0, acquisition_count = 0, show_event_list = 0, event_hours = 0, output_format = EXPORT_CSV, region;
+	unsigned int event_from, event_to, j, k, text_count, demand;
+	unsigned long text_lookups;
+	size_t text_bytes;
+	char *capture_out = NULL, *xmltv_file = NULL, *history_file = NULL, *history_at = NULL, *history_from = NULL, *snapshot_file = NULL, *batch_list = NULL, *batch_dir = ".", event_time[32], name[TEXT_MAX], alt_name[TEXT_MAX], provider[TEXT_MAX];
+	time_t event_start;
+	struct tm event_tm;
+	struct timespec parse_start, parse_end;
+	PoolCap memory_cap = { 0, 0, 0, 0 };
+	Slowlane slowlane;
+	AcquireOptions *options = &slowlane.options;
+	Huffman opentv_dictionary;
+	Acquisition acquisitions[ACQUIRE_MAX], *acquisition = NULL;
 	Network *network;
 	Transport *transport;
+	TransportTuning *tuning;
 	Bouquet *bouquet;
 	Service *service;
+	ServiceNames *names;
 	OpenTVChannel *channel;
+	EventStore *events;
+	Exporter exporter;
+	Xmltv xmltv;
+	Batch batch;
+	HistorySnapshot history_to, history_base;
+	HistoryFilter history_filter = { 0, NULL };
+	unsigned long long history_to_time, history_from_time;
+	EventService *event_service;
+	Event *event;
+	Snapshot snapshot;
+	const SnapshotChannel *snapshot_channel;
+	const SnapshotService *snapshot_service_ptr;
+
+	/* Everything is parsed into the one context. */
+	slowlane_init(&slowlane);
 
 	/* Process command line options. */
-	while ((ch = getopt(argc, argv, "c:C:a:d:l:ib:BSFhvr:s:HU:")) != -1) {
+	while ((ch = getopt(argc, argv, "c:C:a:d:D:l:ib:BSFMm:hvr:s:HU:j:f:w:t:TEe:o:RO:X:Y:Q:G:k:N:q:L:J:W:zy:")) != -1) {
 		switch (ch) {
 			case 'c':
-				crc_dvb = atoi(optarg);
-				slowlane_log(3, "crc_dvb set to %i.", crc_dvb);
+				options->crc_dvb = atoi(optarg);
+				slowlane_log(3, "crc_dvb set to %i.", options->crc_dvb);
 				break;
 			
-				crc_internal = atoi(optarg);
-				slowlane_log(3, "crc_internal set to %i.", crc_internal);
+				options->crc_internal = atoi(optarg);
+				slowlane_log(3, "crc_internal set to %i.", options->crc_internal);
 				break;
 			case 'a':
-				dvb_adapter = atoi(optarg);
-				slowlane_log(3, "dvb_adapter set to %i.", dvb_adapter);
+				/* Each adapter is a feed of its own. */
+				if ((acquisition = add_acquisition(acquisitions, &acquisition_count, ACQUIRE_DEMUX, options)) == NULL) {
+					return EXIT_FAILURE;
+				}
+
+				acquisition->dvb_adapter = atoi(optarg);
+				slowlane_log(3, "dvb_adapter set to %i.", acquisition->dvb_adapter);
 				break;
 			case 'd':
-				dvb_demux = atoi(optarg);
-				slowlane_log(3, "dvb_demux set to %i.", dvb_demux);
+				/* Applies to the adapter before it, or adapter 0 if there isn't one. */
+				if (acquisition == NULL && (acquisition = add_acquisition(acquisitions, &acquisition_count, ACQUIRE_DEMUX, options)) == NULL) {
+					return EXIT_FAILURE;
+				}
+
+				acquisition->dvb_demux = atoi(optarg);
+				slowlane_log(3, "dvb_demux set to %i.", acquisition->dvb_demux);
+				break;
+			case 'D':
+				options->buffer_size = strtoul(optarg, NULL, 10);
+				slowlane_log(3, "dvb_buffer_size set to %lu.", options->buffer_size);
 				break;
 			case 'v':
 				verbose++;
 				slowlane_log(0, "verbose set to %i.", verbose);
 				break;
 			case 'l':
-                                loop_time = atoi(optarg);
-                                slowlane_log(3, "loop_time set to %i.", loop_time);
+                                options->loop_time = atoi(optarg);
+                                slowlane_log(3, "loop_time set to %i.", options->loop_time);
                                 break;
 			case 'B':
 				show_bouquet_list = 1;
@@ -75,18 +123,21 @@ int main (int argc, char *argv[]) {
 				slowlane_log(3, "show_sdt_list set to %i.", show_sdt_list);
 				break;
 			case 'b':
-				filter_bouquet_id = atoi(optarg);
-				slowlane_log(3, "filter_bouquet_id to %i.", filter_bouquet_id);
+				if ((options->filter_bouquet_id = names_bouquet_id(optarg)) < 0) {
+					slowlane_log(0, "Unknown bouquet %s, see BOUQUETS.", optarg);
+					return EXIT_FAILURE;
+				}
+
+				slowlane_log(3, "filter_bouquet_id to %i.", options->filter_bouquet_id);
 				break;
 			case 'r':
-				if (filter_region_count == 10) {
-					slowlane_log(1, "filter_region table is full at %i.", filter_region_count);
-				} else {
-					filter_region[filter_region_count] = atoi(optarg);
-					slowlane_log(1, "filter_region table added %i to pos %i.", filter_region[filter_region_count], filter_region_count);
-					filter_region_count++;
+				if ((region = names_region_id(optarg)) < 0) {
+					slowlane_log(0, "Unknown region %s, see REGIONS.", optarg);
+					return EXIT_FAILURE;
 				}
-				
+
+				region_set_add(&options->filter_regions, region);
+				slowlane_log(1, "filter_regions added %i, now %u regions.", region, options->filter_regions.count);
 				break;
 			case 's':
 				dvbs = atoi(optarg);
@@ -100,9 +151,126 @@ int main (int argc, char *argv[]) {
 				show_filtered_list = 1;
 				slowlane_log(3, "show_filtered_list set to %i.", show_filtered_list);
 				break;
+			case 'm':
+				memory_cap.limit = (size_t) atol(optarg) << 20;
+				slowlane_set_memory_cap(&slowlane, &memory_cap);
+				slowlane_log(3, "memory cap set to %lu KiB.", (unsigned long) (memory_cap.limit >> 10));
+				break;
+			case 'M':
+				show_memory_report = 1;
+				slowlane_log(3, "show_memory_report set to %i.", show_memory_report);
+				break;
 			case 'U':
-				filter_user_number = atoi(optarg);
-				slowlane_log(1, "Filtering user numbers above %i.", filter_user_number);
+				options->filter_user_number = atoi(optarg);
+				slowlane_log(1, "Filtering user numbers above %i.", options->filter_user_number);
+				break;
+			case 'j':
+				options->workers = atoi(optarg);
+				slowlane_log(3, "workers set to %i.", options->workers);
+				break;
+			case 'f':
+				if ((acquisition = add_acquisition(acquisitions, &acquisition_count, ACQUIRE_CAPTURE, options)) == NULL) {
+					return EXIT_FAILURE;
+				}
+
+				acquisition->filename = optarg;
+				slowlane_log(3, "capture_in set to %s.", acquisition->filename);
+				break;
+			case 'w':
+				capture_out = optarg;
+				slowlane_log(3, "capture_out set to %s.", capture_out);
+				break;
+			case 'z':
+				options->carousel = 1;
+				slowlane_log(3, "capture carousel set to %i.", 1);
+				break;
+			case 'y':
+				options->replay_speed = atoi(optarg);
+				slowlane_log(3, "replay_speed set to %i.", options->replay_speed);
+				break;
+			case 't':
+				if ((acquisition = add_acquisition(acquisitions, &acquisition_count, ACQUIRE_TS, options)) == NULL) {
+					return EXIT_FAILURE;
+				}
+
+				acquisition->filename = optarg;
+				slowlane_log(3, "ts_in set to %s.", acquisition->filename);
+				break;
+			case 'T':
+				ts_dvr = 1;
+				slowlane_log(3, "ts_dvr set to %i.", ts_dvr);
+				break;
+			case 'E':
+				options->eit = 1;
+				slowlane_log(3, "eit set to %i.", options->eit);
+				break;
+			case 'e':
+				options->eit = 1;
+				show_event_list = 1;
+				event_hours = atoi(optarg);
+				slowlane_log(3, "show_event_list set for %i hours.", event_hours);
+				break;
+			case 'o':
+				/* OpenTV titles and summaries can't be read without the provider's dictionary. */
+				if (huffman_load(&opentv_dictionary, optarg) < 0) {
+					return EXIT_FAILURE;
+				}
+
+				slowlane_set_opentv_dictionary(&slowlane, &opentv_dictionary);
+				options->opentv = 1;
+				slowlane_log(3, "opentv set to %i.", options->opentv);
+				break;
+			case 'O':
+				if ((output_format = export_format(optarg)) < 0) {
+					slowlane_log(0, "Unknown output format %s.", optarg);
+					return EXIT_FAILURE;
+				}
+
+				slowlane_log(3, "output_format set to %i.", output_format);
+				break;
+			case 'R':
+				slowlane_set_retain(&slowlane, 1);
+				slowlane_log(3, "section retain set to %i.", 1);
+				break;
+			case 'X':
+				xmltv_file = optarg;
+				slowlane_log(3, "xmltv_file set to %s.", xmltv_file);
+				break;
+			case 'Y':
+				history_file = optarg;
+				slowlane_log(3, "history_file set to %s.", history_file);
+				break;
+			case 'Q':
+				history_at = optarg;
+				slowlane_log(3, "history_at set to %s.", history_at);
+				break;
+			case 'G':
+				history_from = optarg;
+				slowlane_log(3, "history_from set to %s.", history_from);
+				break;
+			case 'k':
+				history_filter.user_number = atoi(optarg);
+				slowlane_log(3, "history user_number set to %i.", history_filter.user_number);
+				break;
+			case 'N':
+				snapshot_file = optarg;
+				slowlane_log(3, "snapshot_file set to %s.", snapshot_file);
+				break;
+			case 'q':
+				snapshot_user_number = atoi(optarg);
+				slowlane_log(3, "snapshot_user_number set to %i.", snapshot_user_number);
+				break;
+			case 'L':
+				batch_list = optarg;
+				slowlane_log(3, "batch_list set to %s.", batch_list);
+				break;
+			case 'J':
+				batch_jobs = atoi(optarg);
+				slowlane_log(3, "batch_jobs set to %i.", batch_jobs);
+				break;
+			case 'W':
+				batch_dir = optarg;
+				slowlane_log(3, "batch_dir set to %s.", batch_dir);
 				break;
 			case 'h':
 			default:
@@ -112,209 +280,348 @@ int main (int argc, char *argv[]) {
 		}
 	}
 
-	/* Fetch fd for DVB card. */
-	if ((dvb_demux_fd = dvb_open(dvb_adapter, dvb_demux)) < 1) {
-		slowlane_log(0, "dvb_open failed and returned %i.", dvb_demux_fd);
-		return EXIT_FAILURE;
-	}
+	/* Questions of the history are answered from it alone, without a scan. */
+	if (history_at || history_from) {
+		if (history_file == NULL) {
+			slowlane_log(0, "A history query needs the history file given by %s.", "-Y");
+			return EXIT_FAILURE;
+		}
 
-	/* Set filter for NIT. */
-	if ((retval = dvb_set_filter(dvb_demux_fd, 0x0010, 0x40, 0xf0, crc_dvb)) < 0) {
-		slowlane_log(0, "NIT dvb_set_filter failed and returned %i.", retval);
-		return EXIT_FAILURE;
-	}
+		if (history_time(history_at ? history_at : "now", &history_to_time) < 0 || (history_from && history_time(history_from, &history_from_time) < 0)) {
+			slowlane_log(0, "Unable to understand the time %s.", history_at ? history_at : history_from);
+			return EXIT_FAILURE;
+		}
 
-	/* Record when we start this loop.*/
-	dvb_loop_start = time(NULL);
+		history_filter.regions = &options->filter_regions;
 
-	/* Loop obtaining packets until we have enough. */
-	while (dvb_loop) {
-		/* Read DVB card. */
-		if ((dvb_bytes = dvb_read(dvb_demux_fd, dvb_buffer, DVB_BUFFER_SIZE)) <= 0) {
-			slowlane_log(0, "dvb_read failed and returned %i.", dvb_bytes);
-			dvb_close(dvb_demux_fd);
+		if (history_read(history_file, history_to_time, &history_to) < 0) {
 			return EXIT_FAILURE;
 		}
 
-		/* Copy data into dvb_data. */
-		if (dvb_data == NULL) {
-			slowlane_log(3, "dvb_read read in %i, mallocing memory.", dvb_bytes);
-			dvb_data_length = dvb_bytes;
-			dvb_data = (char *) malloc (dvb_data_length);
-			memcpy(dvb_data, dvb_buffer, dvb_data_length);		
+		if (history_from) {
+			if (history_read(history_file, history_from_time, &history_base) < 0) {
+				return EXIT_FAILURE;
+			}
+
+			history_diff(stdout, &history_base, &history_to, &history_filter);
+			history_snapshot_free(&history_base);
 		} else {
-			slowlane_log(3, "dvb_read read in %i, already %i here, reallocing memory.", dvb_bytes, dvb_data_length);
-			dvb_data = (char *) realloc (dvb_data, dvb_data_length + dvb_bytes);
-			memcpy(dvb_data + dvb_data_length, dvb_buffer, dvb_bytes);
-                        dvb_data_length += dvb_bytes;
+			history_print(stdout, &history_to, &history_filter);
 		}
 
-		/* Loop while processing function is reporting success, this is needed for some dvb cards or sasc-ng virtual cards which
-		 * don't obey the one packet per read rule. */
-		do {
-			/* Process SI received. */
-			if ((processed_bytes = si_process((unsigned char *)dvb_data, dvb_data_length, crc_internal)) < 0) {
-				slowlane_log(0, "si_process failed and returned %i.", processed_bytes);
-
-				/* Dump data and flush buffer. */
-				free(dvb_data);
-				dvb_data = NULL;
-				dvb_data_length = 0;
-			} else {
-				if (processed_bytes > 0) {
-					if (processed_bytes == dvb_data_length) {
-						slowlane_log(3, "si_process processed whole data of size %i.", processed_bytes);
-						dvb_data_length = 0;
-						free(dvb_data);
-						dvb_data = NULL;
-					} else {
-						slowlane_log(3, "si_process processed less then whole data of size %i out of %i.", processed_bytes, dvb_data_length);
-						dvb_temp = (char *) malloc (dvb_data_length - processed_bytes);
-						memcpy(dvb_temp, dvb_data + processed_bytes, dvb_data_length - processed_bytes);
-						free(dvb_data);
-						dvb_data = dvb_temp;
-						dvb_data_length -= processed_bytes;
-					}
-				}
-			}
-		} while (processed_bytes < dvb_data_length && processed_bytes > 0);
-
-		if (dvb_loop == 1) {
-			/* Verify if timeout has expired. */
-			if (time(NULL) > dvb_loop_start + loop_time) {
-				/* Verify if all present networks are complete. */
-				done = 1;
-
-				for (network = network_list; network != NULL; network = network->next) {
-					if (!section_tracking_check(&network->sections)) {
-						done = 0;
-					}
-				}
+		history_snapshot_free(&history_to);
 
-				if (done) {
-					/* Inform the user. */
-					slowlane_log(2, "NIT tables complete (%i), moving to BAT and DST tables.", dvb_loop);
+		return EXIT_SUCCESS;
+	}
 
-					/* Set filter for BAT and SDT. */
-					if ((retval = dvb_set_filter(dvb_demux_fd, 0x0011, 0x40, 0xf0, crc_dvb)) < 0) {
-						slowlane_log(0, "BAT/DST dvb_set_filter failed and returned %i.", retval);
-						return EXIT_FAILURE;
-					}
+	/* As is a channel in the last snapshot, straight from the mapped file. */
+	if (snapshot_user_number >= 0) {
+		if (snapshot_file == NULL) {
+			slowlane_log(0, "A snapshot query needs the snapshot file given by %s.", "-N");
+			return EXIT_FAILURE;
+		}
 
-					/* Essentially starting the loop again. */
-				        dvb_loop_start = time(NULL);
-					dvb_loop = 2;
-				}
-			}
-		} else {
-			/* Verify if timeout has expired. */
-			if (time(NULL) > dvb_loop_start + loop_time) {
-				/* Verify if all present networks are complete. */
-				done = 1;
-
-				for (network = network_list; network != NULL; network = network->next) {
-					for (transport = network->transports; transport != NULL; transport = transport->next) {
-						if (transport->sections.populated == 0 || !section_tracking_check(&transport->sections)) {
-							done = 0;
-						}
-					}
-				}
+		if (snapshot_open(&snapshot, snapshot_file) < 0) {
+			return EXIT_FAILURE;
+		}
 
-				for (bouquet = bouquet_list; bouquet != NULL; bouquet = bouquet->next) {
-					if (!section_tracking_check(&bouquet->sections)) {
-						done = 0;
-					}
-				}
+		/* Region variants of a number are next to each other in the lineup. */
+		for (i = snapshot_find(&snapshot, snapshot_user_number); i >= 0 && i < (int) snapshot_count(&snapshot, SNAPSHOT_LINEUP) && snapshot.lineup[i].user_number == snapshot_user_number; i++) {
+			snapshot_channel = &snapshot.lineup[i];
+			snapshot_service_ptr = snapshot_channel->service < snapshot_count(&snapshot, SNAPSHOT_SERVICES) ? &snapshot.services[snapshot_channel->service] : NULL;
+			printf("O (%i:%i) %i %s (%s)\n", snapshot_channel->transport_id, snapshot_channel->service_id, snapshot_channel->user_number, snapshot_service_ptr ? snapshot_string(&snapshot, snapshot_service_ptr->name) : "", snapshot_service_ptr ? snapshot_string(&snapshot, snapshot_service_ptr->alt_name) : "");
+		}
 
-				if (done) {
-					/* Inform the user. */
-					slowlane_log(2, "BAT and DST tables complete (%i).", dvb_loop);
+		snapshot_close(&snapshot);
 
-					dvb_loop = 0;
-					break;
-				}
+		return EXIT_SUCCESS;
+	}
+
+	/* Adapter 0 if nothing else was given. */
+	if (acquisition_count == 0) {
+		add_acquisition(acquisitions, &acquisition_count, ACQUIRE_DEMUX, options);
+	}
+
+	for (i = 0; i < acquisition_count; i++) {
+		/* Read the whole transport stream through the dvr rather than the demux's sections. */
+		if (ts_dvr && acquisitions[i].source == ACQUIRE_DEMUX) {
+			acquisitions[i].source = ACQUIRE_DVR;
+		}
+
+		/* Each feed records to a capture of its own, the first to the name given. */
+		if (capture_out) {
+			if (i == 0) {
+				acquisitions[i].capture_out = capture_out;
+			} else if ((acquisitions[i].capture_out = (char *) malloc(strlen(capture_out) + 4)) != NULL) {
+				sprintf(acquisitions[i].capture_out, "%s.%i", capture_out, i);
 			}
 		}
 	}
 
-	/* Close fd now we're done. */
-	dvb_close(dvb_demux_fd);
+	/* Only decode what's going to be shown, the channel list unless something else was asked for. */
+	if (show_memory_report) {
+		demand = SI_DEMAND_ALL;
+	} else if (show_bouquet_list || show_sdt_list || show_event_list) {
+		demand = SI_DEMAND_EVENTS;
+		demand |= show_bouquet_list ? SI_DEMAND_BOUQUET_NAMES : 0;
+		demand |= show_sdt_list ? SI_DEMAND_NETWORK_NAMES | SI_DEMAND_SERVICE_NAMES | SI_DEMAND_TUNING : 0;
+	} else {
+		demand = SI_DEMAND_EVENTS | SI_DEMAND_SERVICE_NAMES | SI_DEMAND_TUNING | SI_DEMAND_CHANNELS;
+	}
+
+	/* OpenTV events are linked to their services through every bouquet's channels. */
+	if (options->opentv) {
+		demand |= SI_DEMAND_CHANNELS;
+		slowlane_set_demand(&slowlane, verbose > 2 ? demand | SI_DEMAND_OTHER : demand, 0);
+	} else {
+		slowlane_set_demand(&slowlane, verbose > 2 ? demand | SI_DEMAND_OTHER : demand, options->filter_bouquet_id);
+		slowlane_set_demand_regions(&slowlane, &options->filter_regions);
+	}
+
+	/* With only a bouquet's lineup to show, the scan can stop once everything it uses is in. */
+	options->lineup = options->filter_bouquet_id && !show_memory_report && !show_bouquet_list && !show_sdt_list && !options->eit && !options->opentv;
+
+	/* A batch scans each capture on its own, several at once, rather than as feeds of one scan. */
+	if (batch_list) {
+		batch_init(&batch, options);
+		batch.demand = slowlane.model.settings.demand;
+		batch.retain = slowlane.model.settings.retain;
+		batch.filter_dvbs = dvbs;
+		batch.filter_hd = hd;
+		batch.output_dir = batch_dir;
+		batch.output_format = output_format;
+		batch.jobs = batch_jobs > 0 ? batch_jobs : batch.jobs;
+		batch.memory_cap = memory_cap.limit;
+
+		if (batch_add(&batch, batch_list) < 0 || batch.count == 0) {
+			slowlane_log(0, "No captures to scan in %s.", batch_list);
+			return EXIT_FAILURE;
+		}
+
+		batch_failed = batch_run(&batch);
+		batch_report(&batch, stdout);
+		batch_free(&batch);
+
+		return batch_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	/* Scan every feed at once, the slowest decides how long we take. */
+	clock_gettime(CLOCK_MONOTONIC, &parse_start);
+
+	if (slowlane_acquire(&slowlane, acquisitions, acquisition_count) < 0) {
+		return EXIT_FAILURE;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &parse_end);
+	slowlane_log(1, "Acquisition and parsing took %li ms.", (parse_end.tv_sec - parse_start.tv_sec) * 1000 + (parse_end.tv_nsec - parse_start.tv_nsec) / 1000000);
+
+	/* Parsing is when the most is held, with a cap it's always reported. */
+	if (memory_cap.limit) {
+		slowlane_log(0, "Peak RSS %li KiB, models peaked at %lu KiB of a %lu KiB cap.", peak_rss(), (unsigned long) (memory_cap.peak >> 10), (unsigned long) (memory_cap.limit >> 10));
+	} else {
+		slowlane_log(1, "Peak RSS %li KiB.", peak_rss());
+	}
+
+	text_intern_stats(&text_count, &text_bytes, &text_lookups);
+	slowlane_log(1, "Interned %lu names as %u strings in %lu bytes.", text_lookups, text_count, (unsigned long) text_bytes);
+
+	/* The lists below walk the context's model. */
+	slowlane_select(&slowlane);
+
+	/* Lists go out together once they're all built. */
+	export_init(&exporter, output_format, 1);
+
+	/* Print Memory Report if requested. */
+	if (show_memory_report) {
+		data_memory_report();
+	}
 
 	/* Print Bouquet List if requested. */
 	if (show_bouquet_list) {
-		printf("# Bouquet List\n");
-		for (bouquet = bouquet_list; bouquet != NULL; bouquet = bouquet->next) {
-			printf("%i,%s\n", bouquet->bouquet_id, bouquet->name);
+		if (output_format == EXPORT_CSV) {
+			export_raw(&exporter, "# Bouquet List\n");
+		}
+
+		for (bouquet = bouquet_at(data_model->bouquet_list); bouquet != NULL; bouquet = bouquet_at(bouquet->next)) {
+			export_bouquet(&exporter, bouquet);
 		}
 	}
 
 	/* Print Network, Transponder and Service List if requested. */
-	if (show_sdt_list) {
+	if (show_sdt_list && output_format != EXPORT_CSV) {
+		for (network = network_at(data_model->network_list); network != NULL; network = network_at(network->next)) {
+			export_network(&exporter, network);
+			for (transport = transport_at(network->transports); transport != NULL; transport = transport_at(transport->next)) {
+				export_transport(&exporter, transport);
+				for (service = service_at(transport->services); service != NULL; service = service_at(service->next)) {
+					export_service(&exporter, transport, service);
+				}
+			}
+		}
+	} else if (show_sdt_list) {
+		/* The readable layout, after anything already built. */
+		export_flush(&exporter);
+
 		printf("# Satellite Network, Transponder and Service List.\n");
-		for (network = network_list; network != NULL; network = network->next) {
-			printf("N %i - %s\n", network->network_id, network->name);
-			for (transport = network->transports; transport != NULL; transport = transport->next) {
-				printf("T %i - ON: %i ModSys: %i Freq: %i Sym: %i Pol: %i ModType: %i FEC: %i RollOff: %i Orb: %i West: %i\n", transport->transport_id, transport->original_network_id, transport->modulation_system, transport->frequency, transport->symbol_rate, transport->polarization, transport->modulation_type, transport->fec, transport->roll_off, transport->orbital_position, transport->west_east_flag);
-				for (service = transport->services; service != NULL; service = service->next) {
-					printf("S %i - Running: %i FreeCA: %i Type: %i Name: %s AltName: %s Provider: %s\n", service->service_id, service->running, service->free_ca, service->type, service->name, service->alt_name, service->provider);
+		for (network = network_at(data_model->network_list); network != NULL; network = network_at(network->next)) {
+			printf("N %i - %s\n", network->network_id, text_view_string(network->name, name, sizeof(name)));
+			for (transport = transport_at(network->transports); transport != NULL; transport = transport_at(transport->next)) {
+				tuning = transport_tuning(transport);
+				printf("T %i - ON: %i ModSys: %i Freq: %i Sym: %i Pol: %i ModType: %i FEC: %i RollOff: %i Orb: %i West: %i\n", transport->transport_id, transport->original_network_id, tuning->modulation_system, tuning->frequency, tuning->symbol_rate, tuning->polarization, tuning->modulation_type, tuning->fec, tuning->roll_off, tuning->orbital_position, tuning->west_east_flag);
+				for (service = service_at(transport->services); service != NULL; service = service_at(service->next)) {
+					names = service_names(service);
+					printf("S %i - Running: %i FreeCA: %i Type: %i Name: %s AltName: %s Provider: %s\n", service->service_id, service->running, service->free_ca, service->type, text_view_string(names->name, name, sizeof(name)), text_view_string(names->alt_name, alt_name, sizeof(alt_name)), text_view_string(names->provider, provider, sizeof(provider)));
 				}
 			}
 		}
 	}
 
+	/* Print Events if requested, those running from now for the hours asked or all of them. */
+	if (show_event_list && (events = event_store(data_model, 0)) != NULL) {
+		export_flush(&exporter);
+
+		printf("# Event List\n");
+		event_from = event_hours ? (unsigned int) time(NULL) : 0;
+		event_to = event_hours ? event_from + event_hours * 3600 : 0xffffffff;
+
+		for (j = 1; j < events->services.count; j++) {
+			event_service = event_service_at(events, j);
+
+			for (k = event_find(event_service, event_from); k < event_service->event_count && event_service->events[k].start < event_to; k++) {
+				event = &event_service->events[k];
+				event_start = event->start;
+				gmtime_r(&event_start, &event_tm);
+				strftime(event_time, sizeof(event_time), "%Y-%m-%d %H:%M:%S", &event_tm);
+				printf("E (%i:%i:%i) %i %s %u %s (%s)\n", event_service->original_network_id, event_service->transport_id, event_service->service_id, event->event_id, event_time, event->duration, event->title, event->text);
+			}
+		}
+	}
+
 	/* If we did either of the above, abort. */
-	if (show_bouquet_list || show_sdt_list) {
-		return EXIT_SUCCESS;
+	if (show_bouquet_list || show_sdt_list || show_memory_report || show_event_list) {
+		return export_flush(&exporter) < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 	}
 
-	/* Process BAT/SMT data to form channnel list. */
-	bouquet = filter_data (filter_bouquet_id, filter_region_count, filter_region, dvbs, hd, filter_user_number);
+	/* Process BAT/SMT data to form channnel list, ordered by channel number. */
+	if (slowlane_filter(&slowlane, dvbs, hd) < 0) {
+		return EXIT_FAILURE;
+	}
+
+	/* Keep the lineup as it stands now, as the changes since the last one. */
+	if (history_file && history_append(history_file, time(NULL), &slowlane.lineup) < 0) {
+		return EXIT_FAILURE;
+	}
+
+	/* Replace the snapshot others map the lineup from. */
+	if (snapshot_file && snapshot_write(snapshot_file, time(NULL), &slowlane.lineup, options->filter_bouquet_id, &options->filter_regions, options->filter_user_number) < 0) {
+		return EXIT_FAILURE;
+	}
 
 	/* Exit if we're displaying the list. */
-	if (show_filtered_list) {
+	if (show_filtered_list && output_format == EXPORT_CSV) {
 		/* Cycle through channels. */
-		for (channel = bouquet->channels; channel != NULL; channel = channel->next) {
-			printf("O (%i:%i) %i %s (%s)\n", channel->transport->transport_id, channel->service->service_id, channel->user_number, channel->service->name, channel->service->alt_name);
+		for (j = 0; j < slowlane.lineup.count; j++) {
+			channel = channel_index_at(&slowlane.lineup, j);
+			names = service_names(service_at(channel->service));
+			printf("O (%i:%i) %i %s (%s)\n", channel->transport_id, channel->service_id, channel->user_number, text_view_string(names->name, name, sizeof(name)), text_view_string(names->alt_name, alt_name, sizeof(alt_name)));
 		}
 
 		return EXIT_SUCCESS;
 	}
 
+	/* Callsigns, icons and xmltvids are joined on from an XMLTV file. */
+	if (xmltv_file && xmltv_load(&xmltv, xmltv_file) < 0) {
+		return EXIT_FAILURE;
+	}
+
 	/* XXX - Update MySQL database with it. */
-	for (channel = bouquet->channels; channel != NULL; channel = channel->next) {
-		printf("%i,%i,%i,%i,%i,%i,%i,%i,%i,%s\n", 
-				channel->transport->transport_id,
-				channel->transport->original_network_id,
-				channel->transport->frequency,
-				channel->transport->symbol_rate,
-				channel->transport->polarization,
-				channel->transport->modulation_system,
-				channel->transport->roll_off,
-				channel->service->service_id,
-				channel->user_number,
-				channel->service->name
-		 );
+	for (j = 0; j < slowlane.lineup.count; j++) {
+		export_channel(&exporter, channel_index_at(&slowlane.lineup, j), xmltv_file ? &xmltv : NULL);
 	}
 
-	/* XXX - Somehow handle xmltv overrides. */
+	if (export_flush(&exporter) < 0) {
+		return EXIT_FAILURE;
+	}
 
 	return EXIT_SUCCESS;
 }
 
+/* Add a feed to scan. */
+Acquisition * add_acquisition (Acquisition *acquisitions, int *acquisition_count, int source, AcquireOptions *options) {
+	if (*acquisition_count == ACQUIRE_MAX) {
+		slowlane_log(0, "Unable to scan more than %i feeds.", ACQUIRE_MAX);
+		return NULL;
+	}
+
+	acquire_init(&acquisitions[*acquisition_count], source, options);
+
+	return &acquisitions[(*acquisition_count)++];
+}
+
+/* Most KiB resident so far. The kernel's high water mark is for this image
+ * alone, getrusage also counts whatever ran before the exec. */
+long peak_rss (void) {
+	struct rusage resources;
+	char line[128];
+	long peak = -1;
+	FILE *status;
+
+	if ((status = fopen("/proc/self/status", "r")) != NULL) {
+		while (peak < 0 && fgets(line, sizeof(line), status) != NULL) {
+			if (sscanf(line, "VmHWM: %ld", &peak) != 1) {
+				peak = -1;
+			}
+		}
+
+		fclose(status);
+	}
+
+	if (peak < 0 && getrusage(RUSAGE_SELF, &resources) == 0) {
+		peak = resources.ru_maxrss;
+	}
+
+	return peak;
+}
+
 /* Display usage information. */
 void usage (void) {
 	printf("%s (%s) by %s\n", SLOWLANE_NAME, SLOWLANE_VERSION, SLOWLANE_AUTHOR);
 	printf("\t-c <flag>\tCRC Check (DVB Stack) (0 = Off, 1 = On <default>)\n");
 	printf("\t-C <flag>\tCRC Check (Internal) (0 = Off, 1 = On <default>)\n");
-	printf("\t-a <number>\tDVB Adapter Number (<default = 0>)\n");
-	printf("\t-d <number>\tDVB Demux Number (<default = 0>)\n");
+	printf("\t-a <number>\tDVB Adapter Number, Scanned Together (Repeatable) (<default = 0>)\n");
+	printf("\t-d <number>\tDVB Demux Number for the Adapter Before (<default = 0>)\n");
+	printf("\t-D <bytes>\tDVB Demux Buffer Size (<default = kernel default>)\n");
 	printf("\t-l <seconds>\tMinimum Seconds on DVB Loop (<default = 10>)\n");
-	printf("\t-b <bouquet>\tFilter Results for Specified Bouquet (<default = unfiltered>)\n");
-	printf("\t-r <region>\tFilter Results for Specified Region (Repeatable) (<default = unfiltered>)\n");
+	printf("\t-f <file>\tReplay Sections from Capture File instead of DVB Card (Repeatable)\n");
+	printf("\t-w <file>\tWrite Sections Read to Capture File, Further Feeds to <file>.<n>\n");
+	printf("\t-z\t\tWrite -w Captures Deduplicated, Each Distinct Section Once with the Time of Every Read\n");
+	printf("\t-y <speed>\tReplay Deduplicated Captures at Speed Times as Fast as Read (<default = 0, as fast as possible>)\n");
+	printf("\t-t <file>\tDemux Sections from Transport Stream Recording (Repeatable)\n");
+	printf("\t-T\t\tDemux Sections from Transport Stream on DVB Card's DVR\n");
+	printf("\t-E\t\tAcquire EIT Present/Following and Schedule Events\n");
+	printf("\t-o <file>\tAcquire OpenTV Titles and Summaries with Huffman Dictionary\n");
+	printf("\t-O <format>\tOutput Format for Lists (csv <default>, ndjson, binary)\n");
+	printf("\t-X <file>\tJoin Callsigns, Icons and XMLTV IDs from an XMLTV Channels File or Guide\n");
+	printf("\t-Y <file>\tAppend the Filtered Lineup to a History File\n");
+	printf("\t-Q <time>\tDisplay the Lineup in the History File at a Time (Epoch, UTC YYYY-MM-DD [HH:MM[:SS]] or now)\n");
+	printf("\t-G <time>\tDisplay Changes in the History File from a Time to -Q or the Latest\n");
+	printf("\t-k <number>\tOnly Show History for a User Number, -r Limits Regions (<default = all>)\n");
+	printf("\t-N <file>\tWrite the Filtered Lineup to a Snapshot File, Replacing it Whole\n");
+	printf("\t-q <number>\tDisplay a User Number's Channels from the Snapshot File Given by -N\n");
+	printf("\t-L <list>\tScan Each Capture in a List File or Directory on its Own, Then Report\n");
+	printf("\t-J <jobs>\tCaptures Scanned at Once in a Batch (<default = cores>)\n");
+	printf("\t-W <dir>\tWrite Each Batch Capture's Lineup to <dir>/<name>.<format> (<default = .>)\n");
+	printf("\t-R\t\tRetain Accepted NIT/SDT/BAT Sections, Names are Read from Them\n");
+	printf("\t-j <workers>\tParse Sections on Worker Threads (<default = 0, parse inline>)\n");
+	printf("\t-b <bouquet>\tFilter Results for Specified Bouquet, by Id or Name in BOUQUETS (<default = unfiltered>)\n");
+	printf("\t-r <region>\tFilter Results for Specified Region, by Id or Name in REGIONS (Repeatable) (<default = unfiltered>)\n");
 	printf("\t-s <dvb-s>\tFilter Results for Specified DVB-S Technology (<default = 1>)\n");
 	printf("\t-U <filter>\tFilter Results to Reject Channels Above Number (<default = unfiltered>)\n");
 	printf("\t-H\t\tInclude Results for HD Streams (<default don't include>)\n");
 	printf("\t-v\t\tIncrement Verbose Level (<default = 0>)\n");
 	printf("\t-B\t\tDisplay list of Bouquets\n");
 	printf("\t-S\t\tDisplay list of Networks, Transports, Services\n");
+	printf("\t-M\t\tDisplay memory used by the stored data\n");
+	printf("\t-m <MiB>\tFail the Scan Rather Than Hold More Than <MiB> in the Model, Reports Peak RSS\n");
+	printf("\t-e <hours>\tDisplay Events Running in the Next Hours (0 = All), Implies -E\n");
 }
@@ -0,0 +1,368 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * mknames.c - Build time generator of the region and bouquet name tables.
+ * Reads REGIONS and BOUQUETS and writes names_table.h, the entries as listed
+ * with a minimal perfect hash from names to entries and one from ids, found
+ * by hash and displace: keys are put in buckets by their unseeded hash, and
+ * the largest buckets first are given the first seed sending every key of
+ * theirs to a free slot.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "names.h"
+
+/* Most entries a file may list, slots hold an entry in a byte. */
+#define MKNAMES_ENTRIES_MAX 255
+#define MKNAMES_SEED_MAX 65535
+
+typedef struct tMknamesEntry {
+	unsigned int	id;
+	unsigned int	bouquet_id;
+	char		name[NAMES_KEY_MAX];
+} MknamesEntry;
+
+/* A key into the entries, a name's key or an id as two big endian bytes. */
+typedef struct tMknamesKey {
+	char		key[NAMES_KEY_MAX + 1];
+	unsigned int	length;
+	unsigned int	entry;
+	int		alias;
+} MknamesKey;
+
+typedef struct tMknamesTable {
+	MknamesEntry	entries[MKNAMES_ENTRIES_MAX];
+	unsigned int	count;
+} MknamesTable;
+
+/* Trim trailing white space and line ends. */
+static void mknames_trim (char *text) {
+	size_t length;
+
+	for (length = strlen(text); length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r' || text[length - 1] == ' ' || text[length - 1] == '\t'); text[--length] = '\0');
+}
+
+static int mknames_add (MknamesTable *table, const char *filename, unsigned int id, unsigned int bouquet_id, const char *name) {
+	MknamesEntry *entry;
+
+	if (table->count == MKNAMES_ENTRIES_MAX || strlen(name) >= NAMES_KEY_MAX) {
+		fprintf(stderr, "mknames: %s has too many entries or too long a name at %s.\n", filename, name);
+		return -1;
+	}
+
+	entry = &table->entries[table->count++];
+	entry->id = id;
+	entry->bouquet_id = bouquet_id;
+	strcpy(entry->name, name);
+
+	return 0;
+}
+
+/* REGIONS lists "Channel:<bouquet>,<region>\t\t// <name>", BOUQUETS
+ * "<bouquet>,<name>", anything else in either is prose. */
+static int mknames_read (MknamesTable *table, const char *filename, int regions) {
+	unsigned int id, bouquet_id;
+	char line[512], *name;
+	int retval = 0;
+	FILE *file;
+
+	if ((file = fopen(filename, "r")) == NULL) {
+		fprintf(stderr, "mknames: Unable to open %s.\n", filename);
+		return -1;
+	}
+
+	while (retval == 0 && fgets(line, sizeof(line), file) != NULL) {
+		mknames_trim(line);
+
+		if (regions) {
+			if (sscanf(line, "Channel:%u,%u", &bouquet_id, &id) != 2 || (name = strstr(line, "//")) == NULL) {
+				continue;
+			}
+
+			for (name += 2; *name == ' ' || *name == '\t'; name++);
+		} else {
+			if (line[0] < '0' || line[0] > '9' || (name = strchr(line, ',')) == NULL || sscanf(line, "%u,", &id) != 1) {
+				continue;
+			}
+
+			bouquet_id = id;
+			name++;
+		}
+
+		if (id > (regions ? 0xffu : 0xffffu)) {
+			fprintf(stderr, "mknames: %s lists %u, out of range.\n", filename, id);
+			retval = -1;
+		} else {
+			retval = mknames_add(table, filename, id, bouquet_id, name);
+		}
+	}
+
+	fclose(file);
+
+	return retval;
+}
+
+/* Every entry's name, and the part after its last " - " unless shared. */
+static unsigned int mknames_name_keys (MknamesTable *table, MknamesKey *keys) {
+	unsigned char shared[MKNAMES_ENTRIES_MAX * 2] = { 0 };
+	unsigned int i, j, count = 0;
+	const char *alias;
+
+	for (i = 0; i < table->count; i++) {
+		names_key(table->entries[i].name, keys[count].key);
+		keys[count].entry = i;
+		keys[count++].alias = 0;
+
+		for (alias = table->entries[i].name; strstr(alias, " - ") != NULL; alias = strstr(alias, " - ") + 3);
+
+		if (alias != table->entries[i].name) {
+			names_key(alias, keys[count].key);
+			keys[count].entry = i;
+			keys[count++].alias = 1;
+		}
+	}
+
+	/* A name matching two entries is an error, a shared alias is dropped. */
+	for (i = 0; i < count; i++) {
+		for (j = i + 1; j < count; j++) {
+			if (strcmp(keys[i].key, keys[j].key) != 0) {
+				continue;
+			}
+
+			if (!keys[i].alias && !keys[j].alias) {
+				fprintf(stderr, "mknames: %s and %s have the same name.\n", table->entries[keys[i].entry].name, table->entries[keys[j].entry].name);
+				return 0;
+			}
+
+			shared[i] |= keys[i].alias;
+			shared[j] |= keys[j].alias;
+		}
+	}
+
+	for (i = 0, j = 0; i < count; i++) {
+		if (!shared[i]) {
+			keys[j++] = keys[i];
+		}
+	}
+
+	count = j;
+
+	for (i = 0; i < count; i++) {
+		keys[i].length = strlen(keys[i].key);
+	}
+
+	return count;
+}
+
+static unsigned int mknames_id_keys (MknamesTable *table, MknamesKey *keys) {
+	unsigned int i;
+
+	for (i = 0; i < table->count; i++) {
+		keys[i].key[0] = table->entries[i].id >> 8;
+		keys[i].key[1] = table->entries[i].id & 0xff;
+		keys[i].length = 2;
+		keys[i].entry = i;
+		keys[i].alias = 0;
+	}
+
+	return table->count;
+}
+
+/* Find a seed for every bucket, largest first, and the key in every slot. */
+static int mknames_hash (MknamesKey *keys, unsigned int count, unsigned short *seeds, int *slot_keys) {
+	unsigned int *buckets, *sizes, i, j, bucket, slot, seed, largest, placed;
+	int retval = 0;
+
+	buckets = (unsigned int *) calloc(count, sizeof(unsigned int));
+	sizes = (unsigned int *) calloc(count, sizeof(unsigned int));
+
+	if (buckets == NULL || sizes == NULL) {
+		fprintf(stderr, "mknames: Unable to allocate %u buckets.\n", count);
+		free(buckets);
+		free(sizes);
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		buckets[i] = names_hash((unsigned char *) keys[i].key, keys[i].length, 0) % count;
+		sizes[buckets[i]]++;
+		seeds[i] = 0;
+		slot_keys[i] = -1;
+	}
+
+	for (placed = 0; placed < count && retval == 0;) {
+		for (bucket = 0, largest = 0; largest < count; largest++) {
+			if (sizes[largest] > sizes[bucket]) {
+				bucket = largest;
+			}
+		}
+
+		for (seed = 1; seed <= MKNAMES_SEED_MAX; seed++) {
+			for (i = 0; i < count; i++) {
+				if (buckets[i] != bucket) {
+					continue;
+				}
+
+				slot = names_hash((unsigned char *) keys[i].key, keys[i].length, seed) % count;
+
+				for (j = 0; j < i && (buckets[j] != bucket || names_hash((unsigned char *) keys[j].key, keys[j].length, seed) % count != slot); j++);
+
+				if (slot_keys[slot] >= 0 || j < i) {
+					break;
+				}
+			}
+
+			if (i == count) {
+				break;
+			}
+		}
+
+		if (seed > MKNAMES_SEED_MAX) {
+			fprintf(stderr, "mknames: No seed places bucket %u of %u keys.\n", bucket, sizes[bucket]);
+			retval = -1;
+			break;
+		}
+
+		for (i = 0; i < count; i++) {
+			if (buckets[i] == bucket) {
+				slot_keys[names_hash((unsigned char *) keys[i].key, keys[i].length, seed) % count] = i;
+				placed++;
+			}
+		}
+
+		seeds[bucket] = seed;
+		sizes[bucket] = 0;
+	}
+
+	free(buckets);
+	free(sizes);
+
+	return retval;
+}
+
+static void mknames_string (FILE *out, const char *text) {
+	fputc('"', out);
+
+	for (; *text; text++) {
+		if (*text == '"' || *text == '\\') {
+			fputc('\\', out);
+		}
+
+		fputc(*text, out);
+	}
+
+	fputc('"', out);
+}
+
+/* Write one hash as its seeds, slots and, for names, keys. */
+static int mknames_write_hash (FILE *out, const char *name, MknamesKey *keys, unsigned int count, int names) {
+	unsigned short seeds[MKNAMES_ENTRIES_MAX * 2];
+	int slot_keys[MKNAMES_ENTRIES_MAX * 2];
+	unsigned int i;
+
+	if (count == 0 || mknames_hash(keys, count, seeds, slot_keys) < 0) {
+		return -1;
+	}
+
+	fprintf(out, "\nstatic const unsigned short %s_seeds[%u] = {", name, count);
+
+	for (i = 0; i < count; i++) {
+		fprintf(out, "%s%u", i % 12 ? ", " : (i ? ",\n\t" : "\n\t"), seeds[i]);
+	}
+
+	fprintf(out, "\n};\n\nstatic const unsigned char %s_slots[%u] = {", name, count);
+
+	for (i = 0; i < count; i++) {
+		fprintf(out, "%s%u", i % 12 ? ", " : (i ? ",\n\t" : "\n\t"), keys[slot_keys[i]].entry);
+	}
+
+	fprintf(out, "\n};\n");
+
+	if (names) {
+		fprintf(out, "\nstatic const char * const %s_keys[%u] = {\n", name, count);
+
+		for (i = 0; i < count; i++) {
+			fprintf(out, "\t");
+			mknames_string(out, keys[slot_keys[i]].key);
+			fprintf(out, "%s\n", i + 1 < count ? "," : "");
+		}
+
+		fprintf(out, "};\n");
+	}
+
+	fprintf(out, "\nstatic const NameHash %s = { %u, %s_seeds, %s_slots, ", name, count, name, name);
+
+	if (names) {
+		fprintf(out, "%s_keys };\n", name);
+	} else {
+		fprintf(out, "NULL };\n");
+	}
+
+	return 0;
+}
+
+/* Write a table's entries and both its hashes. */
+static int mknames_write (FILE *out, const char *name, MknamesTable *table) {
+	MknamesKey keys[MKNAMES_ENTRIES_MAX * 2];
+	char hash[64];
+	unsigned int i, j, count;
+
+	fprintf(out, "\nstatic const NameEntry names_%ss[%u] = {\n", name, table->count);
+
+	for (i = 0; i < table->count; i++) {
+		fprintf(out, "\t{ %u, %u, ", table->entries[i].id, table->entries[i].bouquet_id);
+		mknames_string(out, table->entries[i].name);
+		fprintf(out, " }%s\n", i + 1 < table->count ? "," : "");
+	}
+
+	fprintf(out, "};\n");
+
+	if ((count = mknames_name_keys(table, keys)) == 0) {
+		return -1;
+	}
+
+	snprintf(hash, sizeof(hash), "names_%s_names", name);
+
+	if (mknames_write_hash(out, hash, keys, count, 1) < 0) {
+		return -1;
+	}
+
+	snprintf(hash, sizeof(hash), "names_%s_ids", name);
+
+	for (i = 0; i < table->count; i++) {
+		for (j = 0; j < i; j++) {
+			if (table->entries[j].id == table->entries[i].id) {
+				fprintf(stderr, "mknames: %u is listed twice.\n", table->entries[i].id);
+				return -1;
+			}
+		}
+	}
+
+	return mknames_write_hash(out, hash, keys, mknames_id_keys(table, keys), 0);
+}
+
+int main (int argc, char *argv[]) {
+	static MknamesTable regions, bouquets;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <REGIONS> <BOUQUETS>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (mknames_read(&regions, argv[1], 1) < 0 || mknames_read(&bouquets, argv[2], 0) < 0) {
+		return EXIT_FAILURE;
+	}
+
+	printf("/* Generated by mknames from %s and %s, do not edit. */\n", argv[1], argv[2]);
+
+	if (mknames_write(stdout, "region", &regions) < 0 || mknames_write(stdout, "bouquet", &bouquets) < 0) {
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * names.c - Region and bouquet names. The tables are generated from REGIONS
+ * and BOUQUETS by mknames at build time, so a lookup either way is two hashes
+ * and a comparison, with nothing to load or allocate.
+ */
+
+/* Includes */
+#include <stdlib.h>
+#include <string.h>
+#include "names.h"
+#include "names_table.h"
+
+/* An id written as a number, -1 if it isn't one or is above max. */
+static long names_number (const char *text, long max) {
+	char *end;
+	long id;
+
+	if (text[0] < '0' || text[0] > '9') {
+		return -1;
+	}
+
+	id = strtol(text, &end, 10);
+
+	return *end == '\0' && id <= max ? id : -1;
+}
+
+static const NameEntry * names_find_name (const NameHash *table, const NameEntry *entries, const char *text) {
+	char key[NAMES_KEY_MAX + 1];
+	unsigned int slot;
+	int length;
+
+	if ((length = names_key(text, key)) <= 0) {
+		return NULL;
+	}
+
+	slot = names_slot(table, (unsigned char *) key, length);
+
+	return strcmp(table->keys[slot], key) == 0 ? &entries[table->slots[slot]] : NULL;
+}
+
+static const NameEntry * names_find_id (const NameHash *table, const NameEntry *entries, unsigned short id) {
+	unsigned char key[2] = { id >> 8, id & 0xff };
+	const NameEntry *entry = &entries[table->slots[names_slot(table, key, sizeof(key))]];
+
+	return entry->id == id ? entry : NULL;
+}
+
+int names_bouquet_id (const char *text) {
+	const NameEntry *entry;
+	long id;
+
+	if ((id = names_number(text, 0xffff)) >= 0) {
+		return id;
+	}
+
+	return (entry = names_find_name(&names_bouquet_names, names_bouquets, text)) ? entry->id : -1;
+}
+
+int names_region_id (const char *text) {
+	const NameEntry *entry;
+	long id;
+
+	if ((id = names_number(text, 0xff)) >= 0) {
+		return id;
+	}
+
+	return (entry = names_find_name(&names_region_names, names_regions, text)) ? entry->id : -1;
+}
+
+const char * names_bouquet (unsigned short bouquet_id) {
+	const NameEntry *entry = names_find_id(&names_bouquet_ids, names_bouquets, bouquet_id);
+
+	return entry ? entry->name : NULL;
+}
+
+const char * names_region (unsigned char region) {
+	const NameEntry *entry = names_find_id(&names_region_ids, names_regions, region);
+
+	return entry ? entry->name : NULL;
+}
@@ -0,0 +1,261 @@
+/* Generated by mknames from ../REGIONS and ../BOUQUETS, do not edit. */
+
+static const NameEntry names_regions[49] = {
+	{ 14, 4097, "England (BBC) - Border & NW (ITV)" },
+	{ 12, 4097, "England (BBC) - Border (ITV)" },
+	{ 29, 4097, "England (BBC) - E Mid & Yorkshire (ITV)" },
+	{ 27, 4097, "England (BBC) - E London & Midlands (ITV)" },
+	{ 18, 4097, "England (BBC) - East London & SE (ITV)" },
+	{ 25, 4097, "England (BBC) - East & Midlands (ITV)" },
+	{ 21, 4097, "England (BBC) - East & Yorkshire (ITV)" },
+	{ 2, 4097, "England (BBC) - East (ITV)" },
+	{ 11, 4097, "England (BBC) - London & SE (ITV)" },
+	{ 9, 4097, "England (BBC) - London & South (ITV)" },
+	{ 1, 4097, "England (BBC) - London (ITV)" },
+	{ 19, 4097, "England (BBC) - Midlands & NW (ITV)" },
+	{ 24, 4097, "England (BBC) - Midlands & West (ITV)" },
+	{ 3, 4097, "England (BBC) - Midlands (ITV)" },
+	{ 20, 4097, "England (BBC) - Midlands & Yorkshire (ITV)" },
+	{ 26, 4097, "England (BBC) - NE & Yorkshire (ITV)" },
+	{ 17, 4097, "England (BBC) - NW & Wales (ITV)" },
+	{ 13, 4097, "England (BBC) - North East (ITV)" },
+	{ 7, 4097, "England (BBC) - North West (ITV)" },
+	{ 5, 4097, "England (BBC) - South (ITV)" },
+	{ 10, 4097, "England (BBC) - South East (ITV)" },
+	{ 6, 4097, "England (BBC) - South West (ITV)" },
+	{ 4, 4097, "England (BBC) - West (ITV)" },
+	{ 8, 4097, "England (BBC) - Yorkshire (ITV)" },
+	{ 73, 4099, "England 2 - Isle Of Man" },
+	{ 65, 4099, "England 2 - Brighton" },
+	{ 63, 4099, "England 2 - HTV W/Thames Valley" },
+	{ 70, 4099, "England 2 - Henley On Thames" },
+	{ 66, 4099, "England 2 - London / Thames Valley" },
+	{ 64, 4099, "England 2 - London Kent" },
+	{ 68, 4099, "England 2 - Meridian North" },
+	{ 62, 4099, "England 2 - North East Midlands" },
+	{ 71, 4099, "England 2 - Oxford" },
+	{ 61, 4099, "England 2 - Scarborough (bc)" },
+	{ 60, 4099, "England 2 - Sheffield (au)" },
+	{ 72, 4099, "England 2 - South Yorkshire" },
+	{ 69, 4099, "England 2 - Tees" },
+	{ 67, 4099, "England 2 - West Dorset" },
+	{ 41, 4099, "Wales (BBC) - Midlands (ITV)" },
+	{ 42, 4099, "Wales (BBC) - North West (ITV)" },
+	{ 43, 4099, "Wales (BBC) - Wales (ITV)" },
+	{ 45, 4099, "Wales (BBC) - NW & Wales (ITV)" },
+	{ 33, 4100, "Northern Ireland(BBC & ITV)" },
+	{ 34, 4100, "Channel Isles(ITV)" },
+	{ 50, 4100, "Republic of Ireland 4100" },
+	{ 36, 4098, "Scotland (BBC) - Border (ITV)" },
+	{ 38, 4098, "Scotland (BBC) - C Scot & N Scot (ITV)" },
+	{ 37, 4098, "Scotland (BBC) - Central Scotland (ITV)" },
+	{ 35, 4098, "Scotland (BBC) - North Scotland (ITV)" }
+};
+
+static const unsigned short names_region_names_seeds[87] = {
+	1, 1, 1, 9, 6, 1, 0, 0, 0, 0, 1, 2,
+	1, 1, 0, 1, 0, 1, 0, 1, 3, 0, 2, 0,
+	0, 1, 2, 3, 1, 2, 0, 5, 0, 1, 1, 0,
+	0, 4, 8, 0, 2, 1, 13, 27, 1, 4, 0, 4,
+	13, 1, 2, 9, 10, 0, 1, 20, 8, 1, 0, 0,
+	18, 3, 1, 0, 26, 14, 0, 7, 16, 0, 0, 1,
+	0, 9, 2, 1, 11, 0, 6, 0, 23, 60, 55, 0,
+	0, 0, 0
+};
+
+static const unsigned char names_region_names_slots[87] = {
+	41, 35, 37, 44, 19, 21, 48, 15, 3, 17, 27, 31,
+	18, 2, 27, 38, 14, 8, 11, 23, 42, 26, 17, 43,
+	36, 29, 3, 15, 23, 29, 7, 30, 47, 31, 12, 6,
+	45, 12, 19, 2, 9, 25, 16, 7, 21, 39, 32, 8,
+	22, 0, 33, 26, 6, 32, 5, 24, 4, 22, 20, 24,
+	1, 47, 34, 33, 0, 10, 37, 4, 36, 30, 28, 40,
+	10, 48, 35, 20, 28, 11, 14, 13, 46, 5, 46, 40,
+	25, 9, 34
+};
+
+static const char * const names_region_names_keys[87] = {
+	"walesbbcnwwalesitv",
+	"southyorkshire",
+	"england2westdorset",
+	"republicofireland4100",
+	"southitv",
+	"englandbbcsouthwestitv",
+	"northscotlanditv",
+	"neyorkshireitv",
+	"englandbbcelondonmidlandsitv",
+	"englandbbcnortheastitv",
+	"henleyonthames",
+	"northeastmidlands",
+	"englandbbcnorthwestitv",
+	"englandbbcemidyorkshireitv",
+	"england2henleyonthames",
+	"walesbbcmidlandsitv",
+	"midlandsyorkshireitv",
+	"englandbbclondonseitv",
+	"englandbbcmidlandsnwitv",
+	"yorkshireitv",
+	"northernirelandbbcitv",
+	"htvwthamesvalley",
+	"northeastitv",
+	"channelislesitv",
+	"england2tees",
+	"england2londonkent",
+	"elondonmidlandsitv",
+	"englandbbcneyorkshireitv",
+	"englandbbcyorkshireitv",
+	"londonkent",
+	"englandbbceastitv",
+	"england2meridiannorth",
+	"centralscotlanditv",
+	"england2northeastmidlands",
+	"midlandswestitv",
+	"eastyorkshireitv",
+	"scotlandbbcborderitv",
+	"englandbbcmidlandswestitv",
+	"englandbbcsouthitv",
+	"emidyorkshireitv",
+	"englandbbclondonsouthitv",
+	"brighton",
+	"englandbbcnwwalesitv",
+	"eastitv",
+	"southwestitv",
+	"walesbbcnorthwestitv",
+	"oxford",
+	"londonseitv",
+	"westitv",
+	"bordernwitv",
+	"england2scarboroughbc",
+	"england2htvwthamesvalley",
+	"englandbbceastyorkshireitv",
+	"england2oxford",
+	"englandbbceastmidlandsitv",
+	"isleofman",
+	"eastlondonseitv",
+	"englandbbcwestitv",
+	"englandbbcsoutheastitv",
+	"england2isleofman",
+	"englandbbcborderitv",
+	"scotlandbbccentralscotlanditv",
+	"england2sheffieldau",
+	"scarboroughbc",
+	"englandbbcbordernwitv",
+	"londonitv",
+	"westdorset",
+	"englandbbceastlondonseitv",
+	"tees",
+	"meridiannorth",
+	"england2londonthamesvalley",
+	"walesitv",
+	"englandbbclondonitv",
+	"scotlandbbcnorthscotlanditv",
+	"england2southyorkshire",
+	"southeastitv",
+	"londonthamesvalley",
+	"midlandsnwitv",
+	"englandbbcmidlandsyorkshireitv",
+	"englandbbcmidlandsitv",
+	"cscotnscotitv",
+	"eastmidlandsitv",
+	"scotlandbbccscotnscotitv",
+	"walesbbcwalesitv",
+	"england2brighton",
+	"londonsouthitv",
+	"sheffieldau"
+};
+
+static const NameHash names_region_names = { 87, names_region_names_seeds, names_region_names_slots, names_region_names_keys };
+
+static const unsigned short names_region_ids_seeds[49] = {
+	0, 1, 0, 1, 3, 2, 3, 1, 1, 0, 1, 0,
+	0, 1, 1, 1, 1, 1, 1, 6, 6, 0, 0, 1,
+	3, 1, 1, 0, 1, 2, 1, 4, 8, 1, 1, 1,
+	3, 1, 2, 2, 2, 0, 1, 1, 5, 137, 0, 3,
+	133
+};
+
+static const unsigned char names_region_ids_slots[49] = {
+	14, 15, 5, 21, 2, 8, 43, 10, 25, 47, 22, 30,
+	9, 24, 41, 13, 4, 37, 18, 32, 39, 16, 0, 31,
+	27, 6, 7, 28, 46, 19, 35, 20, 36, 1, 17, 11,
+	42, 40, 29, 12, 3, 38, 23, 34, 48, 44, 33, 26,
+	45
+};
+
+static const NameHash names_region_ids = { 49, names_region_ids_seeds, names_region_ids_slots, NULL };
+
+static const NameEntry names_bouquets[15] = {
+	{ 4096, 4096, "BSkyB Bouquet" },
+	{ 4097, 4097, "BSkyB Bouquet 1 - DTH England" },
+	{ 4098, 4098, "BSkyB Bouquet 2 - DTH Scotland" },
+	{ 4099, 4099, "BSkyB Bouquet 3 - DTH Wales" },
+	{ 4100, 4100, "BSkyB Bouquet 4 - DTH Other" },
+	{ 4101, 4101, "BSkyB Bouquet 5 - HD England" },
+	{ 4102, 4102, "BSkyB Bouquet 6 - HD Scotland" },
+	{ 4103, 4103, "BSkyB Bouquet 7 - HD Wales" },
+	{ 4104, 4104, "BSkyB Bouquet 8 - HD Other" },
+	{ 4105, 4105, "BSkyB Bouquet 9 - Commercial England" },
+	{ 4106, 4106, "BSkyB Bouquet 10 - Commercial Scotland" },
+	{ 4107, 4107, "BSkyB Bouquet 11 - Commercial Wales" },
+	{ 4108, 4108, "BSkyB Bouquet 12 - Commercial Other" },
+	{ 4109, 4109, "BSkyB Bouquet 13 - Test" },
+	{ 4110, 4110, "BSkyB Bouquet 14 - Interactive Test" }
+};
+
+static const unsigned short names_bouquet_names_seeds[29] = {
+	3, 2, 0, 0, 1, 1, 0, 3, 3, 1, 0, 0,
+	16, 0, 1, 0, 0, 0, 6, 1, 6, 9, 16, 0,
+	2, 4, 0, 21, 0
+};
+
+static const unsigned char names_bouquet_names_slots[29] = {
+	13, 1, 5, 6, 7, 8, 7, 11, 4, 4, 14, 2,
+	2, 1, 0, 11, 3, 10, 9, 3, 5, 12, 10, 12,
+	13, 6, 8, 14, 9
+};
+
+static const char * const names_bouquet_names_keys[29] = {
+	"test",
+	"dthengland",
+	"hdengland",
+	"hdscotland",
+	"bskybbouquet7hdwales",
+	"bskybbouquet8hdother",
+	"hdwales",
+	"bskybbouquet11commercialwales",
+	"bskybbouquet4dthother",
+	"dthother",
+	"bskybbouquet14interactivetest",
+	"bskybbouquet2dthscotland",
+	"dthscotland",
+	"bskybbouquet1dthengland",
+	"bskybbouquet",
+	"commercialwales",
+	"dthwales",
+	"bskybbouquet10commercialscotland",
+	"bskybbouquet9commercialengland",
+	"bskybbouquet3dthwales",
+	"bskybbouquet5hdengland",
+	"commercialother",
+	"commercialscotland",
+	"bskybbouquet12commercialother",
+	"bskybbouquet13test",
+	"bskybbouquet6hdscotland",
+	"hdother",
+	"interactivetest",
+	"commercialengland"
+};
+
+static const NameHash names_bouquet_names = { 29, names_bouquet_names_seeds, names_bouquet_names_slots, names_bouquet_names_keys };
+
+static const unsigned short names_bouquet_ids_seeds[15] = {
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 3, 1,
+	11, 1, 15
+};
+
+static const unsigned char names_bouquet_ids_slots[15] = {
+	6, 8, 14, 13, 12, 3, 2, 1, 0, 7, 4, 5,
+	11, 10, 9
+};
+
+static const NameHash names_bouquet_ids = { 15, names_bouquet_ids_seeds, names_bouquet_ids_slots, NULL };
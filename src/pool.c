@@ -0,0 +1,105 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * pool.c - Chunked object pool functions.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slowlane.h"
+#include "pool.h"
+
+void pool_init (Pool *pool, unsigned int object_size, unsigned int chunk_shift) {
+	memset(pool, '\0', sizeof(Pool));
+	pool->object_size = object_size;
+	pool->chunk_shift = chunk_shift;
+
+	/* Reserve index 0 as the terminator. */
+	pool->count = 1;
+}
+
+/* Hand out a zeroed object, returns its index or POOL_NONE if out of memory. */
+unsigned int pool_alloc (Pool *pool) {
+	unsigned int index = pool->count, chunk = index >> pool->chunk_shift;
+	char **chunks;
+
+	/* Grow the chunk table and add a chunk when we cross into a new one. */
+	if (chunk >= pool->chunk_count) {
+		if (pool_cap_charge(pool->cap, (size_t) pool->object_size << pool->chunk_shift) < 0) {
+			return POOL_NONE;
+		}
+
+		if ((chunks = (char **) realloc(pool->chunks, (chunk + 1) * sizeof(char *))) == NULL) {
+			slowlane_log(0, "Unable to grow pool chunk table to %u chunks.", chunk + 1);
+			pool_cap_release(pool->cap, (size_t) pool->object_size << pool->chunk_shift);
+			return POOL_NONE;
+		}
+
+		pool->chunks = chunks;
+
+		if ((pool->chunks[chunk] = (char *) calloc(1u << pool->chunk_shift, pool->object_size)) == NULL) {
+			slowlane_log(0, "Unable to allocate pool chunk of %u objects.", 1u << pool->chunk_shift);
+			pool_cap_release(pool->cap, (size_t) pool->object_size << pool->chunk_shift);
+			return POOL_NONE;
+		}
+
+		pool->chunk_count = chunk + 1;
+	}
+
+	pool->count++;
+
+	return index;
+}
+
+void pool_free_all (Pool *pool) {
+	PoolCap *cap = pool->cap;
+	unsigned int i;
+
+	for (i = 0; i < pool->chunk_count; i++) {
+		free(pool->chunks[i]);
+	}
+
+	pool_cap_release(cap, (size_t) pool->chunk_count * ((size_t) pool->object_size << pool->chunk_shift));
+	free(pool->chunks);
+	pool_init(pool, pool->object_size, pool->chunk_shift);
+	pool->cap = cap;
+}
+
+/* Bytes held by the pool, including unused slots in the last chunk. */
+size_t pool_bytes (Pool *pool) {
+	return (size_t) pool->chunk_count * ((size_t) pool->object_size << pool->chunk_shift) + pool->chunk_count * sizeof(char *);
+}
+
+/* Take bytes from a cap, none being unlimited. Returns -1 and marks the cap
+ * exceeded, once, if they would take it past its limit. */
+int pool_cap_charge (PoolCap *cap, size_t bytes) {
+	size_t used, peak;
+
+	if (cap == NULL) {
+		return 0;
+	}
+
+	if ((used = __sync_add_and_fetch(&cap->used, bytes)) > cap->limit) {
+		__sync_sub_and_fetch(&cap->used, bytes);
+
+		if (__sync_bool_compare_and_swap(&cap->exceeded, 0, 1)) {
+			slowlane_log(0, "Memory cap of %lu KiB reached with %lu KiB in use.", (unsigned long) (cap->limit >> 10), (unsigned long) ((used - bytes) >> 10));
+		}
+
+		return -1;
+	}
+
+	for (peak = cap->peak; used > peak && !__sync_bool_compare_and_swap(&cap->peak, peak, used); peak = cap->peak);
+
+	return 0;
+}
+
+void pool_cap_release (PoolCap *cap, size_t bytes) {
+	if (cap != NULL) {
+		__sync_sub_and_fetch(&cap->used, bytes);
+	}
+}
@@ -0,0 +1,145 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * queue.c - Single producer, single consumer section queue functions.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include "slowlane.h"
+#include "queue.h"
+
+/* How long to sleep between polls once spinning has not helped. */
+#define QUEUE_SLEEP_NS 200000
+
+/* Yield a few times before sleeping, most waits are very short. */
+#define QUEUE_SPINS 64
+
+int queue_init (Queue *queue, unsigned int size, unsigned int slot_size) {
+	memset(queue, '\0', sizeof(Queue));
+	queue->slot_size = slot_size;
+
+	/* Round up to a power of two so positions can be masked. */
+	for (queue->size = 1; queue->size < size; queue->size <<= 1);
+
+	if ((queue->slots = (char *) malloc(queue->size * slot_size)) == NULL) {
+		slowlane_log(0, "Unable to allocate queue of %u slots.", queue->size);
+		return -1;
+	}
+
+	slowlane_log(2, "Queue of %u slots (%lu bytes) allocated.", queue->size, (unsigned long) queue->size * slot_size);
+	return 0;
+}
+
+void queue_free (Queue *queue) {
+	free(queue->slots);
+	queue->slots = NULL;
+}
+
+/* Monotonic milliseconds, for wait timeouts. */
+static long queue_now_ms (void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Wait for the other side, used by both ends. */
+static void queue_backoff (int *spins) {
+	struct timespec delay;
+
+	if ((*spins)++ < QUEUE_SPINS) {
+		sched_yield();
+	} else {
+		delay.tv_sec = 0;
+		delay.tv_nsec = QUEUE_SLEEP_NS;
+		nanosleep(&delay, NULL);
+	}
+}
+
+/* Producer: free slot to fill, or NULL if the queue is full. */
+void * queue_write_slot (Queue *queue) {
+	unsigned int head = queue->head;
+
+	if (head - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) >= queue->size) {
+		return NULL;
+	}
+
+	return queue->slots + (head & (queue->size - 1)) * queue->slot_size;
+}
+
+/* Producer: as above, but wait up to timeout_ms for the consumer. */
+void * queue_write_wait (Queue *queue, int timeout_ms) {
+	void *slot;
+	long start = queue_now_ms();
+	int spins = 0, stalled = 0;
+
+	while ((slot = queue_write_slot(queue)) == NULL) {
+		if (!stalled) {
+			queue->stalls++;
+			stalled = 1;
+		}
+
+		if (queue_now_ms() - start > timeout_ms) {
+			return NULL;
+		}
+
+		queue_backoff(&spins);
+	}
+
+	return slot;
+}
+
+/* Producer: publish the slot returned by queue_write_slot. */
+void queue_write_commit (Queue *queue) {
+	__atomic_store_n(&queue->head, queue->head + 1, __ATOMIC_RELEASE);
+}
+
+/* Producer: nothing more will be written. */
+void queue_close (Queue *queue) {
+	__atomic_store_n(&queue->closed, 1, __ATOMIC_RELEASE);
+}
+
+/* Consumer: next filled slot, or NULL if the queue is empty. */
+void * queue_read_slot (Queue *queue) {
+	unsigned int tail = queue->tail;
+
+	if (__atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == tail) {
+		return NULL;
+	}
+
+	return queue->slots + (tail & (queue->size - 1)) * queue->slot_size;
+}
+
+/* Consumer: as above, but wait up to timeout_ms for the producer. */
+void * queue_read_wait (Queue *queue, int timeout_ms) {
+	void *slot;
+	long start = queue_now_ms();
+	int spins = 0;
+
+	while ((slot = queue_read_slot(queue)) == NULL) {
+		if (queue_finished(queue) || queue_now_ms() - start > timeout_ms) {
+			return NULL;
+		}
+
+		queue_backoff(&spins);
+	}
+
+	return slot;
+}
+
+/* Consumer: hand the slot returned by queue_read_slot back to the producer. */
+void queue_read_release (Queue *queue) {
+	__atomic_store_n(&queue->tail, queue->tail + 1, __ATOMIC_RELEASE);
+}
+
+/* Consumer: closed and everything written has been read. */
+int queue_finished (Queue *queue) {
+	return __atomic_load_n(&queue->closed, __ATOMIC_ACQUIRE) && __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == queue->tail;
+}
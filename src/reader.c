@@ -0,0 +1,256 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * reader.c - Demux reader thread, drains the demux into the section queue
+ * so that parsing can never hold up a read.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "slowlane.h"
+#include "dvb.h"
+#include "queue.h"
+#include "ts.h"
+#include "feed.h"
+#include "carousel.h"
+#include "reader.h"
+
+/* How often the reader wakes to see if it has been asked to stop. */
+#define READER_POLL_MS 100
+
+/* Monotonic microseconds, what each read is stamped with. */
+static unsigned long long reader_now (void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/* Pass on the slot being filled with sections, if any. */
+static void reader_commit (Reader *reader) {
+	if (reader->slot) {
+		queue_write_commit(reader->queue);
+		reader->slot = NULL;
+	}
+}
+
+/* TS demux callback, packs each section into the queue. */
+static void reader_section (void *context, unsigned char *section, int section_length) {
+	Reader *reader = (Reader *) context;
+
+	if (reader->slot && reader->slot->length + section_length > QUEUE_SLOT_SIZE) {
+		reader_commit(reader);
+	}
+
+	while (reader->slot == NULL) {
+		/* Sections are dropped once we've been asked to stop. */
+		if (__atomic_load_n(&reader->stop, __ATOMIC_ACQUIRE)) {
+			return;
+		}
+
+		if ((reader->slot = (QueueSlot *) queue_write_wait(reader->queue, READER_POLL_MS)) != NULL) {
+			reader->slot->length = 0;
+			reader->slot->time = reader_now();
+		}
+	}
+
+	memcpy(reader->slot->data + reader->slot->length, section, section_length);
+	reader->slot->length += section_length;
+}
+
+/* Read and demux a transport stream, returns as dvb_read. */
+static int reader_read_ts (Reader *reader, int fd) {
+	int length;
+
+	if ((length = dvb_read(fd, (char *) reader->buffer, READER_TS_PACKETS * TS_PACKET_SIZE)) > 0) {
+		ts_demux_process(&reader->feed->ts, reader->buffer, length);
+		reader_commit(reader);
+	}
+
+	return length;
+}
+
+/* Read a section capture after what was left of the last read, and filter it. */
+static int reader_read_capture (Reader *reader, int fd, QueueSlot *slot) {
+	int length = 0, used;
+
+	memcpy(slot->data, reader->buffer, reader->carry_length);
+
+	/* If what was left fills the slot there's no room to read, which isn't the
+	 * end of the capture, so just filter what's there. */
+	if (reader->carry_length < QUEUE_SLOT_SIZE && (length = dvb_read(fd, (char *) slot->data + reader->carry_length, QUEUE_SLOT_SIZE - reader->carry_length)) <= 0) {
+		return length;
+	}
+
+	/* Keep any section split over the end for next time. */
+	used = feed_filter_sections(reader->feed, slot->data, reader->carry_length + length, &slot->length);
+
+	/* A slot with no whole section in it never will have. */
+	if (length == 0 && used == 0) {
+		slowlane_log(1, "Capture dropped %i bytes which aren't a whole section.", reader->carry_length);
+		used = reader->carry_length;
+	}
+
+	reader->carry_length += length - used;
+	memcpy(reader->buffer, slot->data + used, reader->carry_length);
+
+	return length > 0 ? length : used;
+}
+
+/* Replay the next read of a deduplicated capture, and filter it. */
+static int reader_read_carousel (Reader *reader, QueueSlot *slot) {
+	int length;
+
+	if ((length = carousel_read(reader->feed->carousel, slot->data, QUEUE_SLOT_SIZE, &slot->time)) > 0) {
+		feed_filter_sections(reader->feed, slot->data, length, &slot->length);
+	}
+
+	return length;
+}
+
+/* Read from one of the feed's fds into the queue, returns as dvb_read. */
+static int reader_read (Reader *reader, int fd) {
+	QueueSlot *slot;
+	long wait;
+	int length;
+
+	if (reader->feed->type == FEED_TS) {
+		/* Sections find their own way into the queue. */
+		return reader_read_ts(reader, fd);
+	}
+
+	/* A paced replay waits until the next read is due, still waking to see if it should stop. */
+	if (reader->feed->carousel && (wait = carousel_wait(reader->feed->carousel)) > 0) {
+		usleep(wait < READER_POLL_MS * 1000 ? wait : READER_POLL_MS * 1000);
+		errno = EAGAIN;
+		return -1;
+	}
+
+	/* Get somewhere to put it, the parser is behind if we have to wait. */
+	if ((slot = (QueueSlot *) queue_write_wait(reader->queue, READER_POLL_MS)) == NULL) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	slot->time = reader_now();
+
+	if (reader->feed->carousel) {
+		length = reader_read_carousel(reader, slot);
+	} else if (reader->feed->type == FEED_CAPTURE) {
+		length = reader_read_capture(reader, fd, slot);
+	} else {
+		length = slot->length = dvb_read(fd, (char *) slot->data, QUEUE_SLOT_SIZE);
+	}
+
+	if (length > 0 && slot->length > 0) {
+		queue_write_commit(reader->queue);
+	}
+
+	return length;
+}
+
+static void * reader_thread (void *arg) {
+	Reader *reader = (Reader *) arg;
+	struct pollfd pfds[FEED_FILTER_MAX];
+	int retval, length, i, fd;
+
+	for (i = 0; i < reader->feed->fd_count; i++) {
+		pfds[i].fd = reader->feed->fds[i];
+		pfds[i].events = POLLIN;
+	}
+
+	while (!__atomic_load_n(&reader->stop, __ATOMIC_ACQUIRE) && reader->state == READER_RUNNING) {
+		/* Only read once there is data, a blocked read would hold up filter changes. */
+		if ((retval = poll(pfds, reader->feed->fd_count, READER_POLL_MS)) == 0 || (retval < 0 && errno == EINTR)) {
+			continue;
+		} else if (retval < 0) {
+			slowlane_log(0, "Reader poll failed (%s).", strerror(errno));
+			reader->state = READER_FAILED;
+			break;
+		}
+
+		for (i = 0; i < reader->feed->fd_count; i++) {
+			if (!pfds[i].revents) {
+				continue;
+			}
+
+			fd = pfds[i].fd;
+
+			if ((length = reader_read(reader, fd)) < 0) {
+				if (errno == EOVERFLOW) {
+					/* The kernel dropped data, the carousel will bring it round again. */
+					reader->overflows++;
+					slowlane_log(1, "Demux buffer overflow on fd %i, %lu so far.", fd, reader->overflows);
+					continue;
+				} else if (errno == EINTR || errno == EAGAIN) {
+					continue;
+				}
+
+				slowlane_log(0, "dvb_read failed on fd %i (%s).", fd, strerror(errno));
+				reader->state = READER_FAILED;
+				break;
+			} else if (length == 0) {
+				slowlane_log(2, "End of data on fd %i.", fd);
+				reader->state = READER_EOF;
+				break;
+			}
+
+			reader->reads++;
+			reader->bytes += length;
+		}
+	}
+
+	/* Let the parser know there will be nothing else. */
+	queue_close(reader->queue);
+
+	return NULL;
+}
+
+/* Start draining the feed into queue on a thread of its own. */
+int reader_start (Reader *reader, Feed *feed, Queue *queue) {
+	int retval;
+
+	memset(reader, '\0', sizeof(Reader));
+	reader->feed = feed;
+	reader->queue = queue;
+	reader->state = READER_RUNNING;
+
+	/* Packets waiting to be demuxed, or the start of a capture's split section. */
+	if (feed->type != FEED_DEMUX) {
+		if ((reader->buffer = (unsigned char *) malloc(READER_TS_PACKETS * TS_PACKET_SIZE)) == NULL) {
+			slowlane_log(0, "Unable to allocate %i byte reader buffer.", READER_TS_PACKETS * TS_PACKET_SIZE);
+			return -1;
+		}
+	}
+
+	if (feed->type == FEED_TS) {
+		feed->ts.callback = reader_section;
+		feed->ts.context = reader;
+	}
+
+	if ((retval = pthread_create(&reader->thread, NULL, reader_thread, reader)) != 0) {
+		slowlane_log(0, "Unable to start reader thread (%s).", strerror(retval));
+		return -1;
+	}
+
+	slowlane_log(2, "Reader thread started on %i fds.", feed->fd_count);
+	return 0;
+}
+
+/* Stop the reader thread and wait for it. */
+void reader_stop (Reader *reader) {
+	__atomic_store_n(&reader->stop, 1, __ATOMIC_RELEASE);
+	pthread_join(reader->thread, NULL);
+	free(reader->buffer);
+
+	slowlane_log(1, "Reader read %lu buffers (%lu bytes), %lu demux overflows, %lu queue stalls.", reader->reads, reader->bytes, reader->overflows, reader->queue->stalls);
+}
@@ -16,6 +16,213 @@
 #include "si.h"
 #include "crc32.h"
 #include "data.h"
+#include "event.h"
+#include "huffman.h"
+#include "text.h"
+#include "store.h"
+#include "schema.h"
+
+/* Let whoever is listening know of a section accepted into the model,
+ * buffer being past the section header. */
+static void si_accepted (unsigned char *buffer, int buffer_length) {
+	ParseSettings *settings = &data_model->settings;
+
+	if (settings->section_callback) {
+		settings->section_callback(settings->section_user, buffer - 3, buffer_length + 3);
+	}
+}
+
+/* Move an accepted section into the model's store if we're retaining them,
+ * returning where to parse it from. buffer is past the section header. NULL
+ * if it couldn't be kept. */
+static unsigned char * si_retain (unsigned char *buffer, int buffer_length) {
+	SectionStore *store;
+	unsigned char *section;
+
+	si_accepted(buffer, buffer_length);
+
+	if (!data_model->settings.retain) {
+		return buffer;
+	}
+
+	if ((store = section_store(data_model, 1)) == NULL || (section = section_store_add(store, buffer - 3, buffer_length + 3)) == NULL) {
+		return NULL;
+	}
+
+	return section + 3;
+}
+
+/* What each descriptor is needed for, 0 for those always looked at. */
+static const unsigned char si_descriptor_demand[256] = {
+	[0x40] = SI_DEMAND_NETWORK_NAMES,
+	[0x43] = SI_DEMAND_TUNING,
+	[0x47] = SI_DEMAND_BOUQUET_NAMES,
+	[0x48] = SI_DEMAND_SERVICE_NAMES,
+	[0x49] = SI_DEMAND_OTHER,
+	[0x4d] = SI_DEMAND_EVENTS,
+	[0xc0] = SI_DEMAND_SERVICE_NAMES
+};
+
+/* The descriptor loops each parsed descriptor is allowed in, one bit for
+ * each of SCHEMA_NETWORK to SCHEMA_EVENT. Anywhere else it's stepped over, so
+ * a tag can't have its parser write into what another loop describes. */
+static const unsigned char si_descriptor_loops[256] = {
+	[0x40] = 1 << SCHEMA_NETWORK,
+	[0x43] = 1 << SCHEMA_NETWORK_TRANSPORT,
+	[0x47] = 1 << SCHEMA_BOUQUET,
+	[0x48] = 1 << SCHEMA_SERVICE,
+	[0x49] = 1 << SCHEMA_SERVICE | 1 << SCHEMA_BOUQUET,
+	[0x4d] = 1 << SCHEMA_EVENT,
+	[0xb1] = 1 << SCHEMA_BOUQUET_TRANSPORT,
+	[0xc0] = 1 << SCHEMA_SERVICE
+};
+
+static const char *si_loop_names[SCHEMA_LOOPS] = { "OpenTV record", "NIT network", "NIT transport", "SDT service", "BAT bouquet", "BAT transport", "EIT event" };
+
+/* A view of the length prefixed DVB string at data, into the section when
+ * it's retained, otherwise interned. */
+static TextView si_text (unsigned char *data) {
+	TextView view = { data };
+
+	return data_model->settings.retain ? view : text_intern(data + 1, data[0]);
+}
+
+/* Section layouts, see SchemaLayout. */
+static const SchemaLayout si_nit_layout = { "NIT", si_network_header_size, si_network_header_descriptors_length_offset, SCHEMA_NETWORK, 1, si_transport_entry_size, si_transport_entry_descriptors_length_offset, SCHEMA_NETWORK_TRANSPORT };
+static const SchemaLayout si_bat_layout = { "BAT", si_network_header_size, si_network_header_descriptors_length_offset, SCHEMA_BOUQUET, 1, si_transport_entry_size, si_transport_entry_descriptors_length_offset, SCHEMA_BOUQUET_TRANSPORT };
+static const SchemaLayout si_sdt_layout = { "SDT", si_sdt_header_size, -1, SCHEMA_RECORDS, 0, si_service_entry_size, si_service_entry_descriptors_length_offset, SCHEMA_SERVICE };
+static const SchemaLayout si_eit_layout = { "EIT", si_eit_header_size, -1, SCHEMA_RECORDS, 0, si_event_entry_size, si_event_entry_descriptors_length_offset, SCHEMA_EVENT };
+static const SchemaLayout si_opentv_layout = { "OpenTV", si_opentv_header_size, -1, SCHEMA_RECORDS, 0, si_opentv_event_entry_size, si_opentv_event_entry_descriptors_length_offset, SCHEMA_RECORDS };
+
+/* Does a descriptor which will be parsed hold everything its parser reads? */
+static int si_valid_descriptor (unsigned char tag, const unsigned char *data, int length) {
+	SiServiceDescriptor service;
+	SiShortEvent short_event;
+	int position;
+
+	switch (tag) {
+		case 0x43:
+			return length >= si_satellite_delivery_size;
+
+		case 0x48:
+			if (length < si_service_descriptor_size) {
+				return 0;
+			}
+
+			si_service_descriptor_read(data, &service);
+			position = si_service_descriptor_size + service.provider_name_length;
+
+			return position < length && position + 1 + data[position] <= length;
+
+		case 0x49:
+			return length >= si_country_availability_size;
+
+		case 0x4d:
+			if (length < si_short_event_size) {
+				return 0;
+			}
+
+			si_short_event_read(data, &short_event);
+			position = si_short_event_size + short_event.event_name_length;
+
+			return position < length && position + 1 + data[position] <= length;
+
+		case 0xb1:
+			return length >= si_opentv_channels_size && (length - si_opentv_channels_size) % si_opentv_channel_size == 0;
+	}
+
+	return 1;
+}
+
+/* Does a descriptor loop fill exactly its length, with every descriptor
+ * which will be parsed in a loop of its kind whole? OpenTV records are only
+ * checked to fit. */
+static int si_valid_descriptors (const unsigned char *data, int length, int loop) {
+	SiDescriptor descriptor;
+	int position;
+
+	for (position = 0; position < length; position += si_descriptor_size + descriptor.length) {
+		if (position + si_descriptor_size > length) {
+			return 0;
+		}
+
+		si_descriptor_read(data + position, &descriptor);
+
+		if (position + si_descriptor_size + (int) descriptor.length > length) {
+			return 0;
+		}
+
+		if (loop == SCHEMA_RECORDS || !(si_descriptor_loops[descriptor.tag] & (1 << loop)) || (si_descriptor_demand[descriptor.tag] && !(si_descriptor_demand[descriptor.tag] & data_model->settings.demand))) {
+			continue;
+		}
+
+		if (!si_valid_descriptor(descriptor.tag, data + position + si_descriptor_size, descriptor.length)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* Check every length in a section against what holds it, in one pass before
+ * anything is taken from it, so the parsers can read without checking.
+ * buffer is past the section header and ends with the CRC. */
+static int si_valid (const SchemaLayout *layout, const unsigned char *buffer, int buffer_length) {
+	int end = buffer_length - 4, loop_end = end, position = layout->header_size, length;
+	SiLoop loop;
+
+	if (position > end) {
+		slowlane_log(1, "%s not long enough for its header, size was %i.", layout->name, buffer_length);
+		return 0;
+	}
+
+	if (layout->header_descriptors >= 0) {
+		length = schema_read2(buffer + layout->header_descriptors) & 0x0fff;
+
+		if (position + length > end || !si_valid_descriptors(buffer + position, length, layout->header_loop)) {
+			slowlane_log(1, "%s descriptors malformed or overrun the section, position was %i in %i, length %i.", layout->name, position, buffer_length, length);
+			return 0;
+		}
+
+		position += length;
+	}
+
+	if (layout->loop) {
+		if (position + si_loop_size > end) {
+			slowlane_log(1, "%s not long enough for its loop length, position was %i in %i.", layout->name, position, buffer_length);
+			return 0;
+		}
+
+		si_loop_read(buffer + position, &loop);
+		position += si_loop_size;
+
+		if (position + (int) loop.length > end) {
+			slowlane_log(1, "%s loop overruns the section, position was %i in %i, length %u.", layout->name, position, buffer_length, loop.length);
+			return 0;
+		}
+
+		loop_end = position + loop.length;
+	}
+
+	while (position < loop_end) {
+		if (position + layout->entry_size > loop_end) {
+			slowlane_log(1, "%s loop not long enough for basic data, position was %i in %i.", layout->name, position, loop_end);
+			return 0;
+		}
+
+		length = schema_read2(buffer + position + layout->entry_descriptors) & 0x0fff;
+		position += layout->entry_size;
+
+		if (position + length > loop_end || !si_valid_descriptors(buffer + position, length, layout->entry_loop)) {
+			slowlane_log(1, "%s entry descriptors malformed or overrun the loop, position was %i in %i, length %i.", layout->name, position, loop_end, length);
+			return 0;
+		}
+
+		position += length;
+	}
+
+	return 1;
+}
 
 /* Process a SI packet received. Returns -1 serious error, lenght of processed bytes. */
 int si_process(unsigned char *buffer, int buffer_length, int internal_crc) {
@@ -64,6 +271,29 @@ int si_process(unsigned char *buffer, int buffer_length, int internal_crc) {
 	/* Let user know if they've asked for this level. */
 	slowlane_log(2, "Valid %x packet recieved, length is %i which leaves %i bytes in buffer.", table_type, table_length + 3, buffer_length - table_length - 3);
 
+	si_process_section(buffer, table_length + 3);
+
+	return table_length + 3;
+}
+
+/* Length of the section at the start of buffer, 0 if it isn't all there yet. No CRC check. */
+int si_section_length(unsigned char *buffer, int buffer_length) {
+	int section_length;
+
+	if (buffer_length < 3) {
+		return 0;
+	}
+
+	section_length = (((buffer[1] & 0x0f) << 8) | buffer[2]) + 3;
+
+	return section_length > buffer_length ? 0 : section_length;
+}
+
+/* Process a whole section which has already been checked by si_process. */
+int si_process_section(unsigned char *buffer, int section_length) {
+	unsigned char table_type = buffer[0];
+	unsigned short table_length = section_length - 3;
+
 	/* Switch based on table_type. */
 	switch (table_type) {
 		case 0x40: /* Network Information Table - This Mux */
@@ -84,544 +314,886 @@ int si_process(unsigned char *buffer, int buffer_length, int internal_crc) {
 			break;
 
 		default:
+			/* Event Information Table - Present/Following and Schedule, This Mux and Other Muxes */
+			if (table_type >= EVENT_TABLE_FIRST && table_type <= EVENT_TABLE_LAST) {
+				slowlane_log(3, "Packet identified as EIT, passing %i bytes to si_process_eit.", table_length);
+				si_process_eit(table_type, buffer + 3, table_length);
+				break;
+			}
+
+			/* OpenTV EPG - Titles and Summaries */
+			if (event_table_opentv(table_type) && data_model->settings.opentv_dictionary) {
+				slowlane_log(3, "Packet identified as OpenTV EPG, passing %i bytes to si_process_opentv.", table_length);
+
+				if (table_type <= EVENT_OPENTV_TITLE_LAST) {
+					si_process_opentv_title(table_type, buffer + 3, table_length);
+				} else {
+					si_process_opentv_summary(table_type, buffer + 3, table_length);
+				}
+
+				break;
+			}
+
 			slowlane_log(1, "Valid, but unknown table 0x%x of size %i was received.", table_type, table_length + 3);
 			break;
 	}
 
-	return table_length + 3;
+	return 0;
 }
 
 /* Process NIT packet. */
 int si_process_nit(unsigned char *buffer, int buffer_length) {
-	unsigned short network_id, network_descriptors_length, transport_stream_loop_length, transport_stream_id, original_network_id, transport_descriptors_length;
-	unsigned char version, section_number, last_section_number;
-	int position;
+	SiNetworkHeader header;
+	SiTransportEntry entry;
+	SiLoop loop;
+	int position, end;
 	Network *network;
 	Transport *transport;
 
-	/* Sanity check. */
-	if (buffer_length <= 7) {
-		slowlane_log(1, "NIT not long enough for basic no looped data, size was %i.", buffer_length);
+	if (!si_valid(&si_nit_layout, buffer, buffer_length)) {
 		return -1;
 	}
 
-	network_id = (buffer[0] << 8) | buffer[1];
-        version = (buffer[2] & 0x3e) >> 1;
-        section_number = buffer[3];
-        last_section_number = buffer[4];
-	network_descriptors_length = ((buffer[5] & 0x0f) << 8) | buffer[6];
+	si_network_header_read(buffer, &header);
 
         /* Display basic Nit data. */
-        slowlane_log(3, "Network: ID: %i Version: %i Section: %i Last: %i", network_id, version, section_number, last_section_number);
+        slowlane_log(3, "Network: ID: %i Version: %i Section: %i Last: %i", header.id, header.version, header.section_number, header.last_section_number);
 
 	/* Find network. */
-	network = network_get(network_id);
+	network = network_get(header.id);
 
 	if (!network) {
-		network = network_new();
-		network->network_id = network_id;
-		network->sections.last_section = last_section_number;
-		network->sections.version = version;
-		network_add(network);
+		if ((network = network_add(header.id)) == NULL) {
+			return -1;
+		}
+
+		network->sections.last_section = header.last_section_number;
+		network->sections.version = header.version;
 	} else {
-		if (network->sections.version != version) {
-	                slowlane_log(1, "Warning version of NIT has changed! Previous is %i and now %i!", network->sections.version, version);
+		if (network->sections.version != header.version) {
+	                slowlane_log(1, "Warning version of NIT has changed! Previous is %i and now %i!", network->sections.version, header.version);
 		}
 	}
 
-	if (network->sections.received_section[section_number]) {
-		slowlane_log(3, "Section already received (%i)", section_number);
+	if (section_tracking_received(&network->sections, header.section_number)) {
+		slowlane_log(3, "Section already received (%i)", header.section_number);
 		return 0;
 	} else {
-		network->sections.received_section[section_number] = 1;
-		slowlane_log(3, "New section received (%i)", section_number);
+		section_tracking_set(&network->sections, header.section_number);
+		slowlane_log(3, "New section received (%i)", header.section_number);
+	}
+
+	if ((buffer = si_retain(buffer, buffer_length)) == NULL) {
+		return -1;
 	}
 
 	/* Set processing position at the end of the header. */
-	position = 7;
+	position = si_network_header_size;
 
 	/* Process descriptors */
-	si_process_descriptors(buffer+position, network_descriptors_length, network);
-	position += network_descriptors_length;
-
-        /* Get size of the next loop. */
-        transport_stream_loop_length = ((buffer[position] & 0x0f) << 8) | buffer[position+1];
-        position += 2;
+	si_process_network_descriptors(buffer+position, header.descriptors_length, network);
+	position += header.descriptors_length;
 
-        /* Loop through the services until we hit the end of the buffer. */
-        while (position < (buffer_length - 4)) {
-                /* Sanity check. */
-                if ((buffer_length - position) <= 6) {
-                        slowlane_log(1, "NIT service loop not long enough for basic data, position was %i in %i.", position, buffer_length);
-                        return -1;
-                }
+	/* The transport streams fill the loop. */
+	si_loop_read(buffer + position, &loop);
+	position += si_loop_size;
 
+	for (end = position + loop.length; position < end; position += entry.descriptors_length) {
 		/* Get TS Details. */
-		transport_stream_id = (buffer[position] << 8) | buffer[position + 1];
-		original_network_id = (buffer[position + 2] << 8) | buffer[position + 3];
-		transport_descriptors_length = ((buffer[position + 4] & 0x0f) << 8) | buffer[position + 5];
-		position += 6;
+		si_transport_entry_read(buffer + position, &entry);
+		position += si_transport_entry_size;
 
 		/* Display TS details. */
-		slowlane_log(3, "Network TS ID: %i Original Network ID: %i", transport_stream_id, original_network_id);
+		slowlane_log(3, "Network TS ID: %i Original Network ID: %i", entry.transport_stream_id, entry.original_network_id);
 
-		transport = transport_new();
-		transport->original_network_id = original_network_id;
-		transport->transport_id = transport_stream_id;
+		if ((transport = transport_add(network, entry.original_network_id, entry.transport_stream_id)) == NULL) {
+			return -1;
+		}
 
 		/* Fetch TS details. */
-		si_process_descriptors(buffer+position, transport_descriptors_length, transport);
-		position += transport_descriptors_length;
-
-		transport_add(network, transport);
-	}	
+		si_process_network_transport_descriptors(buffer+position, entry.descriptors_length, transport);
+	}
 
 	return 0;
 }
 
 /* Process SDT packet. */
 int si_process_sdt(unsigned char *buffer, int buffer_length) {
-	unsigned short transport_stream_id, original_network_id, service_id, descriptors_loop_length;
-	unsigned char version, section_number, last_section_number, running_mode, free_ca_mode;
+	SiSdtHeader header;
+	SiServiceEntry entry;
 	int position;
+	Network *network;
 	Transport *transport;
 	Service *service;
 
-	/* Sanity check. */
-	if (buffer_length <= 8) {
-		slowlane_log(1, "SDT not long enough for basic no looped data, size was %i.", buffer_length);
+	if (!si_valid(&si_sdt_layout, buffer, buffer_length)) {
 		return -1;
 	}
 
-	/* Extract all basic data. */
-	transport_stream_id = (buffer[0] << 8) | buffer[1];
-	version = (buffer[2] & 0x3e) >> 1;
-	section_number = buffer[3];
-	last_section_number = buffer[4];
-	original_network_id = (buffer[5] << 8) | buffer[6];
+	si_sdt_header_read(buffer, &header);
 
 	/* Display basic SDT data. */
-	slowlane_log(3, "SDT: TS_ID: %i Version: %i Section: %i Last: %i Original Net: %i", transport_stream_id, version, section_number, last_section_number, original_network_id);
+	slowlane_log(3, "SDT: TS_ID: %i Version: %i Section: %i Last: %i Original Net: %i", header.transport_stream_id, header.version, header.section_number, header.last_section_number, header.original_network_id);
 
 	/* Find transport. */
-	transport = transport_get_with_original_network_id(original_network_id, transport_stream_id);
+	transport = transport_get_with_original_network_id(header.original_network_id, header.transport_stream_id);
+
+	/* A shard may not have seen the NIT, keep the services on a stand in transport for the merge. */
+	if (!transport && data_model->shard) {
+		if ((network = network_get(header.original_network_id)) == NULL && (network = network_add(header.original_network_id)) == NULL) {
+			return -1;
+		}
+
+		transport = transport_add(network, header.original_network_id, header.transport_stream_id);
+	}
 
 	if (!transport) {
-		slowlane_log(1, "Could not find transport for TS %i on ONID %i!", transport_stream_id, original_network_id);
+		slowlane_log(1, "Could not find transport for TS %i on ONID %i!", header.transport_stream_id, header.original_network_id);
 		return -1;
 	} else {
 		if (transport->sections.populated == 0) {
-			transport->sections.last_section = last_section_number;
-			transport->sections.version = version;
+			transport->sections.last_section = header.last_section_number;
+			transport->sections.version = header.version;
 			transport->sections.populated = 1;
-		} else if (transport->sections.version != version) {
-	                slowlane_log(1, "Warning version of SDT has changed! Previous is %i and now %i!", transport->sections.version, version);
+		} else if (transport->sections.version != header.version) {
+	                slowlane_log(1, "Warning version of SDT has changed! Previous is %i and now %i!", transport->sections.version, header.version);
 		}
 	}
 
-	if (transport->sections.received_section[section_number]) {
-		slowlane_log(3, "Section already received (%i)", section_number);
+	if (section_tracking_received(&transport->sections, header.section_number)) {
+		slowlane_log(3, "Section already received (%i)", header.section_number);
 		return 0;
 	} else {
-		transport->sections.received_section[section_number] = 1;
-		slowlane_log(3, "New section received (%i)", section_number);
+		section_tracking_set(&transport->sections, header.section_number);
+		slowlane_log(3, "New section received (%i)", header.section_number);
 	}
 
-	/* Set processing position at the end of the header. */
-	position = 8;
-
-	/* Loop through the services until we hit the end of the buffer. */
-	while (position < (buffer_length - 4)) {
-		/* Sanity check. */
-		if ((buffer_length - position) <= 5) {
-			slowlane_log(1, "SDT service loop not long enough for basic data, position was %i in %i.", position, buffer_length);
-			return -1;
-		}
+	if ((buffer = si_retain(buffer, buffer_length)) == NULL) {
+		return -1;
+	}
 
-		service_id = (buffer[position] << 8) | buffer[position + 1];
-		running_mode = (buffer[position+3] & 0xe0) >> 5;
-		free_ca_mode = (buffer[position+3] & 0x10) >> 4;
-		descriptors_loop_length = ((buffer[position + 3] & 0x0f) << 8) | buffer[position + 4];
+	/* The services run from the end of the header to the CRC. */
+	for (position = si_sdt_header_size; position < buffer_length - 4; position += entry.descriptors_length) {
+		si_service_entry_read(buffer + position, &entry);
 
 		/* Display service found. */
-		slowlane_log(3, "SDT: Service: %i Running: %i Free CA: %i Descriptors: %i", service_id, running_mode, free_ca_mode, descriptors_loop_length);
+		slowlane_log(3, "SDT: Service: %i Running: %i Free CA: %i Descriptors: %i", entry.service_id, entry.running, entry.free_ca, entry.descriptors_length);
 
-		service = service_new();
-		service->service_id = service_id;
-		service->running = running_mode;
-		service->free_ca = free_ca_mode;
-		service_add(transport, service);
+		if ((service = service_add(transport, entry.service_id)) == NULL) {
+			return -1;
+		}
+
+		service->running = entry.running;
+		service->free_ca = entry.free_ca;
 
 		/* Move position on beyond service header. */
-		position += 5;
+		position += si_service_entry_size;
 
 		/* Process descriptors */
-		si_process_descriptors(buffer+position, descriptors_loop_length, service);
-		position += descriptors_loop_length;
+		si_process_service_descriptors(buffer+position, entry.descriptors_length, service);
 	}
 
 	return 0;
 }
 
+static int si_process_bat_transports(Bouquet *bouquet, unsigned char *buffer, int position);
+
 /* Process BAT packet. */
 int si_process_bat(unsigned char *buffer, int buffer_length) {
-	unsigned short bouquet_id, bouquet_descriptors_length, transport_stream_loop_length, transport_stream_id, original_network_id, transport_descriptors_length;
-	unsigned char version, section_number, last_section_number;
+	SiNetworkHeader header;
 	int position;
 	Bouquet *bouquet;
-	OpenTVChannel *channel;
 
-	/* Sanity check. */
-	if (buffer_length <= 7) {
-		slowlane_log(1, "BAT not long enough for basic no looped data, size was %i.", buffer_length);
+	if (!si_valid(&si_bat_layout, buffer, buffer_length)) {
 		return -1;
 	}
 
-	bouquet_id = (buffer[0] << 8) | buffer[1];
-        version = (buffer[2] & 0x3e) >> 1;
-        section_number = buffer[3];
-        last_section_number = buffer[4];
-	bouquet_descriptors_length = ((buffer[5] & 0x0f) << 8) | buffer[6];
+	si_network_header_read(buffer, &header);
 
         /* Display basic Bouquet data. */
-        slowlane_log(3, "Bouquet: ID: %i Version: %i Section: %i Last: %i", bouquet_id, version, section_number, last_section_number);
+        slowlane_log(3, "Bouquet: ID: %i Version: %i Section: %i Last: %i", header.id, header.version, header.section_number, header.last_section_number);
 
 	/* Find bouquet. */
-	bouquet = bouquet_get(bouquet_id);
+	bouquet = bouquet_get(header.id);
 
 	if (!bouquet) {
-		bouquet = bouquet_new();
-		bouquet->bouquet_id = bouquet_id;
-		bouquet->sections.last_section = last_section_number;
-		bouquet->sections.version = version;
-		bouquet_add(bouquet);
+		if ((bouquet = bouquet_add(header.id)) == NULL) {
+			return -1;
+		}
+
+		bouquet->sections.last_section = header.last_section_number;
+		bouquet->sections.version = header.version;
 	} else {
-		if (bouquet->sections.version != version) {
-	                slowlane_log(1, "Warning version of BAT has changed! Previous is %i and now %i!", bouquet->sections.version, version);
+		if (bouquet->sections.version != header.version) {
+	                slowlane_log(1, "Warning version of BAT has changed! Previous is %i and now %i!", bouquet->sections.version, header.version);
 		}
 	}
 
-	if (bouquet->sections.received_section[section_number]) {
-		slowlane_log(3, "Section already received (%i)", section_number);
+	if (section_tracking_received(&bouquet->sections, header.section_number)) {
+		slowlane_log(3, "Section already received (%i)", header.section_number);
 		return 0;
 	} else {
-		bouquet->sections.received_section[section_number] = 1;
-		slowlane_log(3, "New section received (%i)", section_number);
+		section_tracking_set(&bouquet->sections, header.section_number);
+		slowlane_log(3, "New section received (%i)", header.section_number);
+	}
+
+	if ((buffer = si_retain(buffer, buffer_length)) == NULL) {
+		return -1;
 	}
 
         /* Set processing position at the end of the header. */
-        position = 7;
+        position = si_network_header_size;
 
 	/* Process descriptors */
-	si_process_descriptors(buffer+position, bouquet_descriptors_length, bouquet);
-	position += bouquet_descriptors_length;
+	si_process_bouquet_descriptors(buffer+position, header.descriptors_length, bouquet);
+	position += header.descriptors_length;
+
+	/* Channels nobody asked for are left in the section, they can be loaded
+	 * later if it's retained. */
+	if (!(data_model->settings.demand & SI_DEMAND_CHANNELS) || (data_model->settings.demand_bouquet_id && data_model->settings.demand_bouquet_id != header.id)) {
+		bouquet->deferred = 1;
+		return 0;
+	}
+
+	return si_process_bat_transports(bouquet, buffer, position);
+}
+
+/* The transport stream loop of a validated BAT section, from position. */
+static int si_process_bat_transports(Bouquet *bouquet, unsigned char *buffer, int position) {
+	SiTransportEntry entry;
+	OpenTVChannel channel;
+	SiLoop loop;
+	int end;
 
 	/* Get size of the next loop. */
-	transport_stream_loop_length = ((buffer[position] & 0x0f) << 8) | buffer[position+1];
-	position += 2;
+	si_loop_read(buffer + position, &loop);
+	position += si_loop_size;
 
 	/* Loop through transport streams */
-	while (position < (buffer_length - 4)) {
-		/* Sanity Check */
-		if ((buffer_length - position) <= 6) {
-			slowlane_log(1, "BAT service loop not long enough for basic data, position was %i in %i.", position, buffer_length);
-			return -1;
-		}
-
+	for (end = position + loop.length; position < end; position += entry.descriptors_length) {
 		/* Extract data. */
-		transport_stream_id = (buffer[position] << 8) | buffer[position + 1];
-		original_network_id = (buffer[position + 2] << 8) | buffer[position + 3];
-		transport_descriptors_length = ((buffer[position + 4] & 0x0f) << 8) | buffer[position + 5];
-		position += 6;
+		si_transport_entry_read(buffer + position, &entry);
+		position += si_transport_entry_size;
 
         	/* Display stream Bouquet data. */
-	        slowlane_log(3, "Bouquet Stream: Transport ID: %i Original Network: %i", transport_stream_id, original_network_id);
+	        slowlane_log(3, "Bouquet Stream: Transport ID: %i Original Network: %i", entry.transport_stream_id, entry.original_network_id);
 
-		channel = opentv_channel_new();
-		channel->transport_id = transport_stream_id;
-		channel->original_network_id = original_network_id;
-		channel->bouquet = bouquet;
+		/* Template for the channels found in the descriptors. */
+		memset(&channel, '\0', sizeof(OpenTVChannel));
+		channel.transport_id = entry.transport_stream_id;
+		channel.original_network_id = entry.original_network_id;
+		channel.bouquet = bouquet_lookup(bouquet->bouquet_id);
 
 		/* Extract descriptors. */
-                si_process_descriptors(buffer+position, transport_descriptors_length, channel);
-		position += transport_descriptors_length;
+                si_process_bouquet_transport_descriptors(buffer+position, entry.descriptors_length, &channel);
 	}
 
 	return 0;
 }
 
-int si_process_descriptors(unsigned char *buffer, int buffer_length, void *object) {
-	int position = 0, desc_pos;
-	unsigned char descriptor_id, descriptor_length;
+/* Decode the channels of deferred bouquets from their retained sections, all
+ * of them or just the one asked for. Returns -1 if any weren't retained. */
+int si_load_bouquets(unsigned short bouquet_id) {
+	unsigned char *section;
+	int section_length, section_number, retval = 0;
+	SiNetworkHeader header;
+	Bouquet *bouquet;
 
-	/* Loop through descriptors. */
-	while (position < buffer_length) {
-		if ((buffer_length - position) <= 2) {
-			slowlane_log(1, "Descriptor loop not long enough for basic data, position was %i in %i.", position, buffer_length);
-			return -1;
+	for (bouquet = bouquet_at(data_model->bouquet_list); bouquet != NULL; bouquet = bouquet_at(bouquet->next)) {
+		if (!bouquet->deferred || (bouquet_id && bouquet_id != bouquet->bouquet_id)) {
+			continue;
 		}
 
-		/* Obtain id and length. */
-		descriptor_id = buffer[position];
-		descriptor_length = buffer[position + 1];
-		position += 2;
+		if (data_model->sections == NULL) {
+			slowlane_log(1, "Channels for bouquet %i weren't decoded and its sections weren't retained.", bouquet->bouquet_id);
+			retval = -1;
+			continue;
+		}
 
-		slowlane_log(3, "Descriptor: ID: %x Length: %i", descriptor_id, descriptor_length);
+		for (section_number = 0; section_number <= bouquet->sections.last_section; section_number++) {
+			if ((section = section_store_get(data_model->sections, section_store_key(0x4a, 0, bouquet->bouquet_id, section_number), &section_length)) == NULL) {
+				continue;
+			}
 
-		/* Sanity check. */		
-		if ((buffer_length - position) < descriptor_length) {
-                        slowlane_log(1, "Not enough data in buffer to pass to descriptor function, position was %i in %i, descriptor length is %i.", position, buffer_length, descriptor_length);
-                        return -1;
+			/* The section was validated when it arrived. */
+			si_network_header_read(section + 3, &header);
+			si_process_bat_transports(bouquet, section + 3, si_network_header_size + header.descriptors_length);
 		}
 
-		switch(descriptor_id) {
-			case 0x43: /* Satellite Delivery System */
-				si_process_descriptor_satellite_delivery_system(buffer+position, descriptor_length, (Transport *) object);
-				break;
+		bouquet->deferred = 0;
+		slowlane_log(2, "Loaded channels for bouquet %i from retained sections.", bouquet->bouquet_id);
+	}
 
-			case 0xc0: /* Hidden Display Name (On Demand Channels + Adult) */
-				si_process_descriptor_generic_name(buffer+position, descriptor_length, &(((Service *) object)->alt_name));
-				break;
+	return retval;
+}
 
-			case 0x40: /* Network Name */
-				si_process_descriptor_generic_name(buffer+position, descriptor_length, &(((Network *) object)->name));
-				break;
+/* BCD digits, most significant first. */
+static unsigned int si_bcd (unsigned int value, int digits) {
+	unsigned int result = 0;
+	int shift;
 
-			case 0x47: /* Bouquet Name */
-				si_process_descriptor_generic_name(buffer+position, descriptor_length, &(((Bouquet *) object)->name));
-				break;
+	for (shift = (digits - 1) * 4; shift >= 0; shift -= 4) {
+		result = result * 10 + ((value >> shift) & 0x0f);
+	}
 
-			case 0x48: /* Service Descriptor */
-				si_process_descriptor_service(buffer+position, descriptor_length, (Service *) object);
-				break;
+	return result;
+}
 
-			case 0x49: /* Country Available */
-				si_process_descriptor_country_availability(buffer+position, descriptor_length);
-				break;
+/* Six BCD digits of hours, minutes and seconds in seconds. */
+static unsigned int si_bcd_time (unsigned int value) {
+	return si_bcd(value >> 16, 2) * 3600 + si_bcd((value >> 8) & 0xff, 2) * 60 + si_bcd(value & 0xff, 2);
+}
 
-			case 0xb1: /* MediaHighway Propriatary - Channel Information. */
-				si_process_descriptor_opentv_channel_information(buffer+position, descriptor_length, (OpenTVChannel *) object);
-				break;
+/* Track a section of an event table, returns NULL for a repeat. */
+static SectionTracking * si_event_section (EventStore *store, EventService *service, unsigned char table_id, unsigned char version, unsigned char section_number, unsigned char last_section_number) {
+	SectionTracking *sections = event_tracking(service, table_id);
 
-			case 0x41: /* Service link. */
-			case 0x4a: /* Linkage Descriptor */
-			case 0x4b: /* NVOD Reference. */
-			case 0x4c: /* Time Shifted Service */
-			case 0x5f: /* Private data specifier. */
-			case 0xb2: /* On screen message (Possibly Huffmann) */
-				break;
-			default:
-				slowlane_log(2, "Unhandled descriptor id %x.", descriptor_id);
-			
-				if (verbose > 2) {
-					for (desc_pos = 0; desc_pos < descriptor_length; desc_pos++) {
-						printf("%x ", (buffer+position)[desc_pos]);
-					}
-					printf("\n");
-				}
-				break;
+	store->sections++;
+
+	/* Events change all the time, a new version starts the table again. */
+	if (sections->populated && sections->version != version) {
+		slowlane_log(2, "Event table 0x%x for service %i moved from version %i to %i.", table_id, service->service_id, sections->version, version);
+		memset(sections, '\0', sizeof(SectionTracking));
+	}
+
+	if (sections->populated == 0) {
+		sections->last_section = last_section_number;
+		sections->version = version;
+		sections->populated = 1;
+	}
+
+	/* Repeats are by far the most of what's received, drop them before looking at any events. */
+	if (section_tracking_received(sections, section_number)) {
+		slowlane_log(3, "Section already received (%i)", section_number);
+		store->repeats++;
+		return NULL;
+	}
+
+	section_tracking_set(sections, section_number);
+
+	return sections;
+}
+
+/* Process EIT packet. */
+static int si_process_event_descriptors(unsigned char *buffer, int buffer_length, Event *event);
+
+int si_process_eit(unsigned char table_id, unsigned char *buffer, int buffer_length) {
+	SiEitHeader header;
+	SiEventEntry entry;
+	unsigned int start, duration;
+	int position;
+	EventStore *store;
+	EventService *service;
+	SectionTracking *sections;
+	Event *event;
+
+	if (!si_valid(&si_eit_layout, buffer, buffer_length)) {
+		return -1;
+	}
+
+	si_eit_header_read(buffer, &header);
+
+	slowlane_log(3, "EIT: Table: 0x%x Service: %i Version: %i Section: %i Last: %i Segment Last: %i TS_ID: %i Original Net: %i", table_id, header.service_id, header.version, header.section_number, header.last_section_number, header.segment_last_section_number, header.transport_stream_id, header.original_network_id);
+
+	if ((store = event_store(data_model, 1)) == NULL || (service = event_service_get(store, header.original_network_id, header.transport_stream_id, header.service_id, 1)) == NULL) {
+		return -1;
+	}
+
+	if ((sections = si_event_section(store, service, table_id, header.version, header.section_number, header.last_section_number)) == NULL) {
+		return 0;
+	}
+
+	si_accepted(buffer, buffer_length);
+
+	if (table_id >= 0x50) {
+		event_tracking_segment(sections, header.section_number, header.segment_last_section_number);
+
+		/* Actual and other share tracking, so only the table number matters. */
+		if ((header.last_table_id & 0x0f) >= (service->last_table_id & 0x0f)) {
+			service->last_table_id = header.last_table_id;
 		}
+	}
+
+	/* The events run from the end of the header to the CRC. */
+	for (position = si_eit_header_size; position < buffer_length - 4; position += si_event_entry_size + entry.descriptors_length) {
+		si_event_entry_read(buffer + position, &entry);
+
+		/* All ones for an NVOD reference event. */
+		if (entry.date == 0xffff) {
+			continue;
+		}
+
+		start = (entry.date - 40587) * 86400 + si_bcd_time(entry.start);
+		duration = si_bcd_time(entry.duration);
+
+		slowlane_log(3, "EIT: Event: %i Start: %u Duration: %u Descriptors: %i", entry.event_id, start, duration, entry.descriptors_length);
 
-		position += descriptor_length;
+		if ((event = event_add(store, service, start, duration, entry.event_id)) == NULL) {
+			return -1;
+		}
+
+		event->running = entry.running;
+		event->free_ca = entry.free_ca;
+
+		/* Process descriptors */
+		si_process_event_descriptors(buffer + position + si_event_entry_size, entry.descriptors_length, event);
 	}
 
 	return 0;
 }
 
-int si_process_descriptor_service(unsigned char *buffer, int buffer_length, Service *service) {
-	int position = 0;
-	unsigned char service_type, service_provider_name_length, service_name_length;
-	char service_provider_name[256], service_name[256];
+/* Process OpenTV title packet, events of one channel with their Huffman coded titles. */
+int si_process_opentv_title(unsigned char table_id, unsigned char *buffer, int buffer_length) {
+	SiOpenTVHeader header;
+	SiOpenTVEventEntry entry;
+	SiDescriptor record;
+	SiOpenTVTitle record_title;
+	unsigned int base, start, duration;
+	int position, end;
+	char title[1024];
+	EventStore *store;
+	EventService *service;
+	Event *event;
+
+	if (!si_valid(&si_opentv_layout, buffer, buffer_length)) {
+		return -1;
+	}
+
+	si_opentv_header_read(buffer, &header);
+
+	/* Start times are in two second units from this date. */
+	base = (header.date - 40587) * 86400;
+
+	slowlane_log(3, "OpenTV Title: Table: 0x%x Channel: %i Version: %i Section: %i Last: %i", table_id, header.channel_id, header.version, header.section_number, header.last_section_number);
 
-	/* Sanity check. */
-	if (buffer_length <= 2) {
-		slowlane_log(1, "Service descriptor not long enough for basic no looped data, size was %i.", buffer_length);
+	if ((store = event_store(data_model, 1)) == NULL || (service = event_service_get(store, 0, EVENT_OPENTV_TRANSPORT, header.channel_id, 1)) == NULL) {
 		return -1;
 	}
 
-	service_type = buffer[0];
-	service_provider_name_length = buffer[1];
-	position += 2;
+	if (si_event_section(store, service, table_id, header.version, header.section_number, header.last_section_number) == NULL) {
+		return 0;
+	}
+
+	si_accepted(buffer, buffer_length);
+
+	/* Loop through the events until we hit the end of the buffer. */
+	for (position = si_opentv_header_size; position < buffer_length - 4; position = end) {
+		si_opentv_event_entry_read(buffer + position, &entry);
+		end = position + si_opentv_event_entry_size + entry.descriptors_length;
+
+		for (position += si_opentv_event_entry_size; position < end; position += si_descriptor_size + record.length) {
+			si_descriptor_read(buffer + position, &record);
+
+			if (record.tag != 0xb5 || record.length < si_opentv_title_size) {
+				slowlane_log(3, "OpenTV title record 0x%x of %i bytes skipped.", record.tag, record.length);
+				continue;
+			}
+
+			si_opentv_title_read(buffer + position + si_descriptor_size, &record_title);
+			start = base + (record_title.start << 1);
+			duration = record_title.duration << 1;
+			huffman_decode(data_model->settings.opentv_dictionary, buffer + position + si_descriptor_size + si_opentv_title_size, record.length - si_opentv_title_size, title, sizeof(title));
+
+			slowlane_log(3, "OpenTV Title: Event: %i Start: %u Duration: %u Category: 0x%x Title: %s", entry.event_id, start, duration, record_title.category, title);
+
+			if ((event = event_add(store, service, start, duration, entry.event_id)) == NULL) {
+				return -1;
+			}
+
+			event->title = strdup(title);
+		}
+	}
+
+	return 0;
+}
 
-	/* Sanity check again. */
-	if ((buffer_length - position) <= service_provider_name_length) {
-		slowlane_log(1, "Not enough data for service provider name, position was %i in %i, size was %i.", position, buffer_length, service_provider_name_length);
+/* Process OpenTV summary packet, Huffman coded summaries by event id. */
+int si_process_opentv_summary(unsigned char table_id, unsigned char *buffer, int buffer_length) {
+	SiOpenTVHeader header;
+	SiOpenTVEventEntry entry;
+	SiDescriptor record;
+	int position, end;
+	char summary[4096];
+	EventStore *store;
+	EventService *service;
+
+	if (!si_valid(&si_opentv_layout, buffer, buffer_length)) {
 		return -1;
 	}
 
-	memcpy(&service_provider_name, buffer+position, service_provider_name_length);
-	service_provider_name[service_provider_name_length] = '\0';
-	position += service_provider_name_length;
+	si_opentv_header_read(buffer, &header);
 
-	service_name_length = buffer[position];
-	position += 1;
+	slowlane_log(3, "OpenTV Summary: Table: 0x%x Channel: %i Version: %i Section: %i Last: %i", table_id, header.channel_id, header.version, header.section_number, header.last_section_number);
 
-	/* Sanity check again. */
-	if ((buffer_length - position) < service_name_length) {
-		slowlane_log(1, "Not enough data for service name, position was %i in %i, size was %i.", position, buffer_length, service_name_length);
+	if ((store = event_store(data_model, 1)) == NULL || (service = event_service_get(store, 0, EVENT_OPENTV_TRANSPORT, header.channel_id, 1)) == NULL) {
 		return -1;
 	}
 
-        memcpy(&service_name, buffer+position, service_name_length);
-        service_name[service_name_length] = '\0';
-        position += service_name_length;
+	if (si_event_section(store, service, table_id, header.version, header.section_number, header.last_section_number) == NULL) {
+		return 0;
+	}
+
+	si_accepted(buffer, buffer_length);
+
+	for (position = si_opentv_header_size; position < buffer_length - 4; position = end) {
+		si_opentv_event_entry_read(buffer + position, &entry);
+		end = position + si_opentv_event_entry_size + entry.descriptors_length;
 
-	slowlane_log(3, "Descriptor: Name: %s Provider: %s Type: 0x%x", service_name, service_provider_name, service_type);
+		for (position += si_opentv_event_entry_size; position < end; position += si_descriptor_size + record.length) {
+			si_descriptor_read(buffer + position, &record);
 
-	service->name = strdup(service_name);
-	service->provider = strdup(service_provider_name);
-	service->type = service_type;
+			if (record.tag != 0xb9) {
+				slowlane_log(3, "OpenTV summary record 0x%x of %i bytes skipped.", record.tag, record.length);
+				continue;
+			}
+
+			huffman_decode(data_model->settings.opentv_dictionary, buffer + position + si_descriptor_size, record.length, summary, sizeof(summary));
+
+			slowlane_log(3, "OpenTV Summary: Event: %i Summary: %s", entry.event_id, summary);
+
+			if (event_text_add(service, entry.event_id, strdup(summary)) < 0) {
+				return -1;
+			}
+		}
+	}
 
 	return 0;
 }
 
-int si_process_descriptor_country_availability(unsigned char *buffer, int buffer_length) {
-        int position = 0;
-        unsigned char country_availability_flag;
-        char country[4];
+/* Should a descriptor from a loop of the given kind be parsed? Anything not
+ * allowed in that loop is stepped over, whatever its tag would have it be, as
+ * is anything the output doesn't need. */
+static int si_descriptor_wanted (int loop, SiDescriptor *descriptor, unsigned char *data) {
+	int desc_pos;
 
-        /* Sanity check. */
-        if (buffer_length <= 1) {
-                slowlane_log(1, "Country availability descriptor not long enough for basic no looped data, size was %i.", buffer_length);
-                return -1;
-        }
+	slowlane_log(3, "Descriptor: ID: %x Length: %i", descriptor->tag, descriptor->length);
+
+	if (si_descriptor_loops[descriptor->tag] & (1 << loop)) {
+		return !(si_descriptor_demand[descriptor->tag] && !(si_descriptor_demand[descriptor->tag] & data_model->settings.demand));
+	}
 
-	country_availability_flag = (buffer[0] & 0xe0) >> 7;
-	position += 1;
+	if (si_descriptor_loops[descriptor->tag]) {
+		slowlane_log(2, "Descriptor id %x isn't allowed in a %s loop, skipped.", descriptor->tag, si_loop_names[loop]);
+		return 0;
+	}
 
-        slowlane_log(3, "Country availability: Is Available: %i", country_availability_flag);	
+	switch(descriptor->tag) {
+		case 0x41: /* Service link. */
+		case 0x4a: /* Linkage Descriptor */
+		case 0x4b: /* NVOD Reference. */
+		case 0x4c: /* Time Shifted Service */
+		case 0x4e: /* Extended Event */
+		case 0x50: /* Component */
+		case 0x54: /* Content */
+		case 0x55: /* Parental Rating */
+		case 0x5f: /* Private data specifier. */
+		case 0xb2: /* On screen message (Possibly Huffmann) */
+			break;
+		default:
+			slowlane_log(2, "Unhandled descriptor id %x.", descriptor->tag);
 
-	while (position < buffer_length) {
-		memcpy(&country, buffer+position, 3);
-		country[3] = '\0';
-		position += 3;
-	        slowlane_log(3, "Country availability: %s", country);
+			if (verbose > 2) {
+				for (desc_pos = 0; desc_pos < (int) descriptor->length; desc_pos++) {
+					printf("%x ", data[desc_pos]);
+				}
+				printf("\n");
+			}
+			break;
 	}
 
-        return 0;
+	return 0;
 }
 
-int si_process_descriptor_generic_name(unsigned char *buffer, int buffer_length, char **obj_name) {
-	char name[256];
+/* The descriptor loops below are each validated by si_valid, and parse only
+ * the descriptors si_descriptor_loops allows in them. */
 
-	memcpy(&name, buffer, buffer_length);
-	name[buffer_length] = '\0';
+/* Process the descriptor loop of a NIT's network. */
+int si_process_network_descriptors(unsigned char *buffer, int buffer_length, Network *network) {
+	int position;
+	SiDescriptor descriptor;
+	unsigned char *data;
 
-	slowlane_log(3, "Name: %s", name);
+	for (position = 0; position < buffer_length; position += si_descriptor_size + descriptor.length) {
+		si_descriptor_read(buffer + position, &descriptor);
+		data = buffer + position + si_descriptor_size;
+
+		if (!si_descriptor_wanted(SCHEMA_NETWORK, &descriptor, data)) {
+			continue;
+		}
 
-	if (*obj_name) {
-		free(*obj_name);
+		switch(descriptor.tag) {
+			case 0x40: /* Network Name */
+				si_process_descriptor_generic_name(data, descriptor.length, &network->name);
+				break;
+		}
 	}
 
-	(*obj_name) = strdup(name);
+	return 0;
+}
+
+/* Process the descriptor loop of a transport in a NIT. */
+int si_process_network_transport_descriptors(unsigned char *buffer, int buffer_length, Transport *transport) {
+	int position;
+	SiDescriptor descriptor;
+	unsigned char *data;
+
+	for (position = 0; position < buffer_length; position += si_descriptor_size + descriptor.length) {
+		si_descriptor_read(buffer + position, &descriptor);
+		data = buffer + position + si_descriptor_size;
+
+		if (!si_descriptor_wanted(SCHEMA_NETWORK_TRANSPORT, &descriptor, data)) {
+			continue;
+		}
+
+		switch(descriptor.tag) {
+			case 0x43: /* Satellite Delivery System */
+				si_process_descriptor_satellite_delivery_system(data, descriptor.length, transport);
+				break;
+		}
+	}
 
 	return 0;
 }
 
-int si_process_descriptor_opentv_channel_information(unsigned char *buffer, int buffer_length, OpenTVChannel *channel) {
-	unsigned short service_id, channel_id, user_id, flags, transport_id, original_network_id;
-	unsigned char type, region;
-	int position = 0;
-	Bouquet *bouquet;
-        OpenTVChannel *our_channel;
+/* Process the descriptor loop of a service in a SDT. */
+int si_process_service_descriptors(unsigned char *buffer, int buffer_length, Service *service) {
+	int position;
+	SiDescriptor descriptor;
+	unsigned char *data;
 
-	transport_id = channel->transport_id;
-	original_network_id = channel->original_network_id;
-	bouquet = channel->bouquet;
+	for (position = 0; position < buffer_length; position += si_descriptor_size + descriptor.length) {
+		si_descriptor_read(buffer + position, &descriptor);
+		data = buffer + position + si_descriptor_size;
 
-/*	free(channel);
-*/
-	region = buffer[1];
-	slowlane_log(3, "OpenTV Region: %i", region);
+		if (!si_descriptor_wanted(SCHEMA_SERVICE, &descriptor, data)) {
+			continue;
+		}
 
-	position += 2;
+		switch(descriptor.tag) {
+			case 0x48: /* Service Descriptor */
+				si_process_descriptor_service(data, descriptor.length, service);
+				break;
 
-	while (position < buffer_length) {
-		if ((buffer_length - position) < 9) {
-			slowlane_log(1, "Unable to read OpenTV channel information, lack of buffer position is %i of %i.", position, buffer_length);
-			return -1;
+			case 0x49: /* Country Available */
+				si_process_descriptor_country_availability(data, descriptor.length);
+				break;
+
+			case 0xc0: /* Hidden Display Name (On Demand Channels + Adult) */
+				si_process_descriptor_generic_name(data, descriptor.length, &(service_names_set(service)->alt_name));
+				break;
 		}
+	}
+
+	return 0;
+}
 
-		service_id = (buffer[position] << 8) | buffer[position + 1];
-		type = buffer[position + 2];
-		channel_id = (buffer[position + 3] << 8) | buffer[position + 4];
-		user_id = (buffer[position + 5] << 8) | buffer[position + 6];
-		flags = (buffer[position + 7] << 8) | buffer[position + 8];
+/* Process the descriptor loop of a BAT's bouquet. */
+int si_process_bouquet_descriptors(unsigned char *buffer, int buffer_length, Bouquet *bouquet) {
+	int position;
+	SiDescriptor descriptor;
+	unsigned char *data;
 
-		slowlane_log(3, "OpenTV Channel: Service: %i Type: %i Channel: %i User: %i Flags: %x", service_id, type, channel_id, user_id, flags);
+	for (position = 0; position < buffer_length; position += si_descriptor_size + descriptor.length) {
+		si_descriptor_read(buffer + position, &descriptor);
+		data = buffer + position + si_descriptor_size;
 
-		our_channel = opentv_channel_new();
-		our_channel->transport_id = transport_id;
-		our_channel->original_network_id = original_network_id;
-		our_channel->bouquet = bouquet;
-		our_channel->service_id = service_id;
-		our_channel->type = type;
-		our_channel->channel_number = channel_id;
-		our_channel->user_number = user_id;
-		our_channel->flags = flags;
-		our_channel->region = region;
+		if (!si_descriptor_wanted(SCHEMA_BOUQUET, &descriptor, data)) {
+			continue;
+		}
 
-		opentv_channel_add(bouquet, our_channel);
+		switch(descriptor.tag) {
+			case 0x47: /* Bouquet Name */
+				si_process_descriptor_generic_name(data, descriptor.length, &bouquet->name);
+				break;
 
-		position += 9;
+			case 0x49: /* Country Available */
+				si_process_descriptor_country_availability(data, descriptor.length);
+				break;
+		}
 	}
 
 	return 0;
 }
 
-int si_process_descriptor_satellite_delivery_system(unsigned char *buffer, int buffer_length, Transport *transport) {
-	unsigned int frequency = 0, symbol_rate = 0, tmp;
-	unsigned short orbital_position = 0;
-	unsigned char west_east_flag, polarization, roll_off, modulation_system, modulation_type, fec, pos, bcd;
+/* Process the descriptor loop of a transport in a BAT, channel being the
+ * template for the channels found. */
+int si_process_bouquet_transport_descriptors(unsigned char *buffer, int buffer_length, OpenTVChannel *channel) {
+	int position;
+	SiDescriptor descriptor;
+	unsigned char *data;
+
+	for (position = 0; position < buffer_length; position += si_descriptor_size + descriptor.length) {
+		si_descriptor_read(buffer + position, &descriptor);
+		data = buffer + position + si_descriptor_size;
+
+		if (!si_descriptor_wanted(SCHEMA_BOUQUET_TRANSPORT, &descriptor, data)) {
+			continue;
+		}
+
+		switch(descriptor.tag) {
+			case 0xb1: /* MediaHighway Propriatary - Channel Information. */
+				si_process_descriptor_opentv_channel_information(data, descriptor.length, channel);
+				break;
+		}
+	}
+
+	return 0;
+}
+
+/* Process the descriptor loop of an EIT event. */
+static int si_process_event_descriptors(unsigned char *buffer, int buffer_length, Event *event) {
+	int position;
+	SiDescriptor descriptor;
+	unsigned char *data;
+
+	for (position = 0; position < buffer_length; position += si_descriptor_size + descriptor.length) {
+		si_descriptor_read(buffer + position, &descriptor);
+		data = buffer + position + si_descriptor_size;
+
+		if (!si_descriptor_wanted(SCHEMA_EVENT, &descriptor, data)) {
+			continue;
+		}
+
+		switch(descriptor.tag) {
+			case 0x4d: /* Short Event */
+				si_process_descriptor_short_event(data, descriptor.length, event);
+				break;
+		}
+	}
+
+	return 0;
+}
 
-	/* Calculate frequency from BCD. */
+/* The descriptor parsers below take descriptors si_valid_descriptor has passed. */
 
-	tmp = (buffer[0] << 24) + (buffer[1] << 16) + (buffer[2] << 8) + buffer[3];
+int si_process_descriptor_service(unsigned char *buffer, int buffer_length, Service *service) {
+	SiServiceDescriptor descriptor;
+	unsigned char *service_provider_name, *service_name;
+	ServiceNames *names;
+
+	si_service_descriptor_read(buffer, &descriptor);
+
+	/* Each name follows its length byte. */
+	service_provider_name = buffer + si_service_descriptor_size;
+	service_name = service_provider_name + descriptor.provider_name_length + 1;
+
+	names = service_names_set(service);
+	names->name = si_text(service_name - 1);
+	names->provider = si_text(service_provider_name - 1);
+	service->type = descriptor.service_type;
+
+	slowlane_log(3, "Descriptor: Name: %.*s Provider: %.*s Type: 0x%x", service_name[-1], service_name, descriptor.provider_name_length, service_provider_name, descriptor.service_type);
+
+	return 0;
+}
+
+int si_process_descriptor_country_availability(unsigned char *buffer, int buffer_length) {
+	SiCountryAvailability descriptor;
+	int position;
 
-	for (pos = 0; pos < 8; pos++) {
-		frequency *= 10;
-		bcd = (tmp & 0xf0000000) >> 28;
-		tmp = tmp << 4;
-		frequency += bcd;
+	si_country_availability_read(buffer, &descriptor);
+
+        slowlane_log(3, "Country availability: Is Available: %i", descriptor.flag);
+
+	/* Three letter country codes. */
+	for (position = si_country_availability_size; position + 3 <= buffer_length; position += 3) {
+	        slowlane_log(3, "Country availability: %.3s", buffer + position);
 	}
 
-        tmp = (buffer[4] << 8) + buffer[5];
+        return 0;
+}
+
+int si_process_descriptor_generic_name(unsigned char *buffer, int buffer_length, TextView *obj_name) {
+	/* The descriptor length is the string's length, the view points at it. */
+	(*obj_name) = si_text(buffer - 1);
+
+	slowlane_log(3, "Name: %.*s", buffer_length, buffer);
+
+	return 0;
+}
+
+int si_process_descriptor_short_event(unsigned char *buffer, int buffer_length, Event *event) {
+	SiShortEvent descriptor;
+	unsigned char *event_name, *event_text;
+	char event_name_text[TEXT_MAX], text[TEXT_MAX];
+
+	si_short_event_read(buffer, &descriptor);
 
-        for (pos = 0; pos < 4; pos++) {
-                orbital_position *= 10;
-                bcd = (tmp & 0xf000) >> 12;
-                tmp = tmp << 4;
-                orbital_position += bcd;
-        }
+	/* The text follows the name, after its own length. */
+	event_name = buffer + si_short_event_size;
+	event_text = event_name + descriptor.event_name_length + 1;
 
-	west_east_flag = (buffer[6] & 0x80) >> 7;
-	polarization = (buffer[6] & 0x60) >> 5;
-	roll_off = (buffer[6] & 0x18) >> 3;
-	modulation_system = (buffer[6] & 0x04) >> 2;
-	modulation_type = (buffer[6] & 0x03);
+	text_convert(event_name, descriptor.event_name_length, event_name_text, sizeof(event_name_text));
+	text_convert(event_text, event_text[-1], text, sizeof(text));
 
-	tmp = (buffer[7] << 24) + (buffer[8] << 16) + (buffer[9] << 8) + buffer[10];
+	slowlane_log(3, "Descriptor: Language: %.3s Event: %s Text: %s", buffer, event_name_text, text);
 
-	for (pos = 0; pos < 7; pos++) {
-		symbol_rate *= 10;
-		bcd = (tmp & 0xf0000000) >> 28;
-		tmp = tmp << 4;
-		symbol_rate += bcd;
+	free(event->title);
+	free(event->text);
+	event->title = strdup(event_name_text);
+	event->text = strdup(text);
+
+	return 0;
+}
+
+int si_process_descriptor_opentv_channel_information(unsigned char *buffer, int buffer_length, OpenTVChannel *channel) {
+	SiOpenTVChannels descriptor;
+	SiOpenTVChannel entry;
+	int position;
+	Bouquet *bouquet;
+        OpenTVChannel *our_channel;
+
+	bouquet = bouquet_at(channel->bouquet);
+
+	si_opentv_channels_read(buffer, &descriptor);
+	slowlane_log(3, "OpenTV Region: %i", descriptor.region);
+
+	/* Channels of regions which weren't asked for are never kept. */
+	if (!region_set_passes(&data_model->settings.demand_regions, descriptor.region)) {
+		return 0;
 	}
 
-	fec = (buffer[10] & 0x0f);
+	for (position = si_opentv_channels_size; position < buffer_length; position += si_opentv_channel_size) {
+		si_opentv_channel_read(buffer + position, &entry);
+
+		slowlane_log(3, "OpenTV Channel: Service: %i Type: %i Channel: %i User: %i Flags: %x", entry.service_id, entry.type, entry.channel_number, entry.user_number, entry.flags);
+
+		if ((our_channel = opentv_channel_add(bouquet)) == NULL) {
+			return -1;
+		}
+
+		our_channel->transport_id = channel->transport_id;
+		our_channel->original_network_id = channel->original_network_id;
+		our_channel->bouquet = channel->bouquet;
+		our_channel->service_id = entry.service_id;
+		our_channel->type = entry.type;
+		our_channel->channel_number = entry.channel_number;
+		our_channel->user_number = entry.user_number;
+		our_channel->flags = entry.flags;
+		our_channel->region = descriptor.region;
+	}
 
-	slowlane_log(3, "SDS: Freq: %i Symbol: %i Orbit: %i West/East: %i Polorization: %i Roll Off: %i ModSys: %i ModType: %i FEC: %i", frequency, symbol_rate, orbital_position, west_east_flag, polarization, roll_off, modulation_system, modulation_type, fec);
+	return 0;
+}
 
-	transport->modulation_system = modulation_system;
-	transport->frequency = frequency;
-	transport->symbol_rate = symbol_rate;
-	transport->polarization = polarization;
-	transport->modulation_type = modulation_type;
-	transport->fec = fec;
-	transport->roll_off = roll_off;
-	transport->orbital_position = orbital_position;
-	transport->west_east_flag = west_east_flag;
+int si_process_descriptor_satellite_delivery_system(unsigned char *buffer, int buffer_length, Transport *transport) {
+	SiSatelliteDelivery descriptor;
+	TransportTuning *tuning;
+
+	si_satellite_delivery_read(buffer, &descriptor);
+
+	tuning = transport_tuning_set(transport);
+	tuning->modulation_system = descriptor.modulation_system;
+	tuning->frequency = si_bcd(descriptor.frequency, 8);
+	tuning->symbol_rate = si_bcd(descriptor.symbol_rate, 7);
+	tuning->polarization = descriptor.polarization;
+	tuning->modulation_type = descriptor.modulation_type;
+	tuning->fec = descriptor.fec;
+	tuning->roll_off = descriptor.roll_off;
+	tuning->orbital_position = si_bcd(descriptor.orbital_position, 4);
+	tuning->west_east_flag = descriptor.west_east_flag;
+
+	slowlane_log(3, "SDS: Freq: %i Symbol: %i Orbit: %i West/East: %i Polorization: %i Roll Off: %i ModSys: %i ModType: %i FEC: %i", tuning->frequency, tuning->symbol_rate, tuning->orbital_position, tuning->west_east_flag, tuning->polarization, tuning->roll_off, tuning->modulation_system, tuning->modulation_type, tuning->fec);
 
 	return 0;
 }
@@ -0,0 +1,684 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * snapshot.c - Lineup snapshot file. The model and filtered lineup are
+ * written as fixed size records laid out as they are in memory, each table
+ * ordered by what it is looked up by and every reference an index or an
+ * offset, so a reader maps the file and searches it where it lies with
+ * nothing parsed or allocated. Opening checks the header and that every table
+ * lies within the file, which takes the same time however big the lineup.
+ * The file is written under another name and renamed over the last, so a
+ * reader sees one snapshot or the other and never half of one.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "slowlane.h"
+#include "crc32.h"
+#include "data.h"
+#include "text.h"
+#include "index.h"
+#include "names.h"
+#include "snapshot.h"
+
+/* Tables start on this boundary, so records can be read where they lie. */
+#define SNAPSHOT_ALIGN 8
+
+/* Something to order by a key, pointing at what it orders. */
+typedef struct tSnapshotSort {
+	unsigned long long key;
+	const void	*item;
+	unsigned int	value;
+
+	/* The item's pool index, for those in a pool. */
+	unsigned int	index;
+} SnapshotSort;
+
+/* The strings being built up, each name only once. Names are interned, so
+ * the same name is always at the same address and that is what's hashed. */
+typedef struct tSnapshotStrings {
+	char		*data;
+	size_t		used;
+	size_t		size;
+
+	const void	**keys;
+	unsigned int	*offsets;
+	unsigned int	slots;
+
+	int		failed;
+} SnapshotStrings;
+
+static int snapshot_sort_compare (const void *a, const void *b) {
+	const SnapshotSort *first = (const SnapshotSort *) a, *second = (const SnapshotSort *) b;
+
+	if (first->key != second->key) {
+		return first->key < second->key ? -1 : 1;
+	}
+
+	return first->value < second->value ? -1 : first->value > second->value;
+}
+
+static int snapshot_strings_init (SnapshotStrings *strings, unsigned int expected) {
+	memset(strings, '\0', sizeof(SnapshotStrings));
+
+	for (strings->slots = 64; strings->slots < expected * 2; strings->slots *= 2);
+
+	strings->size = 4096;
+	strings->data = (char *) malloc(strings->size);
+	strings->keys = (const void **) calloc(strings->slots, sizeof(void *));
+	strings->offsets = (unsigned int *) calloc(strings->slots, sizeof(unsigned int));
+
+	if (strings->data == NULL || strings->keys == NULL || strings->offsets == NULL) {
+		slowlane_log(0, "Unable to allocate snapshot strings for %u names.", expected);
+		return -1;
+	}
+
+	/* The empty name. */
+	strings->data[0] = '\0';
+	strings->used = 1;
+
+	return 0;
+}
+
+static void snapshot_strings_free (SnapshotStrings *strings) {
+	free(strings->data);
+	free(strings->keys);
+	free(strings->offsets);
+}
+
+/* Offset of the name key, text as UTF-8 if it has to be added. */
+static unsigned int snapshot_strings_add (SnapshotStrings *strings, const void *key, const char *text) {
+	unsigned int slot = ((unsigned long) key >> 3) * 2654435761u & (strings->slots - 1), offset;
+	size_t length, size;
+	char *data;
+
+	if (key == NULL || text == NULL || text[0] == '\0') {
+		return 0;
+	}
+
+	for (; strings->keys[slot] != NULL; slot = (slot + 1) & (strings->slots - 1)) {
+		if (strings->keys[slot] == key) {
+			return strings->offsets[slot];
+		}
+	}
+
+	length = strlen(text) + 1;
+
+	/* Offsets are 32 bits. */
+	if (strings->used > 0xffffffffu - length) {
+		strings->failed = 1;
+		return 0;
+	}
+
+	if (strings->used + length > strings->size) {
+		for (size = strings->size * 2; size < strings->used + length; size *= 2);
+
+		if ((data = (char *) realloc(strings->data, size)) == NULL) {
+			slowlane_log(0, "Unable to grow snapshot strings to %lu bytes.", (unsigned long) size);
+			strings->failed = 1;
+			return 0;
+		}
+
+		strings->data = data;
+		strings->size = size;
+	}
+
+	offset = strings->used;
+	memcpy(strings->data + offset, text, length);
+	strings->used += length;
+
+	strings->keys[slot] = key;
+	strings->offsets[slot] = offset;
+
+	return offset;
+}
+
+static unsigned int snapshot_strings_text (SnapshotStrings *strings, TextView view) {
+	char text[TEXT_MAX];
+
+	return view.data ? snapshot_strings_add(strings, view.data, text_view_string(view, text, sizeof(text))) : 0;
+}
+
+/* Position of the first record whose key isn't below key, count if none. */
+#define SNAPSHOT_SEARCH(records, count, record_key, key, position) do { \
+	unsigned int low = 0, high = (count), middle; \
+	while (low < high) { \
+		middle = low + (high - low) / 2; \
+		if (record_key(&(records)[middle]) < (key)) { \
+			low = middle + 1; \
+		} else { \
+			high = middle; \
+		} \
+	} \
+	(position) = low; \
+} while (0)
+
+/* Ids then orbit, see snapshot_orbit, services by transport then id. */
+static inline unsigned long long snapshot_transport_ids (unsigned short original_network_id, unsigned short transport_id, unsigned short orbit) { return ((unsigned long long) original_network_id << 32) | ((unsigned long long) transport_id << 16) | orbit; }
+static inline unsigned long long snapshot_service_ids (unsigned short original_network_id, unsigned short transport_id, unsigned short service_id, unsigned short orbit) { return (snapshot_transport_ids(original_network_id, transport_id, orbit) << 16) | service_id; }
+
+static inline unsigned long long snapshot_transport_key (const SnapshotTransport *transport) { return snapshot_transport_ids(transport->original_network_id, transport->transport_id, snapshot_orbit(transport->orbital_position, transport->west_east_flag)); }
+static inline unsigned long long snapshot_service_key (const SnapshotService *service) { return snapshot_service_ids(service->original_network_id, service->transport_id, service->service_id, snapshot_orbit(service->orbital_position, service->west_east_flag)); }
+static inline unsigned long long snapshot_channel_key (const SnapshotChannel *channel) { return snapshot_service_ids(channel->original_network_id, channel->transport_id, channel->service_id, snapshot_orbit(channel->orbital_position, channel->west_east_flag)); }
+static inline unsigned long long snapshot_network_key (const SnapshotNetwork *network) { return network->network_id; }
+static inline unsigned long long snapshot_bouquet_key (const SnapshotBouquet *bouquet) { return bouquet->bouquet_id; }
+static inline unsigned long long snapshot_user_number_key (const SnapshotChannel *channel) { return channel->user_number; }
+
+/* Write a table after what's been written, on the boundary, and note where. */
+static int snapshot_write_table (FILE *file, SnapshotHeader *header, int table, const void *records, unsigned int count, unsigned int size) {
+	static const char padding[SNAPSHOT_ALIGN] = { 0 };
+	unsigned long long offset = header->file_size;
+	size_t pad = (SNAPSHOT_ALIGN - offset % SNAPSHOT_ALIGN) % SNAPSHOT_ALIGN;
+
+	if ((pad && fwrite(padding, pad, 1, file) != 1) || (count && fwrite(records, (size_t) count * size, 1, file) != 1)) {
+		return -1;
+	}
+
+	header->tables[table].offset = offset + pad;
+	header->tables[table].count = count;
+	header->tables[table].size = size;
+	header->file_size = offset + pad + (unsigned long long) count * size;
+
+	return header->file_size > 0xffffffffu ? -1 : 0;
+}
+
+/* A snapshot's tables as they're built, before they're written. */
+typedef struct tSnapshotBuild {
+	SnapshotNetwork		*networks;
+	SnapshotTransport	*transports;
+	SnapshotService		*services;
+	SnapshotBouquet		*bouquets;
+	SnapshotChannel		*channels;
+	unsigned int		*by_service;
+
+	unsigned int		network_count;
+	unsigned int		transport_count;
+	unsigned int		service_count;
+	unsigned int		bouquet_count;
+	unsigned int		channel_count;
+
+	/* Networks, bouquets and channels are sorted in one, the others in their own. */
+	SnapshotSort		*sort;
+	SnapshotSort		*transport_sort;
+	SnapshotSort		*service_sort;
+
+	/* Where each of the model's transports and services went, by pool index. */
+	unsigned int		*transport_positions;
+	unsigned int		*service_positions;
+
+	SnapshotStrings		strings;
+} SnapshotBuild;
+
+static void snapshot_build_free (SnapshotBuild *build) {
+	free(build->networks);
+	free(build->transports);
+	free(build->services);
+	free(build->bouquets);
+	free(build->channels);
+	free(build->by_service);
+	free(build->sort);
+	free(build->transport_sort);
+	free(build->service_sort);
+	free(build->transport_positions);
+	free(build->service_positions);
+	snapshot_strings_free(&build->strings);
+}
+
+/* Count everything in the model and make room for it. */
+static int snapshot_build_init (SnapshotBuild *build, ChannelIndex *lineup) {
+	Network *network;
+	Transport *transport;
+	Service *service;
+	Bouquet *bouquet;
+	unsigned int most;
+
+	memset(build, '\0', sizeof(SnapshotBuild));
+
+	for (network = network_at(data_model->network_list); network != NULL; network = network_at(network->next)) {
+		build->network_count++;
+
+		for (transport = transport_at(network->transports); transport != NULL; transport = transport_at(transport->next)) {
+			build->transport_count++;
+
+			for (service = service_at(transport->services); service != NULL; service = service_at(service->next)) {
+				build->service_count++;
+			}
+		}
+	}
+
+	for (bouquet = bouquet_at(data_model->bouquet_list); bouquet != NULL; bouquet = bouquet_at(bouquet->next)) {
+		build->bouquet_count++;
+	}
+
+	build->channel_count = lineup->count;
+	most = build->network_count > build->bouquet_count ? build->network_count : build->bouquet_count;
+	most = most > build->channel_count ? most : build->channel_count;
+
+	build->networks = (SnapshotNetwork *) calloc(build->network_count + 1, sizeof(SnapshotNetwork));
+	build->transports = (SnapshotTransport *) calloc(build->transport_count + 1, sizeof(SnapshotTransport));
+	build->services = (SnapshotService *) calloc(build->service_count + 1, sizeof(SnapshotService));
+	build->bouquets = (SnapshotBouquet *) calloc(build->bouquet_count + 1, sizeof(SnapshotBouquet));
+	build->channels = (SnapshotChannel *) calloc(build->channel_count + 1, sizeof(SnapshotChannel));
+	build->by_service = (unsigned int *) calloc(build->channel_count + 1, sizeof(unsigned int));
+	build->sort = (SnapshotSort *) calloc(most + 1, sizeof(SnapshotSort));
+	build->transport_sort = (SnapshotSort *) calloc(build->transport_count + 1, sizeof(SnapshotSort));
+	build->service_sort = (SnapshotSort *) calloc(build->service_count + 1, sizeof(SnapshotSort));
+	build->transport_positions = (unsigned int *) malloc(data_model->transports.count * sizeof(unsigned int));
+	build->service_positions = (unsigned int *) malloc(data_model->services.count * sizeof(unsigned int));
+
+	if (snapshot_strings_init(&build->strings, build->network_count + build->bouquet_count + build->service_count * 3 + build->channel_count * 2 + 1) < 0 ||
+	    build->networks == NULL || build->transports == NULL || build->services == NULL || build->bouquets == NULL || build->channels == NULL ||
+	    build->by_service == NULL || build->sort == NULL || build->transport_sort == NULL || build->service_sort == NULL ||
+	    build->transport_positions == NULL || build->service_positions == NULL) {
+		slowlane_log(0, "Unable to allocate a snapshot of %u services and %u channels.", build->service_count, build->channel_count);
+		return -1;
+	}
+
+	/* Every pool has index 0, so these are never empty. */
+	memset(build->transport_positions, 0xff, data_model->transports.count * sizeof(unsigned int));
+	memset(build->service_positions, 0xff, data_model->services.count * sizeof(unsigned int));
+
+	return 0;
+}
+
+/* Networks by id, transports by original network id, transport id and orbit,
+ * and each transport's services by id after the last's, so they're in order
+ * of their ids and orbit. */
+static void snapshot_build_networks (SnapshotBuild *build) {
+	SnapshotSort *sort = build->sort, *transport_sort = build->transport_sort, *service_sort = build->service_sort;
+	Network *network;
+	Transport *transport;
+	TransportTuning *tuning;
+	Service *service;
+	ServiceNames *names;
+	SnapshotTransport *record;
+	unsigned int i, j, k, index;
+
+	for (i = 0, network = network_at(data_model->network_list); network != NULL; network = network_at(network->next), i++) {
+		sort[i].key = network->network_id;
+		sort[i].item = network;
+		sort[i].value = i;
+	}
+
+	qsort(sort, build->network_count, sizeof(SnapshotSort), snapshot_sort_compare);
+
+	for (i = 0, j = 0; i < build->network_count; i++) {
+		network = (Network *) sort[i].item;
+		build->networks[i].network_id = network->network_id;
+		build->networks[i].name = snapshot_strings_text(&build->strings, network->name);
+
+		for (index = network->transports; (transport = transport_at(index)) != NULL; index = transport->next, j++) {
+			tuning = transport_tuning(transport);
+			transport_sort[j].key = snapshot_transport_ids(transport->original_network_id, transport->transport_id, snapshot_orbit(tuning->orbital_position, tuning->west_east_flag));
+			transport_sort[j].item = transport;
+			transport_sort[j].value = i;
+			transport_sort[j].index = index;
+		}
+	}
+
+	qsort(transport_sort, build->transport_count, sizeof(SnapshotSort), snapshot_sort_compare);
+
+	for (i = 0, k = 0; i < build->transport_count; i++) {
+		transport = (Transport *) transport_sort[i].item;
+		tuning = transport_tuning(transport);
+		record = &build->transports[i];
+
+		build->transport_positions[transport_sort[i].index] = i;
+
+		record->original_network_id = transport->original_network_id;
+		record->transport_id = transport->transport_id;
+		record->network = transport_sort[i].value;
+		record->services = k;
+		record->frequency = tuning->frequency;
+		record->symbol_rate = tuning->symbol_rate;
+		record->orbital_position = tuning->orbital_position;
+		record->modulation_system = tuning->modulation_system;
+		record->polarization = tuning->polarization;
+		record->modulation_type = tuning->modulation_type;
+		record->fec = tuning->fec;
+		record->roll_off = tuning->roll_off;
+		record->west_east_flag = tuning->west_east_flag;
+
+		for (j = 0, index = transport->services; (service = service_at(index)) != NULL; index = service->next, j++) {
+			service_sort[j].key = service->service_id;
+			service_sort[j].item = service;
+			service_sort[j].value = j;
+			service_sort[j].index = index;
+		}
+
+		qsort(service_sort, j, sizeof(SnapshotSort), snapshot_sort_compare);
+		record->service_count = j;
+
+		for (j = 0; j < record->service_count; j++, k++) {
+			service = (Service *) service_sort[j].item;
+			names = service_names(service);
+			build->service_positions[service_sort[j].index] = k;
+
+			build->services[k].original_network_id = transport->original_network_id;
+			build->services[k].transport_id = transport->transport_id;
+			build->services[k].service_id = service->service_id;
+			build->services[k].type = service->type;
+			build->services[k].running = service->running;
+			build->services[k].free_ca = service->free_ca;
+			build->services[k].orbital_position = tuning->orbital_position;
+			build->services[k].west_east_flag = tuning->west_east_flag;
+			build->services[k].transport = i;
+			build->services[k].name = snapshot_strings_text(&build->strings, names->name);
+			build->services[k].alt_name = snapshot_strings_text(&build->strings, names->alt_name);
+			build->services[k].provider = snapshot_strings_text(&build->strings, names->provider);
+		}
+	}
+}
+
+static void snapshot_build_bouquets (SnapshotBuild *build) {
+	SnapshotSort *sort = build->sort;
+	Bouquet *bouquet;
+	unsigned int i;
+
+	for (i = 0, bouquet = bouquet_at(data_model->bouquet_list); bouquet != NULL; bouquet = bouquet_at(bouquet->next), i++) {
+		sort[i].key = bouquet->bouquet_id;
+		sort[i].item = bouquet;
+		sort[i].value = i;
+	}
+
+	qsort(sort, build->bouquet_count, sizeof(SnapshotSort), snapshot_sort_compare);
+
+	for (i = 0; i < build->bouquet_count; i++) {
+		bouquet = (Bouquet *) sort[i].item;
+		build->bouquets[i].bouquet_id = bouquet->bouquet_id;
+		build->bouquets[i].name = snapshot_strings_text(&build->strings, bouquet->name);
+	}
+}
+
+/* The lineup is already in user number order, so it is the index by user
+ * number, and the index by service is its positions sorted by ids and orbit.
+ * Channels are given the transport and service the model chose for them,
+ * which the ids alone can't tell apart across satellites. */
+static void snapshot_build_lineup (SnapshotBuild *build, ChannelIndex *lineup) {
+	SnapshotSort *sort = build->sort;
+	SnapshotChannel *record;
+	OpenTVChannel *channel;
+	Bouquet *bouquet;
+	unsigned int i;
+	const char *name;
+
+	for (i = 0; i < build->channel_count; i++) {
+		channel = channel_index_at(lineup, i);
+		record = &build->channels[i];
+
+		record->user_number = channel->user_number;
+		record->channel_number = channel->channel_number;
+		record->original_network_id = channel->original_network_id;
+		record->transport_id = channel->transport_id;
+		record->service_id = channel->service_id;
+		record->bouquet_id = (bouquet = bouquet_at(channel->bouquet)) ? bouquet->bouquet_id : 0;
+		record->region = channel->region;
+		record->type = channel->type;
+		record->flags = channel->flags;
+
+		name = names_region(channel->region);
+		record->region_name = snapshot_strings_add(&build->strings, name, name);
+		name = names_bouquet(record->bouquet_id);
+		record->bouquet_name = snapshot_strings_add(&build->strings, name, name);
+
+		record->transport = channel->transport < data_model->transports.count ? build->transport_positions[channel->transport] : SNAPSHOT_NONE;
+		record->service = channel->service < data_model->services.count ? build->service_positions[channel->service] : SNAPSHOT_NONE;
+
+		if (record->transport != SNAPSHOT_NONE) {
+			record->orbital_position = build->transports[record->transport].orbital_position;
+			record->west_east_flag = build->transports[record->transport].west_east_flag;
+		}
+
+		sort[i].key = snapshot_channel_key(record);
+		sort[i].value = i;
+	}
+
+	qsort(sort, build->channel_count, sizeof(SnapshotSort), snapshot_sort_compare);
+
+	for (i = 0; i < build->channel_count; i++) {
+		build->by_service[i] = sort[i].value;
+	}
+}
+
+/* Write the header and tables, the header last once it knows where everything is. */
+static int snapshot_save (FILE *file, SnapshotHeader *header, SnapshotBuild *build) {
+	if (fwrite(header, sizeof(SnapshotHeader), 1, file) != 1 ||
+	    snapshot_write_table(file, header, SNAPSHOT_NETWORKS, build->networks, build->network_count, sizeof(SnapshotNetwork)) < 0 ||
+	    snapshot_write_table(file, header, SNAPSHOT_TRANSPORTS, build->transports, build->transport_count, sizeof(SnapshotTransport)) < 0 ||
+	    snapshot_write_table(file, header, SNAPSHOT_SERVICES, build->services, build->service_count, sizeof(SnapshotService)) < 0 ||
+	    snapshot_write_table(file, header, SNAPSHOT_BOUQUETS, build->bouquets, build->bouquet_count, sizeof(SnapshotBouquet)) < 0 ||
+	    snapshot_write_table(file, header, SNAPSHOT_LINEUP, build->channels, build->channel_count, sizeof(SnapshotChannel)) < 0 ||
+	    snapshot_write_table(file, header, SNAPSHOT_LINEUP_BY_SERVICE, build->by_service, build->channel_count, sizeof(unsigned int)) < 0 ||
+	    snapshot_write_table(file, header, SNAPSHOT_STRINGS, build->strings.data, build->strings.used, 1) < 0) {
+		return -1;
+	}
+
+	header->crc = crc32((char *) header, offsetof(SnapshotHeader, crc), 0xffffffff);
+
+	if (fseek(file, 0, SEEK_SET) < 0 || fwrite(header, sizeof(SnapshotHeader), 1, file) != 1 || fflush(file) != 0 || fsync(fileno(file)) < 0 || fchmod(fileno(file), 0644) < 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Write the model and lineup of the calling thread's model to filename,
+ * replacing what was there in one step. */
+int snapshot_write (const char *filename, unsigned long long time, ChannelIndex *lineup, unsigned short bouquet_id, RegionSet *regions, unsigned short user_number) {
+	SnapshotHeader header;
+	SnapshotBuild build;
+	char *temporary;
+	int retval = -1, fd;
+	FILE *file;
+
+	if (snapshot_build_init(&build, lineup) < 0) {
+		snapshot_build_free(&build);
+		return -1;
+	}
+
+	snapshot_build_networks(&build);
+	snapshot_build_bouquets(&build);
+	snapshot_build_lineup(&build, lineup);
+
+	memset(&header, '\0', sizeof(SnapshotHeader));
+	memcpy(header.magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE);
+	header.version = SNAPSHOT_VERSION;
+	header.byte_order = SNAPSHOT_BYTE_ORDER;
+	header.time = time;
+	header.bouquet_id = bouquet_id;
+	header.user_number = user_number;
+	header.header_size = sizeof(SnapshotHeader);
+	header.file_size = sizeof(SnapshotHeader);
+	memcpy(header.regions, regions->bits, sizeof(header.regions));
+
+	/* Written beside the last so the rename stays on one filesystem. */
+	if (build.strings.failed || (temporary = (char *) malloc(strlen(filename) + 8)) == NULL) {
+		slowlane_log(0, "Unable to build the snapshot for %s.", filename);
+		snapshot_build_free(&build);
+		return -1;
+	}
+
+	sprintf(temporary, "%s.XXXXXX", filename);
+
+	if ((fd = mkstemp(temporary)) < 0) {
+		slowlane_log(0, "Unable to create %s.", temporary);
+	} else if ((file = fdopen(fd, "wb")) == NULL) {
+		slowlane_log(0, "Unable to write to %s.", temporary);
+		close(fd);
+		unlink(temporary);
+	} else if (snapshot_save(file, &header, &build) < 0) {
+		slowlane_log(0, "Unable to write snapshot %s.", temporary);
+		fclose(file);
+		unlink(temporary);
+	} else if (fclose(file) != 0 || rename(temporary, filename) < 0) {
+		slowlane_log(0, "Unable to replace %s with the new snapshot.", filename);
+		unlink(temporary);
+	} else {
+		slowlane_log(1, "Snapshot of %u services and %u channels written to %s, %llu bytes.", build.service_count, build.channel_count, filename, header.file_size);
+		retval = 0;
+	}
+
+	free(temporary);
+	snapshot_build_free(&build);
+
+	return retval;
+}
+
+/* Map a snapshot and check it can be read, -1 if it can't. */
+int snapshot_open (Snapshot *snapshot, const char *filename) {
+	static const unsigned int sizes[SNAPSHOT_TABLES] = { sizeof(SnapshotNetwork), sizeof(SnapshotTransport), sizeof(SnapshotService), sizeof(SnapshotBouquet), sizeof(SnapshotChannel), sizeof(unsigned int), 1 };
+	const SnapshotHeader *header;
+	const SnapshotTable *table;
+	struct stat status;
+	int fd, i;
+
+	memset(snapshot, '\0', sizeof(Snapshot));
+
+	if ((fd = open(filename, O_RDONLY)) < 0) {
+		slowlane_log(0, "Unable to open snapshot %s.", filename);
+		return -1;
+	}
+
+	if (fstat(fd, &status) < 0 || status.st_size < (off_t) sizeof(SnapshotHeader)) {
+		slowlane_log(0, "%s is too short to be a snapshot.", filename);
+		close(fd);
+		return -1;
+	}
+
+	snapshot->map_size = status.st_size;
+	snapshot->map = mmap(NULL, snapshot->map_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (snapshot->map == MAP_FAILED) {
+		slowlane_log(0, "Unable to map snapshot %s.", filename);
+		snapshot->map = NULL;
+		return -1;
+	}
+
+	header = snapshot->header = (const SnapshotHeader *) snapshot->map;
+
+	if (memcmp(header->magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE) != 0 || header->byte_order != SNAPSHOT_BYTE_ORDER || header->version != SNAPSHOT_VERSION || header->header_size != sizeof(SnapshotHeader)) {
+		slowlane_log(0, "%s isn't a version %i snapshot of this byte order.", filename, SNAPSHOT_VERSION);
+		snapshot_close(snapshot);
+		return -1;
+	}
+
+	if (header->crc != crc32((const char *) header, offsetof(SnapshotHeader, crc), 0xffffffff) || header->file_size != snapshot->map_size) {
+		slowlane_log(0, "Snapshot %s is damaged or cut short.", filename);
+		snapshot_close(snapshot);
+		return -1;
+	}
+
+	for (i = 0; i < SNAPSHOT_TABLES; i++) {
+		table = &header->tables[i];
+
+		if (table->size != sizes[i] || table->offset % SNAPSHOT_ALIGN != 0 || table->offset < sizeof(SnapshotHeader) || (unsigned long long) table->offset + (unsigned long long) table->count * table->size > snapshot->map_size) {
+			slowlane_log(0, "Snapshot %s table %i doesn't fit the file.", filename, i);
+			snapshot_close(snapshot);
+			return -1;
+		}
+	}
+
+	table = &header->tables[SNAPSHOT_STRINGS];
+
+	if (table->count == 0 || ((const char *) snapshot->map)[table->offset + table->count - 1] != '\0' || header->tables[SNAPSHOT_LINEUP_BY_SERVICE].count != header->tables[SNAPSHOT_LINEUP].count) {
+		slowlane_log(0, "Snapshot %s has damaged tables.", filename);
+		snapshot_close(snapshot);
+		return -1;
+	}
+
+	snapshot->networks = (const SnapshotNetwork *) ((const char *) snapshot->map + header->tables[SNAPSHOT_NETWORKS].offset);
+	snapshot->transports = (const SnapshotTransport *) ((const char *) snapshot->map + header->tables[SNAPSHOT_TRANSPORTS].offset);
+	snapshot->services = (const SnapshotService *) ((const char *) snapshot->map + header->tables[SNAPSHOT_SERVICES].offset);
+	snapshot->bouquets = (const SnapshotBouquet *) ((const char *) snapshot->map + header->tables[SNAPSHOT_BOUQUETS].offset);
+	snapshot->lineup = (const SnapshotChannel *) ((const char *) snapshot->map + header->tables[SNAPSHOT_LINEUP].offset);
+	snapshot->lineup_by_service = (const unsigned int *) ((const char *) snapshot->map + header->tables[SNAPSHOT_LINEUP_BY_SERVICE].offset);
+	snapshot->strings = (const char *) snapshot->map + header->tables[SNAPSHOT_STRINGS].offset;
+
+	return 0;
+}
+
+void snapshot_close (Snapshot *snapshot) {
+	if (snapshot->map) {
+		munmap(snapshot->map, snapshot->map_size);
+	}
+
+	memset(snapshot, '\0', sizeof(Snapshot));
+}
+
+/* Position of the first lineup channel with a user number, -1 if none. */
+int snapshot_find (Snapshot *snapshot, unsigned short user_number) {
+	unsigned int count = snapshot_count(snapshot, SNAPSHOT_LINEUP), position;
+
+	SNAPSHOT_SEARCH(snapshot->lineup, count, snapshot_user_number_key, user_number, position);
+
+	return position < count && snapshot->lineup[position].user_number == user_number ? (int) position : -1;
+}
+
+/* The first lineup channel of a service, NULL if it isn't in the lineup. The
+ * orbit is that of its transport, see snapshot_orbit, and with the ids
+ * tells apart transports which share them on different satellites. */
+const SnapshotChannel * snapshot_channel_by_service (Snapshot *snapshot, unsigned short original_network_id, unsigned short transport_id, unsigned short service_id, unsigned short orbit) {
+	unsigned long long key = snapshot_service_ids(original_network_id, transport_id, service_id, orbit);
+	unsigned int count = snapshot_count(snapshot, SNAPSHOT_LINEUP), low = 0, high = count, middle, position;
+
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		position = snapshot->lineup_by_service[middle];
+
+		if (position < count && snapshot_channel_key(&snapshot->lineup[position]) < key) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	if (low == count || (position = snapshot->lineup_by_service[low]) >= count || snapshot_channel_key(&snapshot->lineup[position]) != key) {
+		return NULL;
+	}
+
+	return &snapshot->lineup[position];
+}
+
+const SnapshotService * snapshot_service (Snapshot *snapshot, unsigned short original_network_id, unsigned short transport_id, unsigned short service_id, unsigned short orbit) {
+	unsigned long long key = snapshot_service_ids(original_network_id, transport_id, service_id, orbit);
+	unsigned int count = snapshot_count(snapshot, SNAPSHOT_SERVICES), position;
+
+	SNAPSHOT_SEARCH(snapshot->services, count, snapshot_service_key, key, position);
+
+	return position < count && snapshot_service_key(&snapshot->services[position]) == key ? &snapshot->services[position] : NULL;
+}
+
+const SnapshotTransport * snapshot_transport (Snapshot *snapshot, unsigned short original_network_id, unsigned short transport_id, unsigned short orbit) {
+	unsigned long long key = snapshot_transport_ids(original_network_id, transport_id, orbit);
+	unsigned int count = snapshot_count(snapshot, SNAPSHOT_TRANSPORTS), position;
+
+	SNAPSHOT_SEARCH(snapshot->transports, count, snapshot_transport_key, key, position);
+
+	return position < count && snapshot_transport_key(&snapshot->transports[position]) == key ? &snapshot->transports[position] : NULL;
+}
+
+const SnapshotNetwork * snapshot_network (Snapshot *snapshot, unsigned short network_id) {
+	unsigned int count = snapshot_count(snapshot, SNAPSHOT_NETWORKS), position;
+
+	SNAPSHOT_SEARCH(snapshot->networks, count, snapshot_network_key, network_id, position);
+
+	return position < count && snapshot->networks[position].network_id == network_id ? &snapshot->networks[position] : NULL;
+}
+
+const SnapshotBouquet * snapshot_bouquet (Snapshot *snapshot, unsigned short bouquet_id) {
+	unsigned int count = snapshot_count(snapshot, SNAPSHOT_BOUQUETS), position;
+
+	SNAPSHOT_SEARCH(snapshot->bouquets, count, snapshot_bouquet_key, bouquet_id, position);
+
+	return position < count && snapshot->bouquets[position].bouquet_id == bouquet_id ? &snapshot->bouquets[position] : NULL;
+}
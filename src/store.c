@@ -0,0 +1,242 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * store.c - Retained section store. Each accepted section is copied once into
+ * blocks which never move and indexed by table, extension and section, so the
+ * model can point into the section rather than copy out of it, and a table
+ * can be read again without waiting for the carousel to come round.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slowlane.h"
+#include "pool.h"
+#include "data.h"
+#include "store.h"
+
+#define STORE_INITIAL_BUCKETS 256
+
+/* The store for a model, created on first use if create is set. */
+SectionStore * section_store (DataModel *model, int create) {
+	SectionStore *store;
+
+	if (model->sections || !create) {
+		return model->sections;
+	}
+
+	if ((store = (SectionStore *) calloc(1, sizeof(SectionStore))) == NULL || (store->buckets = (unsigned int *) calloc(STORE_INITIAL_BUCKETS, sizeof(unsigned int))) == NULL) {
+		slowlane_log(0, "Unable to allocate section store of %i buckets.", STORE_INITIAL_BUCKETS);
+		free(store);
+		return NULL;
+	}
+
+	pool_init(&store->sections, sizeof(StoredSection), 8);
+	store->sections.cap = model->settings.cap;
+	store->bucket_count = STORE_INITIAL_BUCKETS;
+	model->sections = store;
+
+	return store;
+}
+
+/* Release a store and every block it still owns. */
+void section_store_free (SectionStore *store) {
+	unsigned int i;
+
+	if (store == NULL) {
+		return;
+	}
+
+	for (i = 0; i < store->block_count; i++) {
+		free(store->blocks[i]);
+	}
+
+	pool_cap_release(store->sections.cap, (size_t) store->block_count * STORE_BLOCK_SIZE);
+	pool_free_all(&store->sections);
+	free(store->blocks);
+	free(store->buckets);
+	free(store);
+}
+
+/* Tables which repeat their extension across networks carry the original
+ * network id as well, the SDT and EIT. */
+unsigned long long section_store_key (unsigned char table_id, unsigned short secondary_id, unsigned short extension, unsigned char section_number) {
+	return ((unsigned long long) table_id << 40) | ((unsigned long long) secondary_id << 24) | ((unsigned long long) extension << 8) | section_number;
+}
+
+static unsigned long long section_store_key_of (const unsigned char *section) {
+	unsigned short secondary_id = 0;
+
+	if (section[0] == 0x42 || section[0] == 0x46 || (section[0] >= 0x4e && section[0] <= 0x6f)) {
+		secondary_id = (section[8] << 8) | section[9];
+	}
+
+	return section_store_key(section[0], secondary_id, (section[3] << 8) | section[4], section[6]);
+}
+
+static unsigned int section_store_hash (unsigned long long key) {
+	key ^= key >> 29;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 32;
+	return (unsigned int) key;
+}
+
+/* Double the buckets, keeps chains to around one section. */
+static int section_store_grow (SectionStore *store) {
+	unsigned int *buckets, bucket_count = store->bucket_count * 2, i, bucket;
+	StoredSection *stored;
+
+	if ((buckets = (unsigned int *) calloc(bucket_count, sizeof(unsigned int))) == NULL) {
+		slowlane_log(0, "Unable to grow section store to %u buckets.", bucket_count);
+		return -1;
+	}
+
+	for (i = 1; i < store->sections.count; i++) {
+		stored = stored_section_at(store, i);
+		bucket = section_store_hash(stored->key) & (bucket_count - 1);
+		stored->next = buckets[bucket];
+		buckets[bucket] = i;
+	}
+
+	free(store->buckets);
+	store->buckets = buckets;
+	store->bucket_count = bucket_count;
+
+	return 0;
+}
+
+static StoredSection * section_store_find (SectionStore *store, unsigned long long key) {
+	unsigned int index;
+	StoredSection *stored;
+
+	for (index = store->buckets[section_store_hash(key) & (store->bucket_count - 1)]; index != POOL_NONE; index = stored->next) {
+		stored = stored_section_at(store, index);
+
+		if (stored->key == key) {
+			return stored;
+		}
+	}
+
+	return NULL;
+}
+
+/* Index bytes already in one of the store's blocks. */
+static StoredSection * section_store_index (SectionStore *store, unsigned long long key, unsigned char *data, int length) {
+	StoredSection *stored;
+	unsigned int index, bucket;
+
+	if ((stored = section_store_find(store, key)) == NULL) {
+		if (store->sections.count > store->bucket_count && section_store_grow(store) < 0) {
+			return NULL;
+		}
+
+		if ((index = pool_alloc(&store->sections)) == POOL_NONE) {
+			return NULL;
+		}
+
+		bucket = section_store_hash(key) & (store->bucket_count - 1);
+		stored = stored_section_at(store, index);
+		stored->key = key;
+		stored->next = store->buckets[bucket];
+		store->buckets[bucket] = index;
+	}
+
+	stored->data = data;
+	stored->length = length;
+
+	return stored;
+}
+
+/* Copy a whole section in, replacing any earlier copy in the index. The old
+ * bytes stay where they are, the model may still point into them. Returns the
+ * copy, NULL if memory ran out. */
+unsigned char * section_store_add (SectionStore *store, const unsigned char *section, int section_length) {
+	unsigned char **blocks, *data;
+
+	if (store->block_count == 0 || store->block_used + section_length > STORE_BLOCK_SIZE) {
+		if ((blocks = (unsigned char **) realloc(store->blocks, (store->block_count + 1) * sizeof(unsigned char *))) == NULL) {
+			slowlane_log(0, "Unable to grow section store to %u blocks.", store->block_count + 1);
+			return NULL;
+		}
+
+		store->blocks = blocks;
+
+		/* Blocks are charged to the model's cap along with its pools. */
+		if (pool_cap_charge(store->sections.cap, STORE_BLOCK_SIZE) < 0) {
+			return NULL;
+		}
+
+		if ((store->blocks[store->block_count] = (unsigned char *) malloc(STORE_BLOCK_SIZE)) == NULL) {
+			pool_cap_release(store->sections.cap, STORE_BLOCK_SIZE);
+			slowlane_log(0, "Unable to allocate section store block %u.", store->block_count);
+			return NULL;
+		}
+
+		store->block_count++;
+		store->block_used = 0;
+	}
+
+	data = store->blocks[store->block_count - 1] + store->block_used;
+	memcpy(data, section, section_length);
+	store->block_used += section_length;
+	store->bytes += section_length;
+
+	if (section_store_index(store, section_store_key_of(data), data, section_length) == NULL) {
+		return NULL;
+	}
+
+	return data;
+}
+
+/* The latest copy of a section, NULL if it was never accepted. */
+unsigned char * section_store_get (SectionStore *store, unsigned long long key, int *section_length) {
+	StoredSection *stored;
+
+	if ((stored = section_store_find(store, key)) == NULL) {
+		return NULL;
+	}
+
+	*section_length = stored->length;
+
+	return stored->data;
+}
+
+/* Take over another store's blocks, so anything pointing into them stays
+ * valid, and index its sections. As with the model the first copy wins. */
+void section_store_merge (SectionStore *to, SectionStore *from) {
+	unsigned char **blocks;
+	StoredSection *stored;
+	unsigned int i;
+
+	if (from->block_count == 0) {
+		return;
+	}
+
+	if ((blocks = (unsigned char **) realloc(to->blocks, (to->block_count + from->block_count) * sizeof(unsigned char *))) == NULL) {
+		slowlane_log(0, "Unable to grow section store to %u blocks.", to->block_count + from->block_count);
+		return;
+	}
+
+	/* Carry on filling the last block taken over. */
+	memcpy(blocks + to->block_count, from->blocks, from->block_count * sizeof(unsigned char *));
+	to->blocks = blocks;
+	to->block_count += from->block_count;
+	to->block_used = from->block_used;
+	to->bytes += from->bytes;
+
+	for (i = 1; i < from->sections.count; i++) {
+		stored = stored_section_at(from, i);
+
+		if (section_store_find(to, stored->key) == NULL) {
+			section_store_index(to, stored->key, stored->data, stored->length);
+		}
+	}
+
+	free(from->blocks);
+	from->blocks = NULL;
+	from->block_count = 0;
+	from->block_used = 0;
+}
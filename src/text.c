@@ -0,0 +1,672 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * text.c - DVB text conversion to UTF-8 and string interning. The character
+ * table is picked from the first bytes of the string as in EN 300 468 Annex
+ * A, then each byte is converted by a lookup in a table of ready encoded
+ * UTF-8 built once at start up.
+ *
+ * Names are kept unconverted as views, either into the retained sections or
+ * into an intern set so the provider name carried by thousands of services is
+ * stored once, and converted when they're output.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "slowlane.h"
+#include "text.h"
+
+/* Code points for 0xa0 to 0xff of each character table, 0 where undefined. */
+static const unsigned short text_upper[TEXT_CHARSETS][96] = {
+	/* Figure A.1, ISO/IEC 6937 with the Euro sign, diacritics are handled separately. */
+	{
+		0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x20ac, 0x00a5, 0x0023, 0x00a7,
+		0x00a4, 0x2018, 0x201c, 0x00ab, 0x2190, 0x2191, 0x2192, 0x2193,
+		0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00d7, 0x00b5, 0x00b6, 0x00b7,
+		0x00f7, 0x2019, 0x201d, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x00bf,
+		0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x2015, 0x00b9, 0x00ae, 0x00a9, 0x2122, 0x266a, 0x00ac, 0x00a6,
+		0x0000, 0x0000, 0x0000, 0x0000, 0x215b, 0x215c, 0x215d, 0x215e,
+		0x2126, 0x00c6, 0x0110, 0x00aa, 0x0126, 0x0000, 0x0132, 0x013f,
+		0x0141, 0x00d8, 0x0152, 0x00ba, 0x00de, 0x0166, 0x014a, 0x0149,
+		0x0138, 0x00e6, 0x0111, 0x00f0, 0x0127, 0x0131, 0x0133, 0x0140,
+		0x0142, 0x00f8, 0x0153, 0x00df, 0x00fe, 0x0167, 0x014b, 0x00ad
+	},
+	/* ISO/IEC 8859-1 */
+	{
+		0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x00a4, 0x00a5, 0x00a6, 0x00a7,
+		0x00a8, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+		0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x00b6, 0x00b7,
+		0x00b8, 0x00b9, 0x00ba, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x00bf,
+		0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7,
+		0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+		0x00d0, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7,
+		0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+		0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+		0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+		0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7,
+		0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff
+	},
+	/* ISO/IEC 8859-2 */
+	{
+		0x00a0, 0x0104, 0x02d8, 0x0141, 0x00a4, 0x013d, 0x015a, 0x00a7,
+		0x00a8, 0x0160, 0x015e, 0x0164, 0x0179, 0x00ad, 0x017d, 0x017b,
+		0x00b0, 0x0105, 0x02db, 0x0142, 0x00b4, 0x013e, 0x015b, 0x02c7,
+		0x00b8, 0x0161, 0x015f, 0x0165, 0x017a, 0x02dd, 0x017e, 0x017c,
+		0x0154, 0x00c1, 0x00c2, 0x0102, 0x00c4, 0x0139, 0x0106, 0x00c7,
+		0x010c, 0x00c9, 0x0118, 0x00cb, 0x011a, 0x00cd, 0x00ce, 0x010e,
+		0x0110, 0x0143, 0x0147, 0x00d3, 0x00d4, 0x0150, 0x00d6, 0x00d7,
+		0x0158, 0x016e, 0x00da, 0x0170, 0x00dc, 0x00dd, 0x0162, 0x00df,
+		0x0155, 0x00e1, 0x00e2, 0x0103, 0x00e4, 0x013a, 0x0107, 0x00e7,
+		0x010d, 0x00e9, 0x0119, 0x00eb, 0x011b, 0x00ed, 0x00ee, 0x010f,
+		0x0111, 0x0144, 0x0148, 0x00f3, 0x00f4, 0x0151, 0x00f6, 0x00f7,
+		0x0159, 0x016f, 0x00fa, 0x0171, 0x00fc, 0x00fd, 0x0163, 0x02d9
+	},
+	/* ISO/IEC 8859-3 */
+	{
+		0x00a0, 0x0126, 0x02d8, 0x00a3, 0x00a4, 0x0000, 0x0124, 0x00a7,
+		0x00a8, 0x0130, 0x015e, 0x011e, 0x0134, 0x00ad, 0x0000, 0x017b,
+		0x00b0, 0x0127, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x0125, 0x00b7,
+		0x00b8, 0x0131, 0x015f, 0x011f, 0x0135, 0x00bd, 0x0000, 0x017c,
+		0x00c0, 0x00c1, 0x00c2, 0x0000, 0x00c4, 0x010a, 0x0108, 0x00c7,
+		0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+		0x0000, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x0120, 0x00d6, 0x00d7,
+		0x011c, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x016c, 0x015c, 0x00df,
+		0x00e0, 0x00e1, 0x00e2, 0x0000, 0x00e4, 0x010b, 0x0109, 0x00e7,
+		0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+		0x0000, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x0121, 0x00f6, 0x00f7,
+		0x011d, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x016d, 0x015d, 0x02d9
+	},
+	/* ISO/IEC 8859-4 */
+	{
+		0x00a0, 0x0104, 0x0138, 0x0156, 0x00a4, 0x0128, 0x013b, 0x00a7,
+		0x00a8, 0x0160, 0x0112, 0x0122, 0x0166, 0x00ad, 0x017d, 0x00af,
+		0x00b0, 0x0105, 0x02db, 0x0157, 0x00b4, 0x0129, 0x013c, 0x02c7,
+		0x00b8, 0x0161, 0x0113, 0x0123, 0x0167, 0x014a, 0x017e, 0x014b,
+		0x0100, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x012e,
+		0x010c, 0x00c9, 0x0118, 0x00cb, 0x0116, 0x00cd, 0x00ce, 0x012a,
+		0x0110, 0x0145, 0x014c, 0x0136, 0x00d4, 0x00d5, 0x00d6, 0x00d7,
+		0x00d8, 0x0172, 0x00da, 0x00db, 0x00dc, 0x0168, 0x016a, 0x00df,
+		0x0101, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x012f,
+		0x010d, 0x00e9, 0x0119, 0x00eb, 0x0117, 0x00ed, 0x00ee, 0x012b,
+		0x0111, 0x0146, 0x014d, 0x0137, 0x00f4, 0x00f5, 0x00f6, 0x00f7,
+		0x00f8, 0x0173, 0x00fa, 0x00fb, 0x00fc, 0x0169, 0x016b, 0x02d9
+	},
+	/* ISO/IEC 8859-5 */
+	{
+		0x00a0, 0x0401, 0x0402, 0x0403, 0x0404, 0x0405, 0x0406, 0x0407,
+		0x0408, 0x0409, 0x040a, 0x040b, 0x040c, 0x00ad, 0x040e, 0x040f,
+		0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,
+		0x0418, 0x0419, 0x041a, 0x041b, 0x041c, 0x041d, 0x041e, 0x041f,
+		0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,
+		0x0428, 0x0429, 0x042a, 0x042b, 0x042c, 0x042d, 0x042e, 0x042f,
+		0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+		0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e, 0x043f,
+		0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+		0x0448, 0x0449, 0x044a, 0x044b, 0x044c, 0x044d, 0x044e, 0x044f,
+		0x2116, 0x0451, 0x0452, 0x0453, 0x0454, 0x0455, 0x0456, 0x0457,
+		0x0458, 0x0459, 0x045a, 0x045b, 0x045c, 0x00a7, 0x045e, 0x045f
+	},
+	/* ISO/IEC 8859-6 */
+	{
+		0x00a0, 0x0000, 0x0000, 0x0000, 0x00a4, 0x0000, 0x0000, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x0000, 0x060c, 0x00ad, 0x0000, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x061b, 0x0000, 0x0000, 0x0000, 0x061f,
+		0x0000, 0x0621, 0x0622, 0x0623, 0x0624, 0x0625, 0x0626, 0x0627,
+		0x0628, 0x0629, 0x062a, 0x062b, 0x062c, 0x062d, 0x062e, 0x062f,
+		0x0630, 0x0631, 0x0632, 0x0633, 0x0634, 0x0635, 0x0636, 0x0637,
+		0x0638, 0x0639, 0x063a, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x0640, 0x0641, 0x0642, 0x0643, 0x0644, 0x0645, 0x0646, 0x0647,
+		0x0648, 0x0649, 0x064a, 0x064b, 0x064c, 0x064d, 0x064e, 0x064f,
+		0x0650, 0x0651, 0x0652, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000
+	},
+	/* ISO/IEC 8859-7 */
+	{
+		0x00a0, 0x2018, 0x2019, 0x00a3, 0x20ac, 0x20af, 0x00a6, 0x00a7,
+		0x00a8, 0x00a9, 0x037a, 0x00ab, 0x00ac, 0x00ad, 0x0000, 0x2015,
+		0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x0384, 0x0385, 0x0386, 0x00b7,
+		0x0388, 0x0389, 0x038a, 0x00bb, 0x038c, 0x00bd, 0x038e, 0x038f,
+		0x0390, 0x0391, 0x0392, 0x0393, 0x0394, 0x0395, 0x0396, 0x0397,
+		0x0398, 0x0399, 0x039a, 0x039b, 0x039c, 0x039d, 0x039e, 0x039f,
+		0x03a0, 0x03a1, 0x0000, 0x03a3, 0x03a4, 0x03a5, 0x03a6, 0x03a7,
+		0x03a8, 0x03a9, 0x03aa, 0x03ab, 0x03ac, 0x03ad, 0x03ae, 0x03af,
+		0x03b0, 0x03b1, 0x03b2, 0x03b3, 0x03b4, 0x03b5, 0x03b6, 0x03b7,
+		0x03b8, 0x03b9, 0x03ba, 0x03bb, 0x03bc, 0x03bd, 0x03be, 0x03bf,
+		0x03c0, 0x03c1, 0x03c2, 0x03c3, 0x03c4, 0x03c5, 0x03c6, 0x03c7,
+		0x03c8, 0x03c9, 0x03ca, 0x03cb, 0x03cc, 0x03cd, 0x03ce, 0x0000
+	},
+	/* ISO/IEC 8859-8 */
+	{
+		0x00a0, 0x0000, 0x00a2, 0x00a3, 0x00a4, 0x00a5, 0x00a6, 0x00a7,
+		0x00a8, 0x00a9, 0x00d7, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+		0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x00b6, 0x00b7,
+		0x00b8, 0x00b9, 0x00f7, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x2017,
+		0x05d0, 0x05d1, 0x05d2, 0x05d3, 0x05d4, 0x05d5, 0x05d6, 0x05d7,
+		0x05d8, 0x05d9, 0x05da, 0x05db, 0x05dc, 0x05dd, 0x05de, 0x05df,
+		0x05e0, 0x05e1, 0x05e2, 0x05e3, 0x05e4, 0x05e5, 0x05e6, 0x05e7,
+		0x05e8, 0x05e9, 0x05ea, 0x0000, 0x0000, 0x200e, 0x200f, 0x0000
+	},
+	/* ISO/IEC 8859-9 */
+	{
+		0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x00a4, 0x00a5, 0x00a6, 0x00a7,
+		0x00a8, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+		0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x00b6, 0x00b7,
+		0x00b8, 0x00b9, 0x00ba, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x00bf,
+		0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7,
+		0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+		0x011e, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7,
+		0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x0130, 0x015e, 0x00df,
+		0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+		0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+		0x011f, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7,
+		0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x0131, 0x015f, 0x00ff
+	},
+	/* ISO/IEC 8859-10 */
+	{
+		0x00a0, 0x0104, 0x0112, 0x0122, 0x012a, 0x0128, 0x0136, 0x00a7,
+		0x013b, 0x0110, 0x0160, 0x0166, 0x017d, 0x00ad, 0x016a, 0x014a,
+		0x00b0, 0x0105, 0x0113, 0x0123, 0x012b, 0x0129, 0x0137, 0x00b7,
+		0x013c, 0x0111, 0x0161, 0x0167, 0x017e, 0x2015, 0x016b, 0x014b,
+		0x0100, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x012e,
+		0x010c, 0x00c9, 0x0118, 0x00cb, 0x0116, 0x00cd, 0x00ce, 0x00cf,
+		0x00d0, 0x0145, 0x014c, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x0168,
+		0x00d8, 0x0172, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+		0x0101, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x012f,
+		0x010d, 0x00e9, 0x0119, 0x00eb, 0x0117, 0x00ed, 0x00ee, 0x00ef,
+		0x00f0, 0x0146, 0x014d, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x0169,
+		0x00f8, 0x0173, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x0138
+	},
+	/* ISO/IEC 8859-11 */
+	{
+		0x00a0, 0x0e01, 0x0e02, 0x0e03, 0x0e04, 0x0e05, 0x0e06, 0x0e07,
+		0x0e08, 0x0e09, 0x0e0a, 0x0e0b, 0x0e0c, 0x0e0d, 0x0e0e, 0x0e0f,
+		0x0e10, 0x0e11, 0x0e12, 0x0e13, 0x0e14, 0x0e15, 0x0e16, 0x0e17,
+		0x0e18, 0x0e19, 0x0e1a, 0x0e1b, 0x0e1c, 0x0e1d, 0x0e1e, 0x0e1f,
+		0x0e20, 0x0e21, 0x0e22, 0x0e23, 0x0e24, 0x0e25, 0x0e26, 0x0e27,
+		0x0e28, 0x0e29, 0x0e2a, 0x0e2b, 0x0e2c, 0x0e2d, 0x0e2e, 0x0e2f,
+		0x0e30, 0x0e31, 0x0e32, 0x0e33, 0x0e34, 0x0e35, 0x0e36, 0x0e37,
+		0x0e38, 0x0e39, 0x0e3a, 0x0000, 0x0000, 0x0000, 0x0000, 0x0e3f,
+		0x0e40, 0x0e41, 0x0e42, 0x0e43, 0x0e44, 0x0e45, 0x0e46, 0x0e47,
+		0x0e48, 0x0e49, 0x0e4a, 0x0e4b, 0x0e4c, 0x0e4d, 0x0e4e, 0x0e4f,
+		0x0e50, 0x0e51, 0x0e52, 0x0e53, 0x0e54, 0x0e55, 0x0e56, 0x0e57,
+		0x0e58, 0x0e59, 0x0e5a, 0x0e5b, 0x0000, 0x0000, 0x0000, 0x0000
+	},
+	/* 8859-12 was never published. */
+	{ 0 },
+	/* ISO/IEC 8859-13 */
+	{
+		0x00a0, 0x201d, 0x00a2, 0x00a3, 0x00a4, 0x201e, 0x00a6, 0x00a7,
+		0x00d8, 0x00a9, 0x0156, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00c6,
+		0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x201c, 0x00b5, 0x00b6, 0x00b7,
+		0x00f8, 0x00b9, 0x0157, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x00e6,
+		0x0104, 0x012e, 0x0100, 0x0106, 0x00c4, 0x00c5, 0x0118, 0x0112,
+		0x010c, 0x00c9, 0x0179, 0x0116, 0x0122, 0x0136, 0x012a, 0x013b,
+		0x0160, 0x0143, 0x0145, 0x00d3, 0x014c, 0x00d5, 0x00d6, 0x00d7,
+		0x0172, 0x0141, 0x015a, 0x016a, 0x00dc, 0x017b, 0x017d, 0x00df,
+		0x0105, 0x012f, 0x0101, 0x0107, 0x00e4, 0x00e5, 0x0119, 0x0113,
+		0x010d, 0x00e9, 0x017a, 0x0117, 0x0123, 0x0137, 0x012b, 0x013c,
+		0x0161, 0x0144, 0x0146, 0x00f3, 0x014d, 0x00f5, 0x00f6, 0x00f7,
+		0x0173, 0x0142, 0x015b, 0x016b, 0x00fc, 0x017c, 0x017e, 0x2019
+	},
+	/* ISO/IEC 8859-14 */
+	{
+		0x00a0, 0x1e02, 0x1e03, 0x00a3, 0x010a, 0x010b, 0x1e0a, 0x00a7,
+		0x1e80, 0x00a9, 0x1e82, 0x1e0b, 0x1ef2, 0x00ad, 0x00ae, 0x0178,
+		0x1e1e, 0x1e1f, 0x0120, 0x0121, 0x1e40, 0x1e41, 0x00b6, 0x1e56,
+		0x1e81, 0x1e57, 0x1e83, 0x1e60, 0x1ef3, 0x1e84, 0x1e85, 0x1e61,
+		0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7,
+		0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+		0x0174, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x1e6a,
+		0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x0176, 0x00df,
+		0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+		0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+		0x0175, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x1e6b,
+		0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x0177, 0x00ff
+	},
+	/* ISO/IEC 8859-15 */
+	{
+		0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x20ac, 0x00a5, 0x0160, 0x00a7,
+		0x0161, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+		0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x017d, 0x00b5, 0x00b6, 0x00b7,
+		0x017e, 0x00b9, 0x00ba, 0x00bb, 0x0152, 0x0153, 0x0178, 0x00bf,
+		0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7,
+		0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+		0x00d0, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7,
+		0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+		0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+		0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+		0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7,
+		0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff
+	}
+};
+
+/* Letters the DVB default table's non spacing diacritics (0xc1-0xcf) combine
+ * with, the diacritic coming before the letter. */
+typedef struct tTextComposition {
+	unsigned char	diacritic;
+	unsigned char	letter;
+	unsigned short	code_point;
+} TextComposition;
+
+static const TextComposition text_compositions[] = {
+	{ 0xc1, 'A', 0x00c0 }, { 0xc1, 'E', 0x00c8 }, { 0xc1, 'I', 0x00cc }, { 0xc1, 'N', 0x01f8 }, { 0xc1, 'O', 0x00d2 }, { 0xc1, 'U', 0x00d9 },
+	{ 0xc1, 'W', 0x1e80 }, { 0xc1, 'Y', 0x1ef2 }, { 0xc1, 'a', 0x00e0 }, { 0xc1, 'e', 0x00e8 }, { 0xc1, 'i', 0x00ec }, { 0xc1, 'n', 0x01f9 },
+	{ 0xc1, 'o', 0x00f2 }, { 0xc1, 'u', 0x00f9 }, { 0xc1, 'w', 0x1e81 }, { 0xc1, 'y', 0x1ef3 }, { 0xc2, 'A', 0x00c1 }, { 0xc2, 'C', 0x0106 },
+	{ 0xc2, 'E', 0x00c9 }, { 0xc2, 'G', 0x01f4 }, { 0xc2, 'I', 0x00cd }, { 0xc2, 'K', 0x1e30 }, { 0xc2, 'L', 0x0139 }, { 0xc2, 'M', 0x1e3e },
+	{ 0xc2, 'N', 0x0143 }, { 0xc2, 'O', 0x00d3 }, { 0xc2, 'P', 0x1e54 }, { 0xc2, 'R', 0x0154 }, { 0xc2, 'S', 0x015a }, { 0xc2, 'U', 0x00da },
+	{ 0xc2, 'W', 0x1e82 }, { 0xc2, 'Y', 0x00dd }, { 0xc2, 'Z', 0x0179 }, { 0xc2, 'a', 0x00e1 }, { 0xc2, 'c', 0x0107 }, { 0xc2, 'e', 0x00e9 },
+	{ 0xc2, 'g', 0x01f5 }, { 0xc2, 'i', 0x00ed }, { 0xc2, 'k', 0x1e31 }, { 0xc2, 'l', 0x013a }, { 0xc2, 'm', 0x1e3f }, { 0xc2, 'n', 0x0144 },
+	{ 0xc2, 'o', 0x00f3 }, { 0xc2, 'p', 0x1e55 }, { 0xc2, 'r', 0x0155 }, { 0xc2, 's', 0x015b }, { 0xc2, 'u', 0x00fa }, { 0xc2, 'w', 0x1e83 },
+	{ 0xc2, 'y', 0x00fd }, { 0xc2, 'z', 0x017a }, { 0xc3, 'A', 0x00c2 }, { 0xc3, 'C', 0x0108 }, { 0xc3, 'E', 0x00ca }, { 0xc3, 'G', 0x011c },
+	{ 0xc3, 'H', 0x0124 }, { 0xc3, 'I', 0x00ce }, { 0xc3, 'J', 0x0134 }, { 0xc3, 'O', 0x00d4 }, { 0xc3, 'S', 0x015c }, { 0xc3, 'U', 0x00db },
+	{ 0xc3, 'W', 0x0174 }, { 0xc3, 'Y', 0x0176 }, { 0xc3, 'Z', 0x1e90 }, { 0xc3, 'a', 0x00e2 }, { 0xc3, 'c', 0x0109 }, { 0xc3, 'e', 0x00ea },
+	{ 0xc3, 'g', 0x011d }, { 0xc3, 'h', 0x0125 }, { 0xc3, 'i', 0x00ee }, { 0xc3, 'j', 0x0135 }, { 0xc3, 'o', 0x00f4 }, { 0xc3, 's', 0x015d },
+	{ 0xc3, 'u', 0x00fb }, { 0xc3, 'w', 0x0175 }, { 0xc3, 'y', 0x0177 }, { 0xc3, 'z', 0x1e91 }, { 0xc4, 'A', 0x00c3 }, { 0xc4, 'E', 0x1ebc },
+	{ 0xc4, 'I', 0x0128 }, { 0xc4, 'N', 0x00d1 }, { 0xc4, 'O', 0x00d5 }, { 0xc4, 'U', 0x0168 }, { 0xc4, 'V', 0x1e7c }, { 0xc4, 'Y', 0x1ef8 },
+	{ 0xc4, 'a', 0x00e3 }, { 0xc4, 'e', 0x1ebd }, { 0xc4, 'i', 0x0129 }, { 0xc4, 'n', 0x00f1 }, { 0xc4, 'o', 0x00f5 }, { 0xc4, 'u', 0x0169 },
+	{ 0xc4, 'v', 0x1e7d }, { 0xc4, 'y', 0x1ef9 }, { 0xc5, 'A', 0x0100 }, { 0xc5, 'E', 0x0112 }, { 0xc5, 'G', 0x1e20 }, { 0xc5, 'I', 0x012a },
+	{ 0xc5, 'O', 0x014c }, { 0xc5, 'U', 0x016a }, { 0xc5, 'Y', 0x0232 }, { 0xc5, 'a', 0x0101 }, { 0xc5, 'e', 0x0113 }, { 0xc5, 'g', 0x1e21 },
+	{ 0xc5, 'i', 0x012b }, { 0xc5, 'o', 0x014d }, { 0xc5, 'u', 0x016b }, { 0xc5, 'y', 0x0233 }, { 0xc6, 'A', 0x0102 }, { 0xc6, 'E', 0x0114 },
+	{ 0xc6, 'G', 0x011e }, { 0xc6, 'I', 0x012c }, { 0xc6, 'O', 0x014e }, { 0xc6, 'U', 0x016c }, { 0xc6, 'a', 0x0103 }, { 0xc6, 'e', 0x0115 },
+	{ 0xc6, 'g', 0x011f }, { 0xc6, 'i', 0x012d }, { 0xc6, 'o', 0x014f }, { 0xc6, 'u', 0x016d }, { 0xc7, 'A', 0x0226 }, { 0xc7, 'B', 0x1e02 },
+	{ 0xc7, 'C', 0x010a }, { 0xc7, 'D', 0x1e0a }, { 0xc7, 'E', 0x0116 }, { 0xc7, 'F', 0x1e1e }, { 0xc7, 'G', 0x0120 }, { 0xc7, 'H', 0x1e22 },
+	{ 0xc7, 'I', 0x0130 }, { 0xc7, 'M', 0x1e40 }, { 0xc7, 'N', 0x1e44 }, { 0xc7, 'O', 0x022e }, { 0xc7, 'P', 0x1e56 }, { 0xc7, 'R', 0x1e58 },
+	{ 0xc7, 'S', 0x1e60 }, { 0xc7, 'T', 0x1e6a }, { 0xc7, 'W', 0x1e86 }, { 0xc7, 'X', 0x1e8a }, { 0xc7, 'Y', 0x1e8e }, { 0xc7, 'Z', 0x017b },
+	{ 0xc7, 'a', 0x0227 }, { 0xc7, 'b', 0x1e03 }, { 0xc7, 'c', 0x010b }, { 0xc7, 'd', 0x1e0b }, { 0xc7, 'e', 0x0117 }, { 0xc7, 'f', 0x1e1f },
+	{ 0xc7, 'g', 0x0121 }, { 0xc7, 'h', 0x1e23 }, { 0xc7, 'm', 0x1e41 }, { 0xc7, 'n', 0x1e45 }, { 0xc7, 'o', 0x022f }, { 0xc7, 'p', 0x1e57 },
+	{ 0xc7, 'r', 0x1e59 }, { 0xc7, 's', 0x1e61 }, { 0xc7, 't', 0x1e6b }, { 0xc7, 'w', 0x1e87 }, { 0xc7, 'x', 0x1e8b }, { 0xc7, 'y', 0x1e8f },
+	{ 0xc7, 'z', 0x017c }, { 0xc8, 'A', 0x00c4 }, { 0xc8, 'E', 0x00cb }, { 0xc8, 'H', 0x1e26 }, { 0xc8, 'I', 0x00cf }, { 0xc8, 'O', 0x00d6 },
+	{ 0xc8, 'U', 0x00dc }, { 0xc8, 'W', 0x1e84 }, { 0xc8, 'X', 0x1e8c }, { 0xc8, 'Y', 0x0178 }, { 0xc8, 'a', 0x00e4 }, { 0xc8, 'e', 0x00eb },
+	{ 0xc8, 'h', 0x1e27 }, { 0xc8, 'i', 0x00ef }, { 0xc8, 'o', 0x00f6 }, { 0xc8, 't', 0x1e97 }, { 0xc8, 'u', 0x00fc }, { 0xc8, 'w', 0x1e85 },
+	{ 0xc8, 'x', 0x1e8d }, { 0xc8, 'y', 0x00ff }, { 0xca, 'A', 0x00c5 }, { 0xca, 'U', 0x016e }, { 0xca, 'a', 0x00e5 }, { 0xca, 'u', 0x016f },
+	{ 0xca, 'w', 0x1e98 }, { 0xca, 'y', 0x1e99 }, { 0xcb, 'C', 0x00c7 }, { 0xcb, 'D', 0x1e10 }, { 0xcb, 'E', 0x0228 }, { 0xcb, 'G', 0x0122 },
+	{ 0xcb, 'H', 0x1e28 }, { 0xcb, 'K', 0x0136 }, { 0xcb, 'L', 0x013b }, { 0xcb, 'N', 0x0145 }, { 0xcb, 'R', 0x0156 }, { 0xcb, 'S', 0x015e },
+	{ 0xcb, 'T', 0x0162 }, { 0xcb, 'c', 0x00e7 }, { 0xcb, 'd', 0x1e11 }, { 0xcb, 'e', 0x0229 }, { 0xcb, 'g', 0x0123 }, { 0xcb, 'h', 0x1e29 },
+	{ 0xcb, 'k', 0x0137 }, { 0xcb, 'l', 0x013c }, { 0xcb, 'n', 0x0146 }, { 0xcb, 'r', 0x0157 }, { 0xcb, 's', 0x015f }, { 0xcb, 't', 0x0163 },
+	{ 0xcd, 'O', 0x0150 }, { 0xcd, 'U', 0x0170 }, { 0xcd, 'o', 0x0151 }, { 0xcd, 'u', 0x0171 }, { 0xce, 'A', 0x0104 }, { 0xce, 'E', 0x0118 },
+	{ 0xce, 'I', 0x012e }, { 0xce, 'O', 0x01ea }, { 0xce, 'U', 0x0172 }, { 0xce, 'a', 0x0105 }, { 0xce, 'e', 0x0119 }, { 0xce, 'i', 0x012f },
+	{ 0xce, 'o', 0x01eb }, { 0xce, 'u', 0x0173 }, { 0xcf, 'A', 0x01cd }, { 0xcf, 'C', 0x010c }, { 0xcf, 'D', 0x010e }, { 0xcf, 'E', 0x011a },
+	{ 0xcf, 'G', 0x01e6 }, { 0xcf, 'H', 0x021e }, { 0xcf, 'I', 0x01cf }, { 0xcf, 'K', 0x01e8 }, { 0xcf, 'L', 0x013d }, { 0xcf, 'N', 0x0147 },
+	{ 0xcf, 'O', 0x01d1 }, { 0xcf, 'R', 0x0158 }, { 0xcf, 'S', 0x0160 }, { 0xcf, 'T', 0x0164 }, { 0xcf, 'U', 0x01d3 }, { 0xcf, 'Z', 0x017d },
+	{ 0xcf, 'a', 0x01ce }, { 0xcf, 'c', 0x010d }, { 0xcf, 'd', 0x010f }, { 0xcf, 'e', 0x011b }, { 0xcf, 'g', 0x01e7 }, { 0xcf, 'h', 0x021f },
+	{ 0xcf, 'i', 0x01d0 }, { 0xcf, 'j', 0x01f0 }, { 0xcf, 'k', 0x01e9 }, { 0xcf, 'l', 0x013e }, { 0xcf, 'n', 0x0148 }, { 0xcf, 'o', 0x01d2 },
+	{ 0xcf, 'r', 0x0159 }, { 0xcf, 's', 0x0161 }, { 0xcf, 't', 0x0165 }, { 0xcf, 'u', 0x01d4 }, { 0xcf, 'z', 0x017e }
+};
+
+/* One byte of a character table as UTF-8. */
+typedef struct tTextChar {
+	unsigned char	length;
+	char		utf8[3];
+} TextChar;
+
+static TextChar text_chars[TEXT_CHARSETS][256];
+
+/* Composed code point by diacritic (low nibble) and letter (less 0x40), 0 if none. */
+static unsigned short text_composed[16][64];
+
+/* Interned strings, hashed with open addressing and stored back to back in
+ * blocks, each with its length byte in front as in a descriptor. */
+#define TEXT_BLOCK_SIZE 16384
+
+typedef struct tTextInternEntry {
+	unsigned int	hash;
+	unsigned char	*data;
+} TextInternEntry;
+
+static struct {
+	pthread_mutex_t	lock;
+
+	TextInternEntry	*entries;
+	unsigned int	size;
+	unsigned int	count;
+
+	/* Current block, each block starts with a pointer to the one before. */
+	unsigned char	*block;
+	size_t		block_used;
+	size_t		block_size;
+
+	/* Statistics. */
+	size_t		bytes;
+	unsigned long	lookups;
+
+	/* Contexts using the set, it's released when the last one goes. */
+	unsigned int	users;
+} text_set = { PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, NULL, 0, 0, 0, 0, 0 };
+
+static pthread_once_t text_once = PTHREAD_ONCE_INIT;
+
+static int text_encode (unsigned int code_point, char *out) {
+	if (code_point < 0x80) {
+		out[0] = code_point;
+		return 1;
+	}
+
+	if (code_point < 0x800) {
+		out[0] = 0xc0 | (code_point >> 6);
+		out[1] = 0x80 | (code_point & 0x3f);
+		return 2;
+	}
+
+	/* Surrogates can't be encoded on their own. */
+	if (code_point >= 0xd800 && code_point <= 0xdfff) {
+		return 0;
+	}
+
+	out[0] = 0xe0 | (code_point >> 12);
+	out[1] = 0x80 | ((code_point >> 6) & 0x3f);
+	out[2] = 0x80 | (code_point & 0x3f);
+	return 3;
+}
+
+/* Build the UTF-8 tables, once for the process. */
+static void text_tables (void) {
+	unsigned int charset, byte, code_point, i;
+	TextChar *c;
+
+	for (charset = 0; charset < TEXT_CHARSETS; charset++) {
+		for (byte = 0; byte < 256; byte++) {
+			c = &text_chars[charset][byte];
+
+			/* Control codes are dropped, except CR/LF which breaks a line. */
+			if (byte < 0x20 || (byte >= 0x7f && byte < 0xa0)) {
+				code_point = byte == 0x8a ? ' ' : 0;
+			} else if (byte < 0x80) {
+				code_point = byte;
+			} else {
+				code_point = text_upper[charset][byte - 0xa0];
+			}
+
+			c->length = code_point ? text_encode(code_point, c->utf8) : 0;
+		}
+	}
+
+	for (i = 0; i < sizeof(text_compositions) / sizeof(TextComposition); i++) {
+		text_composed[text_compositions[i].diacritic & 0x0f][text_compositions[i].letter - 0x40] = text_compositions[i].code_point;
+	}
+}
+
+/* Before any text is converted, once for each user of the intern set. */
+void text_init (void) {
+	pthread_once(&text_once, text_tables);
+
+	pthread_mutex_lock(&text_set.lock);
+	text_set.users++;
+	pthread_mutex_unlock(&text_set.lock);
+}
+
+/* True if every byte is printable ASCII, eight at a time. A byte below 0x20
+ * borrows into its top bit when 0x20 is taken away, 0x7f carries into it when
+ * one is added, and a byte above 0x7f has it set already. */
+static int text_ascii (const unsigned char *data, int data_length) {
+	unsigned long long word;
+	int i = 0;
+
+	for (; i + 8 <= data_length; i += 8) {
+		memcpy(&word, data + i, 8);
+
+		if ((word | (word - 0x2020202020202020ULL) | (word + 0x0101010101010101ULL)) & 0x8080808080808080ULL) {
+			return 0;
+		}
+	}
+
+	for (; i < data_length; i++) {
+		if (data[i] < 0x20 || data[i] > 0x7e) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* ISO/IEC 10646 Basic Multilingual Plane, two bytes big endian per character. */
+static int text_convert_ucs2 (const unsigned char *data, int data_length, char *out, int out_size) {
+	unsigned int code_point;
+	int i, used = 0;
+
+	for (i = 0; i + 1 < data_length && used + 3 < out_size; i += 2) {
+		code_point = (data[i] << 8) | data[i + 1];
+
+		/* Control codes live at 0xe080-0xe09f. */
+		if (code_point >= 0xe080 && code_point <= 0xe09f) {
+			code_point = code_point == 0xe08a ? ' ' : 0;
+		}
+
+		if (code_point >= 0x20 && code_point != 0x7f) {
+			used += text_encode(code_point, out + used);
+		}
+	}
+
+	out[used] = '\0';
+
+	return used;
+}
+
+/* Convert a DVB string to UTF-8 in out, which is always terminated. Returns
+ * the length of out. */
+int text_convert (const unsigned char *data, int data_length, char *out, int out_size) {
+	unsigned int charset = TEXT_CHARSET_DEFAULT, composed;
+	int i, used = 0;
+	TextChar *c;
+
+	if (data_length <= 0 || out_size <= 0) {
+		if (out_size > 0) {
+			out[0] = '\0';
+		}
+
+		return 0;
+	}
+
+	/* Nearly every name is plain ASCII, which is the same in every table. */
+	if (data[0] >= 0x20 && text_ascii(data, data_length)) {
+		used = data_length < out_size - 1 ? data_length : out_size - 1;
+		memcpy(out, data, used);
+		out[used] = '\0';
+		return used;
+	}
+
+	/* Pick the character table, the default unless the first byte says otherwise. */
+	if (data[0] < 0x20) {
+		if (data[0] >= 0x01 && data[0] <= 0x0b) {
+			charset = data[0] + 4;
+			data++;
+			data_length--;
+		} else if (data[0] == 0x10 && data_length >= 3 && data[1] == 0x00 && data[2] >= 1 && data[2] < TEXT_CHARSETS) {
+			charset = data[2];
+			data += 3;
+			data_length -= 3;
+		} else if (data[0] == 0x11) {
+			return text_convert_ucs2(data + 1, data_length - 1, out, out_size);
+		} else if (data[0] == 0x15) {
+			/* UTF-8 already, only the control codes are dropped. */
+			for (i = 1; i < data_length && used < out_size - 1; i++) {
+				if (data[i] >= 0x20 && data[i] != 0x7f) {
+					out[used++] = data[i];
+				}
+			}
+
+			out[used] = '\0';
+			return used;
+		} else {
+			slowlane_log(2, "Unsupported DVB character table 0x%02x, keeping ASCII only.", data[0]);
+			charset = TEXT_CHARSET_ASCII;
+			data++;
+			data_length--;
+		}
+	}
+
+	for (i = 0; i < data_length && used + 3 < out_size; i++) {
+		/* The default table puts a diacritic before the letter it sits on. */
+		if (charset == TEXT_CHARSET_DEFAULT && data[i] >= 0xc1 && data[i] <= 0xcf) {
+			if (i + 1 < data_length && data[i + 1] >= 0x40 && data[i + 1] < 0x80 && (composed = text_composed[data[i] & 0x0f][data[i + 1] - 0x40])) {
+				used += text_encode(composed, out + used);
+				i++;
+			}
+
+			/* Otherwise the letter goes out bare. */
+			continue;
+		}
+
+		c = &text_chars[charset][data[i]];
+		memcpy(out + used, c->utf8, 3);
+		used += c->length;
+	}
+
+	out[used] = '\0';
+
+	return used;
+}
+
+/* FNV-1a. */
+static unsigned int text_hash (const unsigned char *data, int length) {
+	unsigned int hash = 2166136261U;
+	int i;
+
+	for (i = 0; i < length; i++) {
+		hash = (hash ^ data[i]) * 16777619U;
+	}
+
+	return hash;
+}
+
+static int text_set_grow (void) {
+	TextInternEntry *entries, *entry;
+	unsigned int size = text_set.size ? text_set.size * 2 : 1024, i, j;
+
+	if ((entries = (TextInternEntry *) calloc(size, sizeof(TextInternEntry))) == NULL) {
+		slowlane_log(0, "Unable to grow string set to %u entries.", size);
+		return -1;
+	}
+
+	for (i = 0; i < text_set.size; i++) {
+		entry = &text_set.entries[i];
+
+		if (entry->data) {
+			for (j = entry->hash & (size - 1); entries[j].data; j = (j + 1) & (size - 1));
+			entries[j] = *entry;
+		}
+	}
+
+	free(text_set.entries);
+	text_set.entries = entries;
+	text_set.size = size;
+
+	return 0;
+}
+
+/* Copy a string and its length into the current block, starting a new one if
+ * it won't fit. */
+static unsigned char * text_set_store (const unsigned char *data, int length) {
+	unsigned char *block;
+
+	if (text_set.block == NULL || text_set.block_used + length + 1 > text_set.block_size) {
+		if ((block = (unsigned char *) malloc(TEXT_BLOCK_SIZE)) == NULL) {
+			slowlane_log(0, "Unable to allocate string block of %i bytes.", TEXT_BLOCK_SIZE);
+			return NULL;
+		}
+
+		memcpy(block, &text_set.block, sizeof(unsigned char *));
+		text_set.block = block;
+		text_set.block_used = sizeof(unsigned char *);
+		text_set.block_size = TEXT_BLOCK_SIZE;
+		text_set.bytes += TEXT_BLOCK_SIZE;
+	}
+
+	block = text_set.block + text_set.block_used;
+	block[0] = length;
+	memcpy(block + 1, data, length);
+	text_set.block_used += length + 1;
+
+	return block;
+}
+
+/* A view of the shared copy of a DVB string of up to 255 bytes, which lives
+ * until text_free. The view is empty if memory ran out. */
+TextView text_intern (const unsigned char *data, int data_length) {
+	unsigned int hash = text_hash(data, data_length), i;
+	TextView view = { NULL };
+
+	pthread_mutex_lock(&text_set.lock);
+
+	text_set.lookups++;
+
+	if ((text_set.count + 1) * 2 > text_set.size && text_set_grow() < 0) {
+		pthread_mutex_unlock(&text_set.lock);
+		return view;
+	}
+
+	for (i = hash & (text_set.size - 1); text_set.entries[i].data; i = (i + 1) & (text_set.size - 1)) {
+		if (text_set.entries[i].hash == hash && text_set.entries[i].data[0] == data_length && memcmp(text_set.entries[i].data + 1, data, data_length) == 0) {
+			view.data = text_set.entries[i].data;
+			break;
+		}
+	}
+
+	if (view.data == NULL && (view.data = text_set_store(data, data_length)) != NULL) {
+		text_set.entries[i].hash = hash;
+		text_set.entries[i].data = (unsigned char *) view.data;
+		text_set.count++;
+	}
+
+	pthread_mutex_unlock(&text_set.lock);
+
+	return view;
+}
+
+/* A view converted to UTF-8 in out, NULL if no string was seen. */
+const char * text_view_string (TextView view, char *out, int out_size) {
+	if (view.data == NULL) {
+		return NULL;
+	}
+
+	text_convert(view.data + 1, view.data[0], out, out_size);
+
+	return out;
+}
+
+void text_intern_stats (unsigned int *count, size_t *bytes, unsigned long *lookups) {
+	pthread_mutex_lock(&text_set.lock);
+	*count = text_set.count;
+	*bytes = text_set.bytes + text_set.size * sizeof(TextInternEntry);
+	*lookups = text_set.lookups;
+	pthread_mutex_unlock(&text_set.lock);
+}
+
+/* Release every interned string once the last user is done, nothing may
+ * refer to them afterwards. */
+void text_free (void) {
+	unsigned char *block;
+
+	pthread_mutex_lock(&text_set.lock);
+
+	if (text_set.users > 1) {
+		text_set.users--;
+		pthread_mutex_unlock(&text_set.lock);
+		return;
+	}
+
+	text_set.users = 0;
+
+	while ((block = text_set.block) != NULL) {
+		memcpy(&text_set.block, block, sizeof(unsigned char *));
+		free(block);
+	}
+
+	free(text_set.entries);
+	text_set.entries = NULL;
+	text_set.size = text_set.count = 0;
+	text_set.block_used = text_set.block_size = text_set.bytes = 0;
+
+	pthread_mutex_unlock(&text_set.lock);
+}
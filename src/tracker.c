@@ -0,0 +1,119 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * tracker.c - Section tracking by table key, for when the tables themselves
+ * are being built somewhere else.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slowlane.h"
+#include "tracker.h"
+
+#define TRACKER_INITIAL_SIZE 256
+
+/* Actual and other versions of a table describe the same thing, and the data
+ * model stores them in the same place. */
+unsigned char tracker_table_class (unsigned char table_id) {
+	switch (table_id) {
+		case 0x41: /* Network Information Table - Other Muxes */
+			return 0x40;
+		case 0x46: /* Service Description Table - Other Muxes */
+			return 0x42;
+		case 0x4f: /* Event Information Table - Present/Following Other Muxes */
+			return 0x4e;
+		default:
+			/* Event Information Table - Schedule Other Muxes */
+			if (table_id >= 0x60 && table_id <= 0x6f) {
+				return table_id - 0x10;
+			}
+
+			return table_id;
+	}
+}
+
+static unsigned long long tracker_key (unsigned char table_id, unsigned short extension, unsigned short original_network_id, unsigned short transport_id) {
+	return ((unsigned long long) transport_id << 40) | ((unsigned long long) tracker_table_class(table_id) << 32) | ((unsigned long long) extension << 16) | original_network_id;
+}
+
+static unsigned int tracker_hash (unsigned long long key) {
+	key ^= key >> 29;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 32;
+	return (unsigned int) key;
+}
+
+int tracker_init (SectionTracker *tracker) {
+	tracker->size = TRACKER_INITIAL_SIZE;
+	tracker->count = 0;
+
+	if ((tracker->entries = (TrackerEntry *) calloc(tracker->size, sizeof(TrackerEntry))) == NULL) {
+		slowlane_log(0, "Unable to allocate tracker of %u entries.", tracker->size);
+		return -1;
+	}
+
+	return 0;
+}
+
+void tracker_free (SectionTracker *tracker) {
+	free(tracker->entries);
+	tracker->entries = NULL;
+	tracker->size = tracker->count = 0;
+}
+
+/* Double the table and rehash, keeps the load under a half. */
+static int tracker_grow (SectionTracker *tracker) {
+	TrackerEntry *old = tracker->entries;
+	unsigned int old_size = tracker->size, i, pos;
+
+	if ((tracker->entries = (TrackerEntry *) calloc(old_size * 2, sizeof(TrackerEntry))) == NULL) {
+		slowlane_log(0, "Unable to grow tracker to %u entries.", old_size * 2);
+		tracker->entries = old;
+		return -1;
+	}
+
+	tracker->size = old_size * 2;
+
+	for (i = 0; i < old_size; i++) {
+		if (old[i].key) {
+			for (pos = tracker_hash(old[i].key) & (tracker->size - 1); tracker->entries[pos].key; pos = (pos + 1) & (tracker->size - 1));
+			tracker->entries[pos] = old[i];
+		}
+	}
+
+	free(old);
+	return 0;
+}
+
+/* Find the tracking for a table, adding an empty one if create is set. */
+SectionTracking * tracker_get (SectionTracker *tracker, unsigned char table_id, unsigned short extension, unsigned short original_network_id, unsigned short transport_id, int create) {
+	unsigned long long key = tracker_key(table_id, extension, original_network_id, transport_id);
+	unsigned int pos;
+
+	for (pos = tracker_hash(key) & (tracker->size - 1); tracker->entries[pos].key; pos = (pos + 1) & (tracker->size - 1)) {
+		if (tracker->entries[pos].key == key) {
+			return &tracker->entries[pos].sections;
+		}
+	}
+
+	if (!create) {
+		return NULL;
+	}
+
+	if ((tracker->count + 1) * 2 > tracker->size) {
+		if (tracker_grow(tracker) < 0) {
+			return NULL;
+		}
+
+		return tracker_get(tracker, table_id, extension, original_network_id, transport_id, create);
+	}
+
+	tracker->entries[pos].key = key;
+	tracker->count++;
+
+	return &tracker->entries[pos].sections;
+}
@@ -0,0 +1,361 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * ts.c - Transport stream section demultiplexer. Takes raw 188 byte packets
+ * from a recording or the dvr device, reassembles PSI sections on every
+ * filtered PID and passes on those that match a section filter, so that
+ * what comes out reads the same as the demux's section output.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "slowlane.h"
+#include "crc32.h"
+#include "filter.h"
+#include "ts.h"
+
+int ts_demux_init (TsDemux *ts, TsSectionCallback callback, void *context) {
+	int retval;
+
+	memset(ts, '\0', sizeof(TsDemux));
+	ts->callback = callback;
+	ts->context = context;
+
+	if ((retval = pthread_mutex_init(&ts->lock, NULL)) != 0) {
+		slowlane_log(0, "Unable to create lock for TS demux (%s).", strerror(retval));
+		return -1;
+	}
+
+	return 0;
+}
+
+void ts_demux_free (TsDemux *ts) {
+	int i;
+
+	slowlane_log(1, "TS demux saw %lu packets, %lu resyncs, %lu discontinuities, passed %lu sections, %lu CRC errors.", ts->packets, ts->resyncs, ts->discontinuities, ts->sections, ts->crc_errors);
+
+	for (i = 0; i < TS_PID_COUNT; i++) {
+		free(ts->pids[i]);
+	}
+
+	pthread_mutex_destroy(&ts->lock);
+}
+
+/* Install a filter into slot index, replacing what was there, in the same way
+ * DMX_SET_FILTER on a demux fd replaces its filter. Safe from any thread. */
+int ts_demux_set_filter (TsDemux *ts, int index, SectionFilter *filter) {
+	if (index < 0 || index >= TS_FILTER_MAX || filter->pid >= TS_PID_COUNT) {
+		slowlane_log(0, "Unable to set TS filter %i for PID 0x%x.", index, filter->pid);
+		return -1;
+	}
+
+	pthread_mutex_lock(&ts->lock);
+	memcpy(&ts->pending[index], filter, sizeof(SectionFilter));
+	filter_prepare(&ts->pending[index]);
+	ts->pending_used[index] = 1;
+	ts->pending_changed = 1;
+	pthread_mutex_unlock(&ts->lock);
+
+	slowlane_log(1, "Installed TS filter %i for PID 0x%x for table 0x%x/0x%x, CRC = %i.", index, filter->pid, filter->filter[0], filter->mask[0], filter->flags & FILTER_CHECK_CRC);
+	return 0;
+}
+
+void ts_demux_clear_filter (TsDemux *ts, int index) {
+	if (index < 0 || index >= TS_FILTER_MAX) {
+		return;
+	}
+
+	pthread_mutex_lock(&ts->lock);
+	ts->pending_used[index] = 0;
+	ts->pending_changed = 1;
+	pthread_mutex_unlock(&ts->lock);
+}
+
+/* Pick up filter changes, only ever called on the demuxing thread. */
+static void ts_demux_apply_filters (TsDemux *ts) {
+	TsPid *tspid;
+	int i;
+
+	pthread_mutex_lock(&ts->lock);
+
+	if (ts->pending_changed) {
+		memcpy(ts->filters, ts->pending, sizeof(ts->filters));
+		memcpy(ts->filter_used, ts->pending_used, sizeof(ts->filter_used));
+		memset(ts->pid_map, '\0', sizeof(ts->pid_map));
+		ts->pending_changed = 0;
+
+		for (i = 0; i < TS_FILTER_MAX; i++) {
+			if (!ts->filter_used[i]) {
+				continue;
+			}
+
+			/* First filter on a PID, give it an assembler. */
+			if (ts->pids[ts->filters[i].pid] == NULL) {
+				if ((tspid = (TsPid *) malloc(sizeof(TsPid))) == NULL) {
+					slowlane_log(0, "Unable to allocate assembler for PID 0x%x.", ts->filters[i].pid);
+					continue;
+				}
+
+				tspid->continuity = -1;
+				tspid->length = -1;
+				tspid->section_length = 0;
+				ts->pids[ts->filters[i].pid] = tspid;
+			}
+
+			ts->pid_map[ts->filters[i].pid >> 5] |= 1u << (ts->filters[i].pid & 31);
+		}
+	}
+
+	pthread_mutex_unlock(&ts->lock);
+}
+
+/* Run a whole section past the filters on its PID. */
+static void ts_demux_section (TsDemux *ts, unsigned short pid, unsigned char *section, int section_length) {
+	int i, crc_state = 0;
+
+	for (i = 0; i < TS_FILTER_MAX; i++) {
+		if (!ts->filter_used[i] || ts->filters[i].pid != pid || !filter_match(&ts->filters[i], section, section_length)) {
+			continue;
+		}
+
+		/* As the kernel, only sections with the syntax indicator carry a CRC, work it out once. */
+		if ((ts->filters[i].flags & FILTER_CHECK_CRC) && (section[1] & 0x80)) {
+			if (crc_state == 0) {
+				crc_state = crc32((char *) section, section_length, 0xffffffff) ? -1 : 1;
+			}
+
+			if (crc_state < 0) {
+				continue;
+			}
+		}
+
+		ts->sections++;
+		ts->callback(ts->context, section, section_length);
+		return;
+	}
+
+	if (crc_state < 0) {
+		ts->crc_errors++;
+		slowlane_log(2, "Section 0x%x on PID 0x%x failed CRC check.", section[0], pid);
+	}
+}
+
+/* Add payload to the section being built on a PID, handing on each one completed. */
+static void ts_demux_append (TsDemux *ts, unsigned short pid, TsPid *tspid, unsigned char *data, int length) {
+	int need;
+
+	while (length > 0 && tspid->length >= 0) {
+		/* Stuffing fills the rest of a packet after the last section. */
+		if (tspid->length == 0 && data[0] == 0xff) {
+			tspid->length = -1;
+			return;
+		}
+
+		/* Header first, then whatever it says is left. */
+		need = (tspid->length < 3 ? 3 : tspid->section_length) - tspid->length;
+
+		if (need > length) {
+			need = length;
+		}
+
+		memcpy(tspid->data + tspid->length, data, need);
+		tspid->length += need;
+		data += need;
+		length -= need;
+
+		if (tspid->length == 3 && tspid->section_length == 0) {
+			tspid->section_length = (((tspid->data[1] & 0x0f) << 8) | tspid->data[2]) + 3;
+
+			if (tspid->section_length > TS_SECTION_MAX) {
+				slowlane_log(2, "Section of %i bytes on PID 0x%x is too long, dropping.", tspid->section_length, pid);
+				tspid->length = -1;
+				tspid->section_length = 0;
+				return;
+			}
+		}
+
+		if (tspid->length >= 3 && tspid->length == tspid->section_length) {
+			ts_demux_section(ts, pid, tspid->data, tspid->length);
+
+			/* Another section may follow straight on in this payload. */
+			tspid->length = 0;
+			tspid->section_length = 0;
+		}
+	}
+}
+
+/* Handle one packet that starts with a sync byte. */
+static void ts_demux_packet (TsDemux *ts, unsigned char *packet) {
+	unsigned short pid = ((packet[1] & 0x1f) << 8) | packet[2];
+	unsigned char *payload, pointer;
+	int remaining, continuity;
+	TsPid *tspid;
+
+	/* The vast majority of packets are for PIDs nobody asked for. */
+	if (!(ts->pid_map[pid >> 5] & (1u << (pid & 31)))) {
+		return;
+	}
+
+	tspid = ts->pids[pid];
+
+	/* Something upstream knows this packet is damaged, so is the section. */
+	if (packet[1] & 0x80) {
+		tspid->length = -1;
+		tspid->continuity = -1;
+		return;
+	}
+
+	/* Only packets with a payload count towards continuity. */
+	if (!(packet[3] & 0x10)) {
+		return;
+	}
+
+	continuity = packet[3] & 0x0f;
+
+	if (tspid->continuity >= 0 && continuity != tspid->continuity) {
+		/* A repeated packet may be sent once, it carries nothing new. */
+		if (continuity == ((tspid->continuity + 15) & 0x0f)) {
+			return;
+		}
+
+		ts->discontinuities++;
+		tspid->length = -1;
+	}
+
+	tspid->continuity = (continuity + 1) & 0x0f;
+
+	/* Skip any adaptation field. */
+	payload = packet + 4;
+
+	if (packet[3] & 0x20) {
+		if (packet[4] > TS_PACKET_SIZE - 5) {
+			tspid->length = -1;
+			return;
+		}
+
+		payload += packet[4] + 1;
+	}
+
+	remaining = packet + TS_PACKET_SIZE - payload;
+
+	if (remaining <= 0) {
+		return;
+	} else if (packet[1] & 0x40) {
+		/* A section starts here, pointer_field says how much belongs to the last one. */
+		pointer = payload[0];
+		payload++;
+		remaining--;
+
+		if (pointer > remaining) {
+			tspid->length = -1;
+			return;
+		}
+
+		if (tspid->length > 0) {
+			ts_demux_append(ts, pid, tspid, payload, pointer);
+		}
+
+		tspid->length = 0;
+		tspid->section_length = 0;
+		ts_demux_append(ts, pid, tspid, payload + pointer, remaining - pointer);
+	} else if (tspid->length > 0) {
+		ts_demux_append(ts, pid, tspid, payload, remaining);
+	}
+}
+
+/* Find the next sync byte from offset, -1 if there isn't one. */
+static int ts_find_sync (unsigned char *buffer, int offset, int buffer_length) {
+#ifdef __SSE2__
+	__m128i sync = _mm_set1_epi8(TS_SYNC_BYTE);
+	int found;
+
+	for (; offset + 16 <= buffer_length; offset += 16) {
+		if ((found = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *) (buffer + offset)), sync))) != 0) {
+			return offset + __builtin_ctz(found);
+		}
+	}
+#endif
+
+	for (; offset < buffer_length; offset++) {
+		if (buffer[offset] == TS_SYNC_BYTE) {
+			return offset;
+		}
+	}
+
+	return -1;
+}
+
+/* Find where packets start again, a sync byte is only believed if the next
+ * two packets in the buffer also start with one. */
+static int ts_resync (unsigned char *buffer, int offset, int buffer_length) {
+	while ((offset = ts_find_sync(buffer, offset, buffer_length)) >= 0) {
+		if ((offset + TS_PACKET_SIZE >= buffer_length || buffer[offset + TS_PACKET_SIZE] == TS_SYNC_BYTE) &&
+		    (offset + 2 * TS_PACKET_SIZE >= buffer_length || buffer[offset + 2 * TS_PACKET_SIZE] == TS_SYNC_BYTE)) {
+			return offset;
+		}
+
+		offset++;
+	}
+
+	return -1;
+}
+
+/* Demux a buffer of packets, which need not start or end on a packet boundary. */
+void ts_demux_process (TsDemux *ts, unsigned char *buffer, int buffer_length) {
+	int offset = 0, need;
+
+	ts_demux_apply_filters(ts);
+
+	/* Finish off the packet split over the last read. */
+	if (ts->carry_length) {
+		need = TS_PACKET_SIZE - ts->carry_length;
+
+		if (buffer_length < need) {
+			memcpy(ts->carry + ts->carry_length, buffer, buffer_length);
+			ts->carry_length += buffer_length;
+			return;
+		}
+
+		memcpy(ts->carry + ts->carry_length, buffer, need);
+		ts->carry_length = 0;
+
+		/* Only use it if we're still in step afterwards. */
+		if (need == buffer_length || buffer[need] == TS_SYNC_BYTE) {
+			ts->packets++;
+			ts_demux_packet(ts, ts->carry);
+		}
+
+		offset = need;
+	}
+
+	while (offset + TS_PACKET_SIZE <= buffer_length) {
+		if (buffer[offset] != TS_SYNC_BYTE) {
+			ts->resyncs++;
+
+			if ((offset = ts_resync(buffer, offset, buffer_length)) < 0) {
+				return;
+			}
+
+			continue;
+		}
+
+		ts->packets++;
+		ts_demux_packet(ts, buffer + offset);
+		offset += TS_PACKET_SIZE;
+	}
+
+	/* Keep the start of a split packet for next time. */
+	if (offset < buffer_length && (offset = ts_find_sync(buffer, offset, buffer_length)) >= 0) {
+		ts->carry_length = buffer_length - offset;
+		memcpy(ts->carry, buffer + offset, ts->carry_length);
+	}
+}
@@ -0,0 +1,286 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * worker.c - Sharded section parsing. Sections are handed to a pool of
+ * workers by table class and extension, so each network, transport and
+ * bouquet is only ever built by one worker in a model of its own and no
+ * locking is needed, and a service's event tables all go to one worker.
+ * The NIT is small and gates the second phase, so it is parsed on the
+ * dispatching thread into the global model, and the workers' models are
+ * merged into it once acquisition is complete.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "slowlane.h"
+#include "si.h"
+#include "data.h"
+#include "event.h"
+#include "queue.h"
+#include "tracker.h"
+#include "worker.h"
+
+/* How long either side waits on a queue before checking on the other. */
+#define WORKER_WAIT_MS 10
+
+/* All event tables of a service, or OpenTV channel, go to the same worker. */
+static unsigned char worker_shard_class (unsigned char table_id) {
+	if (event_table_eit(table_id)) {
+		return EVENT_TABLE_FIRST;
+	} else if (event_table_opentv(table_id)) {
+		return EVENT_OPENTV_TITLE_FIRST;
+	}
+
+	return tracker_table_class(table_id);
+}
+
+/* Pull the tracking fields out of a section header. */
+static void worker_section_event (unsigned char *buffer, int section_length, SectionEvent *event) {
+	memset(event, '\0', sizeof(SectionEvent));
+	event->table_id = buffer[0];
+
+	if (section_length >= 8) {
+		event->extension = (buffer[3] << 8) | buffer[4];
+		event->version = (buffer[5] & 0x3e) >> 1;
+		event->section_number = buffer[6];
+		event->last_section = buffer[7];
+	}
+
+	/* Transports are also keyed on the original network. */
+	if (tracker_table_class(buffer[0]) == 0x42 && section_length >= 10) {
+		event->original_network_id = (buffer[8] << 8) | buffer[9];
+	}
+
+	/* Service ids are only unique within a transport. */
+	if (event_table_eit(buffer[0]) && section_length >= 14) {
+		event->transport_id = (buffer[8] << 8) | buffer[9];
+		event->original_network_id = (buffer[10] << 8) | buffer[11];
+		event->segment_last_section = buffer[12];
+	}
+}
+
+static void * worker_thread (void *arg) {
+	Worker *worker = (Worker *) arg;
+	QueueSlot *slot;
+	SectionEvent *event;
+
+	/* Everything parsed on this thread goes into our own model. */
+	data_model = &worker->model;
+
+	while ((slot = (QueueSlot *) queue_read_wait(&worker->sections, WORKER_WAIT_MS)) != NULL || !queue_finished(&worker->sections)) {
+		if (slot == NULL) {
+			continue;
+		}
+
+		if (si_process(slot->data, slot->length, worker->internal_crc) > 0) {
+			worker->parsed++;
+			worker->bytes += slot->length;
+
+			/* Let the dispatcher know so it can stop sending repeats. */
+			while ((event = (SectionEvent *) queue_write_wait(&worker->events, WORKER_WAIT_MS)) == NULL);
+			worker_section_event(slot->data, slot->length, event);
+			queue_write_commit(&worker->events);
+		}
+
+		queue_read_release(&worker->sections);
+	}
+
+	queue_close(&worker->events);
+
+	return NULL;
+}
+
+int worker_pool_start (WorkerPool *pool, int count, int internal_crc, unsigned short local_bouquet_id) {
+	Worker *worker;
+	int i, retval;
+
+	memset(pool, '\0', sizeof(WorkerPool));
+	pool->internal_crc = internal_crc;
+	pool->local_bouquet_id = local_bouquet_id;
+
+	if (count > WORKER_MAX) {
+		slowlane_log(1, "Limiting workers to %i from %i.", WORKER_MAX, count);
+		count = WORKER_MAX;
+	}
+
+	if (tracker_init(&pool->tracker) < 0 || (pool->workers = (Worker *) calloc(count, sizeof(Worker))) == NULL) {
+		slowlane_log(0, "Unable to allocate %i workers.", count);
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		worker = &pool->workers[i];
+		worker->internal_crc = internal_crc;
+		data_model_init(&worker->model);
+		worker->model.shard = 1;
+		data_model_settings(&worker->model, &data_model->settings);
+
+		if (queue_init(&worker->sections, WORKER_QUEUE_SLOTS, sizeof(QueueSlot)) < 0 || queue_init(&worker->events, WORKER_EVENT_SLOTS, sizeof(SectionEvent)) < 0) {
+			return -1;
+		}
+
+		if ((retval = pthread_create(&worker->thread, NULL, worker_thread, worker)) != 0) {
+			slowlane_log(0, "Unable to start worker thread %i (%s).", i, strerror(retval));
+			return -1;
+		}
+
+		pool->count++;
+	}
+
+	slowlane_log(1, "Started %i parsing workers.", pool->count);
+	return 0;
+}
+
+/* Apply everything the workers have accepted to the tracker. */
+static void worker_pool_drain (WorkerPool *pool) {
+	SectionEvent *event;
+	SectionTracking *sections;
+	int i;
+
+	for (i = 0; i < pool->count; i++) {
+		while ((event = (SectionEvent *) queue_read_slot(&pool->workers[i].events)) != NULL) {
+			if ((sections = tracker_get(&pool->tracker, event->table_id, event->extension, event->original_network_id, event->transport_id, 1)) != NULL) {
+				/* As the worker does, a new version of an event table starts it again. */
+				if (sections->populated && sections->version != event->version && (event_table_eit(event->table_id) || event_table_opentv(event->table_id))) {
+					memset(sections, '\0', sizeof(SectionTracking));
+				}
+
+				if (!sections->populated) {
+					sections->version = event->version;
+					sections->last_section = event->last_section;
+					sections->populated = 1;
+				}
+
+				section_tracking_set(sections, event->section_number);
+
+				if (event->table_id >= 0x50 && event_table_eit(event->table_id)) {
+					event_tracking_segment(sections, event->section_number, event->segment_last_section);
+				}
+			}
+
+			queue_read_release(&pool->workers[i].events);
+		}
+	}
+}
+
+/* Take the section at the start of buffer, with the same return as si_process. */
+int worker_pool_dispatch (WorkerPool *pool, unsigned char *buffer, int buffer_length) {
+	int section_length;
+	unsigned int shard;
+	SectionEvent header;
+	SectionTracking *sections;
+	QueueSlot *slot;
+	Worker *worker;
+
+	if ((section_length = si_section_length(buffer, buffer_length)) == 0) {
+		return 0;
+	}
+
+	/* NIT stays on this thread, it's needed before anything else can be completed, as does the BAT of a lineup scan's bouquet. */
+	if (tracker_table_class(buffer[0]) == 0x40 || (pool->local_bouquet_id && buffer[0] == 0x4a && section_length >= 5 && ((buffer[3] << 8) | buffer[4]) == pool->local_bouquet_id)) {
+		return si_process(buffer, buffer_length, pool->internal_crc);
+	}
+
+	worker_pool_drain(pool);
+
+	/* Drop repeats of sections a worker has already accepted. */
+	worker_section_event(buffer, section_length, &header);
+
+	if ((sections = tracker_get(&pool->tracker, header.table_id, header.extension, header.original_network_id, header.transport_id, 0)) != NULL && sections->version == header.version && section_tracking_received(sections, header.section_number)) {
+		pool->repeats++;
+		return section_length;
+	}
+
+	if (section_length > QUEUE_SLOT_SIZE) {
+		slowlane_log(1, "Section of %i bytes is too large to dispatch.", section_length);
+		return -1;
+	}
+
+	/* Each table class and extension always goes to the same worker. */
+	shard = ((unsigned int) worker_shard_class(header.table_id) * 0x9e3779b1u + header.extension) % pool->count;
+	worker = &pool->workers[shard];
+
+	/* Keep taking events while we wait, or the worker could be waiting on us. */
+	while ((slot = (QueueSlot *) queue_write_wait(&worker->sections, WORKER_WAIT_MS)) == NULL) {
+		worker_pool_drain(pool);
+	}
+
+	memcpy(slot->data, buffer, section_length);
+	slot->length = section_length;
+	queue_write_commit(&worker->sections);
+	pool->dispatched++;
+
+	return section_length;
+}
+
+/* Are all transports in the global model and all bouquets and event tables seen complete? */
+int worker_pool_complete (WorkerPool *pool) {
+	Network *network;
+	Transport *transport;
+	SectionTracking *sections;
+	unsigned int i;
+	unsigned char class;
+
+	worker_pool_drain(pool);
+
+	for (network = network_at(data_model->network_list); network != NULL; network = network_at(network->next)) {
+		for (transport = transport_at(network->transports); transport != NULL; transport = transport_at(transport->next)) {
+			sections = tracker_get(&pool->tracker, 0x42, transport->transport_id, transport->original_network_id, 0, 0);
+
+			if (sections == NULL || !section_tracking_check(sections)) {
+				return 0;
+			}
+		}
+	}
+
+	for (i = 0; i < pool->tracker.size; i++) {
+		class = (pool->tracker.entries[i].key >> 32) & 0xff;
+
+		if ((class == 0x4a || event_table_eit(class) || event_table_opentv(class)) && !section_tracking_check(&pool->tracker.entries[i].sections)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* Stop the workers and merge what they built into the global model. */
+void worker_pool_finish (WorkerPool *pool) {
+	Worker *worker;
+	int i;
+
+	for (i = 0; i < pool->count; i++) {
+		queue_close(&pool->workers[i].sections);
+	}
+
+	/* Keep draining until every worker has emptied its queue and gone. */
+	for (i = 0; i < pool->count; i++) {
+		while (!queue_finished(&pool->workers[i].events)) {
+			worker_pool_drain(pool);
+		}
+	}
+
+	for (i = 0; i < pool->count; i++) {
+		worker = &pool->workers[i];
+		pthread_join(worker->thread, NULL);
+
+		slowlane_log(1, "Worker %i parsed %lu sections (%lu bytes).", i, worker->parsed, worker->bytes);
+
+		data_model_merge(&worker->model, 0);
+		data_model_free(&worker->model);
+		queue_free(&worker->sections);
+		queue_free(&worker->events);
+	}
+
+	slowlane_log(1, "Dispatched %lu sections to %i workers, dropped %lu repeats.", pool->dispatched, pool->count, pool->repeats);
+
+	tracker_free(&pool->tracker);
+	free(pool->workers);
+	pool->workers = NULL;
+	pool->count = 0;
+}
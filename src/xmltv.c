@@ -0,0 +1,647 @@
+/* Slowlane - Utility to populate and maintain the MythTV channels tables
+ * with data extracted from the propriatary Media Highway middleware data.
+ *
+ * Peter Wood <peter+slowlane@alastria.net>
+ *
+ * xmltv.c - XMLTV channel overrides. The file is read a block at a time and
+ * scanned once, only <channel> elements being looked at, so a full guide with
+ * its programmes costs no more memory than its channel list. Each channel is
+ * hashed by service and by user number for joining onto the lineup.
+ *
+ * A channel is keyed by the first of its id or display names to look like a
+ * service, "dvb://onid.tsid.sid" in hex as a DVB locator, or "onid.tsid.sid"
+ * or "onid:tsid:sid" in decimal, and by the first display name or <lcn> which
+ * is a plain number, taken as the user number. The first display name which
+ * is neither is the callsign, the first <icon> its icon.
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "slowlane.h"
+#include "pool.h"
+#include "data.h"
+#include "xmltv.h"
+
+/* Largest the read buffer may grow to hold one tag or comment. */
+#define XMLTV_BUFFER_MAX (64 * 1024 * 1024)
+
+/* Text being collected, from a display name or lcn. */
+#define XMLTV_CAPTURE_NONE 0
+#define XMLTV_CAPTURE_NAME 1
+#define XMLTV_CAPTURE_NUMBER 2
+
+typedef struct tXmltvParser {
+	Xmltv		*xmltv;
+
+	/* The channel element being read. */
+	int		in_channel;
+	XmltvChannel	channel;
+	char		xmltvid[XMLTV_TEXT_MAX];
+	char		callsign[XMLTV_TEXT_MAX];
+	char		icon[XMLTV_TEXT_MAX];
+
+	int		capture;
+	char		text[XMLTV_TEXT_MAX];
+	int		text_length;
+} XmltvParser;
+
+static unsigned int xmltv_service_hash (unsigned short original_network_id, unsigned short transport_id, unsigned short service_id) {
+	unsigned long long key = ((unsigned long long) original_network_id << 32) | ((unsigned long long) transport_id << 16) | service_id;
+
+	key ^= key >> 29;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 32;
+	return (unsigned int) key;
+}
+
+static unsigned int xmltv_number_hash (unsigned short user_number) {
+	return user_number * 0x9e3779b1u >> 8;
+}
+
+/* Chain a channel into whichever tables it has a key for, ahead of any
+ * earlier channel with the same key so the later one wins. */
+static void xmltv_chain (Xmltv *xmltv, unsigned int index) {
+	XmltvChannel *channel = xmltv_channel_at(xmltv, index);
+	unsigned int bucket;
+
+	if (channel->has_service) {
+		bucket = xmltv_service_hash(channel->original_network_id, channel->transport_id, channel->service_id) & (xmltv->bucket_count - 1);
+		channel->next_service = xmltv->service_buckets[bucket];
+		xmltv->service_buckets[bucket] = index;
+	}
+
+	if (channel->has_number) {
+		bucket = xmltv_number_hash(channel->user_number) & (xmltv->bucket_count - 1);
+		channel->next_number = xmltv->number_buckets[bucket];
+		xmltv->number_buckets[bucket] = index;
+	}
+}
+
+/* Double the buckets, rechaining in file order so later channels still win. */
+static int xmltv_grow (Xmltv *xmltv) {
+	unsigned int *service_buckets, *number_buckets, bucket_count = xmltv->bucket_count * 2, i;
+
+	if ((service_buckets = (unsigned int *) calloc(bucket_count, sizeof(unsigned int))) == NULL || (number_buckets = (unsigned int *) calloc(bucket_count, sizeof(unsigned int))) == NULL) {
+		slowlane_log(0, "Unable to grow XMLTV channels to %u buckets.", bucket_count);
+		free(service_buckets);
+		return -1;
+	}
+
+	free(xmltv->service_buckets);
+	free(xmltv->number_buckets);
+	xmltv->service_buckets = service_buckets;
+	xmltv->number_buckets = number_buckets;
+	xmltv->bucket_count = bucket_count;
+
+	for (i = 1; i < xmltv->channels.count; i++) {
+		xmltv_chain(xmltv, i);
+	}
+
+	return 0;
+}
+
+static int xmltv_add (Xmltv *xmltv, XmltvChannel *from, const char *xmltvid, const char *callsign, const char *icon) {
+	XmltvChannel *channel;
+	unsigned int index;
+
+	if (xmltv->channels.count > xmltv->bucket_count && xmltv_grow(xmltv) < 0) {
+		return -1;
+	}
+
+	if ((index = pool_alloc(&xmltv->channels)) == POOL_NONE) {
+		return -1;
+	}
+
+	channel = xmltv_channel_at(xmltv, index);
+	memcpy(channel, from, sizeof(XmltvChannel));
+	channel->xmltvid = xmltvid[0] ? strdup(xmltvid) : NULL;
+	channel->callsign = callsign[0] ? strdup(callsign) : NULL;
+	channel->icon = icon[0] ? strdup(icon) : NULL;
+
+	xmltv_chain(xmltv, index);
+
+	return 0;
+}
+
+/* Append a code point as UTF-8. */
+static int xmltv_utf8 (unsigned long code, char *out, int used, int out_size) {
+	char bytes[4];
+	int length;
+
+	if (code == 0) {
+		return used;
+	} else if (code < 0x80) {
+		bytes[0] = code;
+		length = 1;
+	} else if (code < 0x800) {
+		bytes[0] = 0xc0 | (code >> 6);
+		bytes[1] = 0x80 | (code & 0x3f);
+		length = 2;
+	} else if (code < 0x10000) {
+		bytes[0] = 0xe0 | (code >> 12);
+		bytes[1] = 0x80 | ((code >> 6) & 0x3f);
+		bytes[2] = 0x80 | (code & 0x3f);
+		length = 3;
+	} else if (code < 0x110000) {
+		bytes[0] = 0xf0 | (code >> 18);
+		bytes[1] = 0x80 | ((code >> 12) & 0x3f);
+		bytes[2] = 0x80 | ((code >> 6) & 0x3f);
+		bytes[3] = 0x80 | (code & 0x3f);
+		length = 4;
+	} else {
+		return used;
+	}
+
+	if (used + length > out_size - 1) {
+		return used;
+	}
+
+	memcpy(out + used, bytes, length);
+
+	return used + length;
+}
+
+/* Append text with its entities replaced, anything we don't know is kept as
+ * it is. Returns the new length of out, which is always terminated. */
+static int xmltv_decode (const char *p, const char *end, char *out, int used, int out_size) {
+	const char *semicolon;
+	unsigned long code;
+	char *number_end;
+	int length;
+
+	while (p < end) {
+		if (*p != '&' || (semicolon = memchr(p, ';', end - p > 12 ? 12 : end - p)) == NULL) {
+			if (used < out_size - 1) {
+				out[used++] = *p;
+			}
+
+			p++;
+			continue;
+		}
+
+		length = semicolon - p - 1;
+
+		if (length > 1 && p[1] == '#') {
+			code = (p[2] == 'x' || p[2] == 'X') ? strtoul(p + 3, &number_end, 16) : strtoul(p + 2, &number_end, 10);
+
+			if (number_end != semicolon) {
+				code = '&';
+				semicolon = p;
+			}
+
+			used = xmltv_utf8(code, out, used, out_size);
+		} else if (length == 3 && memcmp(p + 1, "amp", 3) == 0) {
+			used = xmltv_utf8('&', out, used, out_size);
+		} else if (length == 2 && memcmp(p + 1, "lt", 2) == 0) {
+			used = xmltv_utf8('<', out, used, out_size);
+		} else if (length == 2 && memcmp(p + 1, "gt", 2) == 0) {
+			used = xmltv_utf8('>', out, used, out_size);
+		} else if (length == 4 && memcmp(p + 1, "quot", 4) == 0) {
+			used = xmltv_utf8('"', out, used, out_size);
+		} else if (length == 4 && memcmp(p + 1, "apos", 4) == 0) {
+			used = xmltv_utf8('\'', out, used, out_size);
+		} else {
+			used = xmltv_utf8('&', out, used, out_size);
+			semicolon = p;
+		}
+
+		p = semicolon + 1;
+	}
+
+	out[used] = '\0';
+
+	return used;
+}
+
+/* A plain decimal number which fits a user number. */
+static int xmltv_number (const char *text, unsigned short *number) {
+	unsigned long value;
+	char *end;
+
+	if (*text < '0' || *text > '9') {
+		return 0;
+	}
+
+	value = strtoul(text, &end, 10);
+
+	if (*end != '\0' || value == 0 || value > 0xffff) {
+		return 0;
+	}
+
+	*number = value;
+
+	return 1;
+}
+
+/* A service in one of the forms above. */
+static int xmltv_service (const char *text, XmltvChannel *channel) {
+	unsigned long value[3];
+	int i, base = 10;
+	char *end;
+
+	if (strncmp(text, "dvb://", 6) == 0) {
+		text += 6;
+		base = 16;
+	}
+
+	for (i = 0; i < 3; i++) {
+		if (!((*text >= '0' && *text <= '9') || (base == 16 && ((*text >= 'a' && *text <= 'f') || (*text >= 'A' && *text <= 'F'))))) {
+			return 0;
+		}
+
+		value[i] = strtoul(text, &end, base);
+
+		if (value[i] > 0xffff || (i == 2 && *end != '\0') || (i < 2 && *end != '.' && (base == 16 || *end != ':'))) {
+			return 0;
+		}
+
+		text = end + 1;
+	}
+
+	channel->original_network_id = value[0];
+	channel->transport_id = value[1];
+	channel->service_id = value[2];
+	channel->has_service = 1;
+
+	return 1;
+}
+
+/* Strip leading and trailing white space in place. */
+static char * xmltv_trim (char *text, int length) {
+	while (length > 0 && (text[length - 1] == ' ' || text[length - 1] == '\t' || text[length - 1] == '\r' || text[length - 1] == '\n')) {
+		text[--length] = '\0';
+	}
+
+	while (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n') {
+		text++;
+	}
+
+	return text;
+}
+
+/* Find an attribute within a start tag, decoding its value into out. */
+static int xmltv_attribute (const char *p, const char *end, const char *name, char *out, int out_size) {
+	int name_length = strlen(name);
+	const char *value;
+	char quote;
+
+	while (p < end) {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' || *p == '/')) {
+			p++;
+		}
+
+		value = p;
+
+		while (p < end && *p != '=' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+			p++;
+		}
+
+		if (p - value == name_length && memcmp(value, name, name_length) == 0) {
+			while (p < end && *p != '"' && *p != '\'') {
+				p++;
+			}
+
+			if (p == end) {
+				return 0;
+			}
+
+			quote = *p++;
+
+			for (value = p; p < end && *p != quote; p++);
+
+			xmltv_decode(value, p, out, 0, out_size);
+			return 1;
+		}
+
+		/* Step over this attribute's value. */
+		while (p < end && *p != '"' && *p != '\'') {
+			p++;
+		}
+
+		if (p == end) {
+			return 0;
+		}
+
+		quote = *p++;
+
+		while (p < end && *p != quote) {
+			p++;
+		}
+
+		p++;
+	}
+
+	return 0;
+}
+
+/* Text from a display name or lcn is finished with. */
+static void xmltv_captured (XmltvParser *parser) {
+	char *text = xmltv_trim(parser->text, parser->text_length);
+	unsigned short number;
+
+	if (xmltv_number(text, &number)) {
+		if (!parser->channel.has_number) {
+			parser->channel.user_number = number;
+			parser->channel.has_number = 1;
+		}
+	} else if (parser->capture == XMLTV_CAPTURE_NAME && !parser->channel.has_service && xmltv_service(text, &parser->channel)) {
+		/* Keyed by service. */
+	} else if (parser->capture == XMLTV_CAPTURE_NAME && parser->callsign[0] == '\0') {
+		snprintf(parser->callsign, sizeof(parser->callsign), "%s", text);
+	}
+
+	parser->capture = XMLTV_CAPTURE_NONE;
+	parser->text_length = 0;
+}
+
+static int xmltv_element (XmltvParser *parser, const char *name, int name_length, const char *attributes, const char *tag_end, int closing, int empty) {
+	char id[XMLTV_TEXT_MAX];
+
+	parser->xmltv->tags++;
+
+	if (name_length == 7 && memcmp(name, "channel", 7) == 0) {
+		if (!closing) {
+			memset(&parser->channel, '\0', sizeof(XmltvChannel));
+			parser->xmltvid[0] = parser->callsign[0] = parser->icon[0] = '\0';
+			parser->in_channel = !empty;
+
+			if (xmltv_attribute(attributes, tag_end, "id", id, sizeof(id))) {
+				snprintf(parser->xmltvid, sizeof(parser->xmltvid), "%s", xmltv_trim(id, strlen(id)));
+				xmltv_service(parser->xmltvid, &parser->channel);
+			}
+
+			/* A self closed channel is an id alone, kept if it names the service. */
+			if (empty && parser->channel.has_service) {
+				return xmltv_add(parser->xmltv, &parser->channel, parser->xmltvid, parser->callsign, parser->icon);
+			}
+		} else if (parser->in_channel) {
+			parser->in_channel = 0;
+
+			if (!parser->channel.has_service && !parser->channel.has_number) {
+				slowlane_log(2, "XMLTV channel %s has neither a service nor a number, skipping.", parser->xmltvid);
+				return 0;
+			}
+
+			return xmltv_add(parser->xmltv, &parser->channel, parser->xmltvid, parser->callsign, parser->icon);
+		}
+	} else if (!parser->in_channel) {
+		return 0;
+	} else if ((name_length == 12 && memcmp(name, "display-name", 12) == 0) || (name_length == 3 && memcmp(name, "lcn", 3) == 0)) {
+		if (closing && parser->capture != XMLTV_CAPTURE_NONE) {
+			xmltv_captured(parser);
+		} else if (!closing && !empty) {
+			parser->capture = name_length == 3 ? XMLTV_CAPTURE_NUMBER : XMLTV_CAPTURE_NAME;
+			parser->text_length = 0;
+		}
+	} else if (name_length == 4 && memcmp(name, "icon", 4) == 0 && !closing && parser->icon[0] == '\0') {
+		xmltv_attribute(attributes, tag_end, "src", parser->icon, sizeof(parser->icon));
+	}
+
+	return 0;
+}
+
+/* The closing '>' of a tag, stepping over quoted values which may hold one. */
+static const char * xmltv_tag_end (const char *p, const char *end) {
+	char quote = 0;
+
+	for (; p < end; p++) {
+		if (quote) {
+			if (*p == quote) {
+				quote = 0;
+			}
+		} else if (*p == '"' || *p == '\'') {
+			quote = *p;
+		} else if (*p == '>') {
+			return p;
+		}
+	}
+
+	return NULL;
+}
+
+/* Where text first appears, NULL if it doesn't yet. */
+static const char * xmltv_find_text (const char *p, const char *end, const char *text) {
+	int length = strlen(text);
+
+	while ((p = memchr(p, text[0], end - p)) != NULL && end - p >= length) {
+		if (memcmp(p, text, length) == 0) {
+			return p;
+		}
+
+		p++;
+	}
+
+	return NULL;
+}
+
+/* Parse what's complete of data, returning how much was used. What's left
+ * is given again with more following it, unless this is the end. */
+static long xmltv_parse (XmltvParser *parser, const char *data, long length, int eof) {
+	const char *p = data, *end = data + length, *next, *name, *name_end;
+	int closing;
+
+	while (p < end) {
+		if (*p != '<') {
+			next = memchr(p, '<', end - p);
+
+			/* Text outside a display name is never needed, however long. */
+			if (parser->capture == XMLTV_CAPTURE_NONE) {
+				p = next ? next : end;
+				continue;
+			}
+
+			/* Wait for the rest, an entity may be cut in two. */
+			if (next == NULL && !eof) {
+				break;
+			}
+
+			parser->text_length = xmltv_decode(p, next ? next : end, parser->text, parser->text_length, sizeof(parser->text));
+			p = next ? next : end;
+			continue;
+		}
+
+		if (end - p < 9 && !eof) {
+			break;
+		}
+
+		if (end - p >= 4 && memcmp(p, "<!--", 4) == 0) {
+			if ((next = xmltv_find_text(p + 4, end, "-->")) == NULL) {
+				break;
+			}
+
+			p = next + 3;
+		} else if (end - p >= 9 && memcmp(p, "<![CDATA[", 9) == 0) {
+			if ((next = xmltv_find_text(p + 9, end, "]]>")) == NULL) {
+				break;
+			}
+
+			if (parser->capture != XMLTV_CAPTURE_NONE && next - p - 9 < (long) sizeof(parser->text) - parser->text_length) {
+				memcpy(parser->text + parser->text_length, p + 9, next - p - 9);
+				parser->text_length += next - p - 9;
+				parser->text[parser->text_length] = '\0';
+			}
+
+			p = next + 3;
+		} else if (end - p >= 2 && p[1] == '?') {
+			if ((next = xmltv_find_text(p + 2, end, "?>")) == NULL) {
+				break;
+			}
+
+			p = next + 2;
+		} else {
+			if ((next = xmltv_tag_end(p + 1, end)) == NULL) {
+				break;
+			}
+
+			/* Declarations such as the DOCTYPE are passed over. */
+			if (p[1] != '!') {
+				name = p + 1;
+				closing = *name == '/';
+				name += closing;
+
+				for (name_end = name; name_end < next && *name_end != ' ' && *name_end != '\t' && *name_end != '\r' && *name_end != '\n' && *name_end != '/'; name_end++);
+
+				if (xmltv_element(parser, name, name_end - name, name_end, next, closing, next[-1] == '/') < 0) {
+					return -1;
+				}
+			}
+
+			p = next + 1;
+		}
+	}
+
+	return p - data;
+}
+
+/* Read a channels file, or a whole guide, "-" being stdin. */
+int xmltv_load (Xmltv *xmltv, const char *filename) {
+	XmltvParser parser;
+	char *buffer, *grown;
+	long size = XMLTV_READ_SIZE, used = 0, consumed;
+	ssize_t bytes;
+	int fd, eof = 0, retval = 0;
+
+	memset(xmltv, '\0', sizeof(Xmltv));
+	memset(&parser, '\0', sizeof(XmltvParser));
+	parser.xmltv = xmltv;
+
+	if ((fd = strcmp(filename, "-") == 0 ? STDIN_FILENO : open(filename, O_RDONLY)) < 0) {
+		slowlane_log(0, "Unable to open XMLTV file %s.", filename);
+		return -1;
+	}
+
+	pool_init(&xmltv->channels, sizeof(XmltvChannel), 8);
+	xmltv->bucket_count = XMLTV_INITIAL_BUCKETS;
+
+	if ((xmltv->service_buckets = (unsigned int *) calloc(xmltv->bucket_count, sizeof(unsigned int))) == NULL || (xmltv->number_buckets = (unsigned int *) calloc(xmltv->bucket_count, sizeof(unsigned int))) == NULL || (buffer = (char *) malloc(size)) == NULL) {
+		slowlane_log(0, "Unable to allocate XMLTV buffers for %s.", filename);
+		retval = -1;
+		buffer = NULL;
+	}
+
+	while (retval == 0 && !eof) {
+		if ((bytes = read(fd, buffer + used, size - used)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			slowlane_log(0, "Unable to read XMLTV file %s.", filename);
+			retval = -1;
+			break;
+		}
+
+		eof = bytes == 0;
+		used += bytes;
+		xmltv->bytes += bytes;
+
+		if ((consumed = xmltv_parse(&parser, buffer, used, eof)) < 0) {
+			retval = -1;
+			break;
+		}
+
+		memmove(buffer, buffer + consumed, used - consumed);
+		used -= consumed;
+
+		/* One tag or comment fills the buffer. */
+		if (used == size) {
+			if (size * 2 > XMLTV_BUFFER_MAX || (grown = (char *) realloc(buffer, size * 2)) == NULL) {
+				slowlane_log(0, "XMLTV file %s has a tag of over %li bytes.", filename, size);
+				retval = -1;
+				break;
+			}
+
+			buffer = grown;
+			size *= 2;
+		}
+	}
+
+	if (retval == 0 && used > 0) {
+		slowlane_log(1, "XMLTV file %s ends part way through a tag, %li bytes ignored.", filename, used);
+	}
+
+	free(buffer);
+
+	if (fd != STDIN_FILENO) {
+		close(fd);
+	}
+
+	if (retval < 0) {
+		xmltv_free(xmltv);
+		return -1;
+	}
+
+	slowlane_log(1, "XMLTV file %s has %u channels in %lu bytes, %lu tags.", filename, xmltv->channels.count - 1, xmltv->bytes, xmltv->tags);
+
+	return 0;
+}
+
+void xmltv_free (Xmltv *xmltv) {
+	XmltvChannel *channel;
+	unsigned int i;
+
+	for (i = 1; i < xmltv->channels.count; i++) {
+		channel = xmltv_channel_at(xmltv, i);
+		free(channel->xmltvid);
+		free(channel->callsign);
+		free(channel->icon);
+	}
+
+	pool_free_all(&xmltv->channels);
+	free(xmltv->service_buckets);
+	free(xmltv->number_buckets);
+	memset(xmltv, '\0', sizeof(Xmltv));
+}
+
+/* The override for a lineup channel, by service first and then by user
+ * number, NULL if there's neither. */
+XmltvChannel * xmltv_find (Xmltv *xmltv, OpenTVChannel *channel) {
+	XmltvChannel *match;
+	unsigned int index;
+
+	if (xmltv->bucket_count == 0) {
+		return NULL;
+	}
+
+	for (index = xmltv->service_buckets[xmltv_service_hash(channel->original_network_id, channel->transport_id, channel->service_id) & (xmltv->bucket_count - 1)]; index != POOL_NONE; index = match->next_service) {
+		match = xmltv_channel_at(xmltv, index);
+
+		if (match->original_network_id == channel->original_network_id && match->transport_id == channel->transport_id && match->service_id == channel->service_id) {
+			return match;
+		}
+	}
+
+	for (index = xmltv->number_buckets[xmltv_number_hash(channel->user_number) & (xmltv->bucket_count - 1)]; index != POOL_NONE; index = match->next_number) {
+		match = xmltv_channel_at(xmltv, index);
+
+		if (match->user_number == channel->user_number) {
+			return match;
+		}
+	}
+
+	return NULL;
+}